@@ -0,0 +1,268 @@
+#include "BenchReport.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include "Logger.h"
+
+namespace
+{
+    using JsonWriter = rapidjson::PrettyWriter<rapidjson::StringBuffer>;
+
+    // differences below these are timer and allocator noise, not regressions
+    constexpr double MIN_TIMING_DELTA_MS = 0.05;
+    constexpr double MIN_LOAD_DELTA_MS = 5.0;
+    constexpr double MIN_MEMORY_DELTA_MB = 4.0;
+
+    void WriteTimings(JsonWriter &writer, const char *key, const std::vector<std::pair<std::string, ProfileStats>> &timings)
+    {
+        writer.Key(key);
+        writer.StartObject();
+        for (const auto &[name, stats] : timings)
+        {
+            writer.Key(name.c_str());
+            writer.StartObject();
+            writer.Key("count");
+            writer.Uint(stats.count);
+            writer.Key("avgMs");
+            writer.Double(stats.avgMs);
+            writer.Key("minMs");
+            writer.Double(stats.minMs);
+            writer.Key("maxMs");
+            writer.Double(stats.maxMs);
+            writer.Key("p50Ms");
+            writer.Double(stats.p50Ms);
+            writer.Key("p95Ms");
+            writer.Double(stats.p95Ms);
+            writer.Key("p99Ms");
+            writer.Double(stats.p99Ms);
+            writer.EndObject();
+        }
+        writer.EndObject();
+    }
+
+    void WriteScene(JsonWriter &writer, const BenchSceneResult &result)
+    {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(result.name.c_str());
+        writer.Key("succeeded");
+        writer.Bool(result.succeeded);
+        writer.Key("device");
+        writer.String(result.device.c_str());
+        writer.Key("frames");
+        writer.Uint(result.frameCount);
+        writer.Key("startupMs");
+        writer.Double(result.startupMs);
+        writer.Key("loadMs");
+        writer.Double(result.loadMs);
+        writer.Key("peakRssMb");
+        writer.Double(result.peakRssMb);
+        writer.Key("peakGpuMemoryMb");
+        writer.Double(result.peakGpuMemoryMb);
+        WriteTimings(writer, "cpu", result.cpuTimings);
+        WriteTimings(writer, "gpu", result.gpuTimings);
+        writer.EndObject();
+    }
+
+    double GetDouble(const rapidjson::Value &value, const char *key)
+    {
+        auto iter = value.FindMember(key);
+        return iter != value.MemberEnd() && iter->value.IsNumber() ? iter->value.GetDouble() : 0.0;
+    }
+
+    void ReadTimings(const rapidjson::Value &value, const char *key, std::vector<std::pair<std::string, ProfileStats>> &timings)
+    {
+        timings.clear();
+        auto iter = value.FindMember(key);
+        if (iter == value.MemberEnd() || !iter->value.IsObject())
+            return;
+
+        for (const auto &member : iter->value.GetObject())
+        {
+            ProfileStats stats;
+            stats.count = (uint32_t)GetDouble(member.value, "count");
+            stats.avgMs = GetDouble(member.value, "avgMs");
+            stats.minMs = GetDouble(member.value, "minMs");
+            stats.maxMs = GetDouble(member.value, "maxMs");
+            stats.p50Ms = GetDouble(member.value, "p50Ms");
+            stats.p95Ms = GetDouble(member.value, "p95Ms");
+            stats.p99Ms = GetDouble(member.value, "p99Ms");
+            timings.emplace_back(member.name.GetString(), stats);
+        }
+    }
+
+    void ReadScene(const rapidjson::Value &value, BenchSceneResult &result)
+    {
+        if (value.HasMember("name") && value["name"].IsString())
+            result.name = value["name"].GetString();
+        if (value.HasMember("succeeded") && value["succeeded"].IsBool())
+            result.succeeded = value["succeeded"].GetBool();
+        if (value.HasMember("device") && value["device"].IsString())
+            result.device = value["device"].GetString();
+        result.frameCount = (uint32_t)GetDouble(value, "frames");
+        result.startupMs = GetDouble(value, "startupMs");
+        result.loadMs = GetDouble(value, "loadMs");
+        result.peakRssMb = GetDouble(value, "peakRssMb");
+        result.peakGpuMemoryMb = GetDouble(value, "peakGpuMemoryMb");
+        ReadTimings(value, "cpu", result.cpuTimings);
+        ReadTimings(value, "gpu", result.gpuTimings);
+    }
+
+    bool WriteFile(const std::string &path, const rapidjson::StringBuffer &buffer)
+    {
+        std::ofstream file(path);
+        if (!file.is_open())
+        {
+            LOG_WARN("Failed to write {}", path);
+            return false;
+        }
+        file << buffer.GetString() << "\n";
+        return true;
+    }
+
+    bool ParseFile(const std::string &path, rapidjson::Document &document)
+    {
+        std::ifstream file(path);
+        if (!file.is_open())
+            return false;
+
+        std::stringstream content;
+        content << file.rdbuf();
+        document.Parse(content.str().c_str());
+        if (document.HasParseError() || !document.IsObject())
+        {
+            LOG_WARN("{} is not a valid benchmark json", path);
+            return false;
+        }
+        return true;
+    }
+
+    // true when current is worse than baseline beyond both the relative threshold and the noise floor
+    bool CheckMetric(const std::string &scene, const std::string &metric, double current, double baseline, double threshold, double minDelta)
+    {
+        const double delta = current - baseline;
+        const double ratio = baseline > 0.0 ? delta / baseline : 0.0;
+        if (delta > minDelta && ratio > threshold)
+        {
+            LOG_WARN("REGRESSION {} {}: {:.3f} -> {:.3f} ({:+.1f}%)", scene, metric, baseline, current, ratio * 100.0);
+            return true;
+        }
+        if (-delta > minDelta && -ratio > threshold)
+            LOG_INFO("improved {} {}: {:.3f} -> {:.3f} ({:+.1f}%)", scene, metric, baseline, current, ratio * 100.0);
+        return false;
+    }
+
+    uint32_t CompareTimings(const std::string &scene, const char *track,
+                            const std::vector<std::pair<std::string, ProfileStats>> &current,
+                            const std::vector<std::pair<std::string, ProfileStats>> &baseline,
+                            double threshold)
+    {
+        uint32_t regressions = 0;
+        for (const auto &[name, baseStats] : baseline)
+        {
+            auto iter = std::find_if(current.begin(), current.end(), [&](const auto &timing)
+                                     { return timing.first == name; });
+            // renamed or removed scopes are not comparable
+            if (iter == current.end() || baseStats.count == 0 || iter->second.count == 0)
+                continue;
+
+            if (CheckMetric(scene, std::string(track) + " " + name + " p50Ms", iter->second.p50Ms, baseStats.p50Ms, threshold, MIN_TIMING_DELTA_MS))
+                ++regressions;
+        }
+        return regressions;
+    }
+}
+
+bool WriteBenchSceneResult(const std::string &path, const BenchSceneResult &result)
+{
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    WriteScene(writer, result);
+    return WriteFile(path, buffer);
+}
+
+bool ReadBenchSceneResult(const std::string &path, BenchSceneResult &result)
+{
+    rapidjson::Document document;
+    if (!ParseFile(path, document))
+        return false;
+    ReadScene(document, result);
+    return true;
+}
+
+bool WriteBenchReport(const std::string &path, const BenchReport &report)
+{
+    rapidjson::StringBuffer buffer;
+    JsonWriter writer(buffer);
+    writer.StartObject();
+    writer.Key("frames");
+    writer.Uint(report.frameCount);
+    writer.Key("warmupFrames");
+    writer.Uint(report.warmupFrameCount);
+    writer.Key("scenes");
+    writer.StartArray();
+    for (const auto &scene : report.scenes)
+        WriteScene(writer, scene);
+    writer.EndArray();
+    writer.EndObject();
+    return WriteFile(path, buffer);
+}
+
+bool ReadBenchReport(const std::string &path, BenchReport &report)
+{
+    rapidjson::Document document;
+    if (!ParseFile(path, document))
+        return false;
+
+    report.frameCount = (uint32_t)GetDouble(document, "frames");
+    report.warmupFrameCount = (uint32_t)GetDouble(document, "warmupFrames");
+    report.scenes.clear();
+    if (document.HasMember("scenes") && document["scenes"].IsArray())
+    {
+        for (const auto &value : document["scenes"].GetArray())
+        {
+            BenchSceneResult result;
+            ReadScene(value, result);
+            report.scenes.emplace_back(result);
+        }
+    }
+    return true;
+}
+
+uint32_t CompareWithBaseline(const BenchReport &current, const BenchReport &baseline, double threshold)
+{
+    if (current.frameCount != baseline.frameCount)
+        LOG_WARN("Baseline ran {} frames, this run {}, timings may not be comparable", baseline.frameCount, current.frameCount);
+
+    uint32_t regressions = 0;
+    for (const auto &base : baseline.scenes)
+    {
+        auto iter = std::find_if(current.scenes.begin(), current.scenes.end(), [&](const BenchSceneResult &scene)
+                                 { return scene.name == base.name; });
+        if (iter == current.scenes.end())
+            continue;
+
+        const BenchSceneResult &cur = *iter;
+        if (!base.succeeded)
+            continue;
+        if (!cur.succeeded)
+        {
+            LOG_WARN("REGRESSION {}: ran in the baseline but failed now", cur.name);
+            ++regressions;
+            continue;
+        }
+
+        if (cur.device != base.device)
+            LOG_WARN("{}: baseline was recorded on {}, this run uses {}", cur.name, base.device, cur.device);
+
+        regressions += CheckMetric(cur.name, "loadMs", cur.loadMs, base.loadMs, threshold, MIN_LOAD_DELTA_MS);
+        regressions += CheckMetric(cur.name, "peakRssMb", cur.peakRssMb, base.peakRssMb, threshold, MIN_MEMORY_DELTA_MB);
+        regressions += CheckMetric(cur.name, "peakGpuMemoryMb", cur.peakGpuMemoryMb, base.peakGpuMemoryMb, threshold, MIN_MEMORY_DELTA_MB);
+        regressions += CompareTimings(cur.name, "cpu", cur.cpuTimings, base.cpuTimings, threshold);
+        regressions += CompareTimings(cur.name, "gpu", cur.gpuTimings, base.gpuTimings, threshold);
+    }
+    return regressions;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Profiler.h"
+
+struct BenchSceneResult
+{
+    std::string name;
+    // false when the scene crashed or the device lacks the features it needs
+    bool succeeded = false;
+    std::string device;
+    uint32_t frameCount = 0;
+
+    // process start until the first frame, instance and device creation included
+    double startupMs = 0.0;
+    // Scene::Init alone: shader compilation, asset import and uploads
+    double loadMs = 0.0;
+
+    double peakRssMb = 0.0;
+    // 0 when the device has no VK_EXT_memory_budget
+    double peakGpuMemoryMb = 0.0;
+
+    std::vector<std::pair<std::string, ProfileStats>> cpuTimings;
+    std::vector<std::pair<std::string, ProfileStats>> gpuTimings;
+};
+
+struct BenchReport
+{
+    uint32_t frameCount = 0;
+    uint32_t warmupFrameCount = 0;
+    std::vector<BenchSceneResult> scenes;
+};
+
+bool WriteBenchSceneResult(const std::string &path, const BenchSceneResult &result);
+bool ReadBenchSceneResult(const std::string &path, BenchSceneResult &result);
+
+bool WriteBenchReport(const std::string &path, const BenchReport &report);
+bool ReadBenchReport(const std::string &path, BenchReport &report);
+
+// Logs every metric that got worse than the baseline by more than threshold (0.1 = 10%),
+// timings use the median so a single hitch does not fail the run. Returns the number of regressions.
+uint32_t CompareWithBaseline(const BenchReport &current, const BenchReport &baseline, double threshold);
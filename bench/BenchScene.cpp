@@ -0,0 +1,97 @@
+#include "BenchScene.h"
+#include <algorithm>
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+BenchScene::BenchScene(const std::string &name, std::unique_ptr<Scene> scene, uint64_t processStart)
+    : mScene(std::move(scene)), mProcessStart(processStart)
+{
+    mResult.name = name;
+}
+
+void BenchScene::Init()
+{
+    mResult.device = App::Instance().GetGraphicsContext()->GetDevice()->GetPhysicalProps().deviceName;
+
+    const uint64_t start = Timer::Now();
+    mScene->Init();
+    mResult.loadMs = (Timer::Now() - start) / 1e6;
+
+    SampleMemory();
+}
+
+void BenchScene::ProcessInput()
+{
+    mScene->ProcessInput();
+}
+
+void BenchScene::Update()
+{
+    if (mFirstFrame)
+    {
+        mResult.startupMs = (Timer::Now() - mProcessStart) / 1e6;
+        mFirstFrame = false;
+    }
+    mScene->Update();
+}
+
+void BenchScene::Render()
+{
+    mScene->Render();
+    SampleMemory();
+}
+
+void BenchScene::RenderUI()
+{
+    mScene->RenderUI();
+}
+
+void BenchScene::CleanUp()
+{
+    mScene->CleanUp();
+}
+
+BenchSceneResult BenchScene::GetResult() const
+{
+    BenchSceneResult result = mResult;
+    result.succeeded = true;
+    result.peakRssMb = GetPeakRssMb();
+
+    auto &profiler = Profiler::Instance();
+    result.frameCount = profiler.GetStats("Frame").count;
+    for (const auto &name : profiler.GetNames(ProfileTrack::CPU))
+        result.cpuTimings.emplace_back(name, profiler.GetStats(name, ProfileTrack::CPU));
+    for (const auto &name : profiler.GetNames(ProfileTrack::GPU))
+        result.gpuTimings.emplace_back(name, profiler.GetStats(name, ProfileTrack::GPU));
+    return result;
+}
+
+double BenchScene::GetPeakRssMb()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0.0;
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+#if defined(__APPLE__)
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    // kilobytes on linux
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+void BenchScene::SampleMemory()
+{
+    const uint64_t gpuMemory = App::Instance().GetGraphicsContext()->GetDevice()->GetDeviceLocalMemoryUsage();
+    mResult.peakGpuMemoryMb = std::max(mResult.peakGpuMemoryMb, gpuMemory / (1024.0 * 1024.0));
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include "labgraphics.h"
+#include "BenchReport.h"
+
+// Wraps the scene under test to time its Init and to sample the memory usage every frame
+class BenchScene : public Scene
+{
+public:
+    // processStart is a Timer::Now tick taken first thing in main
+    BenchScene(const std::string &name, std::unique_ptr<Scene> scene, uint64_t processStart);
+    ~BenchScene() override {}
+
+    void Init() override;
+    void ProcessInput() override;
+    void Update() override;
+    void Render() override;
+    void RenderUI() override;
+    void CleanUp() override;
+
+    // call after App::Run returned, adds the profiler stats of the timed frames
+    BenchSceneResult GetResult() const;
+
+    static double GetPeakRssMb();
+
+private:
+    void SampleMemory();
+
+    std::unique_ptr<Scene> mScene;
+    uint64_t mProcessStart;
+    bool mFirstFrame = true;
+    BenchSceneResult mResult;
+};
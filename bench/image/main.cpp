@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include "ImageProcessing.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    constexpr uint32_t WIDTH = 2048;
+    constexpr uint32_t HEIGHT = 1024;
+
+    struct Sources
+    {
+        ImageData ldrRgb{ImageDataType::RGB8, WIDTH, HEIGHT};
+        ImageData ldrRgba{ImageDataType::RGBA8, WIDTH, HEIGHT};
+        ImageData hdrRgb{ImageDataType::RGB32F, WIDTH, HEIGHT};
+        ImageData hdrRgba{ImageDataType::RGBA32F, WIDTH, HEIGHT};
+    };
+
+    // noise over a smooth gradient, the hdr values spread over a few stops above and below 1 like a sky map
+    void FillSources(Sources &sources)
+    {
+        uint32_t state = 12345u;
+        auto next = [&state]()
+        {
+            state = state * 1664525u + 1013904223u;
+            return state >> 8;
+        };
+
+        const size_t pixelCount = (size_t)WIDTH * HEIGHT;
+        for (size_t i = 0; i < pixelCount * 3; ++i)
+            sources.ldrRgb.GetPixels<uint8_t>()[i] = (uint8_t)next();
+        for (size_t i = 0; i < pixelCount * 4; ++i)
+            sources.ldrRgba.GetPixels<uint8_t>()[i] = (uint8_t)next();
+        for (size_t i = 0; i < pixelCount; ++i)
+        {
+            const float gradient = (float)(i % WIDTH) / WIDTH * 8.0f - 4.0f;
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const float value = std::exp2(gradient + (next() & 0xFFFF) / 65536.0f * 4.0f - 2.0f);
+                if (c < 3)
+                    sources.hdrRgb.GetPixels<float>()[i * 3 + c] = value;
+                sources.hdrRgba.GetPixels<float>()[i * 4 + c] = c < 3 ? value : 1.0f;
+            }
+        }
+    }
+
+    struct Operation
+    {
+        const char *name;
+        // source texels processed, levels below the first included
+        double pixels;
+        std::function<std::vector<ImageData>(const ImageProcessingSettings &)> run;
+    };
+
+    std::vector<ImageData> Single(ImageData image)
+    {
+        std::vector<ImageData> images;
+        images.emplace_back(std::move(image));
+        return images;
+    }
+
+    // Largest difference to the scalar output: codes for unorm8, bit patterns for half (the conversions round the
+    // same way and must agree exactly), relative error for float.
+    double GetMaxError(const std::vector<ImageData> &images, const std::vector<ImageData> &references)
+    {
+        double maxError = 0.0;
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            const ImageData &image = images[i];
+            const ImageData &reference = references[i];
+            const size_t count = (size_t)image.GetWidth() * image.GetHeight() * GetImageDataTypeChannels(image.GetType());
+            for (size_t j = 0; j < count; ++j)
+            {
+                double error;
+                if (IsFloat32ImageDataType(image.GetType()))
+                {
+                    const double value = image.GetPixels<float>()[j], expected = reference.GetPixels<float>()[j];
+                    error = std::abs(value - expected) / std::max(1.0, std::abs(expected));
+                }
+                else if (image.GetType() == ImageDataType::RGB16F || image.GetType() == ImageDataType::RGBA16F)
+                    error = std::abs((int)image.GetPixels<uint16_t>()[j] - (int)reference.GetPixels<uint16_t>()[j]);
+                else
+                    error = std::abs((int)image.GetPixels<uint8_t>()[j] - (int)reference.GetPixels<uint8_t>()[j]);
+                maxError = std::max(maxError, error);
+            }
+        }
+        return maxError;
+    }
+
+    double GetErrorLimit(ImageDataType type)
+    {
+        if (IsFloat32ImageDataType(type))
+            return 1.0e-5;
+        if (type == ImageDataType::RGB16F || type == ImageDataType::RGBA16F)
+            return 0.0;
+        return 1.0;
+    }
+
+    struct Result
+    {
+        std::string name;
+        SimdLevel level;
+        uint32_t threadCount;
+        double ms;
+        double mpixelsPerSecond;
+        // against scalar on one thread
+        double speedup;
+        double efficiency;
+        double maxError;
+    };
+
+    bool WriteJson(const std::string &path, const std::vector<Result> &results)
+    {
+        char date[64] = {};
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        rapidjson::StringBuffer buffer;
+        rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("context");
+        writer.StartObject();
+        writer.Key("date");
+        writer.String(date);
+        writer.Key("num_cpus");
+        writer.Uint(std::thread::hardware_concurrency());
+        writer.Key("simd");
+        writer.String(GetSimdLevelName(GetSimdLevel()));
+        writer.EndObject();
+
+        writer.Key("benchmarks");
+        writer.StartArray();
+        for (const auto &result : results)
+        {
+            writer.StartObject();
+            writer.Key("name");
+            writer.String(result.name.c_str());
+            writer.Key("simd");
+            writer.String(GetSimdLevelName(result.level));
+            writer.Key("threads");
+            writer.Uint(result.threadCount);
+            writer.Key("real_time");
+            writer.Double(result.ms);
+            writer.Key("time_unit");
+            writer.String("ms");
+            writer.Key("mpixels_per_second");
+            writer.Double(result.mpixelsPerSecond);
+            writer.Key("speedup");
+            writer.Double(result.speedup);
+            writer.Key("efficiency");
+            writer.Double(result.efficiency);
+            writer.Key("max_error");
+            writer.Double(result.maxError);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+
+        std::ofstream file(path);
+        if (!file.is_open())
+        {
+            std::fprintf(stderr, "Failed to write %s\n", path.c_str());
+            return false;
+        }
+        file << buffer.GetString() << "\n";
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string outputPath;
+    int repetitions = 3;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.rfind("--benchmark_out=", 0) == 0)
+            outputPath = arg.substr(std::strlen("--benchmark_out="));
+        else if (arg.rfind("--benchmark_repetitions=", 0) == 0)
+            repetitions = std::max(1, std::atoi(arg.c_str() + std::strlen("--benchmark_repetitions=")));
+        else
+        {
+            std::printf("usage: labgraphics_image_bench [--benchmark_repetitions=<n>] [--benchmark_out=<file.json>]\n");
+            return 1;
+        }
+    }
+
+    // the calling thread works too, one more than the pool
+    const uint32_t maxThreads = ThreadPool::Instance().GetThreadCount() + 1;
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t count = 1; count < maxThreads; count *= 2)
+        threadCounts.push_back(count);
+    threadCounts.push_back(maxThreads);
+
+    Sources sources;
+    FillSources(sources);
+    // results and resize temporaries recycled between repetitions, as a per frame caller would
+    ImagePool pool;
+
+    const double pixels = (double)WIDTH * HEIGHT;
+    const Operation operations[] = {
+        {"rgb8_to_rgba8", pixels, [&](const ImageProcessingSettings &settings)
+         { return Single(ConvertToRgba(sources.ldrRgb, settings)); }},
+        {"rgb32f_to_rgba32f", pixels, [&](const ImageProcessingSettings &settings)
+         { return Single(ConvertToRgba(sources.hdrRgb, settings)); }},
+        {"float_to_half", pixels, [&](const ImageProcessingSettings &settings)
+         { return Single(ConvertFloatToHalf(sources.hdrRgba, settings)); }},
+        {"srgb_to_linear", pixels, [&](const ImageProcessingSettings &settings)
+         { return Single(ConvertSrgbToLinear(sources.ldrRgba, settings)); }},
+        {"resize_lanczos3", pixels, [&](const ImageProcessingSettings &settings)
+         { return Single(ResizeImage(sources.hdrRgba, WIDTH * 5 / 8, HEIGHT * 5 / 8, ResampleFilter::LANCZOS3, settings)); }},
+        {"mips_box", pixels * 4.0 / 3.0, [&](const ImageProcessingSettings &settings)
+         { return GenerateImageMips(sources.hdrRgba, ResampleFilter::BOX, settings); }},
+        {"tonemap_reinhard", pixels, [&](const ImageProcessingSettings &settings)
+         { return Single(TonemapImage(sources.hdrRgba, TonemapSettings{}, settings)); }},
+        {"tonemap_aces_rgb", pixels, [&](const ImageProcessingSettings &settings)
+         {
+             TonemapSettings tonemap;
+             tonemap.op = TonemapOperator::ACES;
+             return Single(TonemapImage(sources.hdrRgb, tonemap, settings));
+         }},
+    };
+
+    std::printf("%ux%u, %s supported, %u threads\n\n", WIDTH, HEIGHT, GetSimdLevelName(GetSimdLevel()), maxThreads);
+    std::printf("%-18s %-8s %8s %10s %10s %10s %10s %10s\n", "operation", "simd", "threads", "ms", "Mpix/s", "speedup", "efficiency", "max error");
+
+    std::vector<Result> results;
+    bool passed = true;
+    for (const auto &operation : operations)
+    {
+        std::vector<ImageData> scalarImages;
+        double baselineMs = 0.0;
+        for (int level = (int)SimdLevel::SCALAR; level <= (int)GetSimdLevel(); ++level)
+        {
+            double singleThreadMs = 0.0;
+            for (uint32_t threadCount : threadCounts)
+            {
+                ImageProcessingSettings settings;
+                settings.level = (SimdLevel)level;
+                settings.threadCount = threadCount;
+                settings.pool = &pool;
+
+                std::vector<ImageData> images;
+                double bestMs = 0.0;
+                for (int repetition = 0; repetition < repetitions; ++repetition)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    images = operation.run(settings);
+                    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    bestMs = repetition == 0 ? ms : std::min(bestMs, ms);
+                }
+
+                if (scalarImages.empty())
+                {
+                    scalarImages = operation.run(settings);
+                    baselineMs = bestMs;
+                }
+                if (threadCount == 1)
+                    singleThreadMs = bestMs;
+
+                Result result;
+                result.name = std::string(operation.name) + "/" + GetSimdLevelName((SimdLevel)level) + "/threads:" + std::to_string(threadCount);
+                result.level = (SimdLevel)level;
+                result.threadCount = threadCount;
+                result.ms = bestMs;
+                result.mpixelsPerSecond = operation.pixels / (bestMs * 1.0e3);
+                result.speedup = baselineMs / bestMs;
+                // thread scaling only, the SIMD gain is in speedup
+                result.efficiency = singleThreadMs / bestMs / threadCount;
+                result.maxError = GetMaxError(images, scalarImages);
+                std::printf("%-18s %-8s %8u %10.2f %10.1f %9.2fx %9.0f%% %10.3g\n", operation.name, GetSimdLevelName(result.level), threadCount, result.ms,
+                            result.mpixelsPerSecond, result.speedup, 100.0 * result.efficiency, result.maxError);
+                results.emplace_back(result);
+
+                passed &= result.maxError <= GetErrorLimit(images.front().GetType());
+            }
+        }
+        std::printf("\n");
+    }
+
+    if (!outputPath.empty())
+        passed &= WriteJson(outputPath, results);
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include "labgraphics.h"
+#include "BenchReport.h"
+#include "BenchScene.h"
+#include "SceneSph.h"
+#include "SceneMandelbrotSetGen.h"
+#include "SceneRayTraceTriangle.h"
+#include "SceneDescriptorStress.h"
+#include "PathTracer/RaymanScene.h"
+#include "Pbr/PbrScene.h"
+
+struct BenchOptions
+{
+    std::vector<std::string> scenes;
+    uint32_t frameCount = 300;
+    uint32_t warmupFrameCount = 30;
+    std::string outputDir = "bench";
+    std::string baselinePath;
+    double threshold = 0.1;
+    // set on the child processes, one scene each
+    std::string runScene;
+};
+
+static const std::vector<std::pair<std::string, std::function<std::unique_ptr<Scene>()>>> gBenchScenes = {
+    {"sph", []()
+     { return std::make_unique<SceneSph>(); }},
+    {"mandelbrot", []()
+     { return std::make_unique<SceneMandelbrotSetGen>(); }},
+    {"pbr", []()
+     { return std::make_unique<PbrScene>(); }},
+    {"rayman", []()
+     { return std::make_unique<RaymanScene>(std::string(ASSETS_DIR) + "rayman/scene.json"); }},
+    {"raytrace_triangle", []()
+     { return std::make_unique<SceneRayTraceTriangle>(); }},
+    {"descriptor_stress", []()
+     { return std::make_unique<SceneDescriptorStress>(); }},
+};
+
+static void PrintUsage()
+{
+    std::cout << "usage: labgraphics_bench [options]\n"
+              << "  --scenes a,b,c      subset of sph, mandelbrot, pbr, rayman, raytrace_triangle,\n"
+              << "                      descriptor_stress (default all)\n"
+              << "  --frames N          frames rendered per scene (default 300)\n"
+              << "  --warmup N          leading frames excluded from the timings (default 30)\n"
+              << "  --output DIR        bench.json, traces and the last frame of every scene (default bench)\n"
+              << "  --baseline FILE     bench.json of an earlier run, exits with 1 on regressions\n"
+              << "  --threshold F       allowed slowdown against the baseline, 0.1 = 10% (default 0.1)\n";
+}
+
+static bool ParseOptions(int argc, char **argv, BenchOptions &options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--scenes" && hasValue)
+        {
+            std::stringstream list(argv[++i]);
+            std::string scene;
+            while (std::getline(list, scene, ','))
+                options.scenes.emplace_back(scene);
+        }
+        else if (arg == "--frames" && hasValue)
+            options.frameCount = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--warmup" && hasValue)
+            options.warmupFrameCount = (uint32_t)std::stoul(argv[++i]);
+        else if (arg == "--output" && hasValue)
+            options.outputDir = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            options.baselinePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            options.threshold = std::stod(argv[++i]);
+        else if (arg == "--run" && hasValue)
+            options.runScene = argv[++i];
+        else
+            return false;
+    }
+
+    if (options.scenes.empty())
+    {
+        for (const auto &[name, factory] : gBenchScenes)
+            options.scenes.emplace_back(name);
+    }
+    return true;
+}
+
+static std::string GetSceneDir(const BenchOptions &options, const std::string &scene)
+{
+    return (std::filesystem::path(options.outputDir) / scene).string();
+}
+
+// Child process: App is a process wide singleton, every scene gets a fresh process, device and heap
+static int RunScene(const BenchOptions &options, uint64_t processStart)
+{
+    auto iter = std::find_if(gBenchScenes.begin(), gBenchScenes.end(), [&](const auto &scene)
+                             { return scene.first == options.runScene; });
+    if (iter == gBenchScenes.end())
+    {
+        std::cerr << "unknown scene " << options.runScene << std::endl;
+        return 1;
+    }
+
+    HeadlessSettings settings;
+    settings.frameCount = options.frameCount;
+    settings.warmupFrameCount = options.warmupFrameCount;
+    settings.outputDir = GetSceneDir(options, options.runScene);
+    App::Instance().SetHeadless(settings);
+
+    BenchScene *benchScene = new BenchScene(options.runScene, iter->second(), processStart);
+    App::Instance().AddScene(benchScene);
+    App::Instance().Run();
+
+    return WriteBenchSceneResult(settings.outputDir + "/result.json", benchScene->GetResult()) ? 0 : 1;
+}
+
+static int RunAll(const BenchOptions &options, const std::string &executable)
+{
+    Logger::Init();
+
+    BenchReport report;
+    report.frameCount = options.frameCount;
+    report.warmupFrameCount = options.warmupFrameCount;
+
+    std::error_code errorCode;
+    std::filesystem::create_directories(options.outputDir, errorCode);
+
+    for (const auto &scene : options.scenes)
+    {
+        const std::string sceneDir = GetSceneDir(options, scene);
+        std::filesystem::remove(sceneDir + "/result.json", errorCode);
+
+        std::stringstream command;
+        command << "\"" << executable << "\" --run " << scene
+                << " --frames " << options.frameCount
+                << " --warmup " << options.warmupFrameCount
+                << " --output \"" << options.outputDir << "\"";
+
+        LOG_INFO("Benchmarking {}", scene);
+#if defined(_WIN32)
+        // cmd.exe strips the first and last quote of the line
+        const int exitCode = std::system(("\"" + command.str() + "\"").c_str());
+#else
+        const int exitCode = std::system(command.str().c_str());
+#endif
+
+        BenchSceneResult result;
+        result.name = scene;
+        if (exitCode != 0 || !ReadBenchSceneResult(sceneDir + "/result.json", result))
+        {
+            LOG_WARN("{} failed with exit code {}", scene, exitCode);
+            result = BenchSceneResult();
+            result.name = scene;
+        }
+        else
+        {
+            ProfileStats frame;
+            for (const auto &[name, stats] : result.cpuTimings)
+            {
+                if (name == "Frame")
+                    frame = stats;
+            }
+            LOG_INFO("{}: load {:.1f} ms, frame p50 {:.3f} ms p99 {:.3f} ms, peak rss {:.1f} MB, peak gpu memory {:.1f} MB",
+                     scene, result.loadMs, frame.p50Ms, frame.p99Ms, result.peakRssMb, result.peakGpuMemoryMb);
+        }
+        report.scenes.emplace_back(result);
+    }
+
+    const std::string reportPath = (std::filesystem::path(options.outputDir) / "bench.json").string();
+    WriteBenchReport(reportPath, report);
+    LOG_INFO("Benchmark results written to {}", reportPath);
+
+    if (options.baselinePath.empty())
+        return 0;
+
+    BenchReport baseline;
+    if (!ReadBenchReport(options.baselinePath, baseline))
+    {
+        LOG_WARN("Failed to read baseline {}", options.baselinePath);
+        return 1;
+    }
+
+    const uint32_t regressions = CompareWithBaseline(report, baseline, options.threshold);
+    if (regressions > 0)
+    {
+        LOG_WARN("{} regressions against {} beyond {:.0f}%", regressions, options.baselinePath, options.threshold * 100.0);
+        return 1;
+    }
+    LOG_INFO("No regressions against {}", options.baselinePath);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const uint64_t processStart = Timer::Now();
+
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (!options.runScene.empty())
+        return RunScene(options, processStart);
+    return RunAll(options, argv[0]);
+}
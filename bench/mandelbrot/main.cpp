@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+#include "Mandelbrot.h"
+
+namespace
+{
+    constexpr uint32_t WIDTH = 1280;
+    constexpr uint32_t HEIGHT = 720;
+
+    struct View
+    {
+        const char *name;
+        std::complex<long double> center;
+        // height of the view in the complex plane
+        long double extent;
+        uint32_t maxIterations;
+    };
+
+    const View VIEWS[] = {
+        // the scene's start view
+        {"shallow", {-0.445L, 0.0L}, 2.34L, 1024},
+        // seahorse valley spiral, deep enough for the series skip and rebasing to matter
+        {"deep", {-0.743643887037158704752191506114774L, 0.131825904205311970493132056385139L}, 1.0e-10L, 4096},
+    };
+
+    struct Frame
+    {
+        MandelbrotUniform uniform;
+        MandelbrotReference reference;
+        std::vector<MandelbrotTileJob> jobs;
+    };
+
+    // the whole frame at full resolution in one go, the way a panned out view is rendered tile by tile
+    Frame CreateFrame(const View &view)
+    {
+        Frame frame;
+        const long double pixelScale = view.extent / HEIGHT;
+        const float halfDiagonal = 0.5f * std::sqrt((float)WIDTH * WIDTH + (float)HEIGHT * HEIGHT);
+
+        MandelbrotUniform &uniform = frame.uniform;
+        uniform = {};
+        uniform.width = WIDTH;
+        uniform.height = HEIGHT;
+        uniform.bufferWidth = (WIDTH + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+        uniform.bufferHeight = (HEIGHT + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE;
+        uniform.origin = Vector2i32(0, 0);
+        uniform.referencePixel = Vector2i32((int32_t)WIDTH / 2, (int32_t)HEIGHT / 2);
+        uniform.pixelScale = (float)pixelScale;
+        uniform.seriesRadius = halfDiagonal;
+        uniform.maxIterations = view.maxIterations;
+        uniform.tileSize = TILE_SIZE;
+
+        frame.reference = BuildMandelbrotReference(view.center, halfDiagonal * pixelScale, view.maxIterations);
+        uniform.seriesA = frame.reference.seriesA;
+        uniform.seriesB = frame.reference.seriesB;
+        uniform.seriesC = frame.reference.seriesC;
+        uniform.orbitLength = (uint32_t)frame.reference.orbit.size();
+        uniform.skipIterations = frame.reference.skipIterations;
+
+        for (uint32_t y = 0; y < uniform.bufferHeight; y += TILE_SIZE)
+            for (uint32_t x = 0; x < uniform.bufferWidth; x += TILE_SIZE)
+                frame.jobs.push_back(MandelbrotTileJob{Vector2i32((int32_t)x, (int32_t)y), 1, 0});
+        return frame;
+    }
+
+    struct Result
+    {
+        std::string name;
+        SimdLevel level;
+        uint32_t threadCount;
+        double ms;
+        double giterationsPerSecond;
+        // against scalar on one thread
+        double speedup;
+        double efficiency;
+        double mismatch;
+    };
+
+    double CountMismatch(const std::vector<uint32_t> &image, const std::vector<uint32_t> &reference)
+    {
+        size_t mismatches = 0;
+        for (size_t i = 0; i < image.size(); ++i)
+            mismatches += image[i] != reference[i];
+        return 100.0 * mismatches / image.size();
+    }
+
+    bool WriteJson(const std::string &path, const std::vector<Result> &results)
+    {
+        char date[64] = {};
+        const std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        rapidjson::StringBuffer buffer;
+        rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+        writer.StartObject();
+        writer.Key("context");
+        writer.StartObject();
+        writer.Key("date");
+        writer.String(date);
+        writer.Key("num_cpus");
+        writer.Uint(std::thread::hardware_concurrency());
+        writer.Key("simd");
+        writer.String(GetSimdLevelName(GetSimdLevel()));
+        writer.EndObject();
+
+        writer.Key("benchmarks");
+        writer.StartArray();
+        for (const auto &result : results)
+        {
+            writer.StartObject();
+            writer.Key("name");
+            writer.String(result.name.c_str());
+            writer.Key("simd");
+            writer.String(GetSimdLevelName(result.level));
+            writer.Key("threads");
+            writer.Uint(result.threadCount);
+            writer.Key("real_time");
+            writer.Double(result.ms);
+            writer.Key("time_unit");
+            writer.String("ms");
+            writer.Key("giterations_per_second");
+            writer.Double(result.giterationsPerSecond);
+            writer.Key("speedup");
+            writer.Double(result.speedup);
+            writer.Key("efficiency");
+            writer.Double(result.efficiency);
+            writer.Key("mismatch_percent");
+            writer.Double(result.mismatch);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+
+        std::ofstream file(path);
+        if (!file.is_open())
+        {
+            std::fprintf(stderr, "Failed to write %s\n", path.c_str());
+            return false;
+        }
+        file << buffer.GetString() << "\n";
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string outputPath;
+    int repetitions = 3;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.rfind("--benchmark_out=", 0) == 0)
+            outputPath = arg.substr(std::strlen("--benchmark_out="));
+        else if (arg.rfind("--benchmark_repetitions=", 0) == 0)
+            repetitions = std::max(1, std::atoi(arg.c_str() + std::strlen("--benchmark_repetitions=")));
+        else
+        {
+            std::printf("usage: labgraphics_mandelbrot_bench [--benchmark_repetitions=<n>] [--benchmark_out=<file.json>]\n");
+            return 1;
+        }
+    }
+
+    // the calling thread works too, one more than the pool
+    const uint32_t maxThreads = ThreadPool::Instance().GetThreadCount() + 1;
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t count = 1; count < maxThreads; count *= 2)
+        threadCounts.push_back(count);
+    threadCounts.push_back(maxThreads);
+
+    std::printf("%ux%u, %s supported, %u threads\n\n", WIDTH, HEIGHT, GetSimdLevelName(GetSimdLevel()), maxThreads);
+    std::printf("%-8s %-8s %8s %12s %12s %10s %10s %10s\n", "view", "simd", "threads", "ms", "Giter/s", "speedup", "efficiency", "mismatch");
+
+    std::vector<Result> results;
+    bool passed = true;
+    for (const auto &view : VIEWS)
+    {
+        const Frame frame = CreateFrame(view);
+        const size_t pixelCount = (size_t)frame.uniform.bufferWidth * frame.uniform.bufferHeight;
+
+        std::vector<uint32_t> scalarImage;
+        double baselineMs = 0.0;
+        for (int level = (int)SimdLevel::SCALAR; level <= (int)GetSimdLevel(); ++level)
+        {
+            const MandelbrotCpuRenderer renderer((SimdLevel)level);
+            double singleThreadMs = 0.0;
+            for (uint32_t threadCount : threadCounts)
+            {
+                std::vector<uint32_t> image(pixelCount);
+                double bestMs = 0.0;
+                uint64_t iterations = 0;
+                for (int repetition = 0; repetition < repetitions; ++repetition)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    iterations = renderer.Render(frame.uniform, frame.reference.orbit.data(), frame.jobs, image.data(), threadCount);
+                    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    bestMs = repetition == 0 ? ms : std::min(bestMs, ms);
+                }
+
+                if (scalarImage.empty())
+                {
+                    scalarImage = image;
+                    baselineMs = bestMs;
+                }
+                if (threadCount == 1)
+                    singleThreadMs = bestMs;
+
+                Result result;
+                result.name = std::string(view.name) + "/" + GetSimdLevelName((SimdLevel)level) + "/threads:" + std::to_string(threadCount);
+                result.level = (SimdLevel)level;
+                result.threadCount = threadCount;
+                result.ms = bestMs;
+                result.giterationsPerSecond = iterations / (bestMs * 1.0e6);
+                result.speedup = baselineMs / bestMs;
+                // thread scaling only, the SIMD gain is in speedup
+                result.efficiency = singleThreadMs / bestMs / threadCount;
+                result.mismatch = CountMismatch(image, scalarImage);
+                std::printf("%-8s %-8s %8u %12.2f %12.3f %9.2fx %9.0f%% %9.3f%%\n", view.name, GetSimdLevelName(result.level), threadCount, result.ms,
+                            result.giterationsPerSecond, result.speedup, 100.0 * result.efficiency, result.mismatch);
+                results.emplace_back(result);
+
+                // lanes iterate the same float operations, differences are fma contraction on boundary pixels
+                passed &= result.mismatch < 1.0;
+            }
+        }
+        std::printf("\n");
+    }
+
+    if (!outputPath.empty())
+        passed &= WriteJson(outputPath, results);
+    return passed ? 0 : 1;
+}
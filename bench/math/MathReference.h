@@ -0,0 +1,177 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <utility>
+#include "Math/Matrix4.h"
+#include "Math/Quaternion.h"
+#include "Math/Transform.h"
+
+// Straightforward double precision versions of the Math operations under test. They share no code
+// with the float templates (which are SSE backed and only instantiate for float), so an error in
+// either shows up as a mismatch.
+namespace Reference
+{
+    // column major like Matrix4
+    using Mat4 = std::array<double, 16>;
+    using Vec3 = std::array<double, 3>;
+    // x, y, z, w
+    using Quat = std::array<double, 4>;
+
+    struct Trs
+    {
+        Vec3 position;
+        Quat rotation;
+        Vec3 scale;
+    };
+
+    inline Mat4 FromMatrix(const Matrix4f &m)
+    {
+        Mat4 result;
+        for (size_t i = 0; i < 16; ++i)
+            result[i] = m.elements[i];
+        return result;
+    }
+
+    inline Quat FromQuaternion(const Quaternionf &q)
+    {
+        return {q.x, q.y, q.z, q.w};
+    }
+
+    inline Vec3 FromVector(const Vector3f &v)
+    {
+        return {v.x, v.y, v.z};
+    }
+
+    inline Trs FromTransform(const Transformf &t)
+    {
+        return {FromVector(t.position), FromQuaternion(t.rotation), FromVector(t.scale)};
+    }
+
+    inline Mat4 Multiply(const Mat4 &a, const Mat4 &b)
+    {
+        Mat4 result{};
+        for (size_t col = 0; col < 4; ++col)
+            for (size_t row = 0; row < 4; ++row)
+                for (size_t k = 0; k < 4; ++k)
+                    result[col * 4 + row] += a[k * 4 + row] * b[col * 4 + k];
+        return result;
+    }
+
+    // Gauss-Jordan with partial pivoting
+    inline Mat4 Inverse(const Mat4 &m)
+    {
+        double a[4][8];
+        for (size_t row = 0; row < 4; ++row)
+        {
+            for (size_t col = 0; col < 4; ++col)
+            {
+                a[row][col] = m[col * 4 + row];
+                a[row][col + 4] = row == col ? 1.0 : 0.0;
+            }
+        }
+
+        for (size_t col = 0; col < 4; ++col)
+        {
+            size_t pivot = col;
+            for (size_t row = col + 1; row < 4; ++row)
+                if (std::abs(a[row][col]) > std::abs(a[pivot][col]))
+                    pivot = row;
+            for (size_t k = 0; k < 8; ++k)
+                std::swap(a[col][k], a[pivot][k]);
+
+            const double invPivot = 1.0 / a[col][col];
+            for (size_t k = 0; k < 8; ++k)
+                a[col][k] *= invPivot;
+
+            for (size_t row = 0; row < 4; ++row)
+            {
+                if (row == col)
+                    continue;
+                const double factor = a[row][col];
+                for (size_t k = 0; k < 8; ++k)
+                    a[row][k] -= factor * a[col][k];
+            }
+        }
+
+        Mat4 result;
+        for (size_t row = 0; row < 4; ++row)
+            for (size_t col = 0; col < 4; ++col)
+                result[col * 4 + row] = a[row][col + 4];
+        return result;
+    }
+
+    inline Quat Normalize(const Quat &q)
+    {
+        const double length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        return {q[0] / length, q[1] / length, q[2] / length, q[3] / length};
+    }
+
+    inline double Dot(const Quat &a, const Quat &b)
+    {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    }
+
+    // shortest path, like Quaternion::Slerp
+    inline Quat Slerp(const Quat &a, Quat b, double t)
+    {
+        double cosom = Dot(a, b);
+        if (cosom < 0.0)
+        {
+            cosom = -cosom;
+            b = {-b[0], -b[1], -b[2], -b[3]};
+        }
+
+        double scale0 = 1.0 - t, scale1 = t;
+        if (cosom < 1.0 - 1e-12)
+        {
+            const double omega = std::acos(cosom);
+            scale0 = std::sin((1.0 - t) * omega) / std::sin(omega);
+            scale1 = std::sin(t * omega) / std::sin(omega);
+        }
+        return Normalize({scale0 * a[0] + scale1 * b[0], scale0 * a[1] + scale1 * b[1], scale0 * a[2] + scale1 * b[2], scale0 * a[3] + scale1 * b[3]});
+    }
+
+    // no neighbourhood check, like Quaternion::NLerp
+    inline Quat NLerp(const Quat &a, const Quat &b, double t)
+    {
+        return Normalize({(1.0 - t) * a[0] + t * b[0], (1.0 - t) * a[1] + t * b[1], (1.0 - t) * a[2] + t * b[2], (1.0 - t) * a[3] + t * b[3]});
+    }
+
+    inline Quat Multiply(const Quat &a, const Quat &b)
+    {
+        return {a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1],
+                a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0],
+                a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3],
+                a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2]};
+    }
+
+    // q v q* for a unit quaternion
+    inline Vec3 Rotate(const Quat &q, const Vec3 &v)
+    {
+        const Quat p = Multiply(Multiply(q, {v[0], v[1], v[2], 0.0}), {-q[0], -q[1], -q[2], q[3]});
+        return {p[0], p[1], p[2]};
+    }
+
+    inline Vec3 TransformPoint(const Trs &t, const Vec3 &p)
+    {
+        const Vec3 rotated = Rotate(t.rotation, {p[0] * t.scale[0], p[1] * t.scale[1], p[2] * t.scale[2]});
+        return {rotated[0] + t.position[0], rotated[1] + t.position[1], rotated[2] + t.position[2]};
+    }
+
+    // applying the combined transform equals applying b, then a
+    inline Trs Combine(const Trs &a, const Trs &b)
+    {
+        Trs result;
+        result.scale = {a.scale[0] * b.scale[0], a.scale[1] * b.scale[1], a.scale[2] * b.scale[2]};
+        result.rotation = Multiply(a.rotation, b.rotation);
+        result.position = TransformPoint(a, b.position);
+        return result;
+    }
+
+    inline Vec3 TransformPoint(const Mat4 &m, const Vec3 &p)
+    {
+        return {m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12],
+                m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13],
+                m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14]};
+    }
+}
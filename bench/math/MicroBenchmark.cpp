@@ -0,0 +1,174 @@
+#include "MicroBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <regex>
+#include <thread>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+BenchmarkState::BenchmarkState(int64_t arg, uint64_t iterations)
+    : mArg(arg), mIterations(iterations), mRemaining(iterations)
+{
+}
+
+void MicroBenchmark::Register(const std::string &name, Function function, const std::vector<int64_t> &args)
+{
+    mEntries.push_back({name, function, args});
+}
+
+bool MicroBenchmark::ParseArgs(int argc, char **argv)
+{
+    mExecutable = argc > 0 ? argv[0] : "";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        auto value = [&](const char *flag) -> const char *
+        {
+            const size_t length = strlen(flag);
+            return arg.compare(0, length, flag) == 0 ? argv[i] + length : nullptr;
+        };
+
+        if (const char *filter = value("--benchmark_filter="))
+            mFilter = filter;
+        else if (const char *minTime = value("--benchmark_min_time="))
+            mMinTime = std::stod(minTime);
+        else if (const char *out = value("--benchmark_out="))
+            mOutputPath = out;
+        else
+            return false;
+    }
+    return true;
+}
+
+BenchmarkResult MicroBenchmark::Run(const std::string &name, const Function &function, int64_t arg) const
+{
+    // grow the iteration count until one run lasts mMinTime, the way Google Benchmark calibrates
+    uint64_t iterations = 1;
+    while (true)
+    {
+        BenchmarkState state(arg, iterations);
+
+        const auto realStart = std::chrono::steady_clock::now();
+        const std::clock_t cpuStart = std::clock();
+        function(state);
+        const std::clock_t cpuEnd = std::clock();
+        const auto realEnd = std::chrono::steady_clock::now();
+
+        const double realSeconds = std::chrono::duration<double>(realEnd - realStart).count();
+        const double cpuSeconds = (double)(cpuEnd - cpuStart) / CLOCKS_PER_SEC;
+
+        if (realSeconds >= mMinTime || iterations >= 1000000000ull)
+        {
+            BenchmarkResult result;
+            result.name = name;
+            result.iterations = iterations;
+            result.realTimeNs = realSeconds * 1e9 / iterations;
+            result.cpuTimeNs = cpuSeconds * 1e9 / iterations;
+            if (state.GetItemsProcessed() > 0 && cpuSeconds > 0.0)
+                result.itemsPerSecond = state.GetItemsProcessed() / cpuSeconds;
+            return result;
+        }
+
+        const double multiplier = mMinTime * 1.4 / std::max(realSeconds, 1e-9);
+        iterations = (uint64_t)std::clamp((double)iterations * multiplier, (double)iterations + 1.0, (double)iterations * 10.0);
+    }
+}
+
+std::vector<BenchmarkResult> MicroBenchmark::RunAll() const
+{
+    const std::regex filter(mFilter);
+
+    std::printf("%-48s %14s %14s %12s %16s\n", "Benchmark", "Time (ns)", "CPU (ns)", "Iterations", "Items/s");
+    std::vector<BenchmarkResult> results;
+    for (const auto &entry : mEntries)
+    {
+        std::vector<std::pair<std::string, int64_t>> runs;
+        if (entry.args.empty())
+            runs.emplace_back(entry.name, 0);
+        for (int64_t arg : entry.args)
+            runs.emplace_back(entry.name + "/" + std::to_string(arg), arg);
+
+        for (const auto &[name, arg] : runs)
+        {
+            if (!std::regex_search(name, filter))
+                continue;
+
+            BenchmarkResult result = Run(name, entry.function, arg);
+            std::printf("%-48s %14.2f %14.2f %12llu %16.4g\n", result.name.c_str(), result.realTimeNs, result.cpuTimeNs, (unsigned long long)result.iterations, result.itemsPerSecond);
+            results.emplace_back(result);
+        }
+    }
+    return results;
+}
+
+bool MicroBenchmark::WriteJson(const std::vector<BenchmarkResult> &results) const
+{
+    if (mOutputPath.empty())
+        return true;
+
+    char date[64] = {};
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+
+    writer.Key("context");
+    writer.StartObject();
+    writer.Key("date");
+    writer.String(date);
+    writer.Key("executable");
+    writer.String(mExecutable.c_str());
+    writer.Key("num_cpus");
+    writer.Uint(std::thread::hardware_concurrency());
+    writer.Key("library_build_type");
+#if defined(NDEBUG)
+    writer.String("release");
+#else
+    writer.String("debug");
+#endif
+    writer.EndObject();
+
+    writer.Key("benchmarks");
+    writer.StartArray();
+    for (const auto &result : results)
+    {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(result.name.c_str());
+        writer.Key("run_name");
+        writer.String(result.name.c_str());
+        writer.Key("run_type");
+        writer.String("iteration");
+        writer.Key("iterations");
+        writer.Uint64(result.iterations);
+        writer.Key("real_time");
+        writer.Double(result.realTimeNs);
+        writer.Key("cpu_time");
+        writer.Double(result.cpuTimeNs);
+        writer.Key("time_unit");
+        writer.String("ns");
+        if (result.itemsPerSecond > 0.0)
+        {
+            writer.Key("items_per_second");
+            writer.Double(result.itemsPerSecond);
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+
+    std::ofstream file(mOutputPath);
+    if (!file.is_open())
+    {
+        std::fprintf(stderr, "Failed to write %s\n", mOutputPath.c_str());
+        return false;
+    }
+    file << buffer.GetString() << "\n";
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// A small stand-in for Google Benchmark: the same loop shape, flags and json schema,
+// so results can be diffed with its compare.py without adding the dependency.
+class BenchmarkState
+{
+public:
+    BenchmarkState(int64_t arg, uint64_t iterations);
+
+    // while (state.KeepRunning()) runs the timed body GetIterations times
+    bool KeepRunning()
+    {
+        if (mRemaining == 0)
+            return false;
+        --mRemaining;
+        return true;
+    }
+
+    int64_t GetArg() const { return mArg; }
+    uint64_t GetIterations() const { return mIterations; }
+
+    // turns into items_per_second, e.g. points transformed
+    void SetItemsProcessed(uint64_t items) { mItemsProcessed = items; }
+    uint64_t GetItemsProcessed() const { return mItemsProcessed; }
+
+private:
+    int64_t mArg;
+    uint64_t mIterations;
+    uint64_t mRemaining;
+    uint64_t mItemsProcessed = 0;
+};
+
+// Keeps the compiler from folding away a result that is otherwise unused
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(_MSC_VER)
+    const volatile char *sink = reinterpret_cast<const volatile char *>(&value);
+    (void)*sink;
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t iterations = 0;
+    double realTimeNs = 0.0;
+    double cpuTimeNs = 0.0;
+    double itemsPerSecond = 0.0;
+};
+
+class MicroBenchmark
+{
+public:
+    using Function = std::function<void(BenchmarkState &)>;
+
+    static MicroBenchmark &Instance()
+    {
+        static MicroBenchmark instance;
+        return instance;
+    }
+
+    // an empty arg list runs the benchmark once without argument, otherwise once per arg as name/arg
+    void Register(const std::string &name, Function function, const std::vector<int64_t> &args = {});
+
+    // accepts --benchmark_filter=<regex>, --benchmark_min_time=<seconds> and --benchmark_out=<file>
+    bool ParseArgs(int argc, char **argv);
+
+    std::vector<BenchmarkResult> RunAll() const;
+    bool WriteJson(const std::vector<BenchmarkResult> &results) const;
+
+    const std::string &GetOutputPath() const { return mOutputPath; }
+
+private:
+    MicroBenchmark() = default;
+
+    BenchmarkResult Run(const std::string &name, const Function &function, int64_t arg) const;
+
+    struct Entry
+    {
+        std::string name;
+        Function function;
+        std::vector<int64_t> args;
+    };
+
+    std::vector<Entry> mEntries;
+    std::string mFilter = ".*";
+    double mMinTime = 0.5;
+    std::string mOutputPath;
+    std::string mExecutable;
+};
+
+struct BenchmarkRegistration
+{
+    BenchmarkRegistration(const std::string &name, MicroBenchmark::Function function, const std::vector<int64_t> &args = {})
+    {
+        MicroBenchmark::Instance().Register(name, function, args);
+    }
+};
+
+#define MICRO_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define MICRO_BENCHMARK_CONCAT(a, b) MICRO_BENCHMARK_CONCAT_IMPL(a, b)
+#define MICRO_BENCHMARK(function, ...) static BenchmarkRegistration MICRO_BENCHMARK_CONCAT(benchmarkRegistration, __LINE__)(#function, function, {__VA_ARGS__})
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "Math/Matrix4.h"
+#include "Math/Quaternion.h"
+#include "Math/Transform.h"
+#include "Math/Vector3.h"
+#include "Math/Vector4.h"
+#include "MathReference.h"
+#include "MicroBenchmark.h"
+
+namespace
+{
+    constexpr size_t INPUT_COUNT = 64;
+
+    struct Inputs
+    {
+        std::vector<Matrix4f> matrices;
+        std::vector<Quaternionf> rotations;
+        std::vector<Transformf> transforms;
+        std::vector<Vector3f> points;
+        std::vector<float> factors;
+    };
+
+    Quaternionf RandomRotation(std::mt19937 &rng)
+    {
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        return Quaternionf::Normalize(Quaternionf(normal(rng), normal(rng), normal(rng), normal(rng)));
+    }
+
+    Vector3f RandomVector(std::mt19937 &rng, float min, float max)
+    {
+        std::uniform_real_distribution<float> uniform(min, max);
+        return Vector3f(uniform(rng), uniform(rng), uniform(rng));
+    }
+
+    // well conditioned TRS transforms, the kind the scenes actually build
+    Inputs CreateInputs(size_t pointCount)
+    {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        Inputs inputs;
+        for (size_t i = 0; i < INPUT_COUNT; ++i)
+        {
+            Transformf transform(RandomVector(rng, -10.0f, 10.0f), RandomRotation(rng), RandomVector(rng, 0.5f, 2.0f));
+            inputs.transforms.emplace_back(transform);
+            inputs.matrices.emplace_back(Transformf::ToMatrix4(transform));
+            inputs.rotations.emplace_back(RandomRotation(rng));
+            inputs.factors.emplace_back(unit(rng));
+        }
+        for (size_t i = 0; i < pointCount; ++i)
+            inputs.points.emplace_back(RandomVector(rng, -100.0f, 100.0f));
+        return inputs;
+    }
+
+    const Inputs &GetInputs()
+    {
+        static const Inputs inputs = CreateInputs(65536);
+        return inputs;
+    }
+
+    // error relative to the magnitude of the reference, absolute near zero, so cancellation in
+    // a single component of a large vector does not count as imprecision
+    template <size_t N>
+    double MaxError(const std::array<double, N> &value, const std::array<double, N> &reference)
+    {
+        double error = 0.0, magnitude = 0.0;
+        for (size_t i = 0; i < N; ++i)
+        {
+            error += (value[i] - reference[i]) * (value[i] - reference[i]);
+            magnitude += reference[i] * reference[i];
+        }
+        return std::sqrt(error) / std::max(1.0, std::sqrt(magnitude));
+    }
+
+    // q and -q are the same rotation
+    double MaxError(Reference::Quat value, const Reference::Quat &reference)
+    {
+        if (Reference::Dot(value, reference) < 0.0)
+            value = {-value[0], -value[1], -value[2], -value[3]};
+        return MaxError<4>(value, reference);
+    }
+
+    struct Check
+    {
+        const char *name;
+        double tolerance;
+        double maxError;
+    };
+
+    std::vector<Check> RunChecks()
+    {
+        const Inputs &inputs = GetInputs();
+        std::vector<Check> checks = {
+            {"Matrix4 multiply", 1e-5, 0.0},
+            {"Matrix4 inverse", 1e-4, 0.0},
+            {"Quaternion slerp", 1e-5, 0.0},
+            {"Quaternion nlerp", 1e-5, 0.0},
+            {"Transform combine", 1e-5, 0.0},
+            {"Transform point", 1e-5, 0.0},
+            {"Matrix4 point", 1e-5, 0.0},
+        };
+
+        for (size_t i = 0; i < INPUT_COUNT; ++i)
+        {
+            const size_t j = (i + 1) % INPUT_COUNT;
+            const Reference::Mat4 a = Reference::FromMatrix(inputs.matrices[i]);
+            const Reference::Mat4 b = Reference::FromMatrix(inputs.matrices[j]);
+
+            checks[0].maxError = std::max(checks[0].maxError, MaxError(Reference::FromMatrix(inputs.matrices[i] * inputs.matrices[j]), Reference::Multiply(a, b)));
+            checks[1].maxError = std::max(checks[1].maxError, MaxError(Reference::FromMatrix(Matrix4f::Inverse(inputs.matrices[i])), Reference::Inverse(a)));
+
+            const Quaternionf &qa = inputs.rotations[i];
+            const Quaternionf &qb = inputs.rotations[j];
+            const float t = inputs.factors[i];
+            checks[2].maxError = std::max(checks[2].maxError, MaxError(Reference::FromQuaternion(Quaternionf::Slerp(qa, qb, t)), Reference::Slerp(Reference::FromQuaternion(qa), Reference::FromQuaternion(qb), t)));
+            checks[3].maxError = std::max(checks[3].maxError, MaxError(Reference::FromQuaternion(Quaternionf::NLerp(qa, qb, t)), Reference::NLerp(Reference::FromQuaternion(qa), Reference::FromQuaternion(qb), t)));
+
+            const Reference::Trs ta = Reference::FromTransform(inputs.transforms[i]);
+            const Reference::Trs tb = Reference::FromTransform(inputs.transforms[j]);
+            const Reference::Trs combined = Reference::FromTransform(Transformf::Combine(inputs.transforms[i], inputs.transforms[j]));
+            const Reference::Trs expected = Reference::Combine(ta, tb);
+            checks[4].maxError = std::max({checks[4].maxError, MaxError(combined.position, expected.position), MaxError(combined.rotation, expected.rotation), MaxError(combined.scale, expected.scale)});
+        }
+
+        for (size_t i = 0; i < inputs.points.size(); ++i)
+        {
+            const size_t t = i % INPUT_COUNT;
+            const Vector3f &point = inputs.points[i];
+            const Reference::Vec3 expected = Reference::TransformPoint(Reference::FromTransform(inputs.transforms[t]), Reference::FromVector(point));
+
+            checks[5].maxError = std::max(checks[5].maxError, MaxError(Reference::FromVector(Transformf::TransformPoint(inputs.transforms[t], point)), expected));
+
+            const Vector4f transformed = inputs.matrices[t] * Vector4f(point, 1.0f);
+            checks[6].maxError = std::max(checks[6].maxError, MaxError(Reference::Vec3{transformed.x, transformed.y, transformed.z}, Reference::TransformPoint(Reference::FromMatrix(inputs.matrices[t]), Reference::FromVector(point))));
+        }
+        return checks;
+    }
+
+    void BM_Matrix4Multiply(BenchmarkState &state)
+    {
+        const auto &matrices = GetInputs().matrices;
+        size_t i = 0;
+        while (state.KeepRunning())
+        {
+            Matrix4f result = matrices[i % INPUT_COUNT] * matrices[(i + 1) % INPUT_COUNT];
+            DoNotOptimize(result);
+            ++i;
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    }
+
+    void BM_Matrix4Inverse(BenchmarkState &state)
+    {
+        const auto &matrices = GetInputs().matrices;
+        size_t i = 0;
+        while (state.KeepRunning())
+        {
+            Matrix4f result = Matrix4f::Inverse(matrices[i % INPUT_COUNT]);
+            DoNotOptimize(result);
+            ++i;
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    }
+
+    void BM_QuaternionSlerp(BenchmarkState &state)
+    {
+        const auto &rotations = GetInputs().rotations;
+        const auto &factors = GetInputs().factors;
+        size_t i = 0;
+        while (state.KeepRunning())
+        {
+            Quaternionf result = Quaternionf::Slerp(rotations[i % INPUT_COUNT], rotations[(i + 1) % INPUT_COUNT], factors[i % INPUT_COUNT]);
+            DoNotOptimize(result);
+            ++i;
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    }
+
+    void BM_QuaternionNLerp(BenchmarkState &state)
+    {
+        const auto &rotations = GetInputs().rotations;
+        const auto &factors = GetInputs().factors;
+        size_t i = 0;
+        while (state.KeepRunning())
+        {
+            Quaternionf result = Quaternionf::NLerp(rotations[i % INPUT_COUNT], rotations[(i + 1) % INPUT_COUNT], factors[i % INPUT_COUNT]);
+            DoNotOptimize(result);
+            ++i;
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    }
+
+    void BM_TransformCombine(BenchmarkState &state)
+    {
+        const auto &transforms = GetInputs().transforms;
+        size_t i = 0;
+        while (state.KeepRunning())
+        {
+            Transformf result = Transformf::Combine(transforms[i % INPUT_COUNT], transforms[(i + 1) % INPUT_COUNT]);
+            DoNotOptimize(result);
+            ++i;
+        }
+        state.SetItemsProcessed(state.GetIterations());
+    }
+
+    // the arg is the batch size, one transform applied to a contiguous array of points
+    void BM_TransformPointBatch(BenchmarkState &state)
+    {
+        const Transformf &transform = GetInputs().transforms[0];
+        const size_t count = (size_t)state.GetArg();
+        std::vector<Vector3f> points(GetInputs().points.begin(), GetInputs().points.begin() + count);
+        std::vector<Vector3f> output(count);
+        while (state.KeepRunning())
+        {
+            for (size_t i = 0; i < count; ++i)
+                output[i] = Transformf::TransformPoint(transform, points[i]);
+            DoNotOptimize(output.data());
+        }
+        state.SetItemsProcessed(state.GetIterations() * count);
+    }
+
+    void BM_Matrix4PointBatch(BenchmarkState &state)
+    {
+        const Matrix4f &matrix = GetInputs().matrices[0];
+        const size_t count = (size_t)state.GetArg();
+        std::vector<Vector4f> points;
+        points.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+            points.emplace_back(GetInputs().points[i], 1.0f);
+        std::vector<Vector4f> output(count);
+        while (state.KeepRunning())
+        {
+            for (size_t i = 0; i < count; ++i)
+                output[i] = matrix * points[i];
+            DoNotOptimize(output.data());
+        }
+        state.SetItemsProcessed(state.GetIterations() * count);
+    }
+}
+
+MICRO_BENCHMARK(BM_Matrix4Multiply);
+MICRO_BENCHMARK(BM_Matrix4Inverse);
+MICRO_BENCHMARK(BM_QuaternionSlerp);
+MICRO_BENCHMARK(BM_QuaternionNLerp);
+MICRO_BENCHMARK(BM_TransformCombine);
+MICRO_BENCHMARK(BM_TransformPointBatch, 16, 256, 4096, 65536);
+MICRO_BENCHMARK(BM_Matrix4PointBatch, 16, 256, 4096, 65536);
+
+int main(int argc, char **argv)
+{
+    if (!MicroBenchmark::Instance().ParseArgs(argc, argv))
+    {
+        std::printf("usage: labgraphics_math_bench [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>] [--benchmark_out=<file.json>]\n");
+        return 1;
+    }
+
+    // a faster but wrong template must not pass as an improvement
+    bool passed = true;
+    for (const auto &check : RunChecks())
+    {
+        const bool ok = check.maxError <= check.tolerance;
+        std::printf("[%s] %-20s max relative error %.3e (tolerance %.0e)\n", ok ? " OK " : "FAIL", check.name, check.maxError, check.tolerance);
+        passed &= ok;
+    }
+    std::printf("\n");
+
+    MicroBenchmark::Instance().WriteJson(MicroBenchmark::Instance().RunAll());
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Logger.h"
+#include "Parallel.h"
+#include "Pbr/Image.h"
+#include "Pbr/SpecularFilter.h"
+
+// The specular prefilter of the Pbr renderer emulated on the CPU: the precomputed GGX sample table of
+// specularmap.comp against the on-the-fly sampling it replaced (1024 Hammersley samples a texel, lods computed
+// per sample, once with the mip chain and once from mip 0 only as the old compute sampler clamped it). Both are
+// compared per roughness against a brute force integral of the GGX lobe over every source texel.
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+    constexpr uint32_t ON_THE_FLY_SAMPLES = 1024;
+
+    struct Vec3
+    {
+        double x, y, z;
+    };
+
+    Vec3 operator+(const Vec3 &a, const Vec3 &b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+    Vec3 operator*(const Vec3 &a, double s) { return {a.x * s, a.y * s, a.z * s}; }
+    double Dot(const Vec3 &a, const Vec3 &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    Vec3 Cross(const Vec3 &a, const Vec3 &b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+    Vec3 Normalize(const Vec3 &v) { return v * (1.0 / std::sqrt(Dot(v, v))); }
+
+    // face layout of GetSamplingVector in specularmap.comp, uv in [-1, 1] with v up
+    Vec3 GetCubeDirection(uint32_t face, double u, double v)
+    {
+        switch (face)
+        {
+        case 0:
+            return Normalize({1.0, v, -u});
+        case 1:
+            return Normalize({-1.0, v, u});
+        case 2:
+            return Normalize({u, 1.0, -v});
+        case 3:
+            return Normalize({u, -1.0, v});
+        case 4:
+            return Normalize({u, v, 1.0});
+        default:
+            return Normalize({-u, v, -1.0});
+        }
+    }
+
+    void GetCubeCoords(const Vec3 &d, uint32_t &face, double &u, double &v)
+    {
+        const double ax = std::abs(d.x), ay = std::abs(d.y), az = std::abs(d.z);
+        if (ax >= ay && ax >= az)
+        {
+            face = d.x > 0.0 ? 0 : 1;
+            u = (d.x > 0.0 ? -d.z : d.z) / ax;
+            v = d.y / ax;
+        }
+        else if (ay >= az)
+        {
+            face = d.y > 0.0 ? 2 : 3;
+            u = d.x / ay;
+            v = (d.y > 0.0 ? -d.z : d.z) / ay;
+        }
+        else
+        {
+            face = d.z > 0.0 ? 4 : 5;
+            u = (d.z > 0.0 ? d.x : -d.x) / az;
+            v = d.y / az;
+        }
+    }
+
+    // uv of the center of a texel, row 0 at the top as in the shader
+    void GetTexelUv(uint32_t x, uint32_t y, uint32_t size, double &u, double &v)
+    {
+        u = (x + 0.5) / size * 2.0 - 1.0;
+        v = 1.0 - (y + 0.5) / size * 2.0;
+    }
+
+    struct CubeLevel
+    {
+        uint32_t size;
+        // rgb, face major
+        std::vector<float> texels;
+
+        const float *GetTexel(uint32_t face, uint32_t x, uint32_t y) const
+        {
+            return &texels[(((size_t)face * size + y) * size + x) * 3];
+        }
+    };
+
+    using Cube = std::vector<CubeLevel>;
+
+    Cube BuildSourceCube(const Image &equirect, uint32_t size)
+    {
+        Cube cube(1);
+        cube[0].size = size;
+        cube[0].texels.resize((size_t)6 * size * size * 3);
+
+        const float *pixels = equirect.pixels<float>();
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            for (uint32_t y = 0; y < size; ++y)
+            {
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    double u, v;
+                    GetTexelUv(x, y, size, u, v);
+                    const Vec3 d = GetCubeDirection(face, u, v);
+
+                    // nearest texel of the equirect, the source is already much finer than the cube
+                    const double phi = std::atan2(d.z, d.x), theta = std::acos(std::clamp(d.y, -1.0, 1.0));
+                    const int32_t ex = std::clamp((int32_t)((phi / (2.0 * PI) + 0.5) * equirect.mWidth), 0, equirect.mWidth - 1);
+                    const int32_t ey = std::clamp((int32_t)(theta / PI * equirect.mHeight), 0, equirect.mHeight - 1);
+                    const float *src = pixels + ((size_t)ey * equirect.mWidth + ex) * equirect.mChannels;
+
+                    float *dst = &cube[0].texels[(((size_t)face * size + y) * size + x) * 3];
+                    for (uint32_t c = 0; c < 3; ++c)
+                        dst[c] = src[c];
+                }
+            }
+        }
+
+        // box filtered chain, GenerateMipmaps blits the same way
+        while (cube.back().size > 1)
+        {
+            const CubeLevel &parent = cube.back();
+            CubeLevel level;
+            level.size = parent.size / 2;
+            level.texels.resize((size_t)6 * level.size * level.size * 3);
+            for (uint32_t face = 0; face < 6; ++face)
+                for (uint32_t y = 0; y < level.size; ++y)
+                    for (uint32_t x = 0; x < level.size; ++x)
+                        for (uint32_t c = 0; c < 3; ++c)
+                            level.texels[(((size_t)face * level.size + y) * level.size + x) * 3 + c] =
+                                0.25f * (parent.GetTexel(face, 2 * x, 2 * y)[c] + parent.GetTexel(face, 2 * x + 1, 2 * y)[c] +
+                                         parent.GetTexel(face, 2 * x, 2 * y + 1)[c] + parent.GetTexel(face, 2 * x + 1, 2 * y + 1)[c]);
+            cube.emplace_back(std::move(level));
+        }
+        return cube;
+    }
+
+    // bilinear within the face, clamped at its edges
+    Vec3 SampleLevel(const CubeLevel &level, const Vec3 &d)
+    {
+        uint32_t face;
+        double u, v;
+        GetCubeCoords(d, face, u, v);
+
+        const double fx = std::clamp((u + 1.0) * 0.5 * level.size - 0.5, 0.0, level.size - 1.0);
+        const double fy = std::clamp((1.0 - v) * 0.5 * level.size - 0.5, 0.0, level.size - 1.0);
+        const uint32_t x0 = (uint32_t)fx, y0 = (uint32_t)fy;
+        const uint32_t x1 = std::min(x0 + 1, level.size - 1), y1 = std::min(y0 + 1, level.size - 1);
+        const double tx = fx - x0, ty = fy - y0;
+
+        const float *t00 = level.GetTexel(face, x0, y0), *t10 = level.GetTexel(face, x1, y0);
+        const float *t01 = level.GetTexel(face, x0, y1), *t11 = level.GetTexel(face, x1, y1);
+        double rgb[3];
+        for (uint32_t c = 0; c < 3; ++c)
+            rgb[c] = (t00[c] * (1.0 - tx) + t10[c] * tx) * (1.0 - ty) + (t01[c] * (1.0 - tx) + t11[c] * tx) * ty;
+        return {rgb[0], rgb[1], rgb[2]};
+    }
+
+    // textureLod with a trilinear sampler clamped to maxLod
+    Vec3 SampleLod(const Cube &cube, const Vec3 &d, double lod, double maxLod)
+    {
+        lod = std::clamp(lod, 0.0, std::min(maxLod, cube.size() - 1.0));
+        const uint32_t level = (uint32_t)lod;
+        const double t = lod - level;
+        if (t == 0.0 || level + 1 >= cube.size())
+            return SampleLevel(cube[level], d);
+        return SampleLevel(cube[level], d) * (1.0 - t) + SampleLevel(cube[level + 1], d) * t;
+    }
+
+    void ComputeBasisVectors(const Vec3 &n, Vec3 &s, Vec3 &t)
+    {
+        t = Cross(n, {0.0, 1.0, 0.0});
+        if (Dot(t, t) < 0.00001)
+            t = Cross(n, {1.0, 0.0, 0.0});
+        t = Normalize(t);
+        s = Normalize(Cross(n, t));
+    }
+
+    double RadicalInverseVdC(uint32_t bits)
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return double(bits) * 2.3283064365386963e-10;
+    }
+
+    double NdfGGX(double cosLh, double roughness)
+    {
+        const double alpha = roughness * roughness;
+        const double alphaSq = alpha * alpha;
+        const double denom = (cosLh * cosLh) * (alphaSq - 1.0) + 1.0;
+        return alphaSq / (PI * denom * denom);
+    }
+
+    // the kernel of specularmap.comp
+    Vec3 FilterWithTable(const Cube &cube, const SpecularFilterTable &table, uint32_t level, const Vec3 &n)
+    {
+        Vec3 s, t;
+        ComputeBasisVectors(n, s, t);
+
+        const SpecularFilterLevel &filterLevel = table.levels[level - 1];
+        Vec3 color{0.0, 0.0, 0.0};
+        for (uint32_t i = 0; i < filterLevel.sampleCount; ++i)
+        {
+            const Vector4f &sample = table.samples[filterLevel.sampleOffset + i];
+            const Vec3 li = s * sample.x + t * sample.y + n * sample.z;
+            color = color + SampleLod(cube, li, sample.w, cube.size()) * sample.z;
+        }
+        return color * filterLevel.invWeightSum;
+    }
+
+    // the kernel specularmap.comp had before the table, everything per texel and sample
+    Vec3 FilterOnTheFly(const Cube &cube, double roughness, const Vec3 &n, double maxLod)
+    {
+        Vec3 s, t;
+        ComputeBasisVectors(n, s, t);
+
+        const double alpha = roughness * roughness;
+        const double wt = 4.0 * PI / (6.0 * cube[0].size * cube[0].size);
+        Vec3 color{0.0, 0.0, 0.0};
+        double weight = 0.0;
+        for (uint32_t i = 0; i < ON_THE_FLY_SAMPLES; ++i)
+        {
+            const double u1 = double(i) / ON_THE_FLY_SAMPLES, u2 = RadicalInverseVdC(i);
+            const double cosTheta = std::sqrt((1.0 - u2) / (1.0 + (alpha * alpha - 1.0) * u2));
+            const double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+            const double phi = 2.0 * PI * u1;
+            const Vec3 lh = s * (sinTheta * std::cos(phi)) + t * (sinTheta * std::sin(phi)) + n * cosTheta;
+            const Vec3 li = lh * (2.0 * Dot(n, lh)) + n * -1.0;
+
+            const double cosLi = Dot(n, li);
+            if (cosLi > 0.0)
+            {
+                const double pdf = NdfGGX(std::max(Dot(n, lh), 0.0), roughness) * 0.25;
+                const double ws = 1.0 / (ON_THE_FLY_SAMPLES * pdf);
+                const double lod = std::max(0.5 * std::log2(ws / wt) + 1.0, 0.0);
+                color = color + SampleLod(cube, li, lod, maxLod) * cosLi;
+                weight += cosLi;
+            }
+        }
+        return color * (1.0 / weight);
+    }
+
+    // solid angle of a texel of a face, from the area of its corners' projection onto the unit sphere
+    double GetTexelSolidAngle(uint32_t x, uint32_t y, uint32_t size)
+    {
+        auto areaElement = [](double u, double v)
+        { return std::atan2(u * v, std::sqrt(u * u + v * v + 1.0)); };
+        const double u0 = (double)x / size * 2.0 - 1.0, u1 = (double)(x + 1) / size * 2.0 - 1.0;
+        const double v0 = (double)y / size * 2.0 - 1.0, v1 = (double)(y + 1) / size * 2.0 - 1.0;
+        return std::abs(areaElement(u0, v0) - areaElement(u0, v1) - areaElement(u1, v0) + areaElement(u1, v1));
+    }
+
+    struct SourceTexel
+    {
+        Vec3 direction;
+        Vec3 radiance;
+        double solidAngle;
+    };
+
+    // What the importance sampled filters estimate: the GGX lobe around N = V weighted by cos(Li), integrated
+    // over every texel of the source's mip 0.
+    Vec3 FilterReference(const std::vector<SourceTexel> &source, double roughness, const Vec3 &n)
+    {
+        Vec3 color{0.0, 0.0, 0.0};
+        double weight = 0.0;
+        for (const SourceTexel &texel : source)
+        {
+            const double cosLi = Dot(n, texel.direction);
+            if (cosLi <= 0.0)
+                continue;
+
+            const Vec3 h = Normalize(n + texel.direction);
+            // pdf of Li is D(h) / 4 with V = N, the sampled filters weight each Li by cos(Li)
+            const double w = NdfGGX(Dot(n, h), roughness) * 0.25 * cosLi * texel.solidAngle;
+            color = color + texel.radiance * w;
+            weight += w;
+        }
+        return color * (1.0 / weight);
+    }
+
+    double Luminance(const Vec3 &rgb)
+    {
+        return 0.2126 * rgb.x + 0.7152 * rgb.y + 0.0722 * rgb.z;
+    }
+
+    struct Result
+    {
+        double ms = 0.0;
+        // over the probed texels, relative to the mean luminance of the reference
+        double rmse = 0.0;
+        double maxError = 0.0;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t size = 128;
+    uint32_t probes = 16;
+    std::string envPath = std::string(ASSETS_DIR) + "hdr/newport_loft.hdr";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg.rfind("--size=", 0) == 0)
+            size = (uint32_t)std::atoi(arg.c_str() + std::strlen("--size="));
+        else if (arg.rfind("--probes=", 0) == 0)
+            probes = (uint32_t)std::atoi(arg.c_str() + std::strlen("--probes="));
+        else if (arg.rfind("--env=", 0) == 0)
+            envPath = arg.substr(std::strlen("--env="));
+        else
+        {
+            std::printf("usage: labgraphics_specular_bench [--size=<cube face size, power of two>] [--probes=<texels a face side checked>] [--env=<file.hdr>]\n");
+            return 1;
+        }
+    }
+    if (size < 2 || (size & (size - 1)) != 0 || probes == 0)
+    {
+        std::printf("--size must be a power of two from 2 up and --probes at least 1\n");
+        return 1;
+    }
+
+    // Image logs its loads
+    Logger::Init();
+    const Image equirect(envPath);
+    const Cube cube = BuildSourceCube(equirect, size);
+    const uint32_t numMipTailLevels = (uint32_t)cube.size() - 1;
+    const SpecularFilterTable table = BuildSpecularFilterTable(size, numMipTailLevels);
+
+    std::vector<SourceTexel> source;
+    source.reserve((size_t)6 * size * size);
+    for (uint32_t face = 0; face < 6; ++face)
+    {
+        for (uint32_t y = 0; y < size; ++y)
+        {
+            for (uint32_t x = 0; x < size; ++x)
+            {
+                double u, v;
+                GetTexelUv(x, y, size, u, v);
+                const float *rgb = cube[0].GetTexel(face, x, y);
+                source.push_back({GetCubeDirection(face, u, v), {rgb[0], rgb[1], rgb[2]}, GetTexelSolidAngle(x, y, size)});
+            }
+        }
+    }
+
+    std::printf("%ux%u cube from %s, %u mip tail levels, %u x %u probes a face\n\n", size, size, envPath.c_str(), numMipTailLevels, probes, probes);
+    std::printf("%-6s %-9s %8s %8s | %10s %10s %10s | %10s %10s %10s | %10s %10s\n", "level", "roughness", "table", "old", "table ms", "old ms", "speedup",
+                "table rmse", "old rmse", "mip0 rmse", "table max", "old max");
+
+    for (uint32_t level = 1, levelSize = size / 2; level <= numMipTailLevels; ++level, levelSize = std::max(levelSize / 2, 1u))
+    {
+        const double roughness = (double)level / numMipTailLevels;
+        const size_t texelCount = (size_t)6 * levelSize * levelSize;
+
+        // every texel of the level like a dispatch, one thread so the kernels' costs compare directly
+        auto timeFilter = [&](const std::function<Vec3(const Vec3 &)> &filter)
+        {
+            double checksum = 0.0;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < texelCount; ++i)
+            {
+                double u, v;
+                GetTexelUv((uint32_t)(i % levelSize), (uint32_t)(i / levelSize % levelSize), levelSize, u, v);
+                checksum += Luminance(filter(GetCubeDirection((uint32_t)(i / ((size_t)levelSize * levelSize)), u, v)));
+            }
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            // keeps the filtered values alive
+            volatile double sink = checksum;
+            (void)sink;
+            return ms;
+        };
+
+        Result tableResult, onTheFly, onTheFlyMip0;
+        tableResult.ms = timeFilter([&](const Vec3 &n)
+                               { return FilterWithTable(cube, table, level, n); });
+        onTheFly.ms = timeFilter([&](const Vec3 &n)
+                                 { return FilterOnTheFly(cube, roughness, n, cube.size()); });
+
+        // the reference is a full pass over the source per texel, so only a grid of probes a face is checked
+        const uint32_t probeCount = std::min(probes, levelSize);
+        std::vector<std::array<double, 4>> probeLuminances((size_t)6 * probeCount * probeCount);
+        ParallelFor(0, probeLuminances.size(), [&](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            const uint32_t face = (uint32_t)(i / ((size_t)probeCount * probeCount));
+                            const uint32_t px = (uint32_t)(i % probeCount), py = (uint32_t)(i / probeCount % probeCount);
+                            double u, v;
+                            GetTexelUv(px * levelSize / probeCount, py * levelSize / probeCount, levelSize, u, v);
+                            const Vec3 n = GetCubeDirection(face, u, v);
+                            probeLuminances[i] = {Luminance(FilterReference(source, roughness, n)), Luminance(FilterWithTable(cube, table, level, n)),
+                                                  Luminance(FilterOnTheFly(cube, roughness, n, cube.size())), Luminance(FilterOnTheFly(cube, roughness, n, 0.0))};
+                        } });
+
+        double referenceMean = 0.0;
+        for (const auto &luminances : probeLuminances)
+            referenceMean += luminances[0];
+        referenceMean /= probeLuminances.size();
+
+        Result *results[] = {&tableResult, &onTheFly, &onTheFlyMip0};
+        for (uint32_t r = 0; r < 3; ++r)
+        {
+            double sumSquared = 0.0;
+            for (const auto &luminances : probeLuminances)
+            {
+                const double error = (luminances[r + 1] - luminances[0]) / referenceMean;
+                sumSquared += error * error;
+                results[r]->maxError = std::max(results[r]->maxError, std::abs(error));
+            }
+            results[r]->rmse = std::sqrt(sumSquared / probeLuminances.size());
+        }
+
+        std::printf("%-6u %-9.3f %8u %8u | %10.2f %10.2f %9.2fx | %9.2f%% %9.2f%% %9.2f%% | %9.2f%% %9.2f%%\n", level, roughness,
+                    table.levels[level - 1].sampleCount, ON_THE_FLY_SAMPLES, tableResult.ms, onTheFly.ms, onTheFly.ms / tableResult.ms,
+                    100.0 * tableResult.rmse, 100.0 * onTheFly.rmse, 100.0 * onTheFlyMip0.rmse, 100.0 * tableResult.maxError, 100.0 * onTheFly.maxError);
+    }
+    return 0;
+}
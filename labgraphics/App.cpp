@@ -1,14 +1,21 @@
 #include "App.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <stb/stb_image_write.h>
 #include "Logger.h"
+#include "Profiler.h"
 void App::Run()
 {
 	Init();
-	while (mIsRunning)
+	if (mIsHeadless)
+		RunHeadless();
+	else
 	{
-		ProcessInput();
-		Update();
-		Render();
-		RenderUI();
+		while (mIsRunning)
+			RunFrame();
 	}
 	CleanUp();
 }
@@ -42,28 +49,77 @@ void App::AddScene(Scene *s)
 	mScenes.emplace_back(s);
 }
 
+void App::SetHeadless(const HeadlessSettings &settings)
+{
+	mIsHeadless = true;
+	mHeadlessSettings = settings;
+	mHeadlessSettings.virtualFrameCount = std::max(mHeadlessSettings.virtualFrameCount, 1u);
+}
+
+bool App::IsHeadless() const
+{
+	return mIsHeadless;
+}
+
+const HeadlessSettings &App::GetHeadlessSettings() const
+{
+	return mHeadlessSettings;
+}
+
 void App::Init()
 {
 	Logger::Init();
-	mWindow = std::make_unique<Window>();
+	if (!mIsHeadless)
+		mWindow = std::make_unique<Window>();
 	mGraphicsContext = std::make_unique<GraphicsContext>();
 	mInputSystem.Init();
 
 	for (const auto &scene : mScenes)
 		scene->Init();
 
-	if (!mWindow->IsVisible())
+	if (mWindow && !mWindow->IsVisible())
 		mWindow->Show();
 }
+void App::RunFrame()
+{
+	Profiler::Instance().BeginFrame();
+	{
+		PROFILE_SCOPE("App::ProcessInput");
+		ProcessInput();
+	}
+	{
+		PROFILE_SCOPE("App::Update");
+		Update();
+	}
+	{
+		PROFILE_SCOPE("App::Render");
+		Render();
+	}
+	{
+		PROFILE_SCOPE("App::RenderUI");
+		RenderUI();
+	}
+	Profiler::Instance().EndFrame();
+}
+
 void App::ProcessInput()
 {
 	mInputSystem.PreUpdate();
 
-	mInputSystem.ProcessInput();
+	// no window, no events to pump
+	if (!mIsHeadless)
+		mInputSystem.ProcessInput();
 
 	if (mInputSystem.GetKeyboard().GetKeyState(SDL_SCANCODE_ESCAPE) == ButtonState::PRESS)
 		Quit();
 
+	if (mInputSystem.GetKeyboard().GetKeyState(SDL_SCANCODE_F12) == ButtonState::PRESS)
+	{
+		Profiler::Instance().PrintStats();
+		Profiler::Instance().ExportChromeTrace("profile_trace.json");
+		mTimer.PrintPacingStats();
+	}
+
 	for (const auto &scene : mScenes)
 		scene->ProcessInput();
 
@@ -94,4 +150,143 @@ void App::CleanUp()
 		scene->CleanUp();
 
 	mWindow.reset(nullptr);
-}
\ No newline at end of file
+}
+
+void App::RunHeadless()
+{
+	std::error_code errorCode;
+	std::filesystem::create_directories(mHeadlessSettings.outputDir, errorCode);
+	if (errorCode)
+		LOG_WARN("Failed to create headless output directory {}: {}", mHeadlessSettings.outputDir, errorCode.message());
+
+	LOG_INFO("Headless run: {} frames at {}x{}, {} frames in flight", mHeadlessSettings.frameCount, mHeadlessSettings.extent.x, mHeadlessSettings.extent.y, mHeadlessSettings.virtualFrameCount);
+
+	std::vector<double> frameTimes;
+	frameTimes.reserve(mHeadlessSettings.frameCount);
+
+	auto runStart = std::chrono::steady_clock::now();
+	for (uint32_t frame = 0; frame < mHeadlessSettings.frameCount && mIsRunning; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		RunFrame();
+
+		auto end = std::chrono::steady_clock::now();
+		// cpu frame time, throttled by the in flight fences once the virtual frames are used up
+		if (frame >= mHeadlessSettings.warmupFrameCount)
+			frameTimes.emplace_back(std::chrono::duration<double, std::milli>(end - start).count());
+		else if (frame + 1 == mHeadlessSettings.warmupFrameCount)
+			Profiler::Instance().Clear(); // keep the profiler stats comparable with the frame times above
+
+		const bool lastFrame = frame + 1 == mHeadlessSettings.frameCount || !mIsRunning;
+		if (lastFrame || (mHeadlessSettings.captureInterval > 0 && frame % mHeadlessSettings.captureInterval == 0))
+			CaptureFrame(frame);
+
+		WriteFinishedCaptures(false);
+	}
+	mGraphicsContext->GetDevice()->WaitIdle();
+	auto runEnd = std::chrono::steady_clock::now();
+
+	WriteFinishedCaptures(true);
+	ReportHeadlessStats(std::move(frameTimes), std::chrono::duration<double, std::milli>(runEnd - runStart).count());
+
+	Profiler::Instance().PrintStats();
+	Profiler::Instance().ExportChromeTrace(mHeadlessSettings.outputDir + "/trace.json");
+	mTimer.PrintPacingStats();
+}
+
+void App::CaptureFrame(uint32_t frame)
+{
+	auto swapChain = mGraphicsContext->GetSwapChain();
+	const GpuImage2D *image = swapChain->GetOffscreenImage(swapChain->GetPresentedImageIdx());
+	if (image == nullptr)
+		return;
+
+	const std::string path = mHeadlessSettings.outputDir + "/frame_" + std::to_string(frame) + ".png";
+	mPendingCaptures.emplace_back(path, mGraphicsContext->GetDevice()->GetReadbackQueue()->ReadImage(image, ImageLayout::PRESENT_SRC_KHR));
+}
+
+void App::WriteFinishedCaptures(bool wait)
+{
+	auto readbackQueue = mGraphicsContext->GetDevice()->GetReadbackQueue();
+	for (auto iter = mPendingCaptures.begin(); iter != mPendingCaptures.end();)
+	{
+		if (iter->second == INVALID_READBACK_TICKET)
+		{
+			iter = mPendingCaptures.erase(iter);
+			continue;
+		}
+
+		if (!wait && !readbackQueue->IsReady(iter->second))
+		{
+			++iter;
+			continue;
+		}
+
+		ReadbackView view = readbackQueue->Wait(iter->second);
+
+		// offscreen images are B8G8R8A8
+		std::vector<uint8_t> pixels(view.data, view.data + view.size);
+		for (size_t i = 0; i + 3 < pixels.size(); i += 4)
+			std::swap(pixels[i], pixels[i + 2]);
+
+		if (stbi_write_png(iter->first.c_str(), view.width, view.height, 4, pixels.data(), view.rowPitch) == 0)
+		{
+			LOG_WARN("Failed to write {}", iter->first);
+		}
+		else
+		{
+			LOG_INFO("Captured {}", iter->first);
+		}
+
+		readbackQueue->Release(iter->second);
+		iter = mPendingCaptures.erase(iter);
+	}
+}
+
+void App::ReportHeadlessStats(std::vector<double> frameTimes, double totalMs)
+{
+	if (frameTimes.empty())
+	{
+		LOG_WARN("Headless run finished without timed frames, increase frameCount above warmupFrameCount");
+		return;
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	auto percentile = [&](double p)
+	{
+		return frameTimes[std::min(frameTimes.size() - 1, (size_t)(p * frameTimes.size()))];
+	};
+
+	const double avg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / frameTimes.size();
+	const double p50 = percentile(0.50);
+	const double p95 = percentile(0.95);
+	const double p99 = percentile(0.99);
+
+	LOG_INFO("Headless frame time over {} frames: avg {:.3f} ms ({:.1f} fps), min {:.3f} ms, p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms, total {:.1f} ms",
+			 frameTimes.size(), avg, 1000.0 / avg, frameTimes.front(), p50, p95, p99, frameTimes.back(), totalMs);
+
+	const std::string path = mHeadlessSettings.outputDir + "/stats.json";
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		LOG_WARN("Failed to write {}", path);
+		return;
+	}
+
+	file << "{\n"
+		 << "  \"device\": \"" << mGraphicsContext->GetDevice()->GetPhysicalProps().deviceName << "\",\n"
+		 << "  \"width\": " << mHeadlessSettings.extent.x << ",\n"
+		 << "  \"height\": " << mHeadlessSettings.extent.y << ",\n"
+		 << "  \"framesInFlight\": " << mHeadlessSettings.virtualFrameCount << ",\n"
+		 << "  \"frames\": " << frameTimes.size() << ",\n"
+		 << "  \"totalMs\": " << totalMs << ",\n"
+		 << "  \"avgMs\": " << avg << ",\n"
+		 << "  \"minMs\": " << frameTimes.front() << ",\n"
+		 << "  \"p50Ms\": " << p50 << ",\n"
+		 << "  \"p95Ms\": " << p95 << ",\n"
+		 << "  \"p99Ms\": " << p99 << ",\n"
+		 << "  \"maxMs\": " << frameTimes.back() << "\n"
+		 << "}\n";
+}
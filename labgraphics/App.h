@@ -4,6 +4,22 @@
 #include "InputSystem.h"
 #include "VK/GraphicsContext.h"
 #include "Scene.h"
+#include "Graphics/VK/ReadbackQueue.h"
+
+// Offscreen run without window or swap chain, for machines without a display
+struct HeadlessSettings
+{
+    uint32_t frameCount = 300;
+    // excluded from the timing stats, pipelines and caches are still warming up
+    uint32_t warmupFrameCount = 10;
+    // offscreen images standing in for the swap chain images
+    uint32_t virtualFrameCount = 3;
+    Vector2u32 extent = Vector2u32(1280, 720);
+    // every nth frame is written as png, 0 writes only the last frame
+    uint32_t captureInterval = 0;
+    std::string outputDir = "headless";
+};
+
 class App
 {
 public:
@@ -28,17 +44,28 @@ public:
 
     void AddScene(Scene *s);
 
+    // must be set before Run
+    void SetHeadless(const HeadlessSettings &settings);
+    bool IsHeadless() const;
+    const HeadlessSettings &GetHeadlessSettings() const;
+
 private:
     App() = default;
     ~App() = default;
 
     void Init();
+    void RunFrame();
     void ProcessInput();
     void Update();
     void Render();
     void RenderUI();
     void CleanUp();
 
+    void RunHeadless();
+    void CaptureFrame(uint32_t frame);
+    void WriteFinishedCaptures(bool wait);
+    void ReportHeadlessStats(std::vector<double> frameTimes, double totalMs);
+
     std::unique_ptr<Window> mWindow;
     InputSystem mInputSystem;
     Timer mTimer;
@@ -47,4 +74,8 @@ private:
     std::vector<std::unique_ptr<Scene>> mScenes;
 
     bool mIsRunning = true;
+
+    bool mIsHeadless = false;
+    HeadlessSettings mHeadlessSettings;
+    std::vector<std::pair<std::string, ReadbackTicket>> mPendingCaptures;
 };
\ No newline at end of file
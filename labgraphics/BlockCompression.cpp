@@ -0,0 +1,358 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+    // mean and principal axis of the block, the endpoints are searched along this line (range fit)
+    template <int N>
+    void FitLine(const float points[16][N], float mean[N], float axis[N])
+    {
+        for (int c = 0; c < N; ++c)
+        {
+            mean[c] = 0.0f;
+            for (int i = 0; i < 16; ++i)
+                mean[c] += points[i][c];
+            mean[c] /= 16.0f;
+        }
+
+        float covariance[N][N] = {};
+        for (int i = 0; i < 16; ++i)
+            for (int a = 0; a < N; ++a)
+                for (int b = 0; b < N; ++b)
+                    covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+
+        // power iteration, started from the row with the most variance
+        int start = 0;
+        for (int c = 1; c < N; ++c)
+            if (covariance[c][c] > covariance[start][start])
+                start = c;
+        for (int c = 0; c < N; ++c)
+            axis[c] = covariance[start][c];
+
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[N] = {};
+            float largest = 0.0f;
+            for (int a = 0; a < N; ++a)
+            {
+                for (int b = 0; b < N; ++b)
+                    next[a] += covariance[a][b] * axis[b];
+                largest = std::max(largest, std::abs(next[a]));
+            }
+            if (largest <= FLT_EPSILON)
+                break;
+            for (int c = 0; c < N; ++c)
+                axis[c] = next[c] / largest;
+        }
+
+        float length = 0.0f;
+        for (int c = 0; c < N; ++c)
+            length += axis[c] * axis[c];
+        length = std::sqrt(length);
+        for (int c = 0; c < N; ++c)
+            axis[c] = length > FLT_EPSILON ? axis[c] / length : 0.0f;
+    }
+
+    template <int N>
+    void GetEndpoints(const float points[16][N], float endpoint0[N], float endpoint1[N])
+    {
+        float mean[N], axis[N];
+        FitLine<N>(points, mean, axis);
+
+        float minT = FLT_MAX, maxT = -FLT_MAX;
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < N; ++c)
+                t += (points[i][c] - mean[c]) * axis[c];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        for (int c = 0; c < N; ++c)
+        {
+            endpoint0[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+            endpoint1[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+        }
+    }
+
+    uint16_t To565(const float color[3])
+    {
+        const uint32_t r = (uint32_t)std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f);
+        const uint32_t g = (uint32_t)std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f);
+        const uint32_t b = (uint32_t)std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void From565(uint16_t value, int color[3])
+    {
+        const int r = (value >> 11) & 31;
+        const int g = (value >> 5) & 63;
+        const int b = value & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // indices into the 4 color palette of c0 > c1 and the summed squared error
+    int FindColorIndices(const float points[16][3], uint16_t c0, uint16_t c1, uint32_t &indices)
+    {
+        int palette[4][3];
+        From565(c0, palette[0]);
+        From565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        indices = 0;
+        int totalError = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            int bestIndex = 0, bestError = INT32_MAX;
+            for (int k = 0; k < 4; ++k)
+            {
+                int error = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    const int d = (int)points[i][c] - palette[k][c];
+                    error += d * d;
+                }
+                if (error < bestError)
+                {
+                    bestError = error;
+                    bestIndex = k;
+                }
+            }
+            indices |= (uint32_t)bestIndex << (2 * i);
+            totalError += bestError;
+        }
+        return totalError;
+    }
+
+    void EncodeColorBlock(const uint8_t rgba[16][4], uint8_t *block)
+    {
+        float points[16][3];
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+                points[i][c] = rgba[i][c];
+
+        float endpoint0[3], endpoint1[3];
+        GetEndpoints<3>(points, endpoint0, endpoint1);
+
+        uint16_t c0 = To565(endpoint0), c1 = To565(endpoint1);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        uint32_t indices = 0;
+        if (c0 != c1)
+        {
+            int error = FindColorIndices(points, c0, c1, indices);
+
+            // one least squares refit of the endpoints to the chosen indices
+            static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[3] = {}, bx[3] = {};
+            for (int i = 0; i < 16; ++i)
+            {
+                const float a = weights[(indices >> (2 * i)) & 3];
+                const float b = 1.0f - a;
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (int c = 0; c < 3; ++c)
+                {
+                    ax[c] += a * points[i][c];
+                    bx[c] += b * points[i][c];
+                }
+            }
+
+            const float determinant = aa * bb - ab * ab;
+            if (std::abs(determinant) > FLT_EPSILON)
+            {
+                float refit0[3], refit1[3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    refit0[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+                    refit1[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+                }
+
+                uint16_t r0 = To565(refit0), r1 = To565(refit1);
+                if (r0 < r1)
+                    std::swap(r0, r1);
+                uint32_t refitIndices = 0;
+                if (r0 != r1 && FindColorIndices(points, r0, r1, refitIndices) < error)
+                {
+                    c0 = r0;
+                    c1 = r1;
+                    indices = refitIndices;
+                }
+            }
+        }
+
+        block[0] = (uint8_t)(c0 & 0xFF);
+        block[1] = (uint8_t)(c0 >> 8);
+        block[2] = (uint8_t)(c1 & 0xFF);
+        block[3] = (uint8_t)(c1 >> 8);
+        for (int i = 0; i < 4; ++i)
+            block[4 + i] = (uint8_t)((indices >> (8 * i)) & 0xFF);
+    }
+
+    // little endian bit stream, the block must be zeroed
+    struct BitWriter
+    {
+        uint8_t *data;
+        uint32_t position = 0;
+
+        void Write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t i = 0; i < bits; ++i, ++position)
+                if ((value >> i) & 1)
+                    data[position >> 3] |= (uint8_t)(1 << (position & 7));
+        }
+    };
+}
+
+void EncodeBC1(const uint8_t rgba[16][4], uint8_t *block)
+{
+    EncodeColorBlock(rgba, block);
+}
+
+void EncodeBC3(const uint8_t rgba[16][4], uint8_t *block)
+{
+    uint8_t alpha[16];
+    for (int i = 0; i < 16; ++i)
+        alpha[i] = rgba[i][3];
+    EncodeBC4(alpha, block);
+    // c0 > c1 or a single color, which BC3 decodes the same as BC1
+    EncodeColorBlock(rgba, block + 8);
+}
+
+void EncodeBC4(const uint8_t values[16], uint8_t *block)
+{
+    const uint8_t minValue = *std::min_element(values, values + 16);
+    const uint8_t maxValue = *std::max_element(values, values + 16);
+
+    // 8 value mode: index 0 is the max, 1 the min and 2-7 step from max to min
+    block[0] = maxValue;
+    block[1] = minValue;
+
+    uint64_t bits = 0;
+    if (maxValue > minValue)
+    {
+        const float scale = 7.0f / (float)(maxValue - minValue);
+        for (int i = 0; i < 16; ++i)
+        {
+            const int t = (int)std::lround((values[i] - minValue) * scale);
+            const uint64_t index = t == 7 ? 0 : (t == 0 ? 1 : 8 - t);
+            bits |= index << (3 * i);
+        }
+    }
+
+    for (int i = 0; i < 6; ++i)
+        block[2 + i] = (uint8_t)((bits >> (8 * i)) & 0xFF);
+}
+
+void EncodeBC5(const uint8_t rg[16][2], uint8_t *block)
+{
+    uint8_t red[16], green[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        red[i] = rg[i][0];
+        green[i] = rg[i][1];
+    }
+    EncodeBC4(red, block);
+    EncodeBC4(green, block + 8);
+}
+
+void EncodeBC7(const uint8_t rgba[16][4], uint8_t *block)
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    float points[16][4];
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 4; ++c)
+            points[i][c] = rgba[i][c];
+
+    float endpoints[2][4];
+    GetEndpoints<4>(points, endpoints[0], endpoints[1]);
+
+    // 7 bit endpoints plus a p-bit shared by the channels of an endpoint, keep the p-bit with less error
+    int quantized[2][4], pBits[2], decoded[2][4];
+    for (int e = 0; e < 2; ++e)
+    {
+        float bestError = FLT_MAX;
+        for (int p = 0; p < 2; ++p)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c)
+            {
+                candidate[c] = std::clamp((int)std::lround((endpoints[e][c] - p) * 0.5f), 0, 127);
+                const float d = (float)((candidate[c] << 1) | p) - endpoints[e][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pBits[e] = p;
+                std::copy(candidate, candidate + 4, quantized[e]);
+            }
+        }
+        for (int c = 0; c < 4; ++c)
+            decoded[e][c] = (quantized[e][c] << 1) | pBits[e];
+    }
+
+    int palette[16][4];
+    for (int k = 0; k < 16; ++k)
+        for (int c = 0; c < 4; ++c)
+            palette[k][c] = ((64 - weights[k]) * decoded[0][c] + weights[k] * decoded[1][c] + 32) >> 6;
+
+    int indices[16];
+    for (int i = 0; i < 16; ++i)
+    {
+        int bestError = INT32_MAX;
+        for (int k = 0; k < 16; ++k)
+        {
+            int error = 0;
+            for (int c = 0; c < 4; ++c)
+            {
+                const int d = rgba[i][c] - palette[k][c];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                indices[i] = k;
+            }
+        }
+    }
+
+    // the anchor index is stored with 3 bits, its top bit must be 0
+    if (indices[0] & 8)
+    {
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (int i = 0; i < 16; ++i)
+            indices[i] = 15 - indices[i];
+    }
+
+    std::memset(block, 0, 16);
+    BitWriter writer{block};
+    writer.Write(1 << 6, 7);
+    for (int c = 0; c < 4; ++c)
+    {
+        writer.Write(quantized[0][c], 7);
+        writer.Write(quantized[1][c], 7);
+    }
+    writer.Write(pBits[0], 1);
+    writer.Write(pBits[1], 1);
+    writer.Write(indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        writer.Write(indices[i], 4);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+
+// 4x4 block encoders for the BCn formats. Texels are row major inside the block, partial edge blocks are
+// expected to be padded by the caller. BC1 and BC4 write 8 bytes, BC3, BC5 and BC7 write 16.
+
+// rgb, 4 color mode only (no punch-through alpha)
+void EncodeBC1(const uint8_t rgba[16][4], uint8_t *block);
+// BC4 alpha block followed by a BC1 color block
+void EncodeBC3(const uint8_t rgba[16][4], uint8_t *block);
+void EncodeBC4(const uint8_t values[16], uint8_t *block);
+// two BC4 blocks for red and green
+void EncodeBC5(const uint8_t rg[16][2], uint8_t *block);
+// mode 6 only: one subset, rgba endpoints with 7 bits plus a p-bit and 4 bit indices
+void EncodeBC7(const uint8_t rgba[16][4], uint8_t *block);
@@ -1,7 +1,10 @@
 #include "AS.h"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 #include "Device.h"
 #include "Utils.h"
+#include "CommandBuffer.h"
 #include "Math/Math.hpp"
 AS::AS(Device &device)
 	: mDevice(device), mHandle(VK_NULL_HANDLE)
@@ -17,11 +20,149 @@ uint64_t AS::GetAddress() const
 	return mAddress;
 }
 
+uint64_t AS::GetStorageSize() const
+{
+	return mAccelStorageBuffer ? mAccelStorageBuffer->GetSize() : 0;
+}
+
+AS &AS::SetBuildFlags(VkBuildAccelerationStructureFlagsKHR flags)
+{
+	mBuildFlags = flags;
+	mBuildSizesValid = false;
+	return *this;
+}
+
+VkBuildAccelerationStructureFlagsKHR AS::GetBuildFlags() const
+{
+	return mBuildFlags;
+}
+
+void AS::CreateStorage(uint64_t size, VkAccelerationStructureTypeKHR type)
+{
+	mType = type;
+	mAccelStorageBuffer = mDevice.CreateAccelerationStorageBuffer(size);
+
+	VkAccelerationStructureCreateInfoKHR accelerationStructureInfo{};
+	accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+	accelerationStructureInfo.buffer = mAccelStorageBuffer->GetHandle();
+	accelerationStructureInfo.size = size;
+	accelerationStructureInfo.type = type;
+
+	VK_CHECK(mDevice.vkCreateAccelerationStructureKHR(mDevice.GetHandle(), &accelerationStructureInfo, nullptr, &mHandle));
+}
+
+void AS::QueryAddress(const char *name)
+{
+	VkAccelerationStructureDeviceAddressInfoKHR asDeviceAddressInfo{};
+	asDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+	asDeviceAddressInfo.accelerationStructure = mHandle;
+	mAddress = mDevice.vkGetAccelerationStructureDeviceAddressKHR(mDevice.GetHandle(), &asDeviceAddressInfo);
+
+	if (mAddress == 0)
+	{
+		std::cout << "Invalid Handle to " << name << std::endl;
+		abort();
+	}
+}
+
+VkAccelerationStructureBuildGeometryInfoKHR AS::GetBuildGeometryInfo(VkBuildAccelerationStructureModeKHR mode) const
+{
+	VkAccelerationStructureBuildGeometryInfoKHR asBuildGeometryInfo{};
+	asBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+	asBuildGeometryInfo.type = mType;
+	asBuildGeometryInfo.flags = mBuildFlags;
+	asBuildGeometryInfo.mode = mode;
+	asBuildGeometryInfo.srcAccelerationStructure = mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR ? mHandle : VK_NULL_HANDLE;
+	asBuildGeometryInfo.dstAccelerationStructure = mHandle;
+	asBuildGeometryInfo.geometryCount = 1;
+	asBuildGeometryInfo.pGeometries = &mGeometry;
+	return asBuildGeometryInfo;
+}
+
+const VkAccelerationStructureBuildSizesInfoKHR &AS::GetBuildSizes() const
+{
+	if (mBuildSizesValid)
+		return mBuildSizes;
+
+	auto asBuildSizeGeometryInfo = GetBuildGeometryInfo();
+
+	mBuildSizes = {};
+	mBuildSizes.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+	mDevice.vkGetAccelerationStructureBuildSizesKHR(mDevice.GetHandle(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildSizeGeometryInfo, &mBuildRange.primitiveCount, &mBuildSizes);
+	mBuildSizes.accelerationStructureSize = Math::RoundUp(mBuildSizes.accelerationStructureSize, (uint64_t)256);
+	mBuildSizes.buildScratchSize = Math::RoundUp(mBuildSizes.buildScratchSize, (uint64_t)mDevice.GetRayTracingAccelerationProps().minAccelerationStructureScratchOffsetAlignment);
+	mBuildSizes.updateScratchSize = Math::RoundUp(mBuildSizes.updateScratchSize, (uint64_t)mDevice.GetRayTracingAccelerationProps().minAccelerationStructureScratchOffsetAlignment);
+	mBuildSizesValid = true;
+	return mBuildSizes;
+}
+
+uint64_t AS::GetScratchSize(VkBuildAccelerationStructureModeKHR mode) const
+{
+	const auto &asBuildSizeInfo = GetBuildSizes();
+	if (mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR)
+		return asBuildSizeInfo.updateScratchSize;
+	if (mBuildFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR)
+		return std::max(asBuildSizeInfo.buildScratchSize, asBuildSizeInfo.updateScratchSize);
+	return asBuildSizeInfo.buildScratchSize;
+}
+
+void AS::RecordBuild(VkBuildAccelerationStructureModeKHR mode, RayTraceCommandBuffer *commandBuffer)
+{
+	const uint64_t scratchSize = GetScratchSize(mode);
+
+	// batched structures have no scratch buffer of their own, keep one around for later updates
+	if (mScratchBuffer == nullptr || mScratchBuffer->GetSize() < scratchSize)
+	{
+		// frames in flight may still build with the current scratch buffer, it can only be replaced outside of them
+		if (commandBuffer != nullptr)
+		{
+			LOG_ERROR("AS::RecordBuild: the scratch buffer holds {} bytes but the {} needs {}, build the structure once before recording refits",
+					  mScratchBuffer ? mScratchBuffer->GetSize() : 0, mode == VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR ? "update" : "build", scratchSize);
+			return;
+		}
+		mScratchBuffer = mDevice.CreateGPUStorageBuffer(scratchSize);
+	}
+
+	auto asBuildGeometryInfo = GetBuildGeometryInfo(mode);
+	asBuildGeometryInfo.scratchData.deviceAddress = mScratchBuffer->GetAddress();
+
+	const VkAccelerationStructureBuildRangeInfoKHR *asBuildRangeInfo = &mBuildRange;
+
+	if (commandBuffer == nullptr)
+	{
+		auto immediateCommandBuffer = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
+		immediateCommandBuffer->ExecuteImmediately([&]()
+												   { immediateCommandBuffer->BuildAccelerationStructureKHR(1, &asBuildGeometryInfo, &asBuildRangeInfo); });
+		return;
+	}
+
+	// earlier traces and builds must be done with the structure and the scratch memory before they are overwritten
+	commandBuffer->GlobalMemoryBarrier(PipelineStage::RAY_TRACING_SHADER | PipelineStage::ACCELERATION_STRUCTURE_BUILD, PipelineStage::ACCELERATION_STRUCTURE_BUILD,
+									   Access::ACCELERATION_STRUCTURE_WRITE, Access::ACCELERATION_STRUCTURE_READ | Access::ACCELERATION_STRUCTURE_WRITE);
+	commandBuffer->BuildAccelerationStructureKHR(1, &asBuildGeometryInfo, &asBuildRangeInfo);
+	commandBuffer->GlobalMemoryBarrier(PipelineStage::ACCELERATION_STRUCTURE_BUILD, PipelineStage::RAY_TRACING_SHADER | PipelineStage::ACCELERATION_STRUCTURE_BUILD,
+									   Access::ACCELERATION_STRUCTURE_WRITE, Access::ACCELERATION_STRUCTURE_READ);
+}
+
+void AS::Update(RayTraceCommandBuffer *commandBuffer)
+{
+	if (mBuildFlags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR)
+		RecordBuild(VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR, commandBuffer);
+	else
+		RecordBuild(VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR, commandBuffer);
+}
+
+void AS::Rebuild(RayTraceCommandBuffer *commandBuffer)
+{
+	RecordBuild(VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR, commandBuffer);
+}
+
  uint32_t BLAS::mInstanceID=0;
 
 BLAS::BLAS(Device &device)
 	: AS(device)
 {
+	mType = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
 }
 BLAS::~BLAS()
 {
@@ -29,9 +170,30 @@ BLAS::~BLAS()
 	mAccelStorageBuffer.reset();
 	mVertexBuffer.reset();
 	mIndexBuffer.reset();
+	// only top level structures are bound to descriptors
 	mDevice.vkDestroyAccelerationStructureKHR(mDevice.GetHandle(), mHandle, nullptr);
 }
 
+void BLAS::Build()
+{
+	CreateStorage(GetBuildSizes().accelerationStructureSize, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR);
+
+	mScratchBuffer = mDevice.CreateCPUStorageBuffer(GetScratchSize(VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR));
+
+	auto asBuildGeometryInfo = GetBuildGeometryInfo();
+	asBuildGeometryInfo.scratchData.deviceAddress = mScratchBuffer->GetAddress();
+
+	std::vector<VkAccelerationStructureBuildRangeInfoKHR *> asBuildRangeInfos = {
+		&mBuildRange};
+
+	auto commandBuffer = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
+
+	commandBuffer->ExecuteImmediately([&]()
+									  { commandBuffer->BuildAccelerationStructureKHR(1, &asBuildGeometryInfo, asBuildRangeInfos.data()); });
+
+	QueryAddress("BLAS");
+}
+
 VkAccelerationStructureInstanceKHR BLAS::CreateInstance(VkTransformMatrixKHR matrix)
 {
 	VkAccelerationStructureInstanceKHR instance = {};
@@ -52,93 +214,94 @@ VkAccelerationStructureInstanceKHR BLAS::CreateInstance()
 						   0.0f, 0.0f, 1.0f, 0.0f});
 }
 
-TLAS::TLAS(Device &device, const std::vector<VkAccelerationStructureInstanceKHR> &instances)
-	: AS(device)
+TLAS::TLAS(Device &device, const std::vector<VkAccelerationStructureInstanceKHR> &instances, VkBuildAccelerationStructureFlagsKHR buildFlags, uint32_t instanceBufferCount)
+	: AS(device), mInstances(instances), mInstanceBufferCount(instanceBufferCount)
 {
-	auto staging = mDevice.CreateCPUBuffer((void *)instances.data(), sizeof(VkAccelerationStructureInstanceKHR) * instances.size(), BufferUsage::TRANSFER_SRC);
-
-	mInstanceBuffer = mDevice.CreateGPUBuffer(staging->GetSize(), BufferUsage::TRANSFER_DST | BufferUsage::ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY);
-	mInstanceBuffer->UploadDataFrom(staging->GetSize(), *staging);
-
-	VkAccelerationStructureGeometryKHR asGeometryInfo{};
-	asGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-	asGeometryInfo.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-	asGeometryInfo.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-	asGeometryInfo.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-	asGeometryInfo.geometry.instances.arrayOfPointers = VK_FALSE;
-	asGeometryInfo.geometry.instances.data = mInstanceBuffer->GetVkAddress();
-	asGeometryInfo.geometry.instances.arrayOfPointers = VK_FALSE;
-
-	VkAccelerationStructureBuildGeometryInfoKHR asBuildSizeGeometryInfo{};
-	asBuildSizeGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-	asBuildSizeGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-	asBuildSizeGeometryInfo.geometryCount = 1;
-	asBuildSizeGeometryInfo.pGeometries = &asGeometryInfo;
-	asBuildSizeGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-	asBuildSizeGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-	asBuildSizeGeometryInfo.srcAccelerationStructure = nullptr;
-
-	const uint32_t primitiveCount = instances.size();
-	VkAccelerationStructureBuildSizesInfoKHR asBuildSizesInfo{};
-	asBuildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-	mDevice.vkGetAccelerationStructureBuildSizesKHR(mDevice.GetHandle(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildSizeGeometryInfo, &primitiveCount, &asBuildSizesInfo);
-	asBuildSizesInfo.accelerationStructureSize = Math::RoundUp(asBuildSizesInfo.accelerationStructureSize, (uint64_t)256);
-	asBuildSizesInfo.buildScratchSize = Math::RoundUp(asBuildSizesInfo.buildScratchSize, (uint64_t)mDevice.GetRayTracingAccelerationProps().minAccelerationStructureScratchOffsetAlignment);
-
-	mAccelStorageBuffer = mDevice.CreateAccelerationStorageBuffer(asBuildSizesInfo.accelerationStructureSize);
+	mType = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+	mBuildFlags = buildFlags;
 
-	VkAccelerationStructureCreateInfoKHR accelerationStructureInfo{};
-	accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-	accelerationStructureInfo.buffer = mAccelStorageBuffer->GetHandle();
-	accelerationStructureInfo.size = asBuildSizesInfo.accelerationStructureSize;
-	accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-	VK_CHECK(mDevice.vkCreateAccelerationStructureKHR(mDevice.GetHandle(), &accelerationStructureInfo, nullptr, &mHandle));
+	mInstanceBuffer = mDevice.CreateCPUBuffer(sizeof(VkAccelerationStructureInstanceKHR) * instances.size() * instanceBufferCount, BufferUsage::ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY);
+	mMappedInstances = mInstanceBuffer->MapWhole<VkAccelerationStructureInstanceKHR>();
 
-	mScratchBuffer = mDevice.CreateCPUStorageBuffer(asBuildSizesInfo.buildScratchSize);
+	mGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+	mGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+	mGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+	mGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+	mGeometry.geometry.instances.arrayOfPointers = VK_FALSE;
 
-	VkAccelerationStructureBuildGeometryInfoKHR asBuildGeometryInfo{};
-	asBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-	asBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-	asBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-	asBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-	asBuildGeometryInfo.dstAccelerationStructure = mHandle;
-	asBuildGeometryInfo.geometryCount = 1;
-	asBuildGeometryInfo.pGeometries = &asGeometryInfo;
-	asBuildGeometryInfo.scratchData.deviceAddress = mScratchBuffer->GetAddress();
+	mBuildRange.primitiveCount = (uint32_t)instances.size();
+	mBuildRange.primitiveOffset = 0;
+	mBuildRange.firstVertex = 0;
+	mBuildRange.transformOffset = 0;
 
-	VkAccelerationStructureBuildRangeInfoKHR asBuildRangeInfo{};
-	asBuildRangeInfo.primitiveCount = primitiveCount;
-	asBuildRangeInfo.primitiveOffset = 0;
-	asBuildRangeInfo.firstVertex = 0;
-	asBuildRangeInfo.transformOffset = 0;
-	std::vector<VkAccelerationStructureBuildRangeInfoKHR *> asBuildRangeInfos{&asBuildRangeInfo};
+	WriteInstances();
 
-	auto commandBuffer = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
-	commandBuffer->ExecuteImmediately([&]()
-									  { commandBuffer->BuildAccelerationStructureKHR(1, &asBuildGeometryInfo, asBuildRangeInfos.data()); });
+	CreateStorage(GetBuildSizes().accelerationStructureSize, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR);
 
-	VkAccelerationStructureDeviceAddressInfoKHR deviceAddressInfo{};
-	deviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-	deviceAddressInfo.accelerationStructure = mHandle;
-	mAddress = mDevice.vkGetAccelerationStructureDeviceAddressKHR(mDevice.GetHandle(), &deviceAddressInfo);
+	RecordBuild(VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR, nullptr);
 
-	if (mAddress == 0)
-	{
-		std::cout << "Invalid Handle to TLAS" << std::endl;
-		abort();
-	}
+	QueryAddress("TLAS");
 }
 
 TLAS::TLAS(Device &device)
 	: AS(device)
 {
+	mType = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
 }
 
 TLAS::~TLAS()
 {
+	if (mMappedInstances)
+		mInstanceBuffer->Unmap();
+
 	mScratchBuffer.reset();
 	mAccelStorageBuffer.reset();
 	mInstanceBuffer.reset();
 
 	mDevice.vkDestroyAccelerationStructureKHR(mDevice.GetHandle(), mHandle, nullptr);
-}
\ No newline at end of file
+	mDevice.NotifyResourceDestroyed((uint64_t)mHandle);
+}
+
+uint32_t TLAS::GetInstanceCount() const
+{
+	return (uint32_t)mInstances.size();
+}
+
+const VkAccelerationStructureInstanceKHR &TLAS::GetInstance(uint32_t index) const
+{
+	return mInstances[index];
+}
+
+void TLAS::SetInstance(uint32_t index, const VkAccelerationStructureInstanceKHR &instance)
+{
+	mInstances[index] = instance;
+}
+
+void TLAS::SetInstanceTransform(uint32_t index, const VkTransformMatrixKHR &transform)
+{
+	mInstances[index].transform = transform;
+}
+
+void TLAS::Update(RayTraceCommandBuffer *commandBuffer)
+{
+	WriteInstances();
+	AS::Update(commandBuffer);
+}
+
+void TLAS::Rebuild(RayTraceCommandBuffer *commandBuffer)
+{
+	WriteInstances();
+	AS::Rebuild(commandBuffer);
+}
+
+void TLAS::WriteInstances()
+{
+	mInstanceBufferSlot = (mInstanceBufferSlot + 1) % mInstanceBufferCount;
+
+	const size_t slotOffset = mInstances.size() * mInstanceBufferSlot;
+	std::memcpy(mMappedInstances + slotOffset, mInstances.data(), sizeof(VkAccelerationStructureInstanceKHR) * mInstances.size());
+
+	VkDeviceOrHostAddressConstKHR instanceData{};
+	instanceData.deviceAddress = mInstanceBuffer->GetAddress() + sizeof(VkAccelerationStructureInstanceKHR) * slotOffset;
+	mGeometry.geometry.instances.data = instanceData;
+}
@@ -12,6 +12,18 @@ public:
     virtual ~AS() = default;
     const VkAccelerationStructureKHR &GetHandle() const;
     uint64_t GetAddress() const;
+    uint64_t GetStorageSize() const;
+
+    // Must be set before the structure is built, ASCompactor requires VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR
+    // and Update refits in place only with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR
+    AS &SetBuildFlags(VkBuildAccelerationStructureFlagsKHR flags);
+    VkBuildAccelerationStructureFlagsKHR GetBuildFlags() const;
+
+    // Refits in place with VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR when the structure allows updates, rebuilds otherwise.
+    // Without a command buffer the build is submitted and waited on, with one it is recorded between barriers
+    // against earlier traces and builds, so it can go into the frame's command buffer right before TraceRaysKHR.
+    virtual void Update(class RayTraceCommandBuffer *commandBuffer = nullptr);
+    virtual void Rebuild(class RayTraceCommandBuffer *commandBuffer = nullptr);
 
     AS(AS &&other)
         : mDevice(other.mDevice)
@@ -20,15 +32,39 @@ public:
         this->mScratchBuffer = std::move(other.mScratchBuffer);
         this->mHandle = other.mHandle;
         this->mAddress = other.mAddress;
+        this->mType = other.mType;
+        this->mBuildFlags = other.mBuildFlags;
+        this->mBuildSizes = other.mBuildSizes;
+        this->mBuildSizesValid = other.mBuildSizesValid;
     }
 
 protected:
+    friend class ASCompactor;
+
+    void CreateStorage(uint64_t size, VkAccelerationStructureTypeKHR type);
+    void QueryAddress(const char *name);
+
+    VkAccelerationStructureBuildGeometryInfoKHR GetBuildGeometryInfo(VkBuildAccelerationStructureModeKHR mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR) const;
+    // queried once per geometry and flags, refits do not change the counts the sizes depend on
+    const VkAccelerationStructureBuildSizesInfoKHR &GetBuildSizes() const;
+    // a build also reserves what updates need, so recorded refits never have to replace the scratch buffer
+    uint64_t GetScratchSize(VkBuildAccelerationStructureModeKHR mode) const;
+    void RecordBuild(VkBuildAccelerationStructureModeKHR mode, class RayTraceCommandBuffer *commandBuffer);
+
     class Device &mDevice;
 
     std::unique_ptr<Buffer> mAccelStorageBuffer;
     std::unique_ptr<Buffer> mScratchBuffer;
     VkAccelerationStructureKHR mHandle;
     uint64_t mAddress = 0;
+    VkAccelerationStructureTypeKHR mType = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    VkBuildAccelerationStructureFlagsKHR mBuildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+
+    VkAccelerationStructureGeometryKHR mGeometry{};
+    VkAccelerationStructureBuildRangeInfoKHR mBuildRange{};
+
+    mutable VkAccelerationStructureBuildSizesInfoKHR mBuildSizes{};
+    mutable bool mBuildSizesValid = false;
 };
 
 class BLAS : public AS
@@ -46,13 +82,27 @@ public:
         this->mIndexBuffer = std::move(other.mIndexBuffer);
     }
 
+    // Uploads the geometry and builds right away with its own scratch buffer and submission
     template <typename vType, typename iType>
     void SetData(const std::vector<vType> &vertices, const std::vector<iType> &indices);
 
+    // Uploads the geometry only, the build is left to an ASBuilder
+    template <typename vType, typename iType>
+    void SetGeometry(const std::vector<vType> &vertices, const std::vector<iType> &indices);
+
+    // Rewrites the vertices of a deforming mesh, count and layout must match SetGeometry. Call Update to refit afterwards,
+    // the device address does not change but TLAS referencing this BLAS must be updated too
+    template <typename vType>
+    void UpdateVertices(const std::vector<vType> &vertices);
+
     VkAccelerationStructureInstanceKHR CreateInstance(VkTransformMatrixKHR matrix);
     VkAccelerationStructureInstanceKHR CreateInstance();
 
 private:
+    friend class ASBuilder;
+
+    void Build();
+
     static uint32_t mInstanceID;
 
     std::unique_ptr<Buffer> mVertexBuffer;
@@ -68,96 +118,65 @@ BLAS::BLAS(Device &device, const std::vector<T1> &vertices, const std::vector<T2
 
 template <typename vType, typename iType>
 inline void BLAS::SetData(const std::vector<vType> &vertices, const std::vector<iType> &indices)
+{
+    SetGeometry(vertices, indices);
+    Build();
+}
+
+template <typename vType, typename iType>
+inline void BLAS::SetGeometry(const std::vector<vType> &vertices, const std::vector<iType> &indices)
 {
     mVertexBuffer = mDevice.CreateRayTraceVertexBuffer(vertices);
 
     if (!indices.empty())
         mIndexBuffer = mDevice.CreateRayTraceIndexBuffer(indices);
 
-    VkAccelerationStructureGeometryKHR asGeometryInfo = {};
-    asGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-    asGeometryInfo.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-    asGeometryInfo.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-    asGeometryInfo.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-    asGeometryInfo.geometry.triangles.vertexData = mVertexBuffer->GetVkAddress();
-    asGeometryInfo.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-    asGeometryInfo.geometry.triangles.maxVertex = (uint32_t)vertices.size();
-    asGeometryInfo.geometry.triangles.vertexStride = sizeof(vType);
+    mGeometry = {};
+    mGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    mGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+    mGeometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+    mGeometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+    mGeometry.geometry.triangles.vertexData = mVertexBuffer->GetVkAddress();
+    mGeometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+    mGeometry.geometry.triangles.maxVertex = (uint32_t)vertices.size();
+    mGeometry.geometry.triangles.vertexStride = sizeof(vType);
 
     uint32_t primitiveCount = (uint32_t)vertices.size() / 3;
     if (!indices.empty())
     {
-        asGeometryInfo.geometry.triangles.indexData = mIndexBuffer->GetVkAddress();
-        asGeometryInfo.geometry.triangles.indexType = DataStr2VkIndexType(typeid(iType).name());
+        mGeometry.geometry.triangles.indexData = mIndexBuffer->GetVkAddress();
+        mGeometry.geometry.triangles.indexType = DataStr2VkIndexType(typeid(iType).name());
         primitiveCount = (uint32_t)indices.size() / 3;
     }
 
-    VkAccelerationStructureBuildGeometryInfoKHR asBuildSizeGeometryInfo{};
-    asBuildSizeGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-    asBuildSizeGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    asBuildSizeGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    asBuildSizeGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    asBuildSizeGeometryInfo.geometryCount = 1;
-    asBuildSizeGeometryInfo.pGeometries = &asGeometryInfo;
-    asBuildSizeGeometryInfo.srcAccelerationStructure = nullptr;
-
-    VkAccelerationStructureBuildSizesInfoKHR asBuildSizeInfo{};
-    asBuildSizeInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-    mDevice.vkGetAccelerationStructureBuildSizesKHR(mDevice.GetHandle(), VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &asBuildSizeGeometryInfo, &primitiveCount, &asBuildSizeInfo);
-    asBuildSizeInfo.accelerationStructureSize = Math::RoundUp(asBuildSizeInfo.accelerationStructureSize, (uint64_t)256);
-    asBuildSizeInfo.buildScratchSize = Math::RoundUp(asBuildSizeInfo.buildScratchSize, (uint64_t)mDevice.GetRayTracingAccelerationProps().minAccelerationStructureScratchOffsetAlignment);
-
-    mAccelStorageBuffer = mDevice.CreateAccelerationStorageBuffer(asBuildSizeInfo.accelerationStructureSize);
-
-    VkAccelerationStructureCreateInfoKHR accelerationStructureInfo{};
-    accelerationStructureInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-    accelerationStructureInfo.buffer = mAccelStorageBuffer->GetHandle();
-    accelerationStructureInfo.size = asBuildSizeInfo.accelerationStructureSize;
-    accelerationStructureInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-
-    VK_CHECK(mDevice.vkCreateAccelerationStructureKHR(mDevice.GetHandle(), &accelerationStructureInfo, nullptr, &mHandle));
-
-    mScratchBuffer = mDevice.CreateCPUStorageBuffer(asBuildSizeInfo.buildScratchSize);
-
-    VkAccelerationStructureBuildGeometryInfoKHR asBuildGeometryInfo{};
-    asBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-    asBuildGeometryInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-    asBuildGeometryInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-    asBuildGeometryInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-    asBuildGeometryInfo.dstAccelerationStructure = mHandle;
-    asBuildGeometryInfo.geometryCount = 1;
-    asBuildGeometryInfo.pGeometries = &asGeometryInfo;
-    asBuildGeometryInfo.scratchData.deviceAddress = mScratchBuffer->GetAddress();
-
-    VkAccelerationStructureBuildRangeInfoKHR asBuildRangeInfo{};
-    asBuildRangeInfo.primitiveCount = primitiveCount;
-    asBuildRangeInfo.primitiveOffset = 0;
-    asBuildRangeInfo.firstVertex = 0;
-    asBuildRangeInfo.transformOffset = 0;
-    std::vector<VkAccelerationStructureBuildRangeInfoKHR *> asBuildRangeInfos = {
-        &asBuildRangeInfo};
-
-    auto commandBuffer = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
-
-    commandBuffer->ExecuteImmediately([&]()
-                                      { commandBuffer->BuildAccelerationStructureKHR(1, &asBuildGeometryInfo, asBuildRangeInfos.data()); });
-
-    VkAccelerationStructureDeviceAddressInfoKHR asDeviceAddressInfo{};
-    asDeviceAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-    asDeviceAddressInfo.accelerationStructure = mHandle;
-    mAddress = mDevice.vkGetAccelerationStructureDeviceAddressKHR(mDevice.GetHandle(), &asDeviceAddressInfo);
-
-    if (mAddress == 0)
+    mBuildRange = {};
+    mBuildSizesValid = false;
+    mBuildRange.primitiveCount = primitiveCount;
+    mBuildRange.primitiveOffset = 0;
+    mBuildRange.firstVertex = 0;
+    mBuildRange.transformOffset = 0;
+}
+
+template <typename vType>
+inline void BLAS::UpdateVertices(const std::vector<vType> &vertices)
+{
+    if (sizeof(vType) * vertices.size() != mVertexBuffer->GetSize())
     {
-        std::cout << "Invalid Handle to BLAS" << std::endl;
-        abort();
+        LOG_ERROR("BLAS::UpdateVertices: vertex data does not match the geometry the BLAS was built with");
+        return;
     }
+
+    auto staging = mDevice.CreateCPUBuffer((void *)vertices.data(), sizeof(vType) * vertices.size(), BufferUsage::TRANSFER_SRC);
+    // ray trace vertex buffers are device local, see Device::CreateRayTraceVertexBuffer
+    static_cast<GpuBuffer *>(mVertexBuffer.get())->UploadDataFrom(staging->GetSize(), *staging);
 }
 
 class TLAS : public AS
 {
 public:
-    TLAS(class Device &device, const std::vector<VkAccelerationStructureInstanceKHR> &instances);
+    // instanceBufferCount > 1 keeps that many copies of the instance data so Update can be recorded
+    // every frame without overwriting instances an in-flight frame is still building from
+    TLAS(class Device &device, const std::vector<VkAccelerationStructureInstanceKHR> &instances, VkBuildAccelerationStructureFlagsKHR buildFlags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR, uint32_t instanceBufferCount = 1);
     TLAS(class Device &device);
     ~TLAS() override;
 
@@ -167,6 +186,24 @@ public:
         this->mInstanceBuffer = std::move(other.mInstanceBuffer);
     }
 
+    uint32_t GetInstanceCount() const;
+    const VkAccelerationStructureInstanceKHR &GetInstance(uint32_t index) const;
+
+    // Changes are picked up by the next Update or Rebuild, the instance count is fixed
+    void SetInstance(uint32_t index, const VkAccelerationStructureInstanceKHR &instance);
+    void SetInstanceTransform(uint32_t index, const VkTransformMatrixKHR &transform);
+
+    void Update(class RayTraceCommandBuffer *commandBuffer = nullptr) override;
+    void Rebuild(class RayTraceCommandBuffer *commandBuffer = nullptr) override;
+
 private:
-    std::unique_ptr<GpuBuffer> mInstanceBuffer;
+    void WriteInstances();
+
+    std::vector<VkAccelerationStructureInstanceKHR> mInstances;
+
+    // persistently mapped, one slot of mInstances.size() instances per instanceBufferCount
+    std::unique_ptr<CpuBuffer> mInstanceBuffer;
+    VkAccelerationStructureInstanceKHR *mMappedInstances = nullptr;
+    uint32_t mInstanceBufferCount = 1;
+    uint32_t mInstanceBufferSlot = 0;
 };
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "ASBuilder.h"
+#include <chrono>
+#include <algorithm>
+#include "Device.h"
+#include "Utils.h"
+#include "CommandBuffer.h"
+#include "CommandPool.h"
+#include "Math/Math.hpp"
+
+ASBuilder::ASBuilder(Device &device, uint64_t scratchBudget)
+    : mDevice(device), mScratchBudget(scratchBudget), mCompactor(device)
+{
+}
+
+ASBuilder::~ASBuilder()
+{
+}
+
+ASBuilder &ASBuilder::AddBLAS(BLAS *blas)
+{
+    mPendingBLASs.emplace_back(blas);
+    return *this;
+}
+
+ASBuilder &ASBuilder::SetCompaction(bool enable)
+{
+    mCompaction = enable;
+    return *this;
+}
+
+void ASBuilder::Build()
+{
+    if (mPendingBLASs.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    const uint64_t scratchAlignment = mDevice.GetRayTracingAccelerationProps().minAccelerationStructureScratchOffsetAlignment;
+
+    std::vector<uint64_t> scratchSizes(mPendingBLASs.size());
+    uint64_t totalScratchSize = 0;
+    uint64_t maxScratchSize = 0;
+    uint64_t storageSize = 0;
+    for (size_t i = 0; i < mPendingBLASs.size(); ++i)
+    {
+        if (mCompaction)
+            mPendingBLASs[i]->SetBuildFlags(mPendingBLASs[i]->GetBuildFlags() | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+
+        auto asBuildSizeInfo = mPendingBLASs[i]->GetBuildSizes();
+        mPendingBLASs[i]->CreateStorage(asBuildSizeInfo.accelerationStructureSize, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR);
+
+        scratchSizes[i] = Math::RoundUp(asBuildSizeInfo.buildScratchSize, scratchAlignment);
+        totalScratchSize += scratchSizes[i];
+        maxScratchSize = std::max(maxScratchSize, scratchSizes[i]);
+        storageSize += asBuildSizeInfo.accelerationStructureSize;
+    }
+
+    // everything builds in parallel if it fits the budget, otherwise it degrades towards one build per batch
+    const uint64_t scratchSize = std::max(maxScratchSize, std::min(totalScratchSize, mScratchBudget));
+
+    // over-allocate so the base device address can be aligned for the first build
+    auto scratchBuffer = mDevice.CreateGPUStorageBuffer(scratchSize + scratchAlignment);
+    const uint64_t scratchBase = Math::RoundUp(scratchBuffer->GetAddress(), scratchAlignment);
+
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(mPendingBLASs.size());
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR *> buildRanges(mPendingBLASs.size());
+    std::vector<std::pair<size_t, size_t>> batches; // first, count
+
+    uint64_t scratchOffset = 0;
+    for (size_t i = 0; i < mPendingBLASs.size(); ++i)
+    {
+        if (batches.empty() || scratchOffset + scratchSizes[i] > scratchSize)
+        {
+            batches.emplace_back(i, 0);
+            scratchOffset = 0;
+        }
+
+        buildInfos[i] = mPendingBLASs[i]->GetBuildGeometryInfo();
+        buildInfos[i].scratchData.deviceAddress = scratchBase + scratchOffset;
+        buildRanges[i] = &mPendingBLASs[i]->mBuildRange;
+
+        scratchOffset += scratchSizes[i];
+        batches.back().second++;
+    }
+
+    auto commandBuffer = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
+    commandBuffer->ExecuteImmediately([&]()
+                                      {
+                                          for (size_t b = 0; b < batches.size(); ++b)
+                                          {
+                                              // the previous batch must be done with the scratch memory before it is reused
+                                              if (b > 0)
+                                                  commandBuffer->GlobalMemoryBarrier(PipelineStage::ACCELERATION_STRUCTURE_BUILD, PipelineStage::ACCELERATION_STRUCTURE_BUILD,
+                                                                                     Access::ACCELERATION_STRUCTURE_READ | Access::ACCELERATION_STRUCTURE_WRITE,
+                                                                                     Access::ACCELERATION_STRUCTURE_READ | Access::ACCELERATION_STRUCTURE_WRITE);
+                                              commandBuffer->BuildAccelerationStructureKHR(batches[b].second, &buildInfos[batches[b].first], &buildRanges[batches[b].first]);
+                                          } });
+
+    for (auto blas : mPendingBLASs)
+        blas->QueryAddress("BLAS");
+
+    // the shared scratch buffer is released when Build returns, compaction frees the original storage
+    uint64_t compactedStorageSize = storageSize;
+    if (mCompaction)
+    {
+        auto compactedSizeBefore = mCompactor.GetReport().compactedSize;
+        for (size_t i = 0; i < mPendingBLASs.size(); ++i)
+            mCompactor.Add(mPendingBLASs[i], "BLAS " + std::to_string(mStats.blasCount + i));
+        mCompactor.Compact();
+        compactedStorageSize = mCompactor.GetReport().compactedSize - compactedSizeBefore;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    mStats.blasCount += mPendingBLASs.size();
+    mStats.batchCount += batches.size();
+    mStats.storageSize += storageSize;
+    mStats.compactedStorageSize += compactedStorageSize;
+    mStats.scratchSize = std::max(mStats.scratchSize, scratchSize);
+    mStats.totalScratchSize += totalScratchSize;
+    mStats.buildMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+    mPendingBLASs.clear();
+}
+
+const ASBuilderStats &ASBuilder::GetStats() const
+{
+    return mStats;
+}
+
+const ASCompactionReport &ASBuilder::GetCompactionReport() const
+{
+    return mCompactor.GetReport();
+}
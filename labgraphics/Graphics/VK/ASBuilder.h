@@ -0,0 +1,49 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "AS.h"
+#include "ASCompactor.h"
+
+struct ASBuilderStats
+{
+    uint32_t blasCount = 0;
+    uint32_t batchCount = 0;
+    uint64_t storageSize = 0;
+    uint64_t compactedStorageSize = 0; // equals storageSize unless compaction is enabled
+    uint64_t scratchSize = 0;      // size of the shared scratch allocation
+    uint64_t totalScratchSize = 0; // sum of every build's scratch, what per-mesh builds would allocate
+    double buildMs = 0.0;
+};
+
+// Builds many BLAS in one submission. Builds are packed into batches whose scratch
+// regions fit side by side in a single shared scratch buffer, batches are separated by
+// barriers so the scratch memory can be reused by the next one.
+class ASBuilder
+{
+public:
+    ASBuilder(class Device &device, uint64_t scratchBudget = 256 * 1024 * 1024);
+    ~ASBuilder();
+
+    // blas must have its geometry set through BLAS::SetGeometry
+    ASBuilder &AddBLAS(BLAS *blas);
+
+    // Builds with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR and compacts right after, off by default
+    ASBuilder &SetCompaction(bool enable);
+
+    void Build();
+
+    const ASBuilderStats &GetStats() const;
+    const ASCompactionReport &GetCompactionReport() const;
+
+private:
+    class Device &mDevice;
+
+    std::vector<BLAS *> mPendingBLASs;
+    uint64_t mScratchBudget;
+    bool mCompaction = false;
+
+    ASCompactor mCompactor;
+
+    ASBuilderStats mStats;
+};
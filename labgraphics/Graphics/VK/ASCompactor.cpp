@@ -0,0 +1,128 @@
+#include "ASCompactor.h"
+#include <chrono>
+#include "Device.h"
+#include "Utils.h"
+#include "Logger.h"
+#include "CommandBuffer.h"
+#include "CommandPool.h"
+
+ASCompactor::ASCompactor(Device &device)
+    : mDevice(device)
+{
+}
+
+ASCompactor::~ASCompactor()
+{
+}
+
+ASCompactor &ASCompactor::Add(AS *as, const std::string &name)
+{
+    if (!(as->GetBuildFlags() & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR))
+    {
+        LOG_WARN("{} was not built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR, skip compaction", name);
+        return *this;
+    }
+
+    mPendingASs.emplace_back(as, name);
+    return *this;
+}
+
+void ASCompactor::Compact()
+{
+    if (mPendingASs.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    const uint32_t count = (uint32_t)mPendingASs.size();
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+    queryPoolInfo.queryCount = count;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateQueryPool(mDevice.GetHandle(), &queryPoolInfo, nullptr, &queryPool));
+
+    std::vector<VkAccelerationStructureKHR> handles(count);
+    for (uint32_t i = 0; i < count; ++i)
+        handles[i] = mPendingASs[i].first->GetHandle();
+
+    auto commandBuffer = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
+    commandBuffer->ExecuteImmediately([&]()
+                                      {
+                                          commandBuffer->ResetQueryPool(queryPool, 0, count);
+                                          // make the builds of previous submissions visible to the size query
+                                          commandBuffer->GlobalMemoryBarrier(PipelineStage::ACCELERATION_STRUCTURE_BUILD, PipelineStage::ACCELERATION_STRUCTURE_BUILD,
+                                                                             Access::ACCELERATION_STRUCTURE_WRITE, Access::ACCELERATION_STRUCTURE_READ);
+                                          commandBuffer->WriteAccelerationStructuresPropertiesKHR(count, handles.data(), VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool, 0);
+                                      });
+
+    std::vector<VkDeviceSize> compactedSizes(count);
+    VK_CHECK(vkGetQueryPoolResults(mDevice.GetHandle(), queryPool, 0, count, sizeof(VkDeviceSize) * count, compactedSizes.data(), sizeof(VkDeviceSize), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    vkDestroyQueryPool(mDevice.GetHandle(), queryPool, nullptr);
+
+    // the originals stay alive until the copies have executed
+    std::vector<std::unique_ptr<Buffer>> originalBuffers(count);
+    std::vector<VkCopyAccelerationStructureInfoKHR> copyInfos(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        AS *as = mPendingASs[i].first;
+
+        ASCompactionEntry entry;
+        entry.name = mPendingASs[i].second;
+        entry.originalSize = as->GetStorageSize();
+        entry.compactedSize = compactedSizes[i];
+        mReport.entries.emplace_back(entry);
+        mReport.originalSize += entry.originalSize;
+        mReport.compactedSize += entry.compactedSize;
+
+        originalBuffers[i] = std::move(as->mAccelStorageBuffer);
+        as->CreateStorage(compactedSizes[i], as->mType);
+
+        copyInfos[i] = {};
+        copyInfos[i].sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR;
+        copyInfos[i].src = handles[i];
+        copyInfos[i].dst = as->mHandle;
+        copyInfos[i].mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+    }
+
+    commandBuffer->ExecuteImmediately([&]()
+                                      {
+                                          for (const auto &copyInfo : copyInfos)
+                                              commandBuffer->CopyAccelerationStructureKHR(copyInfo);
+                                      });
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        AS *as = mPendingASs[i].first;
+
+        mDevice.vkDestroyAccelerationStructureKHR(mDevice.GetHandle(), handles[i], nullptr);
+        originalBuffers[i].reset();
+        // the build sized the scratch buffer for refits as well, the compacted copy stays updatable
+        if (!(as->GetBuildFlags() & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR))
+            as->mScratchBuffer.reset();
+
+        as->QueryAddress(mPendingASs[i].second.c_str());
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    mReport.compactMs += std::chrono::duration<double, std::milli>(end - start).count();
+
+    mPendingASs.clear();
+}
+
+const ASCompactionReport &ASCompactor::GetReport() const
+{
+    return mReport;
+}
+
+void ASCompactionReport::Print() const
+{
+    for (const auto &entry : entries)
+        LOG_INFO("{}: {} -> {} bytes ({:.1f}%)", entry.name, entry.originalSize, entry.compactedSize, entry.originalSize > 0 ? 100.0 * entry.compactedSize / entry.originalSize : 0.0);
+
+    LOG_INFO("Acceleration structure compaction: {:.2f} MB -> {:.2f} MB, {:.2f} MB saved in {:.2f} ms",
+             originalSize / 1e6, compactedSize / 1e6, (originalSize - compactedSize) / 1e6, compactMs);
+}
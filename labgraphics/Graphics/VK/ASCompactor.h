@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "AS.h"
+
+struct ASCompactionEntry
+{
+    std::string name;
+    uint64_t originalSize = 0;
+    uint64_t compactedSize = 0;
+};
+
+struct ASCompactionReport
+{
+    std::vector<ASCompactionEntry> entries;
+    uint64_t originalSize = 0;
+    uint64_t compactedSize = 0;
+    double compactMs = 0.0;
+
+    // logs bytes before and after for every structure followed by the totals
+    void Print() const;
+};
+
+// Copies acceleration structures built with VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR
+// into right-sized storage and frees their scratch and original buffers.
+// Handles and device addresses change: compact BLAS before creating instances that reference them
+// and TLAS before writing them to descriptor sets.
+class ASCompactor
+{
+public:
+    ASCompactor(class Device &device);
+    ~ASCompactor();
+
+    ASCompactor &Add(AS *as, const std::string &name);
+
+    void Compact();
+
+    const ASCompactionReport &GetReport() const;
+
+private:
+    class Device &mDevice;
+
+    std::vector<std::pair<AS *, std::string>> mPendingASs;
+
+    ASCompactionReport mReport;
+};
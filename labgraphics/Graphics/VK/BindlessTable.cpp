@@ -0,0 +1,150 @@
+#include "BindlessTable.h"
+#include <algorithm>
+#include "Utils.h"
+#include "Device.h"
+#include "ImageView.h"
+#include "Sampler.h"
+#include "DescriptorSet.h"
+#include "DescriptorSetLayout.h"
+
+BindlessHandle BindlessTable::HandleAllocator::Allocate()
+{
+    BindlessHandle handle = INVALID_BINDLESS_HANDLE;
+    if (!freeList.empty())
+    {
+        handle = freeList.back();
+        freeList.pop_back();
+    }
+    else if (next < capacity)
+        handle = next++;
+    else
+    {
+        LOG_ERROR("Bindless table is full ({} slots)", capacity);
+        return INVALID_BINDLESS_HANDLE;
+    }
+
+    liveCount++;
+    return handle;
+}
+
+BindlessTable::BindlessTable(const Device &device, uint32_t maxTextureCount)
+    : mDevice(device), mPool(VK_NULL_HANDLE)
+{
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProps{};
+    indexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 deviceProps2{};
+    deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProps2.pNext = &indexingProps;
+    vkGetPhysicalDeviceProperties2(mDevice.GetPhysicalHandle(), &deviceProps2);
+
+    mTextureHandles.capacity = std::min({maxTextureCount,
+                                         indexingProps.maxDescriptorSetUpdateAfterBindSampledImages,
+                                         indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages});
+
+    const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                                  VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                                  VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    const auto allStages = ShaderStage::VERTEX | ShaderStage::FRAGMENT | ShaderStage::COMPUTE |
+                           ShaderStage::RAYGEN | ShaderStage::CLOSEST_HIT | ShaderStage::ANY_HIT | ShaderStage::MISS;
+
+    mLayout = std::make_unique<DescriptorSetLayout>(mDevice);
+    mLayout->AddLayoutBinding(BINDLESS_TEXTURE_BINDING, mTextureHandles.capacity, DescriptorType::COMBINED_IMAGE_SAMPLER, allStages)
+        .SetBindingFlags(BINDLESS_TEXTURE_BINDING, bindingFlags);
+
+    std::vector<VkDescriptorPoolSize> poolSizes = {
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mTextureHandles.capacity},
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.pNext = nullptr;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    VK_CHECK(vkCreateDescriptorPool(mDevice.GetHandle(), &poolInfo, nullptr, &mPool));
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
+    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocInfo.pNext = nullptr;
+    descriptorSetAllocInfo.pSetLayouts = &mLayout->GetHandle();
+    descriptorSetAllocInfo.descriptorPool = mPool;
+    descriptorSetAllocInfo.descriptorSetCount = 1;
+
+    VkDescriptorSet handle = VK_NULL_HANDLE;
+    VK_CHECK(vkAllocateDescriptorSets(mDevice.GetHandle(), &descriptorSetAllocInfo, &handle));
+
+    mDescriptorSet = std::make_unique<DescriptorSet>(mDevice, mLayout.get(), handle);
+}
+
+BindlessTable::~BindlessTable()
+{
+    mDescriptorSet.reset(nullptr);
+    vkDestroyDescriptorPool(mDevice.GetHandle(), mPool, nullptr);
+    mLayout.reset(nullptr);
+}
+
+BindlessHandle BindlessTable::RegisterTexture(const ImageView2D *imageView, Sampler *sampler, ImageLayout layout)
+{
+    BindlessHandle handle = mTextureHandles.Allocate();
+    if (handle != INVALID_BINDLESS_HANDLE)
+        UpdateTexture(handle, imageView, sampler, layout);
+    return handle;
+}
+
+void BindlessTable::UpdateTexture(BindlessHandle handle, const ImageView2D *imageView, Sampler *sampler, ImageLayout layout)
+{
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.sampler = sampler ? sampler->GetHandle() : VK_NULL_HANDLE;
+    imageInfo.imageView = imageView->GetHandle();
+    imageInfo.imageLayout = IMAGE_LAYOUT_CAST(layout);
+
+    VkWriteDescriptorSet setWrite{};
+    setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    setWrite.pNext = nullptr;
+    setWrite.dstSet = mDescriptorSet->GetHandle();
+    setWrite.dstBinding = BINDLESS_TEXTURE_BINDING;
+    setWrite.dstArrayElement = handle;
+    setWrite.descriptorCount = 1;
+    setWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    setWrite.pImageInfo = &imageInfo;
+
+    vkUpdateDescriptorSets(mDevice.GetHandle(), 1, &setWrite, 0, nullptr);
+}
+
+void BindlessTable::ReleaseTexture(BindlessHandle handle)
+{
+    if (handle == INVALID_BINDLESS_HANDLE)
+        return;
+    // command buffers in flight may still index the slot, it keeps its descriptor until they have completed
+    mRetiredHandles.push_back(RetiredHandle{mFrame + mFrameCount, handle});
+    mTextureHandles.liveCount--;
+}
+
+void BindlessTable::BeginFrame(uint32_t frameCount)
+{
+    ++mFrame;
+    mFrameCount = frameCount;
+    while (!mRetiredHandles.empty() && mRetiredHandles.front().frame <= mFrame)
+    {
+        mTextureHandles.freeList.emplace_back(mRetiredHandles.front().handle);
+        mRetiredHandles.pop_front();
+    }
+}
+
+DescriptorSetLayout *BindlessTable::GetLayout() const
+{
+    return mLayout.get();
+}
+
+DescriptorSet *BindlessTable::GetDescriptorSet() const
+{
+    return mDescriptorSet.get();
+}
+
+uint32_t BindlessTable::GetTextureCount() const
+{
+    return mTextureHandles.liveCount;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <cstdint>
+#include "Enum.h"
+
+using BindlessHandle = uint32_t;
+constexpr BindlessHandle INVALID_BINDLESS_HANDLE = UINT32_MAX;
+
+constexpr uint32_t BINDLESS_TEXTURE_BINDING = 0;
+
+// Global descriptor set holding a partially bound, update-after-bind array of sampled textures.
+// Textures get a stable index on registration that shaders use to look them up:
+//   layout(set = N, binding = 0) uniform sampler2D Textures[];
+// Registering or releasing a texture never touches the layout, so pipelines using the table stay valid.
+// A released handle is only reused once the frames that may still index it have completed, see BeginFrame.
+// Buffers are not part of it, the scenes bind theirs as a few large arrays.
+class BindlessTable
+{
+public:
+    BindlessTable(const class Device &device, uint32_t maxTextureCount = 16384);
+    ~BindlessTable();
+
+    BindlessHandle RegisterTexture(const class ImageView2D *imageView, class Sampler *sampler, ImageLayout layout = ImageLayout::SHADER_READ_ONLY_OPTIMAL);
+    void UpdateTexture(BindlessHandle handle, const class ImageView2D *imageView, class Sampler *sampler, ImageLayout layout = ImageLayout::SHADER_READ_ONLY_OPTIMAL);
+    void ReleaseTexture(BindlessHandle handle);
+
+    // Called once a frame by the pass binding the table, after the fence of the frame it records was waited on.
+    // Handles released before the last frameCount calls go back to the free list.
+    void BeginFrame(uint32_t frameCount);
+
+    class DescriptorSetLayout *GetLayout() const;
+    class DescriptorSet *GetDescriptorSet() const;
+
+    uint32_t GetTextureCount() const;
+
+private:
+    struct HandleAllocator
+    {
+        BindlessHandle Allocate();
+
+        uint32_t capacity = 0;
+        uint32_t next = 0;
+        uint32_t liveCount = 0;
+        std::vector<BindlessHandle> freeList;
+    };
+
+    // reusable once the frames recorded up to frame have executed
+    struct RetiredHandle
+    {
+        uint64_t frame;
+        BindlessHandle handle;
+    };
+
+    const class Device &mDevice;
+
+    HandleAllocator mTextureHandles;
+    std::deque<RetiredHandle> mRetiredHandles;
+    uint64_t mFrame = 0;
+    uint32_t mFrameCount = 0;
+
+    std::unique_ptr<class DescriptorSetLayout> mLayout;
+    VkDescriptorPool mPool;
+    std::unique_ptr<class DescriptorSet> mDescriptorSet;
+};
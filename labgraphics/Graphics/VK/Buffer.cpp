@@ -17,7 +17,9 @@ Buffer::Buffer(Device &device,
                uint64_t size,
                BufferUsage usage,
                VkMemoryPropertyFlags properties)
-    : mDevice(device), mSize(size)
+    : mDevice(device), mSize(size),
+      mDescriptorBindable((BUFFER_USAGE_CAST(usage) & (VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                       VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT)) != 0)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -78,6 +80,8 @@ Buffer::~Buffer()
 {
     vkFreeMemory(mDevice.GetHandle(), mMemory, nullptr);
     vkDestroyBuffer(mDevice.GetHandle(), mHandle, nullptr);
+    if (mDescriptorBindable)
+        mDevice.NotifyResourceDestroyed((uint64_t)mHandle);
 }
 
 VkMemoryRequirements Buffer::GetMemoryRequirements() const
@@ -43,6 +43,8 @@ private:
     uint64_t mSize;
     uint64_t mAlignedMemorySize;
     uint64_t mAddress;
+    // staging and vertex buffers never end up in a descriptor, their destruction invalidates nothing
+    bool mDescriptorBindable;
 };
 
 class CpuBuffer : public Buffer
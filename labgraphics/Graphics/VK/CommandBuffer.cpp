@@ -97,6 +97,17 @@ void CommandBuffer::ImageBarrier(const VkImage &image, Access srcAccess,
 		&imageMemoryBarrier);
 }
 
+void CommandBuffer::GlobalMemoryBarrier(PipelineStage srcStage, PipelineStage dstStage, Access srcAccess, Access dstAccess) const
+{
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = ACCESS_CAST(srcAccess);
+	memoryBarrier.dstAccessMask = ACCESS_CAST(dstAccess);
+
+	this->PipelineBarrier(srcStage, dstStage, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
 void CommandBuffer::ImageBarrier(const VkImage &image, Format format, ImageLayout oldLayout, ImageLayout newLayout) const
 {
 	VkImageMemoryBarrier barrier{};
@@ -195,6 +206,37 @@ void CommandBuffer::CopyImageFromBuffer(Image2D *dst, Buffer *src)
 	vkCmdCopyBufferToImage(mHandle, src->GetHandle(), dst->GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
+void CommandBuffer::CopyImageFromBuffer(Image2D *dst, Buffer *src, const std::vector<VkBufferImageCopy> &regions)
+{
+	vkCmdCopyBufferToImage(mHandle, src->GetHandle(), dst->GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+}
+
+void CommandBuffer::CopyBufferFromImage(Buffer *dst, const Image2D *src)
+{
+	VkBufferImageCopy region = {};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = IMAGE_ASPECT_CAST(src->GetAspect());
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {src->GetWidth(), src->GetHeight(), 1};
+
+	vkCmdCopyImageToBuffer(mHandle, src->GetHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->GetHandle(), 1, &region);
+}
+
+void CommandBuffer::ResetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount)
+{
+	vkCmdResetQueryPool(mHandle, queryPool, firstQuery, queryCount);
+}
+
+void CommandBuffer::WriteTimestamp(PipelineStage stage, VkQueryPool queryPool, uint32_t query)
+{
+	vkCmdWriteTimestamp(mHandle, (VkPipelineStageFlagBits)PIPELINE_STAGE_CAST(stage), queryPool, query);
+}
+
 void CommandBuffer::Reset()
 {
 	VK_CHECK(vkResetCommandBuffer(mHandle, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT));
@@ -243,7 +285,7 @@ void RasterCommandBuffer::BindDescriptorSets(PipelineLayout *layout, uint32_t fi
 	for (int32_t i = 0; i < rawDescSets.size(); ++i)
 		rawDescSets[i] = descriptorSets[i]->GetHandle();
 
-	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->GetHandle(), 0, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->GetHandle(), firstSet, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
 }
 
 void RasterCommandBuffer::BindVertexBuffers(uint32_t firstBinding, uint32_t bindingCount, const std::vector<Buffer *> &pBuffers, const std::vector<uint64_t> &pOffsets)
@@ -361,7 +403,7 @@ void ComputeCommandBuffer::BindDescriptorSets(PipelineLayout *layout, uint32_t f
 	std::vector<VkDescriptorSet> rawDescSets(descriptorSets.size());
 	for (int32_t i = 0; i < rawDescSets.size(); ++i)
 		rawDescSets[i] = descriptorSets[i]->GetHandle();
-	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_COMPUTE, layout->GetHandle(), 0, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_COMPUTE, layout->GetHandle(), firstSet, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
 }
 
 void ComputeCommandBuffer::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
@@ -425,7 +467,7 @@ void RayTraceCommandBuffer::BindDescriptorSets(PipelineLayout *layout, uint32_t
 	std::vector<VkDescriptorSet> rawDescSets(descriptorSets.size());
 	for (int32_t i = 0; i < rawDescSets.size(); ++i)
 		rawDescSets[i] = descriptorSets[i]->GetHandle();
-	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, layout->GetHandle(), 0, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, layout->GetHandle(), firstSet, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
 }
 
 void RayTraceCommandBuffer::TraceRaysKHR(const RayTraceSBT &sbt, uint32_t width, uint32_t height, uint32_t depth)
@@ -433,11 +475,39 @@ void RayTraceCommandBuffer::TraceRaysKHR(const RayTraceSBT &sbt, uint32_t width,
 	mDevice.vkCmdTraceRaysKHR(mHandle, &sbt.GetRayGenAddressRegion(), &sbt.GetRayMissAddressRegion(), &sbt.GetRayClosestHitAddressRegion(), &sbt.GetRayCallableAddressRegion(), width, height, depth);
 }
 
+void RayTraceCommandBuffer::BindComputePipeline(ComputePipeline *pipeline) const
+{
+	vkCmdBindPipeline(mHandle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetHandle());
+}
+
+void RayTraceCommandBuffer::BindComputeDescriptorSets(PipelineLayout *layout, uint32_t firstSet, const std::vector<const DescriptorSet *> &descriptorSets, const std::vector<uint32_t> dynamicOffsets)
+{
+	std::vector<VkDescriptorSet> rawDescSets(descriptorSets.size());
+	for (int32_t i = 0; i < rawDescSets.size(); ++i)
+		rawDescSets[i] = descriptorSets[i]->GetHandle();
+	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_COMPUTE, layout->GetHandle(), firstSet, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+}
+
+void RayTraceCommandBuffer::Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+	vkCmdDispatch(mHandle, groupCountX, groupCountY, groupCountZ);
+}
+
 void RayTraceCommandBuffer::BuildAccelerationStructureKHR(uint32_t infoCount, const VkAccelerationStructureBuildGeometryInfoKHR *pInfos, const VkAccelerationStructureBuildRangeInfoKHR *const *ppBuildRangeInfos)
 {
 	mDevice.vkCmdBuildAccelerationStructuresKHR(mHandle, infoCount, pInfos, ppBuildRangeInfos);
 }
 
+void RayTraceCommandBuffer::WriteAccelerationStructuresPropertiesKHR(uint32_t accelerationStructureCount, const VkAccelerationStructureKHR *pAccelerationStructures, VkQueryType queryType, VkQueryPool queryPool, uint32_t firstQuery)
+{
+	mDevice.vkCmdWriteAccelerationStructuresPropertiesKHR(mHandle, accelerationStructureCount, pAccelerationStructures, queryType, queryPool, firstQuery);
+}
+
+void RayTraceCommandBuffer::CopyAccelerationStructureKHR(const VkCopyAccelerationStructureInfoKHR &copyInfo)
+{
+	mDevice.vkCmdCopyAccelerationStructureKHR(mHandle, &copyInfo);
+}
+
 void RayTraceCommandBuffer::Submit(const std::vector<PipelineStage> &waitStages, const std::vector<Semaphore *> waitSemaphores, const std::vector<Semaphore *> signalSemaphores, Fence *fence) const
 {
 	std::vector<VkSemaphore> rawSignal(signalSemaphores.size());
@@ -497,7 +567,7 @@ void TransferCommandBuffer::BindDescriptorSets(PipelineLayout *layout, uint32_t
 	std::vector<VkDescriptorSet> rawDescSets(descriptorSets.size());
 	for (int32_t i = 0; i < rawDescSets.size(); ++i)
 		rawDescSets[i] = descriptorSets[i]->GetHandle();
-	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->GetHandle(), 0, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
+	vkCmdBindDescriptorSets(mHandle, VK_PIPELINE_BIND_POINT_GRAPHICS, layout->GetHandle(), firstSet, rawDescSets.size(), rawDescSets.data(), dynamicOffsets.size(), dynamicOffsets.data());
 }
 
 void TransferCommandBuffer::Submit(const std::vector<PipelineStage> &waitStages, const std::vector<Semaphore *> waitSemaphores, const std::vector<Semaphore *> signalSemaphores, Fence *fence) const
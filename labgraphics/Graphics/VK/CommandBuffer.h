@@ -21,6 +21,7 @@ public:
 
 	virtual void ImageBarrier(const VkImage &image, Access srcAccess, Access dstAccess, ImageLayout oldLayout, ImageLayout newLayout, const VkImageSubresourceRange &subresourceRange) const;
 	virtual void ImageBarrier(const VkImage &image, Format format, ImageLayout oldLayout, ImageLayout newLayout) const;
+	virtual void GlobalMemoryBarrier(PipelineStage srcStage, PipelineStage dstStage, Access srcAccess, Access dstAccess) const;
 	virtual void PipelineBarrier(PipelineStage srcStage, PipelineStage dstStage, VkDependencyFlags dependencyFlags, uint32_t memoryBarrierCount, const VkMemoryBarrier *pMemoryBarriers, uint32_t bufferMemoryBarrierCount, const VkBufferMemoryBarrier *pBufferMemoryBarriers, uint32_t imageMemoryBarrierCount, const VkImageMemoryBarrier *pImageMemoryBarriers) const;
 
 	virtual void BindDescriptorSets(PipelineLayout *layout, uint32_t firstSet, const std::vector<const class DescriptorSet *> &descriptorSets, const std::vector<uint32_t> dynamicOffsets = {}) = 0;
@@ -32,6 +33,11 @@ public:
 	virtual void CopyBuffer(const Buffer &dst, const Buffer &src, VkBufferCopy bufferCopy);
 
 	virtual void CopyImageFromBuffer(Image2D *dst, Buffer *src);
+	void CopyImageFromBuffer(Image2D *dst, Buffer *src, const std::vector<VkBufferImageCopy> &regions);
+	virtual void CopyBufferFromImage(Buffer *dst, const Image2D *src);
+
+	void ResetQueryPool(VkQueryPool queryPool, uint32_t firstQuery, uint32_t queryCount);
+	void WriteTimestamp(PipelineStage stage, VkQueryPool queryPool, uint32_t query);
 
 	virtual void Reset();
 
@@ -99,7 +105,14 @@ public:
 
 	void TraceRaysKHR(const RayTraceSBT &sbt, uint32_t width, uint32_t height, uint32_t depth);
 
+	// Compute passes that consume the trace in the same submission, the ray tracing queue is the graphics queue
+	void BindComputePipeline(ComputePipeline *pipeline) const;
+	void BindComputeDescriptorSets(PipelineLayout *layout, uint32_t firstSet, const std::vector<const class DescriptorSet *> &descriptorSets, const std::vector<uint32_t> dynamicOffsets = {});
+	void Dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+
 	void BuildAccelerationStructureKHR(uint32_t infoCount, const VkAccelerationStructureBuildGeometryInfoKHR *pInfos, const VkAccelerationStructureBuildRangeInfoKHR *const *ppBuildRangeInfos);
+	void WriteAccelerationStructuresPropertiesKHR(uint32_t accelerationStructureCount, const VkAccelerationStructureKHR *pAccelerationStructures, VkQueryType queryType, VkQueryPool queryPool, uint32_t firstQuery);
+	void CopyAccelerationStructureKHR(const VkCopyAccelerationStructureInfoKHR &copyInfo);
 
 	void Submit(const std::vector<PipelineStage> &waitStages = {}, const std::vector<Semaphore *> waitSemaphores = {}, const std::vector<Semaphore *> signalSemaphores = {}, Fence *fence = nullptr) const override;
 };
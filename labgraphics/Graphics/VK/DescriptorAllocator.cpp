@@ -0,0 +1,326 @@
+#include "DescriptorAllocator.h"
+#include <algorithm>
+#include "Utils.h"
+#include "Device.h"
+#include "DescriptorSetLayout.h"
+
+DescriptorAllocator::DescriptorAllocator(const Device &device, uint32_t setsPerPage, uint32_t maxSetsPerPage)
+    : mDevice(device), mCurrentPage(VK_NULL_HANDLE), mSetsPerPage(setsPerPage), mMaxSetsPerPage(maxSetsPerPage)
+{
+    mPoolRatios = {
+        {DescriptorType::SAMPLER, 0.5f},
+        {DescriptorType::COMBINED_IMAGE_SAMPLER, 4.0f},
+        {DescriptorType::SAMPLED_IMAGE, 4.0f},
+        {DescriptorType::STORAGE_IMAGE, 1.0f},
+        {DescriptorType::UNIFORM_BUFFER, 2.0f},
+        {DescriptorType::STORAGE_BUFFER, 2.0f},
+        {DescriptorType::UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {DescriptorType::STORAGE_BUFFER_DYNAMIC, 1.0f},
+        {DescriptorType::INPUT_ATTACHMENT, 0.5f},
+    };
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+    mDescriptorSets.clear();
+    for (auto page : mUsedPages)
+        vkDestroyDescriptorPool(mDevice.GetHandle(), page, nullptr);
+    for (auto page : mFreePages)
+        vkDestroyDescriptorPool(mDevice.GetHandle(), page, nullptr);
+}
+
+DescriptorAllocator &DescriptorAllocator::SetPoolRatio(DescriptorType type, float descriptorsPerSet)
+{
+    mPoolRatios[type] = descriptorsPerSet;
+    return *this;
+}
+
+DescriptorAllocator &DescriptorAllocator::SetPoolRatios(const std::unordered_map<DescriptorType, float> &descriptorsPerSet)
+{
+    mPoolRatios = descriptorsPerSet;
+    return *this;
+}
+
+DescriptorSet *DescriptorAllocator::Allocate(DescriptorSetLayout *descLayout)
+{
+    if (mCurrentPage == VK_NULL_HANDLE)
+    {
+        mCurrentPage = GrabPage();
+        mUsedPages.emplace_back(mCurrentPage);
+    }
+
+    VkDescriptorSet handle = VK_NULL_HANDLE;
+    if (!TryAllocate(mCurrentPage, descLayout, handle))
+    {
+        // current page is full or fragmented, move on to a new one
+        mStats.exhaustedPages++;
+        mCurrentPage = GrabPage();
+        mUsedPages.emplace_back(mCurrentPage);
+
+        if (!TryAllocate(mCurrentPage, descLayout, handle))
+            LOG_ERROR("Descriptor set layout does not fit in an empty descriptor page, raise the pool ratio of its descriptor types");
+    }
+
+    mStats.allocatedSets++;
+    mStats.liveSets++;
+
+    mDescriptorSets.emplace_back(mDevice, descLayout, handle);
+    return &mDescriptorSets.back();
+}
+
+std::vector<DescriptorSet *> DescriptorAllocator::Allocate(DescriptorSetLayout *descLayout, uint32_t count)
+{
+    std::vector<DescriptorSet *> result(count);
+    for (uint32_t i = 0; i < count; ++i)
+        result[i] = Allocate(descLayout);
+    return result;
+}
+
+void DescriptorAllocator::Reset()
+{
+    mDescriptorSets.clear();
+
+    for (auto page : mUsedPages)
+    {
+        VK_CHECK(vkResetDescriptorPool(mDevice.GetHandle(), page, 0));
+        mFreePages.emplace_back(page);
+    }
+    mUsedPages.clear();
+    mCurrentPage = VK_NULL_HANDLE;
+
+    mStats.liveSets = 0;
+    mStats.freePageCount = mFreePages.size();
+    mStats.resetCount++;
+}
+
+const DescriptorAllocatorStats &DescriptorAllocator::GetStats() const
+{
+    return mStats;
+}
+
+VkDescriptorPool DescriptorAllocator::GrabPage()
+{
+    if (!mFreePages.empty())
+    {
+        auto page = mFreePages.back();
+        mFreePages.pop_back();
+        mStats.freePageCount = mFreePages.size();
+        return page;
+    }
+
+    auto page = CreatePage(mSetsPerPage);
+    mSetsPerPage = std::min(mSetsPerPage * 2, mMaxSetsPerPage);
+    mStats.pageCount++;
+    return page;
+}
+
+VkDescriptorPool DescriptorAllocator::CreatePage(uint32_t setCount) const
+{
+    std::vector<VkDescriptorPoolSize> poolSizes;
+    for (const auto &ratio : mPoolRatios)
+    {
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = DESCRIPTOR_TYPE_CAST(ratio.first);
+        poolSize.descriptorCount = std::max(1u, (uint32_t)(ratio.second * setCount));
+        poolSizes.emplace_back(poolSize);
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.pNext = nullptr;
+    poolInfo.flags = 0;
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = poolSizes.size();
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool page = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateDescriptorPool(mDevice.GetHandle(), &poolInfo, nullptr, &page));
+    return page;
+}
+
+bool DescriptorAllocator::TryAllocate(VkDescriptorPool page, DescriptorSetLayout *descLayout, VkDescriptorSet &handle) const
+{
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
+    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocInfo.pNext = nullptr;
+    descriptorSetAllocInfo.pSetLayouts = &descLayout->GetHandle();
+    descriptorSetAllocInfo.descriptorPool = page;
+    descriptorSetAllocInfo.descriptorSetCount = 1;
+
+    VkResult allocResult = vkAllocateDescriptorSets(mDevice.GetHandle(), &descriptorSetAllocInfo, &handle);
+    if (allocResult == VK_ERROR_OUT_OF_POOL_MEMORY || allocResult == VK_ERROR_FRAGMENTED_POOL)
+        return false;
+
+    VK_CHECK(allocResult);
+    return true;
+}
+
+FrameDescriptorAllocator::FrameDescriptorAllocator(const Device &device, uint32_t frameCount)
+{
+    for (uint32_t i = 0; i < frameCount; ++i)
+        mAllocators.emplace_back(std::make_unique<DescriptorAllocator>(device));
+}
+
+FrameDescriptorAllocator::~FrameDescriptorAllocator()
+{
+}
+
+void FrameDescriptorAllocator::BeginFrame(uint32_t frameIdx)
+{
+    mCurFrame = frameIdx % mAllocators.size();
+    mAllocators[mCurFrame]->Reset();
+}
+
+DescriptorSet *FrameDescriptorAllocator::Allocate(DescriptorSetLayout *descLayout)
+{
+    return mAllocators[mCurFrame]->Allocate(descLayout);
+}
+
+DescriptorAllocator *FrameDescriptorAllocator::GetCurrentAllocator() const
+{
+    return mAllocators[mCurFrame].get();
+}
+
+DescriptorAllocatorStats FrameDescriptorAllocator::GetStats() const
+{
+    DescriptorAllocatorStats result;
+    for (const auto &allocator : mAllocators)
+    {
+        const auto &stats = allocator->GetStats();
+        result.allocatedSets += stats.allocatedSets;
+        result.liveSets += stats.liveSets;
+        result.pageCount += stats.pageCount;
+        result.freePageCount += stats.freePageCount;
+        result.exhaustedPages += stats.exhaustedPages;
+        result.resetCount += stats.resetCount;
+    }
+    return result;
+}
+
+DescriptorSetCache::DescriptorSetCache(const Device &device, uint32_t frameCount)
+    : mDevice(device), mFrameCount(frameCount), mResourceGeneration(device.GetResourceGeneration()), mAllocator(std::make_unique<DescriptorAllocator>(device))
+{
+}
+
+DescriptorSetCache::~DescriptorSetCache()
+{
+}
+
+void DescriptorSetCache::BeginFrame(uint32_t frameIdx)
+{
+    InvalidateIfStale();
+
+    for (auto iter = mRetiredAllocators.begin(); iter != mRetiredAllocators.end();)
+    {
+        if (--iter->framesLeft == 0)
+            iter = mRetiredAllocators.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+DescriptorSet *DescriptorSetCache::Request(DescriptorSetLayout *descLayout, const DescriptorWrites &writes)
+{
+    InvalidateIfStale();
+
+    mStats.requests++;
+
+    VkDescriptorSetLayout layoutHandle = descLayout->GetHandle();
+
+    uint64_t key = writes.GetHash();
+    key ^= (uint64_t)layoutHandle + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+
+    auto &bucket = mEntries[key];
+    for (const auto &entry : bucket)
+    {
+        if (entry.layout == layoutHandle && entry.writes == writes)
+        {
+            mStats.hits++;
+            return entry.set;
+        }
+    }
+
+    mStats.misses++;
+
+    auto set = mAllocator->Allocate(descLayout);
+    set->Update(writes);
+
+    bucket.emplace_back(Entry{layoutHandle, writes, set});
+    mStats.cachedSets++;
+
+    return set;
+}
+
+void DescriptorSetCache::Clear()
+{
+    mEntries.clear();
+    mRetiredAllocators.clear();
+    mAllocator->Reset();
+    mStats.cachedSets = 0;
+    mStaleSetCount = 0;
+    mResourceGeneration = mDevice.GetResourceGeneration();
+}
+
+const DescriptorSetCacheStats &DescriptorSetCache::GetStats() const
+{
+    return mStats;
+}
+
+const DescriptorAllocatorStats &DescriptorSetCache::GetAllocatorStats() const
+{
+    return mAllocator->GetStats();
+}
+
+void DescriptorSetCache::InvalidateIfStale()
+{
+    if (mDevice.GetResourceGeneration() == mResourceGeneration)
+        return;
+
+    std::vector<uint64_t> destroyed;
+    const bool complete = mDevice.GetDestroyedResources(mResourceGeneration, mResourceGeneration, destroyed);
+
+    if (mEntries.empty())
+        return;
+
+    // fell too far behind to know what was destroyed
+    if (!complete)
+    {
+        mStats.invalidations++;
+        RetireAllocator();
+        return;
+    }
+
+    std::sort(destroyed.begin(), destroyed.end());
+
+    uint64_t droppedCount = 0;
+    for (auto iter = mEntries.begin(); iter != mEntries.end();)
+    {
+        auto &bucket = iter->second;
+        const auto staleBegin = std::remove_if(bucket.begin(), bucket.end(), [&](const Entry &entry)
+                                               { return entry.writes.References(destroyed); });
+        droppedCount += bucket.end() - staleBegin;
+        bucket.erase(staleBegin, bucket.end());
+        iter = bucket.empty() ? mEntries.erase(iter) : std::next(iter);
+    }
+
+    if (droppedCount == 0)
+        return;
+
+    mStats.cachedSets -= droppedCount;
+    mStats.invalidations++;
+
+    mStaleSetCount += droppedCount;
+    if (mStaleSetCount > mStats.cachedSets)
+        RetireAllocator();
+}
+
+void DescriptorSetCache::RetireAllocator()
+{
+    // frames already recorded may still bind the sets, the allocator goes away once all of them have completed
+    mRetiredAllocators.emplace_back(RetiredAllocator{std::move(mAllocator), mFrameCount});
+    mAllocator = std::make_unique<DescriptorAllocator>(mDevice);
+
+    mEntries.clear();
+    mStats.cachedSets = 0;
+    mStaleSetCount = 0;
+}
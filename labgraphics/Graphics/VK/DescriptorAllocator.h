@@ -0,0 +1,140 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include "Enum.h"
+#include "DescriptorSet.h"
+
+struct DescriptorAllocatorStats
+{
+    uint64_t allocatedSets = 0;
+    uint64_t liveSets = 0;
+    uint64_t pageCount = 0;
+    uint64_t freePageCount = 0;
+    uint64_t exhaustedPages = 0;
+    uint64_t resetCount = 0;
+};
+
+// Growable allocator made of descriptor pool pages. Sets are never freed one by one,
+// the whole allocator is recycled with Reset() once the GPU no longer uses them.
+class DescriptorAllocator
+{
+public:
+    DescriptorAllocator(const class Device &device, uint32_t setsPerPage = 64, uint32_t maxSetsPerPage = 4096);
+    ~DescriptorAllocator();
+
+    DescriptorAllocator &SetPoolRatio(DescriptorType type, float descriptorsPerSet);
+    // replaces the default ratios, for allocators serving a single known layout
+    DescriptorAllocator &SetPoolRatios(const std::unordered_map<DescriptorType, float> &descriptorsPerSet);
+
+    DescriptorSet *Allocate(class DescriptorSetLayout *descLayout);
+    std::vector<DescriptorSet *> Allocate(class DescriptorSetLayout *descLayout, uint32_t count);
+
+    void Reset();
+
+    const DescriptorAllocatorStats &GetStats() const;
+
+private:
+    VkDescriptorPool GrabPage();
+    VkDescriptorPool CreatePage(uint32_t setCount) const;
+    bool TryAllocate(VkDescriptorPool page, class DescriptorSetLayout *descLayout, VkDescriptorSet &handle) const;
+
+    const class Device &mDevice;
+
+    std::unordered_map<DescriptorType, float> mPoolRatios;
+
+    VkDescriptorPool mCurrentPage;
+    std::vector<VkDescriptorPool> mUsedPages;
+    std::vector<VkDescriptorPool> mFreePages;
+
+    std::deque<DescriptorSet> mDescriptorSets;
+
+    uint32_t mSetsPerPage;
+    uint32_t mMaxSetsPerPage;
+
+    DescriptorAllocatorStats mStats;
+};
+
+// One DescriptorAllocator per frame in flight, the frame's allocator is reset in bulk when the frame is reused.
+class FrameDescriptorAllocator
+{
+public:
+    FrameDescriptorAllocator(const class Device &device, uint32_t frameCount);
+    ~FrameDescriptorAllocator();
+
+    void BeginFrame(uint32_t frameIdx);
+
+    DescriptorSet *Allocate(class DescriptorSetLayout *descLayout);
+
+    DescriptorAllocator *GetCurrentAllocator() const;
+    DescriptorAllocatorStats GetStats() const;
+
+private:
+    std::vector<std::unique_ptr<DescriptorAllocator>> mAllocators;
+    uint32_t mCurFrame = 0;
+};
+
+struct DescriptorSetCacheStats
+{
+    uint64_t requests = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t cachedSets = 0;
+    // times entries were dropped because a resource they reference was destroyed
+    uint64_t invalidations = 0;
+};
+
+// Shares descriptor sets with the same layout and the same bound resources across frames and passes.
+// Entries are keyed by raw handles, which Vulkan hands out again once their resource is destroyed: the entries
+// referencing a handle the device reports destroyed are dropped. Sets are not freed one by one, once the dropped
+// ones outnumber the live ones the allocator is retired with every entry and freed after the frames in flight at
+// that point have completed.
+class DescriptorSetCache
+{
+public:
+    DescriptorSetCache(const class Device &device, uint32_t frameCount);
+    ~DescriptorSetCache();
+
+    // the fence of frameIdx has signaled
+    void BeginFrame(uint32_t frameIdx);
+
+    DescriptorSet *Request(class DescriptorSetLayout *descLayout, const DescriptorWrites &writes);
+
+    // must only be called once the GPU is idle
+    void Clear();
+
+    const DescriptorSetCacheStats &GetStats() const;
+    const DescriptorAllocatorStats &GetAllocatorStats() const;
+
+private:
+    struct Entry
+    {
+        VkDescriptorSetLayout layout;
+        DescriptorWrites writes;
+        DescriptorSet *set;
+    };
+
+    struct RetiredAllocator
+    {
+        std::unique_ptr<DescriptorAllocator> allocator;
+        // BeginFrame calls left until every frame that may use its sets has completed
+        uint32_t framesLeft;
+    };
+
+    void InvalidateIfStale();
+    void RetireAllocator();
+
+    const class Device &mDevice;
+    uint32_t mFrameCount;
+    uint64_t mResourceGeneration;
+    // sets of dropped entries still held by mAllocator
+    uint64_t mStaleSetCount = 0;
+
+    std::unique_ptr<DescriptorAllocator> mAllocator;
+    std::vector<RetiredAllocator> mRetiredAllocators;
+    std::unordered_map<uint64_t, std::vector<Entry>> mEntries;
+
+    DescriptorSetCacheStats mStats;
+};
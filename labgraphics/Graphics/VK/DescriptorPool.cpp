@@ -1,5 +1,6 @@
 #include "DescriptorPool.h"
 #include <iostream>
+#include <vector>
 #include "VK/Utils.h"
 #include "VK/Device.h"
 
@@ -9,7 +10,6 @@ DescriptorPool::DescriptorPool(const Device &device)
 }
 DescriptorPool::~DescriptorPool()
 {
-    mDescriptorSetCache.clear();
     vkDestroyDescriptorPool(mDevice.GetHandle(), mHandle, nullptr);
 }
 
@@ -29,20 +29,6 @@ const VkDescriptorPool &DescriptorPool::GetHandle()
     return mHandle;
 }
 
-DescriptorSet *DescriptorPool::AllocateDescriptorSet(DescriptorSetLayout *descLayout)
-{
-    mDescriptorSetCache.emplace_back(std::move(std::make_unique<DescriptorSet>(mDevice, this, descLayout)));
-    return mDescriptorSetCache.back().get();
-}
-
-std::vector<DescriptorSet *> DescriptorPool::AllocateDescriptorSets(DescriptorSetLayout *descLayout, uint32_t count)
-{
-    std::vector<DescriptorSet *> result(count);
-    for (int32_t i = 0; i < count; ++i)
-        result[i] = AllocateDescriptorSet(descLayout);
-    return result;
-}
-
 void DescriptorPool::Build()
 {
     std::vector<VkDescriptorPoolSize> poolSizes;
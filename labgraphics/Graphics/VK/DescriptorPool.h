@@ -1,11 +1,10 @@
 #pragma once
 #include <vulkan/vulkan.h>
-#include <vector>
-#include <memory>
 #include <unordered_map>
-#include "DescriptorSetLayout.h"
-#include "DescriptorSet.h"
+#include "Enum.h"
 
+// A raw pool for code that allocates its own sets, such as the imgui backend; labgraphics sets come from a
+// DescriptorAllocator.
 class DescriptorPool
 {
 public:
@@ -15,15 +14,11 @@ public:
     void AddPoolDesc(DescriptorType type,uint32_t count);
 
     const VkDescriptorPool &GetHandle();
-
-    DescriptorSet* AllocateDescriptorSet(DescriptorSetLayout* descLayout);
-    std::vector<DescriptorSet*> AllocateDescriptorSets(DescriptorSetLayout* descLayout,uint32_t count);
 private:
     void Build();
 
     const class Device &mDevice;
 
-    std::vector<std::unique_ptr<DescriptorSet>> mDescriptorSetCache;
     std::unordered_map<DescriptorType, uint32_t> mPoolDescs;
     VkDescriptorPool mHandle;
 };
\ No newline at end of file
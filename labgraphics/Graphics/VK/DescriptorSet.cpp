@@ -1,146 +1,300 @@
 #include "DescriptorSet.h"
+#include <algorithm>
 #include "Device.h"
-#include "DescriptorPool.h"
-DescriptorSet::DescriptorSet(const Device &device, DescriptorPool *descPool, DescriptorSetLayout *descLayout)
-    : mDevice(device), mHandle(VK_NULL_HANDLE), mDescriptorLayout(descLayout), mDescriptorPool(descPool)
-{
-    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {};
-    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descriptorSetAllocInfo.pNext = nullptr;
-    descriptorSetAllocInfo.pSetLayouts = &mDescriptorLayout->GetHandle();
-    descriptorSetAllocInfo.descriptorPool = descPool->GetHandle();
-    descriptorSetAllocInfo.descriptorSetCount = 1;
 
-    VK_CHECK(vkAllocateDescriptorSets(mDevice.GetHandle(), &descriptorSetAllocInfo, &mHandle));
+static bool operator==(const VkDescriptorBufferInfo &lhs, const VkDescriptorBufferInfo &rhs)
+{
+    return lhs.buffer == rhs.buffer && lhs.offset == rhs.offset && lhs.range == rhs.range;
 }
 
-DescriptorSet::~DescriptorSet()
+static bool operator==(const VkDescriptorImageInfo &lhs, const VkDescriptorImageInfo &rhs)
 {
-    vkFreeDescriptorSets(mDevice.GetHandle(), mDescriptorPool->GetHandle(), 1, &mHandle);
+    return lhs.sampler == rhs.sampler && lhs.imageView == rhs.imageView && lhs.imageLayout == rhs.imageLayout;
 }
 
-const VkDescriptorSet &DescriptorSet::GetHandle() const
+namespace
 {
-    return mHandle;
+    inline void HashCombine(uint64_t &seed, uint64_t value)
+    {
+        seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    }
+
+    template <typename T>
+    inline uint64_t HandleToU64(T handle)
+    {
+        return (uint64_t)handle;
+    }
+
+    inline void HashImageInfo(uint64_t &seed, const VkDescriptorImageInfo &info)
+    {
+        HashCombine(seed, HandleToU64(info.sampler));
+        HashCombine(seed, HandleToU64(info.imageView));
+        HashCombine(seed, (uint64_t)info.imageLayout);
+    }
 }
 
-DescriptorSet &DescriptorSet::WriteBuffer(uint32_t binding, const Buffer *buffer, uint64_t offset, uint64_t size)
+DescriptorWrites &DescriptorWrites::WriteBuffer(uint32_t binding, const Buffer *buffer, uint64_t offset, uint64_t size)
 {
     VkDescriptorBufferInfo bufferInfo{};
     bufferInfo.buffer = buffer->GetHandle();
     bufferInfo.offset = offset;
     bufferInfo.range = size;
 
-    mBufferInfoCache[binding] = bufferInfo;
+    mBufferInfos[binding] = bufferInfo;
 
     return *this;
 }
 
-DescriptorSet &DescriptorSet::WriteBuffer(uint32_t binding, const Buffer *buffer)
+DescriptorWrites &DescriptorWrites::WriteBuffer(uint32_t binding, const Buffer *buffer)
 {
     return WriteBuffer(binding, buffer, 0, buffer->GetSize());
 }
 
-DescriptorSet &DescriptorSet::WriteImage(uint32_t binding, const ImageView2D *imgView, ImageLayout layout, Sampler *sampler)
+DescriptorWrites &DescriptorWrites::WriteImage(uint32_t binding, const ImageView2D *imgView, ImageLayout layout, Sampler *sampler)
 {
     VkDescriptorImageInfo imgInfo;
     imgInfo.imageView = imgView->GetHandle();
     imgInfo.imageLayout = IMAGE_LAYOUT_CAST(layout);
     imgInfo.sampler = sampler ? sampler->GetHandle() : VK_NULL_HANDLE;
 
-    mImageInfoCache[binding] = imgInfo;
+    mImageInfos[binding] = imgInfo;
     return *this;
 }
 
-DescriptorSet &DescriptorSet::WriteImageArray(uint32_t binding, const std::vector<DescriptorImageInfo> &imageInfos)
+DescriptorWrites &DescriptorWrites::WriteImageArray(uint32_t binding, const std::vector<DescriptorImageInfo> &imageInfos)
 {
     std::vector<VkDescriptorImageInfo> rawImageInfos;
     for (const auto &imageInfo : imageInfos)
         rawImageInfos.emplace_back(imageInfo.ToVkDescriptorImageInfo());
 
-    mImagesInfoCache[binding] = rawImageInfos;
+    mImageArrayInfos[binding] = rawImageInfos;
     return *this;
 }
 
-DescriptorSet &DescriptorSet::WriteAccelerationStructure(uint32_t binding, const VkAccelerationStructureKHR &as)
+DescriptorWrites &DescriptorWrites::WriteAccelerationStructure(uint32_t binding, const VkAccelerationStructureKHR &as)
+{
+    mASInfos[binding] = as;
+    return *this;
+}
+
+uint64_t DescriptorWrites::GetHash() const
+{
+    uint64_t seed = 0;
+    for (const auto &bufferInfo : mBufferInfos)
+    {
+        HashCombine(seed, bufferInfo.first);
+        HashCombine(seed, HandleToU64(bufferInfo.second.buffer));
+        HashCombine(seed, bufferInfo.second.offset);
+        HashCombine(seed, bufferInfo.second.range);
+    }
+
+    for (const auto &imageInfo : mImageInfos)
+    {
+        HashCombine(seed, imageInfo.first);
+        HashImageInfo(seed, imageInfo.second);
+    }
+
+    for (const auto &imageArrayInfo : mImageArrayInfos)
+    {
+        HashCombine(seed, imageArrayInfo.first);
+        HashCombine(seed, imageArrayInfo.second.size());
+        for (const auto &imageInfo : imageArrayInfo.second)
+            HashImageInfo(seed, imageInfo);
+    }
+
+    for (const auto &asInfo : mASInfos)
+    {
+        HashCombine(seed, asInfo.first);
+        HashCombine(seed, HandleToU64(asInfo.second));
+    }
+
+    return seed;
+}
+
+bool DescriptorWrites::IsEmpty() const
+{
+    return mBufferInfos.empty() && mImageInfos.empty() && mImageArrayInfos.empty() && mASInfos.empty();
+}
+
+void DescriptorWrites::Clear()
+{
+    mBufferInfos.clear();
+    mImageInfos.clear();
+    mImageArrayInfos.clear();
+    mASInfos.clear();
+}
+
+bool DescriptorWrites::References(const std::vector<uint64_t> &sortedHandles) const
+{
+    const auto contains = [&](uint64_t handle)
+    {
+        return handle != 0 && std::binary_search(sortedHandles.begin(), sortedHandles.end(), handle);
+    };
+    const auto imageInfoReferences = [&](const VkDescriptorImageInfo &info)
+    {
+        return contains(HandleToU64(info.imageView)) || contains(HandleToU64(info.sampler));
+    };
+
+    for (const auto &bufferInfo : mBufferInfos)
+        if (contains(HandleToU64(bufferInfo.second.buffer)))
+            return true;
+
+    for (const auto &imageInfo : mImageInfos)
+        if (imageInfoReferences(imageInfo.second))
+            return true;
+
+    for (const auto &imageArrayInfo : mImageArrayInfos)
+        for (const auto &imageInfo : imageArrayInfo.second)
+            if (imageInfoReferences(imageInfo))
+                return true;
+
+    for (const auto &asInfo : mASInfos)
+        if (contains(HandleToU64(asInfo.second)))
+            return true;
+
+    return false;
+}
+
+bool DescriptorWrites::operator==(const DescriptorWrites &other) const
+{
+    return mBufferInfos == other.mBufferInfos &&
+           mImageInfos == other.mImageInfos &&
+           mImageArrayInfos == other.mImageArrayInfos &&
+           mASInfos == other.mASInfos;
+}
+
+DescriptorSet::DescriptorSet(const Device &device, DescriptorSetLayout *descLayout, VkDescriptorSet handle)
+    : mDevice(device), mHandle(handle), mDescriptorLayout(descLayout)
+{
+}
+
+DescriptorSet::~DescriptorSet()
+{
+    // sets are released in bulk when their DescriptorAllocator page is reset
+}
+
+const VkDescriptorSet &DescriptorSet::GetHandle() const
+{
+    return mHandle;
+}
+
+DescriptorSetLayout *DescriptorSet::GetLayout() const
+{
+    return mDescriptorLayout;
+}
+
+DescriptorSet &DescriptorSet::WriteBuffer(uint32_t binding, const Buffer *buffer, uint64_t offset, uint64_t size)
 {
-    VkWriteDescriptorSetAccelerationStructureKHR structureInfo = {};
-    structureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
-    structureInfo.pNext = nullptr;
-    structureInfo.accelerationStructureCount = 1;
-    structureInfo.pAccelerationStructures = &as;
+    mPendingWrites.WriteBuffer(binding, buffer, offset, size);
+    return *this;
+}
+
+DescriptorSet &DescriptorSet::WriteBuffer(uint32_t binding, const Buffer *buffer)
+{
+    mPendingWrites.WriteBuffer(binding, buffer);
+    return *this;
+}
+
+DescriptorSet &DescriptorSet::WriteImage(uint32_t binding, const ImageView2D *imgView, ImageLayout layout, Sampler *sampler)
+{
+    mPendingWrites.WriteImage(binding, imgView, layout, sampler);
+    return *this;
+}
 
-    mASInfoCache[binding] = structureInfo;
+DescriptorSet &DescriptorSet::WriteImageArray(uint32_t binding, const std::vector<DescriptorImageInfo> &imageInfos)
+{
+    mPendingWrites.WriteImageArray(binding, imageInfos);
+    return *this;
+}
+
+DescriptorSet &DescriptorSet::WriteAccelerationStructure(uint32_t binding, const VkAccelerationStructureKHR &as)
+{
+    mPendingWrites.WriteAccelerationStructure(binding, as);
     return *this;
 }
 
 void DescriptorSet::Update()
+{
+    Update(mPendingWrites);
+    mPendingWrites.Clear();
+}
+
+void DescriptorSet::Update(const DescriptorWrites &writes)
 {
     std::vector<VkWriteDescriptorSet> writeDescriptorSets;
-    for (const auto &bufferInfoCache : mBufferInfoCache)
+    for (const auto &bufferInfo : writes.mBufferInfos)
     {
-        auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(bufferInfoCache.first);
+        auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(bufferInfo.first);
 
         VkWriteDescriptorSet setWrite{};
         setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         setWrite.pNext = nullptr;
         setWrite.dstSet = mHandle;
-        setWrite.dstBinding = bufferInfoCache.first;
+        setWrite.dstBinding = bufferInfo.first;
         setWrite.dstArrayElement = 0;
         setWrite.descriptorCount = 1;
         setWrite.descriptorType = layoutBinding.descriptorType;
         setWrite.pImageInfo = nullptr;
-        setWrite.pBufferInfo = &bufferInfoCache.second;
+        setWrite.pBufferInfo = &bufferInfo.second;
         setWrite.pTexelBufferView = nullptr;
 
         writeDescriptorSets.emplace_back(setWrite);
     }
 
-    for (const auto &imageInfoCache : mImageInfoCache)
+    for (const auto &imageInfo : writes.mImageInfos)
     {
-        auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(imageInfoCache.first);
+        auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(imageInfo.first);
 
         VkWriteDescriptorSet setWrite{};
         setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         setWrite.pNext = nullptr;
         setWrite.dstSet = mHandle;
-        setWrite.dstBinding = imageInfoCache.first;
+        setWrite.dstBinding = imageInfo.first;
         setWrite.dstArrayElement = 0;
         setWrite.descriptorCount = 1;
         setWrite.descriptorType = layoutBinding.descriptorType;
         setWrite.pBufferInfo = nullptr;
-        setWrite.pImageInfo = &imageInfoCache.second;
+        setWrite.pImageInfo = &imageInfo.second;
         setWrite.pTexelBufferView = nullptr;
 
         writeDescriptorSets.emplace_back(setWrite);
     }
 
-    for (const auto &imagesInfoCache : mImagesInfoCache)
+    for (const auto &imageArrayInfo : writes.mImageArrayInfos)
     {
-        auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(imagesInfoCache.first);
+        auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(imageArrayInfo.first);
 
         VkWriteDescriptorSet setWrite{};
         setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         setWrite.pNext = nullptr;
         setWrite.dstSet = mHandle;
-        setWrite.dstBinding = imagesInfoCache.first;
+        setWrite.dstBinding = imageArrayInfo.first;
         setWrite.dstArrayElement = 0;
-        setWrite.descriptorCount = imagesInfoCache.second.size();
+        setWrite.descriptorCount = imageArrayInfo.second.size();
         setWrite.descriptorType = layoutBinding.descriptorType;
         setWrite.pBufferInfo = nullptr;
-        setWrite.pImageInfo = imagesInfoCache.second.data();
+        setWrite.pImageInfo = imageArrayInfo.second.data();
         setWrite.pTexelBufferView = nullptr;
 
         writeDescriptorSets.emplace_back(setWrite);
     }
 
-    for (const auto &asInfo : mASInfoCache)
+    std::vector<VkWriteDescriptorSetAccelerationStructureKHR> asWrites;
+    asWrites.reserve(writes.mASInfos.size());
+    for (const auto &asInfo : writes.mASInfos)
     {
         auto layoutBinding = mDescriptorLayout->GetVkLayoutBinding(asInfo.first);
 
+        VkWriteDescriptorSetAccelerationStructureKHR structureInfo = {};
+        structureInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
+        structureInfo.pNext = nullptr;
+        structureInfo.accelerationStructureCount = 1;
+        structureInfo.pAccelerationStructures = &asInfo.second;
+        asWrites.emplace_back(structureInfo);
+
         VkWriteDescriptorSet setWrite{};
         setWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        setWrite.pNext = &asInfo.second;
+        setWrite.pNext = &asWrites.back();
         setWrite.dstSet = mHandle;
         setWrite.dstBinding = asInfo.first;
         setWrite.dstArrayElement = 0;
@@ -154,9 +308,4 @@ void DescriptorSet::Update()
     }
 
     vkUpdateDescriptorSets(mDevice.GetHandle(), writeDescriptorSets.size(), writeDescriptorSets.data(), 0, nullptr);
-
-    mBufferInfoCache.clear();
-    mImageInfoCache.clear();
-    mImagesInfoCache.clear();
-    mASInfoCache.clear();
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <vulkan/vulkan.h>
-#include <unordered_map>
+#include <map>
+#include <vector>
 #include <cstdint>
 #include "Buffer.h"
 #include "ImageView.h"
@@ -24,13 +25,42 @@ struct DescriptorImageInfo
     }
 };
 
+// Pending descriptor writes of one set, comparable and hashable so that identical sets can be shared.
+class DescriptorWrites
+{
+public:
+    DescriptorWrites &WriteBuffer(uint32_t binding, const Buffer *buffer, uint64_t offset, uint64_t size);
+    DescriptorWrites &WriteBuffer(uint32_t binding, const Buffer *buffer);
+    DescriptorWrites &WriteImage(uint32_t binding, const ImageView2D *imgView, ImageLayout layout, Sampler *sampler = nullptr);
+    DescriptorWrites &WriteImageArray(uint32_t binding, const std::vector<DescriptorImageInfo> &imageInfos);
+    DescriptorWrites &WriteAccelerationStructure(uint32_t binding, const VkAccelerationStructureKHR &as);
+
+    uint64_t GetHash() const;
+    bool IsEmpty() const;
+    void Clear();
+
+    // whether a buffer, view, sampler or acceleration structure of the writes is among the sorted handles
+    bool References(const std::vector<uint64_t> &sortedHandles) const;
+
+    bool operator==(const DescriptorWrites &other) const;
+
+private:
+    friend class DescriptorSet;
+
+    std::map<uint32_t, VkDescriptorBufferInfo> mBufferInfos;
+    std::map<uint32_t, VkDescriptorImageInfo> mImageInfos;
+    std::map<uint32_t, std::vector<VkDescriptorImageInfo>> mImageArrayInfos;
+    std::map<uint32_t, VkAccelerationStructureKHR> mASInfos;
+};
+
 class DescriptorSet
 {
 public:
-    DescriptorSet(const class Device &device, class DescriptorPool *descPool, class DescriptorSetLayout *descLayout);
+    DescriptorSet(const class Device &device, class DescriptorSetLayout *descLayout, VkDescriptorSet handle);
     ~DescriptorSet();
 
     const VkDescriptorSet &GetHandle() const;
+    class DescriptorSetLayout *GetLayout() const;
 
     DescriptorSet &WriteBuffer(uint32_t binding, const Buffer *buffer, uint64_t offset, uint64_t size);
     DescriptorSet &WriteBuffer(uint32_t binding, const Buffer *buffer);
@@ -39,16 +69,13 @@ public:
     DescriptorSet &WriteAccelerationStructure(uint32_t binding, const VkAccelerationStructureKHR &as);
 
     void Update();
+    void Update(const DescriptorWrites &writes);
 
 private:
     const class Device &mDevice;
 
-    std::unordered_map<uint32_t, VkDescriptorBufferInfo> mBufferInfoCache;
-    std::unordered_map<uint32_t, VkDescriptorImageInfo> mImageInfoCache;
-    std::unordered_map<uint32_t, std::vector<VkDescriptorImageInfo>> mImagesInfoCache;
-    std::unordered_map<uint32_t, VkWriteDescriptorSetAccelerationStructureKHR> mASInfoCache;
+    DescriptorWrites mPendingWrites;
 
-    class DescriptorPool *mDescriptorPool;
     DescriptorSetLayout *mDescriptorLayout;
     VkDescriptorSet mHandle;
-};
\ No newline at end of file
+};
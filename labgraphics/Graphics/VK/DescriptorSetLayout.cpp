@@ -32,6 +32,20 @@ DescriptorSetLayout &DescriptorSetLayout::AddLayoutBinding(uint32_t binding, uin
     return *this;
 }
 
+DescriptorSetLayout &DescriptorSetLayout::SetBindingFlags(uint32_t binding, VkDescriptorBindingFlags flags)
+{
+    mBindingFlags[binding] = flags;
+    return *this;
+}
+
+bool DescriptorSetLayout::IsUpdateAfterBind() const
+{
+    for (const auto &bindingFlags : mBindingFlags)
+        if (bindingFlags.second & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT)
+            return true;
+    return false;
+}
+
 const VkDescriptorSetLayout &DescriptorSetLayout::GetHandle()
 {
     if (mHandle == VK_NULL_HANDLE)
@@ -42,6 +56,10 @@ const VkDescriptorSetLayout &DescriptorSetLayout::GetHandle()
 
 VkDescriptorSetLayoutBinding DescriptorSetLayout::GetVkLayoutBinding(uint32_t i)
 {
+    // bindings may be sparse, look the binding point up before falling back to the position
+    for (const auto &binding : mBindings)
+        if (binding.bindingPoint == i)
+            return binding.ToVkDescriptorBinding();
     return mBindings[i].ToVkDescriptorBinding();
 }
 
@@ -62,10 +80,24 @@ void DescriptorSetLayout::Build()
     for (int32_t i = 0; i < mBindings.size(); ++i)
         rawDescLayouts[i] = mBindings[i].ToVkDescriptorBinding();
 
+    std::vector<VkDescriptorBindingFlags> rawBindingFlags(mBindings.size(), 0);
+    for (int32_t i = 0; i < mBindings.size(); ++i)
+    {
+        auto iter = mBindingFlags.find(mBindings[i].bindingPoint);
+        if (iter != mBindingFlags.end())
+            rawBindingFlags[i] = iter->second;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.pNext = nullptr;
+    bindingFlagsInfo.bindingCount = rawBindingFlags.size();
+    bindingFlagsInfo.pBindingFlags = rawBindingFlags.data();
+
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
     descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorSetLayoutInfo.pNext = nullptr;
-    descriptorSetLayoutInfo.flags = 0;
+    descriptorSetLayoutInfo.pNext = mBindingFlags.empty() ? nullptr : &bindingFlagsInfo;
+    descriptorSetLayoutInfo.flags = IsUpdateAfterBind() ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
     descriptorSetLayoutInfo.bindingCount = rawDescLayouts.size();
     descriptorSetLayoutInfo.pBindings = rawDescLayouts.data();
 
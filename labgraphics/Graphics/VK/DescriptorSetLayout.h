@@ -1,6 +1,7 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <map>
 #include "Shader.h"
 #include "Sampler.h"
 #include "Enum.h"
@@ -40,6 +41,10 @@ public:
     DescriptorSetLayout &AddLayoutBinding(const DescriptorBinding &binding);
     DescriptorSetLayout &AddLayoutBinding(uint32_t binding, uint32_t count, DescriptorType type, ShaderStage shaderStage, Sampler *pImmutableSamplers = nullptr);
 
+    // VkDescriptorBindingFlags of descriptor indexing, UPDATE_AFTER_BIND bindings need a pool created with UPDATE_AFTER_BIND_BIT
+    DescriptorSetLayout &SetBindingFlags(uint32_t binding, VkDescriptorBindingFlags flags);
+    bool IsUpdateAfterBind() const;
+
     const VkDescriptorSetLayout &GetHandle();
     VkDescriptorSetLayoutBinding GetVkLayoutBinding(uint32_t i);
     const DescriptorBinding &GetLayoutBinding(uint32_t i) const;
@@ -51,6 +56,7 @@ private:
     const class Device &mDevice;
 
     std::vector<DescriptorBinding> mBindings;
+    std::map<uint32_t, VkDescriptorBindingFlags> mBindingFlags;
 
     VkDescriptorSetLayout mHandle;
 };
\ No newline at end of file
@@ -1,11 +1,15 @@
 #include "DescriptorTable.h"
 #include "Device.h"
-#include "DescriptorPool.h"
+#include "DescriptorAllocator.h"
 #include "DescriptorSet.h"
 #include "DescriptorSetLayout.h"
 
+// tables hand out a few sets each, per frame in flight or per pass
+constexpr uint32_t TABLE_SETS_PER_PAGE = 8;
+constexpr uint32_t TABLE_MAX_SETS_PER_PAGE = 256;
+
 DescriptorTable::DescriptorTable(const Device &device)
-    : mDescriptorPool(std::make_unique<DescriptorPool>(device)), mDescriptorLayout(std::make_unique<DescriptorSetLayout>(device))
+    : mDevice(device), mDescriptorLayout(std::make_unique<DescriptorSetLayout>(device))
 {
 }
 
@@ -15,26 +19,26 @@ DescriptorTable::~DescriptorTable()
 
 DescriptorTable &DescriptorTable::AddLayoutBinding(const DescriptorBinding &binding)
 {
-    mDescriptorPool->AddPoolDesc(binding.type, binding.count);
+    mDescriptorCounts[binding.type] += binding.count;
     mDescriptorLayout->AddLayoutBinding(binding);
     return *this;
 }
 
 DescriptorTable &DescriptorTable::AddLayoutBinding(uint32_t binding, uint32_t count, DescriptorType type, ShaderStage shaderStage, Sampler *pImmutableSamplers)
 {
-    mDescriptorPool->AddPoolDesc(type, count);
+    mDescriptorCounts[type] += count;
     mDescriptorLayout->AddLayoutBinding(binding, count, type, shaderStage, pImmutableSamplers);
     return *this;
 }
 
 DescriptorSet *DescriptorTable::AllocateDescriptorSet()
 {
-    return mDescriptorPool->AllocateDescriptorSet(mDescriptorLayout.get());
+    return GetAllocator()->Allocate(mDescriptorLayout.get());
 }
 
 std::vector<DescriptorSet *> DescriptorTable::AllocateDescriptorSets(uint32_t count)
 {
-    return mDescriptorPool->AllocateDescriptorSets(mDescriptorLayout.get(), count);
+    return GetAllocator()->Allocate(mDescriptorLayout.get(), count);
 }
 
 DescriptorSetLayout *DescriptorTable::GetLayout()
@@ -42,11 +46,6 @@ DescriptorSetLayout *DescriptorTable::GetLayout()
     return mDescriptorLayout.get();
 }
 
-DescriptorPool *DescriptorTable::GetPool()
-{
-    return mDescriptorPool.get();
-}
-
 DescriptorBinding DescriptorTable::GetLayoutBinding(uint32_t i)
 {
     return mDescriptorLayout->GetLayoutBinding(i);
@@ -55,4 +54,15 @@ DescriptorBinding DescriptorTable::GetLayoutBinding(uint32_t i)
 uint32_t DescriptorTable::GetBindingCount() const
 {
     return mDescriptorLayout->GetBindingCount();
-}
\ No newline at end of file
+}
+
+DescriptorAllocator *DescriptorTable::GetAllocator()
+{
+    // the bindings are complete once the first set is allocated
+    if (mDescriptorAllocator == nullptr)
+    {
+        mDescriptorAllocator = std::make_unique<DescriptorAllocator>(mDevice, TABLE_SETS_PER_PAGE, TABLE_MAX_SETS_PER_PAGE);
+        mDescriptorAllocator->SetPoolRatios(mDescriptorCounts);
+    }
+    return mDescriptorAllocator.get();
+}
@@ -1,7 +1,11 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include "Sampler.h"
+
+// A descriptor set layout and the sets allocated with it. The sets come from a paged DescriptorAllocator sized for
+// this layout and live as long as the table.
 class DescriptorTable
 {
 public:
@@ -15,12 +19,16 @@ public:
     std::vector<class DescriptorSet *> AllocateDescriptorSets(uint32_t count);
 
     class DescriptorSetLayout *GetLayout();
-    class DescriptorPool *GetPool();
 
     struct DescriptorBinding GetLayoutBinding(uint32_t i);
     uint32_t GetBindingCount() const;
 
 private:
-    std::unique_ptr<class DescriptorPool> mDescriptorPool;
+    class DescriptorAllocator *GetAllocator();
+
+    const class Device &mDevice;
+    std::unique_ptr<class DescriptorAllocator> mDescriptorAllocator;
     std::unique_ptr<class DescriptorSetLayout> mDescriptorLayout;
+    // descriptors of each type in one set, the allocator's pages are sized from it
+    std::unordered_map<DescriptorType, float> mDescriptorCounts;
 };
\ No newline at end of file
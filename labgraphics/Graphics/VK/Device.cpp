@@ -1,7 +1,14 @@
 #include "Device.h"
 #include <iostream>
+#include <cstring>
 #include "Utils.h"
 #include "CommandPool.h"
+#include "BindlessTable.h"
+#include "ReadbackQueue.h"
+#include "Logger.h"
+
+// destroyed handles a cache may fall behind by before it has to drop all of its entries
+constexpr size_t DESTROYED_RESOURCE_LOG_SIZE = 4096;
 
 Device::Device(const Instance &instance, uint64_t requiredFeature)
     : mInstance(instance), mRequiredFeature(requiredFeature)
@@ -22,11 +29,16 @@ Device::Device(const Instance &instance, uint64_t requiredFeature)
     deviceProperties2.pNext = &mRayTracingPipelineProperties;
     vkGetPhysicalDeviceProperties2(mPhysicalDevice, &deviceProperties2);
 
+    VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexingFeatures{};
+    supportedIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
     mRayTracingAccelerationFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+    mRayTracingAccelerationFeatures.pNext = &supportedIndexingFeatures;
     VkPhysicalDeviceFeatures2 deviceFeatures2{};
     deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
     deviceFeatures2.pNext = &mRayTracingAccelerationFeatures;
     vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &deviceFeatures2);
+    mPhysicalDeviceFeatures = deviceFeatures2.features;
+    mRayTracingAccelerationFeatures.pNext = nullptr;
 
     mRayTracingAccelerationProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
     VkPhysicalDeviceProperties2 deviceProps2{};
@@ -34,6 +46,25 @@ Device::Device(const Instance &instance, uint64_t requiredFeature)
     deviceProps2.pNext = &mRayTracingAccelerationProps;
     vkGetPhysicalDeviceProperties2(mPhysicalDevice, &deviceProps2);
 
+    // software rasterizers such as lavapipe have no ray tracing, headless runs keep going with raster and compute only
+    if ((mRequiredFeature & DeviceFeature::RAY_TRACE) == DeviceFeature::RAY_TRACE && mRayTracingAccelerationFeatures.accelerationStructure != VK_TRUE)
+    {
+        LOG_WARN("{} has no ray tracing support, RAY_TRACE feature disabled", deviceProperties.deviceName);
+        mRequiredFeature &= ~(uint64_t)(DeviceFeature::RAY_TRACE & ~DeviceFeature::BUFFER_ADDRESS);
+    }
+
+    // GetBindlessTable returns nullptr without it, its users fall back to fixed size descriptor arrays
+    const bool bindlessSupported = supportedIndexingFeatures.descriptorBindingPartiallyBound == VK_TRUE &&
+                                   supportedIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE &&
+                                   supportedIndexingFeatures.descriptorBindingUpdateUnusedWhilePending == VK_TRUE;
+    if ((mRequiredFeature & DeviceFeature::BINDLESS) == DeviceFeature::BINDLESS && !bindlessSupported)
+    {
+        LOG_WARN("{} has no update after bind sampled image arrays, BINDLESS feature disabled", deviceProperties.deviceName);
+        mRequiredFeature &= ~(uint64_t)DeviceFeature::BINDLESS;
+    }
+
+    mEnabledExtensions = SelectDeviceExtensions();
+
     const float queuePriority = 0.0f;
     VkDeviceQueueCreateInfo deviceQueueInfo{};
     deviceQueueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -45,25 +76,29 @@ Device::Device(const Instance &instance, uint64_t requiredFeature)
     deviceInfo.pNext = nullptr;
     deviceInfo.queueCreateInfoCount = 1;
     deviceInfo.pQueueCreateInfos = &deviceQueueInfo;
-    deviceInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
-    deviceInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    deviceInfo.enabledExtensionCount = (uint32_t)mEnabledExtensions.size();
+    deviceInfo.ppEnabledExtensionNames = mEnabledExtensions.data();
 
     VkPhysicalDeviceFeatures requiredDeviceFeature{};
+    VkPhysicalDeviceBufferDeviceAddressFeatures deviceBufferDeviceAddressFeatures{};
+    VkPhysicalDeviceRayTracingPipelineFeaturesKHR deviceRayTracingPipelineFeatures{};
     VkPhysicalDeviceAccelerationStructureFeaturesKHR deviceAccelerationStructureFeatures{};
-    if (requiredFeature & DeviceFeature::ANISOTROPY_SAMPLER)
+    VkPhysicalDeviceDescriptorIndexingFeatures deviceDescriptorIndexingFeatures{};
+    if (mRequiredFeature & DeviceFeature::ANISOTROPY_SAMPLER)
     {
         requiredDeviceFeature.samplerAnisotropy = VK_TRUE;
         requiredDeviceFeature.shaderStorageImageExtendedFormats = VK_TRUE;
     }
 
-    if (requiredFeature & DeviceFeature::RAY_TRACE)
+    // block compressed textures are imported as plain mips when this is missing
+    requiredDeviceFeature.textureCompressionBC = mPhysicalDeviceFeatures.textureCompressionBC;
+
+    if ((mRequiredFeature & DeviceFeature::RAY_TRACE) == DeviceFeature::RAY_TRACE)
     {
-        VkPhysicalDeviceBufferDeviceAddressFeatures deviceBufferDeviceAddressFeatures{};
         deviceBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
         deviceBufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
         deviceBufferDeviceAddressFeatures.pNext = nullptr;
 
-        VkPhysicalDeviceRayTracingPipelineFeaturesKHR deviceRayTracingPipelineFeatures{};
         deviceRayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
         deviceRayTracingPipelineFeatures.rayTracingPipeline = VK_TRUE;
         deviceRayTracingPipelineFeatures.pNext = &deviceBufferDeviceAddressFeatures;
@@ -74,15 +109,30 @@ Device::Device(const Instance &instance, uint64_t requiredFeature)
 
         deviceInfo.pNext = &deviceAccelerationStructureFeatures;
     }
-    else if (requiredFeature & DeviceFeature::BUFFER_ADDRESS)
+    else if (mRequiredFeature & DeviceFeature::BUFFER_ADDRESS)
     {
-        VkPhysicalDeviceBufferDeviceAddressFeatures deviceBufferDeviceAddressFeatures{};
         deviceBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
         deviceBufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
         deviceBufferDeviceAddressFeatures.pNext = nullptr;
         deviceInfo.pNext = &deviceBufferDeviceAddressFeatures;
     }
 
+    // the texture arrays of the ray tracing shaders are indexed per hit, with or without the bindless table
+    if ((mRequiredFeature & DeviceFeature::BINDLESS) || (mRequiredFeature & DeviceFeature::RAY_TRACE) == DeviceFeature::RAY_TRACE)
+    {
+        deviceDescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        deviceDescriptorIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = supportedIndexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+        deviceDescriptorIndexingFeatures.runtimeDescriptorArray = supportedIndexingFeatures.runtimeDescriptorArray;
+        if ((mRequiredFeature & DeviceFeature::BINDLESS) == DeviceFeature::BINDLESS)
+        {
+            deviceDescriptorIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            deviceDescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            deviceDescriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        }
+        deviceDescriptorIndexingFeatures.pNext = (void *)deviceInfo.pNext;
+        deviceInfo.pNext = &deviceDescriptorIndexingFeatures;
+    }
+
     deviceInfo.pEnabledFeatures = &requiredDeviceFeature;
 
     VK_CHECK(vkCreateDevice(mPhysicalDevice, &deviceInfo, nullptr, &mHandle));
@@ -107,10 +157,12 @@ Device::~Device()
 {
     WaitIdle();
 
+    mReadbackQueue.reset(nullptr);
     mRasterCommandPool.reset(nullptr);
     mComputeCommandPool.reset(nullptr);
     mRayTraceCommandPool.reset(nullptr);
     mTransferCommandPool.reset(nullptr);
+    mBindlessTable.reset(nullptr);
     vkDestroyDevice(mHandle, nullptr);
 }
 
@@ -245,9 +297,9 @@ std::unique_ptr<GpuImage2D> Device::CreateGpuImage2D(uint32_t width, uint32_t he
     return std::move(std::make_unique<GpuImage2D>(*this, width, height, format, tiling, ImageUsage::TRANSFER_DST | ImageUsage::STORAGE));
 }
 
-std::unique_ptr<ImageView2D> Device::CreateImageView(VkImage image, Format format) const
+std::unique_ptr<ImageView2D> Device::CreateImageView(VkImage image, Format format, uint32_t mipLevels) const
 {
-    return std::move(std::make_unique<ImageView2D>(*this, image, format));
+    return std::move(std::make_unique<ImageView2D>(*this, image, format, mipLevels));
 }
 
 RasterCommandPool *Device::GetRasterCommandPool()
@@ -278,6 +330,47 @@ TransferCommandPool *Device::GetTransferCommandPool()
     return mTransferCommandPool.get();
 }
 
+uint64_t Device::GetResourceGeneration() const
+{
+    return mResourceGeneration.load(std::memory_order_acquire);
+}
+
+void Device::NotifyResourceDestroyed(uint64_t handle) const
+{
+    std::lock_guard<std::mutex> lock(mDestroyedResourcesMutex);
+    mDestroyedResources.emplace_back(handle);
+    if (mDestroyedResources.size() > DESTROYED_RESOURCE_LOG_SIZE)
+        mDestroyedResources.pop_front();
+    mResourceGeneration.fetch_add(1, std::memory_order_acq_rel);
+}
+
+bool Device::GetDestroyedResources(uint64_t generation, uint64_t &currentGeneration, std::vector<uint64_t> &handles) const
+{
+    std::lock_guard<std::mutex> lock(mDestroyedResourcesMutex);
+    currentGeneration = mResourceGeneration.load(std::memory_order_acquire);
+    const uint64_t firstGeneration = currentGeneration - mDestroyedResources.size();
+    if (generation < firstGeneration)
+        return false;
+    handles.assign(mDestroyedResources.begin() + (generation - firstGeneration), mDestroyedResources.end());
+    return true;
+}
+
+BindlessTable *Device::GetBindlessTable()
+{
+    if ((mRequiredFeature & DeviceFeature::BINDLESS) != DeviceFeature::BINDLESS)
+        return nullptr;
+    if (mBindlessTable == nullptr)
+        mBindlessTable = std::make_unique<BindlessTable>(*this);
+    return mBindlessTable.get();
+}
+
+ReadbackQueue *Device::GetReadbackQueue()
+{
+    if (mReadbackQueue == nullptr)
+        mReadbackQueue = std::make_unique<ReadbackQueue>(*this);
+    return mReadbackQueue.get();
+}
+
 std::unique_ptr<GpuBuffer> Device::CreateGPUBuffer(uint64_t bufferSize, BufferUsage usage) const
 {
     return std::move(std::make_unique<GpuBuffer>(const_cast<Device &>(*this), bufferSize, usage));
@@ -298,6 +391,20 @@ std::unique_ptr<CpuBuffer> Device::CreateCPUStorageBuffer(void *srcData, uint64_
     return CreateCPUBuffer(srcData, bufferSize, BufferUsage::STORAGE);
 }
 
+std::unique_ptr<Buffer> Device::CreateReadbackBuffer(uint64_t bufferSize) const
+{
+    VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (uint32_t i = 0; i < mPhysicalDeviceMemoryProps.memoryTypeCount; ++i)
+    {
+        if (mPhysicalDeviceMemoryProps.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+        {
+            properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            break;
+        }
+    }
+    return std::move(std::make_unique<Buffer>(const_cast<Device &>(*this), bufferSize, BufferUsage::TRANSFER_DST, properties));
+}
+
 std::unique_ptr<CpuBuffer> Device::CreateCPUStorageBuffer(uint64_t bufferSize) const
 {
     return CreateCPUBuffer(bufferSize, BufferUsage::STORAGE);
@@ -332,6 +439,22 @@ VkPhysicalDevice Device::SelectPhyDevice()
         }
     }
 
+    // without a display any device will do, this also picks up CPU implementations like lavapipe
+    if (result == VK_NULL_HANDLE && mInstance.IsHeadless() && !phyDevices.empty())
+    {
+        result = phyDevices[0];
+        for (const auto &phyDevice : phyDevices)
+        {
+            VkPhysicalDeviceProperties deviceProperties;
+            vkGetPhysicalDeviceProperties(phyDevice, &deviceProperties);
+            if (deviceProperties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU)
+            {
+                result = phyDevice;
+                break;
+            }
+        }
+    }
+
     if (result == VK_NULL_HANDLE)
     {
         std::cout << "No ray tracing compatible GPU found" << std::endl;
@@ -361,6 +484,77 @@ VkPhysicalDevice Device::SelectPhyDevice()
     return result;
 }
 
+std::vector<const char *> Device::SelectDeviceExtensions() const
+{
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensionProps(extensionCount);
+    vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &extensionCount, extensionProps.data());
+
+    const bool rayTrace = (mRequiredFeature & DeviceFeature::RAY_TRACE) == DeviceFeature::RAY_TRACE;
+
+    std::vector<const char *> result;
+    for (const auto &extension : deviceExtensions)
+    {
+        if (mInstance.IsHeadless() && strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0)
+            continue;
+
+        if (!rayTrace && (strcmp(extension, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME) == 0 ||
+                          strcmp(extension, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) == 0 ||
+                          strcmp(extension, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME) == 0 ||
+                          strcmp(extension, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0))
+            continue;
+
+        if (!CheckExtensionSupport({extension}, extensionProps))
+        {
+            LOG_WARN("Device extension {} is not supported, skipped", extension);
+            continue;
+        }
+
+        result.emplace_back(extension);
+    }
+
+    // optional, only feeds GetDeviceLocalMemoryUsage
+    if (CheckExtensionSupport({VK_EXT_MEMORY_BUDGET_EXTENSION_NAME}, extensionProps))
+        result.emplace_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    return result;
+}
+
+bool Device::IsTextureCompressionBCSupported() const
+{
+    return mPhysicalDeviceFeatures.textureCompressionBC == VK_TRUE;
+}
+
+bool Device::IsMemoryBudgetSupported() const
+{
+    for (const auto &extension : mEnabledExtensions)
+        if (strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            return true;
+    return false;
+}
+
+uint64_t Device::GetDeviceLocalMemoryUsage() const
+{
+    if (!IsMemoryBudgetSupported())
+        return 0;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps{};
+    budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    VkPhysicalDeviceMemoryProperties2 memoryProps2{};
+    memoryProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memoryProps2.pNext = &budgetProps;
+    vkGetPhysicalDeviceMemoryProperties2(mPhysicalDevice, &memoryProps2);
+
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < memoryProps2.memoryProperties.memoryHeapCount; ++i)
+    {
+        if (memoryProps2.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            result += budgetProps.heapUsage[i];
+    }
+    return result;
+}
+
 const VkPhysicalDeviceRayTracingPipelinePropertiesKHR &Device::GetRayTracingPipelineProps() const
 {
     return mRayTracingPipelineProperties;
@@ -1,5 +1,8 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <memory>
 #include "Queue.h"
 #include "Instance.h"
@@ -29,6 +32,7 @@ enum DeviceFeature
 	BUFFER_ADDRESS = 0x0001,
 	RAY_TRACE = 0x0011,
 	ANISOTROPY_SAMPLER = 0x0100,
+	BINDLESS = 0x1000,
 };
 class Device
 {
@@ -66,6 +70,17 @@ public:
 	class RayTraceCommandPool *GetRayTraceCommandPool();
 	class TransferCommandPool *GetTransferCommandPool();
 
+	class BindlessTable *GetBindlessTable();
+	class ReadbackQueue *GetReadbackQueue();
+
+	// bumped whenever a resource descriptors may reference is destroyed: a uniform or storage buffer, an image view,
+	// a sampler or an acceleration structure. Caches keyed by raw handles compare it to know a handle they hold may
+	// have been recycled, then read the destroyed handles back to drop only the entries holding them.
+	uint64_t GetResourceGeneration() const;
+	void NotifyResourceDestroyed(uint64_t handle) const;
+	// handles destroyed from generation up to currentGeneration, false once the oldest of them has left the log
+	bool GetDestroyedResources(uint64_t generation, uint64_t &currentGeneration, std::vector<uint64_t> &handles) const;
+
 	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
 
 	template <typename T>
@@ -90,6 +105,8 @@ public:
 	std::unique_ptr<GpuBuffer> CreateGPUStorageBuffer(uint64_t bufferSize) const;
 	std::unique_ptr<CpuBuffer> CreateCPUStorageBuffer(void *srcData, uint64_t bufferSize) const;
 	std::unique_ptr<CpuBuffer> CreateCPUStorageBuffer(uint64_t bufferSize) const;
+	// Host visible transfer destination, host cached when the device offers it so mapped reads are fast
+	std::unique_ptr<Buffer> CreateReadbackBuffer(uint64_t bufferSize) const;
 
 	const VkPhysicalDeviceRayTracingPipelinePropertiesKHR &GetRayTracingPipelineProps() const;
 	const VkPhysicalDeviceAccelerationStructureFeaturesKHR &GetRayTracingAccelerationFeatures() const;
@@ -97,6 +114,13 @@ public:
 	const VkPhysicalDeviceProperties &GetPhysicalProps() const;
 	const VkPhysicalDeviceMemoryProperties &GetPhysicalMemoryProps() const;
 
+	// BC1-BC7 sampled images, enabled at creation whenever the device has them
+	bool IsTextureCompressionBCSupported() const;
+
+	bool IsMemoryBudgetSupported() const;
+	// bytes of the device local heaps in use by this process, 0 without VK_EXT_memory_budget
+	uint64_t GetDeviceLocalMemoryUsage() const;
+
 	std::unique_ptr<DescriptorTable> CreateDescriptorTable();
 
 	PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT = nullptr;
@@ -115,15 +139,18 @@ public:
 private:
 	friend class SwapChain;
 	friend class Image2D;
-	std::unique_ptr<ImageView2D> CreateImageView(VkImage image, Format format) const;
+	std::unique_ptr<ImageView2D> CreateImageView(VkImage image, Format format, uint32_t mipLevels = 1) const;
 
 private:
 	VkPhysicalDevice SelectPhyDevice();
+	// deviceExtensions minus the ones the enabled features or a headless instance do not need
+	std::vector<const char *> SelectDeviceExtensions() const;
 
 	const Instance &mInstance;
 	VkPhysicalDevice mPhysicalDevice;
 	VkPhysicalDeviceProperties mPhysicalDeviceProps;
 	VkPhysicalDeviceMemoryProperties mPhysicalDeviceMemoryProps;
+	VkPhysicalDeviceFeatures mPhysicalDeviceFeatures{};
 	VkPhysicalDeviceRayTracingPipelinePropertiesKHR mRayTracingPipelineProperties{};
 	VkPhysicalDeviceAccelerationStructureFeaturesKHR mRayTracingAccelerationFeatures{};
 	VkPhysicalDeviceAccelerationStructurePropertiesKHR mRayTracingAccelerationProps{};
@@ -131,6 +158,7 @@ private:
 	VkDevice mHandle;
 
 	uint64_t mRequiredFeature;
+	std::vector<const char *> mEnabledExtensions;
 
 	QueueFamilyIndices mQueueFamilyIndices;
 
@@ -143,5 +171,13 @@ private:
 	std::unique_ptr<class ComputeCommandPool> mComputeCommandPool;
 	std::unique_ptr<class RayTraceCommandPool> mRayTraceCommandPool;
 	std::unique_ptr<class TransferCommandPool> mTransferCommandPool;
+
+	std::unique_ptr<class BindlessTable> mBindlessTable;
+	std::unique_ptr<class ReadbackQueue> mReadbackQueue;
+
+	// resources may be destroyed off the render thread
+	mutable std::mutex mDestroyedResourcesMutex;
+	mutable std::deque<uint64_t> mDestroyedResources;
+	mutable std::atomic<uint64_t> mResourceGeneration{0};
 };
 #include "Device.inl"
\ No newline at end of file
@@ -327,6 +327,61 @@ public:
                mHandle == Format::S8_UINT;
     }
 
+    // Bytes per texel of the core uncompressed formats, 0 for block compressed, planar and extension formats
+    uint32_t GetTexelSize() const
+    {
+        const int32_t f = (int32_t)mHandle;
+        if (f == VK_FORMAT_R4G4_UNORM_PACK8)
+            return 1;
+        if (f >= VK_FORMAT_R4G4B4A4_UNORM_PACK16 && f <= VK_FORMAT_A1R5G5B5_UNORM_PACK16)
+            return 2;
+        if (f >= VK_FORMAT_R8_UNORM && f <= VK_FORMAT_R8_SRGB)
+            return 1;
+        if (f >= VK_FORMAT_R8G8_UNORM && f <= VK_FORMAT_R8G8_SRGB)
+            return 2;
+        if (f >= VK_FORMAT_R8G8B8_UNORM && f <= VK_FORMAT_B8G8R8_SRGB)
+            return 3;
+        if (f >= VK_FORMAT_R8G8B8A8_UNORM && f <= VK_FORMAT_A2B10G10R10_SINT_PACK32)
+            return 4;
+        if (f >= VK_FORMAT_R16_UNORM && f <= VK_FORMAT_R16_SFLOAT)
+            return 2;
+        if (f >= VK_FORMAT_R16G16_UNORM && f <= VK_FORMAT_R16G16_SFLOAT)
+            return 4;
+        if (f >= VK_FORMAT_R16G16B16_UNORM && f <= VK_FORMAT_R16G16B16_SFLOAT)
+            return 6;
+        if (f >= VK_FORMAT_R16G16B16A16_UNORM && f <= VK_FORMAT_R16G16B16A16_SFLOAT)
+            return 8;
+        if (f >= VK_FORMAT_R32_UINT && f <= VK_FORMAT_R32_SFLOAT)
+            return 4;
+        if (f >= VK_FORMAT_R32G32_UINT && f <= VK_FORMAT_R32G32_SFLOAT)
+            return 8;
+        if (f >= VK_FORMAT_R32G32B32_UINT && f <= VK_FORMAT_R32G32B32_SFLOAT)
+            return 12;
+        if (f >= VK_FORMAT_R32G32B32A32_UINT && f <= VK_FORMAT_R32G32B32A32_SFLOAT)
+            return 16;
+        if (f >= VK_FORMAT_R64_UINT && f <= VK_FORMAT_R64_SFLOAT)
+            return 8;
+        if (f >= VK_FORMAT_R64G64_UINT && f <= VK_FORMAT_R64G64_SFLOAT)
+            return 16;
+        if (f >= VK_FORMAT_R64G64B64_UINT && f <= VK_FORMAT_R64G64B64_SFLOAT)
+            return 24;
+        if (f >= VK_FORMAT_R64G64B64A64_UINT && f <= VK_FORMAT_R64G64B64A64_SFLOAT)
+            return 32;
+        if (f == VK_FORMAT_B10G11R11_UFLOAT_PACK32 || f == VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)
+            return 4;
+        if (f == VK_FORMAT_D16_UNORM)
+            return 2;
+        if (f == VK_FORMAT_X8_D24_UNORM_PACK32 || f == VK_FORMAT_D32_SFLOAT || f == VK_FORMAT_D24_UNORM_S8_UINT)
+            return 4;
+        if (f == VK_FORMAT_S8_UINT)
+            return 1;
+        if (f == VK_FORMAT_D16_UNORM_S8_UINT)
+            return 3;
+        if (f == VK_FORMAT_D32_SFLOAT_S8_UINT)
+            return 5;
+        return 0;
+    }
+
 private:
     _Format mHandle;
 };
@@ -0,0 +1,146 @@
+#include "GpuProfiler.h"
+#include "Device.h"
+#include "Utils.h"
+#include "Logger.h"
+#include "CommandBuffer.h"
+
+GpuProfiler::GpuProfiler(Device &device, const std::string &name, uint32_t frameCount, uint32_t maxScopeCount)
+    : mDevice(device), mName(name), mMaxScopeCount(maxScopeCount)
+{
+    const auto &limits = mDevice.GetPhysicalProps().limits;
+    mTimestampPeriod = limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(mDevice.GetPhysicalHandle(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(mDevice.GetPhysicalHandle(), &queueFamilyCount, queueFamilies.data());
+
+    const uint32_t validBits = queueFamilies[mDevice.GetQueueFamilyIndices().graphicsFamily.value()].timestampValidBits;
+    mTimestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+    mIsSupported = limits.timestampComputeAndGraphics == VK_TRUE && validBits > 0;
+    if (!mIsSupported)
+    {
+        LOG_WARN("{}: timestamp queries are not supported, gpu timings disabled", mName);
+        return;
+    }
+
+    mFrames.resize(frameCount);
+    for (auto &frame : mFrames)
+    {
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = mMaxScopeCount * 2;
+        VK_CHECK(vkCreateQueryPool(mDevice.GetHandle(), &queryPoolInfo, nullptr, &frame.queryPool));
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (auto &frame : mFrames)
+        vkDestroyQueryPool(mDevice.GetHandle(), frame.queryPool, nullptr);
+}
+
+bool GpuProfiler::IsSupported() const
+{
+    return mIsSupported;
+}
+
+void GpuProfiler::BeginFrame(CommandBuffer *commandBuffer, size_t frameIdx)
+{
+    if (!mIsSupported)
+        return;
+
+    Collect(frameIdx);
+
+    mCurFrame = frameIdx;
+    Frame &frame = mFrames[mCurFrame];
+    frame.scopes.clear();
+    frame.queryCount = 0;
+    frame.pending = false;
+    commandBuffer->ResetQueryPool(frame.queryPool, 0, mMaxScopeCount * 2);
+}
+
+void GpuProfiler::EndFrame(size_t frameIdx)
+{
+    if (!mIsSupported)
+        return;
+
+    Frame &frame = mFrames[frameIdx];
+    frame.cpuTimeUs = Profiler::Instance().GetTimeUs();
+    frame.pending = !frame.scopes.empty();
+}
+
+void GpuProfiler::Collect(size_t frameIdx)
+{
+    if (!mIsSupported)
+        return;
+
+    Frame &frame = mFrames[frameIdx];
+    if (!frame.pending)
+        return;
+
+    std::vector<uint64_t> timestamps(frame.queryCount);
+    VkResult queryResult = vkGetQueryPoolResults(mDevice.GetHandle(), frame.queryPool, 0, frame.queryCount, sizeof(uint64_t) * timestamps.size(), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (queryResult == VK_NOT_READY)
+        return;
+    VK_CHECK(queryResult);
+
+    frame.pending = false;
+
+    // gpu clocks are not in the steady_clock domain, anchor the first timestamp at the time the frame was recorded
+    const uint64_t base = timestamps[frame.scopes.front().beginQuery] & mTimestampMask;
+    for (const auto &scope : frame.scopes)
+    {
+        const uint64_t begin = timestamps[scope.beginQuery] & mTimestampMask;
+        const uint64_t end = timestamps[scope.endQuery] & mTimestampMask;
+        if (end < begin)
+            continue;
+
+        const double startUs = frame.cpuTimeUs + (begin - base) * mTimestampPeriod / 1000.0;
+        const double durationUs = (end - begin) * mTimestampPeriod / 1000.0;
+        Profiler::Instance().AddSample(mName + "/" + scope.name, ProfileTrack::GPU, startUs, durationUs);
+    }
+}
+
+uint32_t GpuProfiler::BeginScope(CommandBuffer *commandBuffer, const std::string &name)
+{
+    if (!mIsSupported)
+        return UINT32_MAX;
+
+    Frame &frame = mFrames[mCurFrame];
+    if (frame.scopes.size() >= mMaxScopeCount)
+    {
+        LOG_WARN("{}: more than {} gpu scopes in a frame, {} is not timed", mName, mMaxScopeCount, name);
+        return UINT32_MAX;
+    }
+
+    Scope scope;
+    scope.name = name;
+    scope.beginQuery = frame.queryCount++;
+    scope.endQuery = frame.queryCount++;
+    frame.scopes.emplace_back(scope);
+
+    commandBuffer->WriteTimestamp(PipelineStage::TOP_OF_PIPE, frame.queryPool, scope.beginQuery);
+    return (uint32_t)frame.scopes.size() - 1;
+}
+
+void GpuProfiler::EndScope(CommandBuffer *commandBuffer, uint32_t scope)
+{
+    if (!mIsSupported || scope == UINT32_MAX)
+        return;
+
+    Frame &frame = mFrames[mCurFrame];
+    commandBuffer->WriteTimestamp(PipelineStage::BOTTOM_OF_PIPE, frame.queryPool, frame.scopes[scope].endQuery);
+}
+
+GpuProfileScope::GpuProfileScope(GpuProfiler *profiler, CommandBuffer *commandBuffer, const std::string &name)
+    : mProfiler(profiler), mCommandBuffer(commandBuffer), mScope(profiler->BeginScope(commandBuffer, name))
+{
+}
+
+GpuProfileScope::~GpuProfileScope()
+{
+    mProfiler->EndScope(mCommandBuffer, mScope);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+#include "Profiler.h"
+
+// Timestamp queries of one pass, with a query pool per frame in flight so results are read only
+// after the fence of the frame has been waited on. Finished scopes are handed to the Profiler on the GPU track.
+class GpuProfiler
+{
+public:
+    GpuProfiler(class Device &device, const std::string &name, uint32_t frameCount, uint32_t maxScopeCount = 32);
+    ~GpuProfiler();
+
+    bool IsSupported() const;
+
+    // Call first while recording the frame: collects the previous results of the slot and resets its queries
+    void BeginFrame(class CommandBuffer *commandBuffer, size_t frameIdx);
+    // Marks the slot as recorded, its results are collected by the next BeginFrame or Collect
+    void EndFrame(size_t frameIdx);
+
+    // Non blocking, for command buffers that are recorded once and submitted many times
+    void Collect(size_t frameIdx);
+
+    uint32_t BeginScope(class CommandBuffer *commandBuffer, const std::string &name);
+    void EndScope(class CommandBuffer *commandBuffer, uint32_t scope);
+
+private:
+    struct Scope
+    {
+        std::string name;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    struct Frame
+    {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<Scope> scopes;
+        uint32_t queryCount = 0;
+        double cpuTimeUs = 0.0;
+        bool pending = false;
+    };
+
+    class Device &mDevice;
+    std::string mName;
+    uint32_t mMaxScopeCount;
+    double mTimestampPeriod;
+    uint64_t mTimestampMask;
+    bool mIsSupported;
+
+    std::vector<Frame> mFrames;
+    size_t mCurFrame = 0;
+};
+
+// Records the gpu time between construction and destruction into the command buffer
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler *profiler, class CommandBuffer *commandBuffer, const std::string &name);
+    ~GpuProfileScope();
+
+private:
+    GpuProfiler *mProfiler;
+    class CommandBuffer *mCommandBuffer;
+    uint32_t mScope;
+};
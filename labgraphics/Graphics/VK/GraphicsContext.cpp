@@ -2,9 +2,19 @@
 #include "App.h"
 GraphicsContext::GraphicsContext()
 {
+    if (App::Instance().IsHeadless())
+    {
+        const HeadlessSettings &settings = App::Instance().GetHeadlessSettings();
+
+        mInstance = std::make_unique<Instance>(gValidationLayers, gInstanceExtensions);
+        mDevice = std::make_unique<Device>(*mInstance, DeviceFeature::RAY_TRACE | DeviceFeature::BINDLESS);
+        mSwapChain = std::make_unique<SwapChain>(*mDevice, settings.extent, settings.virtualFrameCount);
+        return;
+    }
+
     mInstance = std::make_unique<Instance>(App::Instance().GetWindow(), gValidationLayers, gInstanceExtensions);
 
-    mDevice = std::make_unique<Device>(*mInstance, DeviceFeature::RAY_TRACE);
+    mDevice = std::make_unique<Device>(*mInstance, DeviceFeature::RAY_TRACE | DeviceFeature::BINDLESS);
 
     mSwapChain = std::make_unique<SwapChain>(*mDevice);
 }
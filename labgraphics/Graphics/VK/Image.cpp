@@ -3,7 +3,10 @@
 #include "Utils.h"
 #include "CommandPool.h"
 #include "App.h"
+#include "ReadbackQueue.h"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 Image2D::Image2D(Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage)
     : mDevice(device), mFormat(format), mWidth(width), mHeight(height), mAspect(ImageAspect::COLOR)
 {
@@ -41,7 +44,7 @@ Image2D::Image2D(Device &device, uint32_t width, uint32_t height, Format format,
     mSubResource.arrayLayer = 0;
 }
 
-Image2D::Image2D(Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage, VkMemoryPropertyFlags memoryProp)
+Image2D::Image2D(Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage, VkMemoryPropertyFlags memoryProp, uint32_t mipLevels)
     : mDevice(device), mFormat(format), mWidth(width), mHeight(height), mAspect(ImageAspect::COLOR)
 {
     mImageLayout = ImageLayout::UNDEFINED;
@@ -52,7 +55,7 @@ Image2D::Image2D(Device &device, uint32_t width, uint32_t height, Format format,
     mImageInfo.flags = 0;
     mImageInfo.extent = {width, height, 1};
     mImageInfo.format = format.ToVkHandle();
-    mImageInfo.mipLevels = 1;
+    mImageInfo.mipLevels = mipLevels;
     mImageInfo.arrayLayers = 1;
     mImageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     mImageInfo.usage = IMAGE_USAGE_CAST(usage);
@@ -79,7 +82,7 @@ Image2D::Image2D(Device &device, uint32_t width, uint32_t height, Format format,
 
     VK_CHECK(vkBindImageMemory(mDevice.GetHandle(), mHandle, mMemory, 0));
 
-    mImageView = mDevice.CreateImageView(mHandle, mFormat);
+    mImageView = mDevice.CreateImageView(mHandle, mFormat, mipLevels);
 
     mSubResource.aspectMask = IMAGE_ASPECT_CAST(mAspect);
     mSubResource.mipLevel = 0;
@@ -155,6 +158,15 @@ uint32_t Image2D::GetMipLevel() const
     return mImageInfo.mipLevels;
 }
 
+void Image2D::ReadRawData(void *dst, uint64_t size, ImageLayout layout) const
+{
+    auto readbackQueue = mDevice.GetReadbackQueue();
+    auto ticket = readbackQueue->ReadImage(this, layout);
+    auto view = readbackQueue->Wait(ticket);
+    std::memcpy(dst, view.data, std::min(size, view.size));
+    readbackQueue->Release(ticket);
+}
+
 void Image2D::TransitionToNewLayout(ImageLayout newLayout)
 {
     auto cmd = mDevice.GetTransferCommandPool()->CreatePrimaryCommandBuffer();
@@ -173,8 +185,8 @@ CpuImage2D::~CpuImage2D()
 {
 }
 
-GpuImage2D::GpuImage2D(Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage)
-    : Image2D(device, width, height, format, tiling, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+GpuImage2D::GpuImage2D(Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage, uint32_t mipLevels)
+    : Image2D(device, width, height, format, tiling, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels)
 {
 }
 
@@ -192,4 +204,35 @@ void GpuImage2D::UploadDataFrom(uint64_t bufferSize, CpuBuffer *stagingBuffer, I
                                 cmd->CopyImageFromBuffer(this, stagingBuffer);
                                 cmd->ImageBarrier(mHandle, GetFormat(), ImageLayout::TRANSFER_DST_OPTIMAL, newLayout);
                             });
-}
\ No newline at end of file
+}
+
+void GpuImage2D::UploadMipsFrom(CpuBuffer *stagingBuffer, const std::vector<uint64_t> &mipOffsets, ImageLayout oldLayout, ImageLayout newLayout)
+{
+    auto cmd = mDevice.GetTransferCommandPool()->CreatePrimaryCommandBuffer();
+    cmd->ExecuteImmediately([&]()
+                            { RecordUploadMips(cmd.get(), stagingBuffer, mipOffsets, 0, oldLayout, newLayout); });
+}
+
+void GpuImage2D::RecordUploadMips(CommandBuffer *commandBuffer, CpuBuffer *stagingBuffer, const std::vector<uint64_t> &mipOffsets, uint32_t firstMip, ImageLayout oldLayout, ImageLayout newLayout)
+{
+    const uint32_t mipCount = (uint32_t)std::min<size_t>(mipOffsets.size(), GetMipLevel() - std::min(firstMip, GetMipLevel()));
+    if (mipCount == 0)
+        return;
+
+    std::vector<VkBufferImageCopy> regions(mipCount);
+    for (uint32_t i = 0; i < mipCount; ++i)
+    {
+        const uint32_t mip = firstMip + i;
+        regions[i] = {};
+        regions[i].bufferOffset = mipOffsets[i];
+        regions[i].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+        regions[i].imageExtent = {std::max(mWidth >> mip, 1u), std::max(mHeight >> mip, 1u), 1};
+    }
+
+    const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, firstMip, mipCount, 0, 1};
+
+    commandBuffer->ImageBarrier(mHandle, Access::NONE, Access::TRANSFER_WRITE, oldLayout, ImageLayout::TRANSFER_DST_OPTIMAL, range);
+    commandBuffer->CopyImageFromBuffer(this, stagingBuffer, regions);
+    commandBuffer->ImageBarrier(mHandle, Access::TRANSFER_WRITE, Access::SHADER_READ, ImageLayout::TRANSFER_DST_OPTIMAL, newLayout, range);
+    mImageLayout = newLayout;
+}
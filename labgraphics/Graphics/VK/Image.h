@@ -10,7 +10,7 @@ class Image2D
 {
 public:
     Image2D(class Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage);
-    Image2D(class Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage, VkMemoryPropertyFlags memoryProp);
+    Image2D(class Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage, VkMemoryPropertyFlags memoryProp, uint32_t mipLevels = 1);
     virtual ~Image2D();
 
     const VkImage &GetHandle() const;
@@ -32,10 +32,13 @@ public:
 
     void TransitionToNewLayout(ImageLayout newLayout);
 
+    // Blocking copy of the texels, image must be in layout. Use the device ReadbackQueue directly to read without stalling
     template <typename T>
-    std::vector<T> GetRawData(const ImageAspect &aspect);
+    std::vector<T> GetRawData(ImageLayout layout);
 
 protected:
+    void ReadRawData(void *dst, uint64_t size, ImageLayout layout) const;
+
     class Device &mDevice;
 
     VkImageCreateInfo mImageInfo;
@@ -68,8 +71,15 @@ public:
 class GpuImage2D : public Image2D
 {
 public:
-    GpuImage2D(class Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage);
+    GpuImage2D(class Device &device, uint32_t width, uint32_t height, Format format, ImageTiling tiling, ImageUsage usage, uint32_t mipLevels = 1);
     ~GpuImage2D() override;
 
     void UploadDataFrom(uint64_t bufferSize,class CpuBuffer *stagingBuffer, ImageLayout oldLayout, ImageLayout newLayout);
-};
\ No newline at end of file
+    // mip i is read from mipOffsets[i] in the staging buffer, all levels are transitioned together
+    void UploadMipsFrom(class CpuBuffer *stagingBuffer, const std::vector<uint64_t> &mipOffsets, ImageLayout oldLayout, ImageLayout newLayout);
+    // Records the copy of mip firstMip + i from mipOffsets[i] into commandBuffer, only those levels are transitioned.
+    // The staging buffer must stay alive until the command buffer has executed.
+    void RecordUploadMips(class CommandBuffer *commandBuffer, class CpuBuffer *stagingBuffer, const std::vector<uint64_t> &mipOffsets, uint32_t firstMip, ImageLayout oldLayout, ImageLayout newLayout);
+};
+
+#include "Image.inl"
@@ -4,8 +4,8 @@
 #include "Utils.h"
 #include <iostream>
 
-ImageView2D::ImageView2D(const Device &device, VkImage image, Format format)
-    : mDevice(device)
+ImageView2D::ImageView2D(const Device &device, VkImage image, Format format, uint32_t mipLevels)
+    : mDevice(device), mMipLevels(mipLevels)
 {
     VkImageViewCreateInfo imageViewInfo{};
     imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -13,7 +13,7 @@ ImageView2D::ImageView2D(const Device &device, VkImage image, Format format)
     imageViewInfo.format = format.ToVkHandle();
     imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     imageViewInfo.subresourceRange.baseMipLevel = 0;
-    imageViewInfo.subresourceRange.levelCount = 1;
+    imageViewInfo.subresourceRange.levelCount = mipLevels;
     imageViewInfo.subresourceRange.baseArrayLayer = 0;
     imageViewInfo.subresourceRange.layerCount = 1;
     imageViewInfo.image = image;
@@ -25,13 +25,14 @@ ImageView2D::ImageView2D(const Device &device, VkImage image, Format format)
 }
 
 ImageView2D::ImageView2D(const Device &device, const Image2D *image, Format format)
-    : ImageView2D(device, image->GetHandle(), format)
+    : ImageView2D(device, image->GetHandle(), format, image->GetMipLevel())
 {
 }
 
 ImageView2D::~ImageView2D()
 {
     vkDestroyImageView(mDevice.GetHandle(), mHandle, nullptr);
+    mDevice.NotifyResourceDestroyed((uint64_t)mHandle);
 }
 
 const VkImageView &ImageView2D::GetHandle() const
@@ -44,7 +45,7 @@ VkImageSubresourceRange ImageView2D::GetSubresourceRange() const
     VkImageSubresourceRange subresourceRange;
     subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     subresourceRange.baseMipLevel = 0;
-    subresourceRange.levelCount = 1;
+    subresourceRange.levelCount = mMipLevels;
     subresourceRange.baseArrayLayer = 0;
     subresourceRange.layerCount = 1;
 
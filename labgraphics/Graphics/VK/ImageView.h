@@ -4,7 +4,7 @@
 class ImageView2D
 {
 public:
-    ImageView2D(const class Device &device, VkImage image, Format format);
+    ImageView2D(const class Device &device, VkImage image, Format format, uint32_t mipLevels = 1);
     ImageView2D(const class Device &device,const class Image2D* image, Format format);
     ~ImageView2D();
 
@@ -14,4 +14,5 @@ public:
 private:
     const class Device &mDevice;
     VkImageView mHandle;
+    uint32_t mMipLevels;
 };
\ No newline at end of file
@@ -162,7 +162,7 @@ static void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMesse
 }
 
 Instance::Instance(const std::vector<const char *> &validationLayers, const std::vector<const char *> &extensions)
-    : mWindow(nullptr), mSurface(VK_NULL_HANDLE)
+    : mWindow(nullptr), mSurface(VK_NULL_HANDLE), mRequiredValidationLayers(validationLayers)
 {
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -199,6 +199,7 @@ Instance::Instance(const std::vector<const char *> &validationLayers, const std:
 
     VK_CHECK(vkCreateInstance(&instInfo, nullptr, &mHandle));
 
+#if _DEBUG
     VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
     debugCreateInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
     debugCreateInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
@@ -209,6 +210,7 @@ Instance::Instance(const std::vector<const char *> &validationLayers, const std:
     debugCreateInfo.pNext = nullptr;
 
     VK_CHECK(CreateDebugUtilsMessengerEXT(mHandle, &debugCreateInfo, nullptr, &mDebugUtils));
+#endif
 }
 
 Instance::Instance(const Window *window, const std::vector<const char *> &validationLayers, const std::vector<const char *> &extensions)
@@ -273,7 +275,8 @@ Instance::~Instance()
 #if _DEBUG
     DestroyDebugUtilsMessengerEXT(mHandle, mDebugUtils, nullptr);
 #endif
-    vkDestroySurfaceKHR(mHandle, mSurface, nullptr);
+    if (mSurface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(mHandle, mSurface, nullptr);
     vkDestroyInstance(mHandle, nullptr);
 }
 
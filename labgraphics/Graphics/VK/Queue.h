@@ -27,6 +27,7 @@ private:
 	friend class RasterCommandBuffer;
 	friend class RayTraceCommandBuffer;
 	friend class TransferCommandBuffer;
+	friend class SwapChain;
 	void Submit(const VkSubmitInfo &submitInfo, const Fence *fence = nullptr) const;
 };
 
@@ -0,0 +1,194 @@
+#include "ReadbackQueue.h"
+#include "Device.h"
+#include "Utils.h"
+#include "CommandBuffer.h"
+#include "CommandPool.h"
+
+ReadbackQueue::ReadbackQueue(Device &device, uint32_t slotCount)
+    : mDevice(device)
+{
+    for (uint32_t i = 0; i < slotCount; ++i)
+    {
+        auto slot = std::make_unique<Slot>();
+        slot->commandBuffer = mDevice.GetRasterCommandPool()->CreatePrimaryCommandBuffer();
+        // created signaled so Submit hands the fence to the queue without waiting on it
+        slot->fence = mDevice.CreateFence(FenceStatus::SIGNALED);
+        mSlots.emplace_back(std::move(slot));
+    }
+}
+
+ReadbackQueue::~ReadbackQueue()
+{
+    for (auto &slot : mSlots)
+    {
+        slot->fence->Wait();
+        if (slot->mapped)
+            slot->buffer->Unmap();
+    }
+    mSlots.clear();
+}
+
+ReadbackTicket ReadbackQueue::ReadImage(const Image2D *image, ImageLayout layout)
+{
+    const uint32_t texelSize = image->GetFormat().GetTexelSize();
+    if (texelSize == 0)
+    {
+        LOG_WARN("ReadbackQueue::ReadImage: unsupported format {}", (int32_t)image->GetFormat().GetHandle());
+        return INVALID_READBACK_TICKET;
+    }
+
+    const uint64_t size = (uint64_t)image->GetWidth() * image->GetHeight() * texelSize;
+    Slot *slot = AcquireSlot(size);
+
+    slot->view.size = size;
+    slot->view.width = image->GetWidth();
+    slot->view.height = image->GetHeight();
+    slot->view.rowPitch = image->GetWidth() * texelSize;
+
+    const auto subresourceRange = image->GetView()->GetSubresourceRange();
+    slot->commandBuffer->Record([&]()
+                                {
+                                    slot->commandBuffer->ImageBarrier(image->GetHandle(), Access::MEMORY_WRITE, Access::TRANSFER_READ, layout, ImageLayout::TRANSFER_SRC_OPTIMAL, subresourceRange);
+                                    slot->commandBuffer->CopyBufferFromImage(slot->buffer.get(), image);
+                                    slot->commandBuffer->ImageBarrier(image->GetHandle(), Access::TRANSFER_READ, Access::MEMORY_READ | Access::MEMORY_WRITE, ImageLayout::TRANSFER_SRC_OPTIMAL, layout, subresourceRange);
+                                    slot->commandBuffer->GlobalMemoryBarrier(PipelineStage::TRANSFER, PipelineStage::HOST, Access::TRANSFER_WRITE, Access::HOST_READ);
+                                });
+
+    return Submit(slot);
+}
+
+ReadbackTicket ReadbackQueue::ReadBuffer(const Buffer *buffer, uint64_t offset, uint64_t size)
+{
+    if (size == VK_WHOLE_SIZE)
+        size = buffer->GetSize() - offset;
+
+    Slot *slot = AcquireSlot(size);
+
+    slot->view.size = size;
+    slot->view.width = 0;
+    slot->view.height = 0;
+    slot->view.rowPitch = 0;
+
+    slot->commandBuffer->Record([&]()
+                                {
+                                    VkBufferCopy bufferCopy{};
+                                    bufferCopy.srcOffset = offset;
+                                    bufferCopy.dstOffset = 0;
+                                    bufferCopy.size = size;
+
+                                    slot->commandBuffer->GlobalMemoryBarrier(PipelineStage::ALL_COMMANDS, PipelineStage::TRANSFER, Access::MEMORY_WRITE, Access::TRANSFER_READ);
+                                    slot->commandBuffer->CopyBuffer(*slot->buffer, *buffer, bufferCopy);
+                                    slot->commandBuffer->GlobalMemoryBarrier(PipelineStage::TRANSFER, PipelineStage::HOST, Access::TRANSFER_WRITE, Access::HOST_READ);
+                                });
+
+    return Submit(slot);
+}
+
+bool ReadbackQueue::IsReady(ReadbackTicket ticket) const
+{
+    Slot *slot = FindSlot(ticket);
+    return slot != nullptr && slot->fence->IsSignaled();
+}
+
+ReadbackView ReadbackQueue::Wait(ReadbackTicket ticket)
+{
+    Slot *slot = FindSlot(ticket);
+    if (slot == nullptr)
+    {
+        LOG_WARN("ReadbackQueue::Wait: unknown or released ticket {}", ticket);
+        return {};
+    }
+
+    slot->fence->Wait();
+
+    // host cached memory is not coherent, make the transfer writes visible once
+    if (!slot->invalidated)
+    {
+        VkMappedMemoryRange range{};
+        range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = slot->buffer->GetMemory();
+        range.offset = 0;
+        range.size = VK_WHOLE_SIZE;
+        VK_CHECK(vkInvalidateMappedMemoryRanges(mDevice.GetHandle(), 1, &range));
+        slot->invalidated = true;
+    }
+
+    return slot->view;
+}
+
+void ReadbackQueue::Release(ReadbackTicket ticket)
+{
+    Slot *slot = FindSlot(ticket);
+    if (slot != nullptr)
+        slot->ticket = INVALID_READBACK_TICKET;
+}
+
+uint32_t ReadbackQueue::GetSlotCount() const
+{
+    return (uint32_t)mSlots.size();
+}
+
+ReadbackQueue::Slot *ReadbackQueue::AcquireSlot(uint64_t size)
+{
+    // prefer a free slot that is already large enough, otherwise regrow the first free one
+    Slot *slot = nullptr;
+    for (auto &candidate : mSlots)
+    {
+        if (candidate->ticket != INVALID_READBACK_TICKET)
+            continue;
+        if (candidate->buffer && candidate->buffer->GetSize() >= size)
+        {
+            slot = candidate.get();
+            break;
+        }
+        if (slot == nullptr)
+            slot = candidate.get();
+    }
+
+    // every slot is held by the caller, grow the ring instead of stalling or invalidating views
+    if (slot == nullptr)
+    {
+        auto newSlot = std::make_unique<Slot>();
+        newSlot->commandBuffer = mDevice.GetRasterCommandPool()->CreatePrimaryCommandBuffer();
+        newSlot->fence = mDevice.CreateFence(FenceStatus::SIGNALED);
+        mSlots.emplace_back(std::move(newSlot));
+        slot = mSlots.back().get();
+    }
+
+    // a released slot may still have its copy in flight
+    slot->fence->Wait();
+
+    if (slot->buffer == nullptr || slot->buffer->GetSize() < size)
+    {
+        if (slot->mapped)
+            slot->buffer->Unmap();
+        slot->buffer = mDevice.CreateReadbackBuffer(size);
+        slot->mapped = slot->buffer->MapWhole<uint8_t>();
+    }
+
+    slot->view = {};
+    slot->view.data = slot->mapped;
+    slot->invalidated = false;
+
+    return slot;
+}
+
+ReadbackQueue::Slot *ReadbackQueue::FindSlot(ReadbackTicket ticket) const
+{
+    if (ticket == INVALID_READBACK_TICKET)
+        return nullptr;
+
+    for (const auto &slot : mSlots)
+        if (slot->ticket == ticket)
+            return slot.get();
+    return nullptr;
+}
+
+ReadbackTicket ReadbackQueue::Submit(Slot *slot)
+{
+    slot->fence->Reset();
+    slot->commandBuffer->Submit({}, {}, {}, slot->fence.get());
+
+    slot->ticket = mNextTicket++;
+    return slot->ticket;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "Buffer.h"
+#include "Image.h"
+#include "SyncObject.h"
+
+// Monotonic id of a readback, completion of every ticket is signalled by the fence of its slot
+using ReadbackTicket = uint64_t;
+constexpr ReadbackTicket INVALID_READBACK_TICKET = 0;
+
+// Zero-copy view of a finished readback, points into the mapped staging buffer and stays valid until the ticket is released
+struct ReadbackView
+{
+    const uint8_t *data = nullptr;
+    uint64_t size = 0;
+
+    // tightly packed rows for image readbacks, 0 for buffer readbacks
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t rowPitch = 0;
+
+    template <typename T>
+    const T *As() const
+    {
+        return reinterpret_cast<const T *>(data);
+    }
+};
+
+// Records copies into a ring of host cached staging buffers and submits them without waiting.
+// Copies go to the graphics queue, so they are ordered after all rendering submitted before them.
+// Poll IsReady from the render loop and only call Wait when the data is needed right now.
+class ReadbackQueue
+{
+public:
+    ReadbackQueue(class Device &device, uint32_t slotCount = 3);
+    ~ReadbackQueue();
+
+    // image must be in layout, it is transitioned back to it after the copy
+    ReadbackTicket ReadImage(const Image2D *image, ImageLayout layout);
+    ReadbackTicket ReadBuffer(const Buffer *buffer, uint64_t offset = 0, uint64_t size = VK_WHOLE_SIZE);
+
+    bool IsReady(ReadbackTicket ticket) const;
+
+    // Blocks only while the copy is still in flight
+    ReadbackView Wait(ReadbackTicket ticket);
+
+    // Returns the staging buffer to the ring, views of the ticket become invalid
+    void Release(ReadbackTicket ticket);
+
+    uint32_t GetSlotCount() const;
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<Buffer> buffer;
+        uint8_t *mapped = nullptr;
+        std::unique_ptr<class RasterCommandBuffer> commandBuffer;
+        std::unique_ptr<Fence> fence;
+
+        ReadbackTicket ticket = INVALID_READBACK_TICKET;
+        ReadbackView view;
+        bool invalidated = false;
+    };
+
+    Slot *AcquireSlot(uint64_t size);
+    Slot *FindSlot(ReadbackTicket ticket) const;
+    ReadbackTicket Submit(Slot *slot);
+
+    class Device &mDevice;
+
+    std::vector<std::unique_ptr<Slot>> mSlots;
+    ReadbackTicket mNextTicket = 1;
+};
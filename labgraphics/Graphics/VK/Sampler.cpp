@@ -10,7 +10,10 @@ Sampler::Sampler(const Device &device)
 Sampler::~Sampler()
 {
     if (mHandle)
+    {
         vkDestroySampler(mDevice.GetHandle(), mHandle, nullptr);
+        mDevice.NotifyResourceDestroyed((uint64_t)mHandle);
+    }
 }
 
 const VkSampler &Sampler::GetHandle()
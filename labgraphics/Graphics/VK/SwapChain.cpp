@@ -3,13 +3,32 @@
 #include "VK/Utils.h"
 #include <iostream>
 SwapChain::SwapChain(Device &device)
-    : mDevice(device), mHandle(VK_NULL_HANDLE)
+    : mDevice(device), mHandle(VK_NULL_HANDLE), mNextImageIdx(0)
 {
     Build();
 }
+SwapChain::SwapChain(Device &device, const Vector2u32 &offscreenExtent, uint32_t offscreenImageCount)
+    : mDevice(device), mHandle(VK_NULL_HANDLE), mNextImageIdx(0), mOffscreenImageCount(offscreenImageCount)
+{
+    mExtent = {offscreenExtent.x, offscreenExtent.y};
+    BuildOffscreen();
+}
 SwapChain::~SwapChain()
 {
-    vkDestroySwapchainKHR(mDevice.GetHandle(), mHandle, nullptr);
+    if (mHandle != VK_NULL_HANDLE)
+        vkDestroySwapchainKHR(mDevice.GetHandle(), mHandle, nullptr);
+}
+
+bool SwapChain::IsOffscreen() const
+{
+    return mOffscreenImageCount > 0;
+}
+
+const GpuImage2D *SwapChain::GetOffscreenImage(uint32_t idx) const
+{
+    if (idx >= mOffscreenImages.size())
+        return nullptr;
+    return mOffscreenImages[idx].get();
 }
 
 const VkSwapchainKHR &SwapChain::GetHandle() const
@@ -61,6 +80,15 @@ const std::vector<std::unique_ptr<ImageView2D>> &SwapChain::GetImageViews() cons
 
 void SwapChain::AcquireNextImage(const Semaphore *semaphore, const Fence *fence)
 {
+    if (IsOffscreen())
+    {
+        mNextImageIdx = (mNextImageIdx + 1) % mOffscreenImageCount;
+        // the image is free as soon as the previous frame using it has been waited for, signal right away
+        if (semaphore || fence)
+            SubmitSignal(semaphore, fence);
+        return;
+    }
+
     if (semaphore && fence)
         VK_CHECK(vkAcquireNextImageKHR(mDevice.GetHandle(), mHandle, UINT64_MAX, semaphore->GetHandle(), fence->GetHandle(), &mNextImageIdx))
     else if (semaphore && !fence)
@@ -76,9 +104,19 @@ uint32_t SwapChain::GetNextImageIdx() const
     return mNextImageIdx;
 }
 
+uint32_t SwapChain::GetPresentedImageIdx() const
+{
+    return mPresentedImageIdx;
+}
+
 void SwapChain::ReBuild()
 {
     mDevice.WaitIdle();
+    if (IsOffscreen())
+    {
+        BuildOffscreen();
+        return;
+    }
     vkDestroySwapchainKHR(mDevice.GetHandle(), mHandle, nullptr);
     mHandle = VK_NULL_HANDLE;
     Build();
@@ -91,6 +129,26 @@ void SwapChain::Present(const std::vector<Semaphore *> waitSemaphores)
     for (size_t i = 0; i < rawWait.size(); ++i)
         rawWait[i] = waitSemaphores[i]->GetHandle();
 
+    mPresentedImageIdx = mNextImageIdx;
+
+    if (IsOffscreen())
+    {
+        // nothing to show, only unsignal the semaphores so they can be signaled again next frame
+        if (!rawWait.empty())
+        {
+            std::vector<VkPipelineStageFlags> waitStages(rawWait.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.waitSemaphoreCount = (uint32_t)rawWait.size();
+            submitInfo.pWaitSemaphores = rawWait.data();
+            submitInfo.pWaitDstStageMask = waitStages.data();
+
+            mDevice.GetGraphicsQueue()->Submit(submitInfo);
+        }
+        return;
+    }
+
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = rawWait.size();
@@ -205,6 +263,51 @@ void SwapChain::Build()
     }
 }
 
+void SwapChain::BuildOffscreen()
+{
+    mSurfaceFormat = {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    mSurfacePresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+
+    mOffscreenImages.resize(mOffscreenImageCount);
+    mSwapChainImages.resize(mOffscreenImageCount);
+    mSwapChainImageViews.resize(mOffscreenImageCount);
+    for (uint32_t i = 0; i < mOffscreenImageCount; ++i)
+    {
+        // TRANSFER_SRC so the frames can be read back
+        mOffscreenImages[i] = std::make_unique<GpuImage2D>(mDevice, mExtent.width, mExtent.height, mSurfaceFormat.format, ImageTiling::OPTIMAL,
+                                                           ImageUsage::COLOR_ATTACHMENT | ImageUsage::TRANSFER_DST | ImageUsage::TRANSFER_SRC);
+        mSwapChainImages[i] = mOffscreenImages[i]->GetHandle();
+        mSwapChainImageViews[i] = mDevice.CreateImageView(mSwapChainImages[i], mSurfaceFormat.format);
+    }
+
+    // start from the last image so the first acquire returns image 0
+    mNextImageIdx = mOffscreenImageCount - 1;
+
+    mDefaultRenderPass = std::make_unique<RenderPass>(mDevice, GetFormat());
+    mDefaultFrameBuffers.resize(GetImageViews().size());
+
+    for (size_t i = 0; i < GetImageViews().size(); ++i)
+    {
+        mDefaultFrameBuffers[i] = std::make_unique<Framebuffer>(mDevice);
+        mDefaultFrameBuffers[i]->AttachRenderPass(mDefaultRenderPass.get())
+                                .SetExtent(GetExtent().x, GetExtent().y)
+                                .BindAttachment(0, GetImageViews()[i].get());
+    }
+}
+
+void SwapChain::SubmitSignal(const Semaphore *semaphore, const Fence *fence)
+{
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    if (semaphore)
+    {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &semaphore->GetHandle();
+    }
+
+    mDevice.GetGraphicsQueue()->Submit(submitInfo, fence);
+}
+
 SwapChainSupportDetails SwapChain::QuerySwapChainDetails()
 {
     SwapChainSupportDetails result;
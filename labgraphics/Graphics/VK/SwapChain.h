@@ -7,6 +7,7 @@
 #include "Math/Vector2.h"
 #include "RenderPass.h"
 #include "Framebuffer.h"
+#include "Image.h"
 
 struct SwapChainSupportDetails
 {
@@ -15,12 +16,19 @@ struct SwapChainSupportDetails
     std::vector<VkPresentModeKHR> surfacePresentModes;
 };
 
+// Without a window the swap chain is emulated with offscreen images: acquire hands out the images round robin
+// and present only consumes the wait semaphores, so passes and samples run unchanged.
 class SwapChain
 {
 public:
     SwapChain(class Device &device);
+    SwapChain(class Device &device, const Vector2u32 &offscreenExtent, uint32_t offscreenImageCount);
     ~SwapChain();
 
+    bool IsOffscreen() const;
+    // presented images are left in PRESENT_SRC_KHR layout, nullptr for a window swap chain
+    const GpuImage2D *GetOffscreenImage(uint32_t idx) const;
+
     const VkSwapchainKHR &GetHandle() const;
     Format GetFormat() const;
     const VkSurfaceFormatKHR &GetSurfaceFormat() const;
@@ -37,6 +45,8 @@ public:
     void AcquireNextImage(const Semaphore *semaphore = nullptr, const Fence *fence = nullptr);
 
     uint32_t GetNextImageIdx() const;
+    // image of the last Present, can differ from GetNextImageIdx when the next image is acquired right after presenting
+    uint32_t GetPresentedImageIdx() const;
 
     void ReBuild();
 
@@ -47,6 +57,9 @@ public:
 
 private:
     void Build();
+    void BuildOffscreen();
+
+    void SubmitSignal(const Semaphore *semaphore, const Fence *fence);
 
     SwapChainSupportDetails QuerySwapChainDetails();
 
@@ -70,4 +83,8 @@ private:
     std::vector<std::unique_ptr<Framebuffer>> mDefaultFrameBuffers;
 
     uint32_t mNextImageIdx;
+    uint32_t mPresentedImageIdx = 0;
+
+    uint32_t mOffscreenImageCount = 0;
+    std::vector<std::unique_ptr<GpuImage2D>> mOffscreenImages;
 };
\ No newline at end of file
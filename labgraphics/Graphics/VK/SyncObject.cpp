@@ -35,6 +35,11 @@ void Fence::Reset()
 	VK_CHECK(vkResetFences(mDevice.GetHandle(), 1, &mFenceHandle));
 }
 
+bool Fence::IsSignaled() const
+{
+	return vkGetFenceStatus(mDevice.GetHandle(), mFenceHandle) == VK_SUCCESS;
+}
+
 FenceStatus Fence::GetStatus() const
 {
 	return mStatus;
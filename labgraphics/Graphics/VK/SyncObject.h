@@ -20,6 +20,9 @@ public:
     void Wait(bool waitAll = true, uint64_t timeout = FENCE_WAIT_TIME_OUT);
     void Reset();
 
+    // Polls the fence without blocking
+    bool IsSignaled() const;
+
     FenceStatus GetStatus() const;
 
 private:
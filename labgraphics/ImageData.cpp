@@ -1,60 +1,325 @@
 #include "ImageData.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
 
-ImageData::ImageData() : type(ImageDataType::RGBA8), texWidth(32), texHeight(32), mChannels(4), imageSize(texHeight * texWidth * mChannels)
+uint32_t GetImageDataTypeSize(ImageDataType type)
 {
-	mPixels = new uint8_t[texHeight * texWidth * mChannels];
+	switch (type)
+	{
+	case ImageDataType::R8:
+		return 1;
+	case ImageDataType::RG8:
+	case ImageDataType::R16:
+	case ImageDataType::R16F:
+		return 2;
+	case ImageDataType::RGB8:
+		return 3;
+	case ImageDataType::RGBA8:
+	case ImageDataType::RG16:
+	case ImageDataType::R32F:
+		return 4;
+	case ImageDataType::RGB16:
+	case ImageDataType::RGB16F:
+		return 6;
+	case ImageDataType::RGBA16:
+	case ImageDataType::RGBA16F:
+		return 8;
+	case ImageDataType::RGB32F:
+		return 12;
+	case ImageDataType::RGBA32F:
+		return 16;
+	}
+	return 0;
 }
 
-ImageData::ImageData(ImageDataType type, int width, int height, int channel, void *pixels)
-	: type(type), mPixels(pixels), texWidth(width), texHeight(height),
-	  mChannels(channel), imageSize(texHeight * texWidth * mChannels)
+uint32_t GetImageDataTypeChannels(ImageDataType type)
 {
+	switch (type)
+	{
+	case ImageDataType::R8:
+	case ImageDataType::R16:
+	case ImageDataType::R16F:
+	case ImageDataType::R32F:
+		return 1;
+	case ImageDataType::RG8:
+	case ImageDataType::RG16:
+		return 2;
+	case ImageDataType::RGB8:
+	case ImageDataType::RGB16:
+	case ImageDataType::RGB16F:
+	case ImageDataType::RGB32F:
+		return 3;
+	case ImageDataType::RGBA8:
+	case ImageDataType::RGBA16:
+	case ImageDataType::RGBA16F:
+	case ImageDataType::RGBA32F:
+		return 4;
+	}
+	return 0;
 }
 
-ImageData::ImageData(ImageData &&texture)
+bool IsFloat32ImageDataType(ImageDataType type)
 {
-	type = texture.type;
-	texHeight = texture.texHeight;
-	texWidth = texture.texWidth;
-	mChannels = texture.mChannels;
-	imageSize = texture.imageSize;
-	mPixels = texture.mPixels;
+	return type == ImageDataType::R32F || type == ImageDataType::RGB32F || type == ImageDataType::RGBA32F;
+}
 
-	texture.mPixels = nullptr;
+ImageDataType GetImageDataChannelType(ImageDataType type)
+{
+	switch (type)
+	{
+	case ImageDataType::R8:
+	case ImageDataType::RG8:
+	case ImageDataType::RGB8:
+	case ImageDataType::RGBA8:
+		return ImageDataType::R8;
+	case ImageDataType::R16:
+	case ImageDataType::RG16:
+	case ImageDataType::RGB16:
+	case ImageDataType::RGBA16:
+		return ImageDataType::R16;
+	case ImageDataType::R16F:
+	case ImageDataType::RGB16F:
+	case ImageDataType::RGBA16F:
+		return ImageDataType::R16F;
+	default:
+		return ImageDataType::R32F;
+	}
 }
 
-ImageData &ImageData::operator=(ImageData &&texture)
+namespace
 {
-	if (this != &texture)
+	constexpr size_t PIXEL_ALIGNMENT = 64;
+	constexpr size_t POOL_BLOCK_GRANULARITY = 4096;
+
+	void *AllocatePixels(size_t size)
 	{
-		type = texture.type;
-		texHeight = texture.texHeight;
-		texWidth = texture.texWidth;
-		mChannels = texture.mChannels;
-		imageSize = texture.imageSize;
-		mPixels = texture.mPixels;
+		return ::operator new(std::max<size_t>(size, 1), std::align_val_t(PIXEL_ALIGNMENT));
+	}
 
-		texture.mPixels = nullptr;
+	void FreePixels(void *pixels)
+	{
+		::operator delete(pixels, std::align_val_t(PIXEL_ALIGNMENT));
 	}
 
-	return *this;
+	size_t GetPoolBlockSize(size_t size)
+	{
+		return std::max<size_t>((size + POOL_BLOCK_GRANULARITY - 1) / POOL_BLOCK_GRANULARITY, 1) * POOL_BLOCK_GRANULARITY;
+	}
+}
+
+ImageView::ImageView(ImageDataType type, uint32_t width, uint32_t height, void *pixels, size_t rowPitch, uint32_t texelStride)
+	: mType(type), mWidth(width), mHeight(height), mPixels(static_cast<uint8_t *>(pixels)),
+	  mTexelStride(texelStride ? texelStride : GetImageDataTypeSize(type))
+{
+	mRowPitch = rowPitch ? rowPitch : (size_t)width * mTexelStride;
+}
+
+ImageView ImageView::GetSubRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+{
+	if (x >= mWidth || y >= mHeight)
+		return ImageView(mType, 0, 0, nullptr, mRowPitch, mTexelStride);
+	width = std::min(width, mWidth - x);
+	height = std::min(height, mHeight - y);
+	return ImageView(mType, width, height, GetTexel<uint8_t>(x, y), mRowPitch, mTexelStride);
+}
+
+ImageView ImageView::GetChannel(uint32_t channel) const
+{
+	const ImageDataType channelType = GetImageDataChannelType(mType);
+	if (channel >= GetImageDataTypeChannels(mType))
+		return ImageView(channelType, 0, 0, nullptr, mRowPitch, mTexelStride);
+	return ImageView(channelType, mWidth, mHeight, mPixels + channel * GetImageDataTypeSize(channelType), mRowPitch, mTexelStride);
+}
+
+bool ImageView::CopyTo(const ImageView &destination) const
+{
+	if (mType != destination.mType || mWidth != destination.mWidth || mHeight != destination.mHeight)
+		return false;
+
+	const size_t texelSize = GetImageDataTypeSize(mType);
+	if (IsContiguous() && destination.IsContiguous())
+	{
+		std::memcpy(destination.mPixels, mPixels, texelSize * mWidth * mHeight);
+		return true;
+	}
+
+	for (uint32_t y = 0; y < mHeight; ++y)
+	{
+		if (IsPacked() && destination.IsPacked())
+			std::memcpy(destination.GetRow<uint8_t>(y), GetRow<uint8_t>(y), texelSize * mWidth);
+		else
+			for (uint32_t x = 0; x < mWidth; ++x)
+				std::memcpy(destination.GetTexel<uint8_t>(x, y), GetTexel<uint8_t>(x, y), texelSize);
+	}
+	return true;
+}
+
+bool ImageView::operator==(const ImageView &other) const
+{
+	if (mType != other.mType || mWidth != other.mWidth || mHeight != other.mHeight)
+		return false;
+
+	const size_t texelSize = GetImageDataTypeSize(mType);
+	for (uint32_t y = 0; y < mHeight; ++y)
+	{
+		if (IsPacked() && other.IsPacked())
+		{
+			if (std::memcmp(GetRow<uint8_t>(y), other.GetRow<uint8_t>(y), texelSize * mWidth) != 0)
+				return false;
+		}
+		else
+			for (uint32_t x = 0; x < mWidth; ++x)
+				if (std::memcmp(GetTexel<uint8_t>(x, y), other.GetTexel<uint8_t>(x, y), texelSize) != 0)
+					return false;
+	}
+	return true;
+}
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		++levels;
+	}
+	return levels;
+}
+
+size_t GetMipChainSize(ImageDataType type, uint32_t width, uint32_t height, uint32_t levelCount, size_t alignment)
+{
+	size_t size = 0;
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		size = (size + alignment - 1) / alignment * alignment;
+		size += (size_t)std::max(width >> level, 1u) * std::max(height >> level, 1u) * GetImageDataTypeSize(type);
+	}
+	return size;
+}
+
+std::vector<ImageView> GetMipChainViews(ImageDataType type, uint32_t width, uint32_t height, uint32_t levelCount, void *data, size_t alignment)
+{
+	std::vector<ImageView> levels;
+	size_t offset = 0;
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		offset = (offset + alignment - 1) / alignment * alignment;
+		const uint32_t levelWidth = std::max(width >> level, 1u), levelHeight = std::max(height >> level, 1u);
+		levels.emplace_back(type, levelWidth, levelHeight, static_cast<uint8_t *>(data) + offset);
+		offset += (size_t)levelWidth * levelHeight * GetImageDataTypeSize(type);
+	}
+	return levels;
+}
+
+ImagePool::ImagePool(size_t maxCachedBytes)
+	: mMaxCachedBytes(maxCachedBytes)
+{
+}
+
+ImagePool::~ImagePool()
+{
+	Trim();
+}
+
+void *ImagePool::Acquire(size_t size)
+{
+	const size_t blockSize = GetPoolBlockSize(size);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto iter = mFreeBlocks.find(blockSize);
+		if (iter != mFreeBlocks.end() && !iter->second.empty())
+		{
+			void *pixels = iter->second.back();
+			iter->second.pop_back();
+			mCachedBytes -= blockSize;
+			return pixels;
+		}
+	}
+	return AllocatePixels(blockSize);
+}
+
+void ImagePool::Release(void *pixels, size_t size)
+{
+	if (!pixels)
+		return;
+
+	const size_t blockSize = GetPoolBlockSize(size);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mCachedBytes + blockSize <= mMaxCachedBytes)
+		{
+			mFreeBlocks[blockSize].push_back(pixels);
+			mCachedBytes += blockSize;
+			return;
+		}
+	}
+	FreePixels(pixels);
+}
+
+void ImagePool::Trim()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (auto &blocks : mFreeBlocks)
+		for (void *pixels : blocks.second)
+			FreePixels(pixels);
+	mFreeBlocks.clear();
+	mCachedBytes = 0;
+}
+
+size_t ImagePool::GetCachedBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mCachedBytes;
 }
 
-bool ImageData::operator==(ImageData *other)
+ImageData::ImageData(ImageDataType type, uint32_t width, uint32_t height, void *pixels, ImageDeleter deleter)
+	: type(type), texWidth(width), texHeight(height), imageSize((size_t)width * height * GetImageDataTypeSize(type)),
+	  mPixels(pixels, deleter ? std::move(deleter) : ImageDeleter([](void *) {}))
 {
-	return type == other->type &&
-		   texWidth == other->texWidth &&
-		   texHeight == other->texHeight &&
-		   mChannels == other->mChannels &&
-		   imageSize == other->imageSize &&
-		   mPixels == other->mPixels;
 }
 
-ImageData::~ImageData()
+ImageData::ImageData(ImageDataType type, uint32_t width, uint32_t height, ImagePool *pool)
+	: type(type), texWidth(width), texHeight(height), imageSize((size_t)width * height * GetImageDataTypeSize(type))
 {
-	if (mPixels != nullptr && type != ImageDataType::HDR)
+	if (pool)
 	{
-		delete mPixels;
-		mPixels = nullptr;
+		const size_t size = imageSize;
+		mPixels = std::unique_ptr<void, ImageDeleter>(pool->Acquire(size), [pool, size](void *pixels)
+													  { pool->Release(pixels, size); });
 	}
-}
\ No newline at end of file
+	else
+		mPixels = std::unique_ptr<void, ImageDeleter>(AllocatePixels(imageSize), FreePixels);
+}
+
+ImageData::ImageData(ImageData &&other) noexcept
+	: type(std::exchange(other.type, ImageDataType::RGBA8)), texWidth(std::exchange(other.texWidth, 0)), texHeight(std::exchange(other.texHeight, 0)),
+	  imageSize(std::exchange(other.imageSize, 0)), mPixels(std::move(other.mPixels))
+{
+}
+
+ImageData &ImageData::operator=(ImageData &&other) noexcept
+{
+	if (this != &other)
+	{
+		// our pixels go through our deleter before other's take their place
+		mPixels = std::move(other.mPixels);
+		type = std::exchange(other.type, ImageDataType::RGBA8);
+		texWidth = std::exchange(other.texWidth, 0);
+		texHeight = std::exchange(other.texHeight, 0);
+		imageSize = std::exchange(other.imageSize, 0);
+	}
+	return *this;
+}
+
+bool ImageData::operator==(const ImageData &other) const
+{
+	return GetView() == other.GetView();
+}
+
+ImageView ImageData::GetView() const
+{
+	return ImageView(type, texWidth, texHeight, mPixels.get());
+}
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 enum class ImageDataType
 {
@@ -13,26 +19,41 @@ enum class ImageDataType
 	RG16,
 	RGB16,
 	RGBA16,
-	HDR
+	R16F,
+	RGB16F,
+	RGBA16F,
+	R32F,
+	RGB32F,
+	RGBA32F
 };
 
-class ImageData
+// bytes of one texel
+uint32_t GetImageDataTypeSize(ImageDataType type);
+uint32_t GetImageDataTypeChannels(ImageDataType type);
+bool IsFloat32ImageDataType(ImageDataType type);
+// the single channel type of one channel of type
+ImageDataType GetImageDataChannelType(ImageDataType type);
+
+// Non-owning window onto texels somewhere else: an ImageData, a sub-rect or one channel of it, a mip level of a
+// chain, or mapped staging memory a decoder or a conversion writes straight into. Rows are rowPitch bytes apart and
+// texels texelStride bytes apart, a channel view keeps the texel stride of the image it was taken from.
+class ImageView
 {
 public:
-	ImageData();
-	ImageData(ImageDataType type, int width, int height, int channel, void *pixels);
-
-	ImageData(ImageData &&);
+	ImageView() = default;
+	// rowPitch and texelStride of 0 mean tightly packed
+	ImageView(ImageDataType type, uint32_t width, uint32_t height, void *pixels, size_t rowPitch = 0, uint32_t texelStride = 0);
 
-	ImageData &operator=(ImageData &&);
-
-	bool operator==(ImageData *other);
-	~ImageData();
-
-	int GetWidth() const { return texWidth; }
-	int GetHeight() const { return texHeight; }
-	int GetImageSize() const { return imageSize; }
-	int GetChannels() const { return mChannels; }
+	ImageDataType GetType() const { return mType; }
+	uint32_t GetWidth() const { return mWidth; }
+	uint32_t GetHeight() const { return mHeight; }
+	size_t GetRowPitch() const { return mRowPitch; }
+	uint32_t GetTexelStride() const { return mTexelStride; }
+	bool IsEmpty() const { return mPixels == nullptr || mWidth == 0 || mHeight == 0; }
+	// the texels of a row are side by side
+	bool IsPacked() const { return mTexelStride == GetImageDataTypeSize(mType); }
+	// and so are the rows, the view is one run of bytes
+	bool IsContiguous() const { return IsPacked() && (mHeight <= 1 || mRowPitch == (size_t)mWidth * mTexelStride); }
 
 	template <typename T>
 	T *GetPixels() const
@@ -40,17 +61,116 @@ public:
 		return reinterpret_cast<T *>(mPixels);
 	}
 
-	int32_t BytesPerPixel() const
+	template <typename T>
+	T *GetRow(uint32_t y) const
 	{
-		return mChannels * (mHdr ? sizeof(float) : sizeof(uint8_t));
+		return reinterpret_cast<T *>(mPixels + y * mRowPitch);
 	}
 
+	template <typename T>
+	T *GetTexel(uint32_t x, uint32_t y) const
+	{
+		return reinterpret_cast<T *>(mPixels + y * mRowPitch + (size_t)x * mTexelStride);
+	}
+
+	// clipped to the view, empty when nothing is left
+	ImageView GetSubRect(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+	ImageView GetChannel(uint32_t channel) const;
+
+	// row by row, or texel by texel when either side is strided; false when type or extent differ
+	bool CopyTo(const ImageView &destination) const;
+
+	// type, extent and texel contents, whatever the layouts
+	bool operator==(const ImageView &other) const;
+	bool operator!=(const ImageView &other) const { return !(*this == other); }
+
 private:
-	ImageDataType type;
-	void *mPixels;
-	int texWidth;
-	int texHeight;
-	int mChannels;
-	int imageSize;
-	bool mHdr;
-};
\ No newline at end of file
+	ImageDataType mType = ImageDataType::RGBA8;
+	uint32_t mWidth = 0;
+	uint32_t mHeight = 0;
+	uint8_t *mPixels = nullptr;
+	size_t mRowPitch = 0;
+	uint32_t mTexelStride = 0;
+};
+
+uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+// A mip chain laid out like a vkCmdCopyBufferToImage source: level 0 first, each level packed and starting at a
+// multiple of alignment. GetMipChainViews slices such a chain in data, which must hold GetMipChainSize bytes.
+size_t GetMipChainSize(ImageDataType type, uint32_t width, uint32_t height, uint32_t levelCount, size_t alignment = 16);
+std::vector<ImageView> GetMipChainViews(ImageDataType type, uint32_t width, uint32_t height, uint32_t levelCount, void *data, size_t alignment = 16);
+
+// Recycles pixel blocks between images of the same size, the per frame and per mip temporaries of the image
+// processing functions stop costing an allocation and its page faults each time. Thread safe; must outlive every
+// image allocated from it.
+class ImagePool
+{
+public:
+	// blocks past maxCachedBytes go back to the system on release
+	explicit ImagePool(size_t maxCachedBytes = 256ull << 20);
+	~ImagePool();
+
+	ImagePool(const ImagePool &) = delete;
+	ImagePool &operator=(const ImagePool &) = delete;
+
+	// 64 byte aligned, size rounded up to whole pages
+	void *Acquire(size_t size);
+	void Release(void *pixels, size_t size);
+	// frees every cached block
+	void Trim();
+
+	size_t GetCachedBytes() const;
+
+private:
+	mutable std::mutex mMutex;
+	std::unordered_map<size_t, std::vector<void *>> mFreeBlocks;
+	size_t mCachedBytes = 0;
+	size_t mMaxCachedBytes;
+};
+
+// releases the pixels an ImageData was given, called once with the pixel pointer
+using ImageDeleter = std::function<void(void *)>;
+
+// An owned (or explicitly borrowed) tightly packed image. The pixels go away through the deleter they came with:
+// free for stb, delete[] for arrays, back to the pool for pooled ones, nothing for borrowed ones.
+class ImageData
+{
+public:
+	// empty, 0x0
+	ImageData() = default;
+	// takes pixels, released with deleter; a null deleter borrows them, the caller keeps them alive
+	ImageData(ImageDataType type, uint32_t width, uint32_t height, void *pixels, ImageDeleter deleter);
+	// uninitialized, 64 byte aligned, taken from pool when there is one
+	ImageData(ImageDataType type, uint32_t width, uint32_t height, ImagePool *pool = nullptr);
+
+	// the source is left empty, 0x0 like a default constructed image
+	ImageData(ImageData &&other) noexcept;
+	ImageData &operator=(ImageData &&other) noexcept;
+	ImageData(const ImageData &) = delete;
+	ImageData &operator=(const ImageData &) = delete;
+
+	// type, extent and pixel contents
+	bool operator==(const ImageData &other) const;
+	bool operator!=(const ImageData &other) const { return !(*this == other); }
+
+	ImageDataType GetType() const { return type; }
+	uint32_t GetWidth() const { return texWidth; }
+	uint32_t GetHeight() const { return texHeight; }
+	size_t GetImageSize() const { return imageSize; }
+	uint32_t GetChannels() const { return GetImageDataTypeChannels(type); }
+	uint32_t BytesPerPixel() const { return GetImageDataTypeSize(type); }
+
+	template <typename T>
+	T *GetPixels() const
+	{
+		return reinterpret_cast<T *>(mPixels.get());
+	}
+
+	ImageView GetView() const;
+
+private:
+	ImageDataType type = ImageDataType::RGBA8;
+	uint32_t texWidth = 0;
+	uint32_t texHeight = 0;
+	size_t imageSize = 0;
+	std::unique_ptr<void, ImageDeleter> mPixels{nullptr, ImageDeleter()};
+};
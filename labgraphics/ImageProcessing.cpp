@@ -0,0 +1,1065 @@
+#include "ImageProcessing.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include "Logger.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#if LAB_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+    // rows a block at the least, small images stay on the calling thread
+    constexpr size_t MIN_BLOCK_ROWS = 8;
+
+    constexpr float LUMINANCE_R = 0.2126f;
+    constexpr float LUMINANCE_G = 0.7152f;
+    constexpr float LUMINANCE_B = 0.0722f;
+
+    SimdLevel GetLevel(const ImageProcessingSettings &settings)
+    {
+        return std::min(settings.level, GetSimdLevel());
+    }
+
+    // Rows of source and destination in blocks over the thread pool, fn gets runs of texels: a whole block when both
+    // views are one run of bytes, a row at a time otherwise. Both views are packed, kernels never step past a run.
+    void ForEachRowRun(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings,
+                       const std::function<void(const uint8_t *, uint8_t *, size_t)> &fn)
+    {
+        const uint32_t width = source.GetWidth();
+        const bool contiguous = source.IsContiguous() && destination.IsContiguous();
+        ParallelFor(
+            0, source.GetHeight(), [&](size_t begin, size_t end)
+            {
+                if (contiguous)
+                    fn(source.GetRow<uint8_t>((uint32_t)begin), destination.GetRow<uint8_t>((uint32_t)begin), (end - begin) * width);
+                else
+                    for (size_t y = begin; y < end; ++y)
+                        fn(source.GetRow<uint8_t>((uint32_t)y), destination.GetRow<uint8_t>((uint32_t)y), width); },
+            MIN_BLOCK_ROWS, settings.threadCount);
+    }
+
+    // destination of the expected type and the source extent, both packed
+    bool CheckViews(const char *name, const ImageView &source, const ImageView &destination, ImageDataType destinationType)
+    {
+        if (destination.GetType() != destinationType || destination.GetWidth() != source.GetWidth() || destination.GetHeight() != source.GetHeight() ||
+            !source.IsPacked() || !destination.IsPacked())
+        {
+            LOG_WARN("{} does not take a {}x{} image of type {} to a {}x{} image of type {}", name, source.GetWidth(), source.GetHeight(),
+                     (int)source.GetType(), destination.GetWidth(), destination.GetHeight(), (int)destination.GetType());
+            return false;
+        }
+        return true;
+    }
+
+    ImageData CreateEmpty(ImageDataType type)
+    {
+        return ImageData(type, 0, 0);
+    }
+
+    // a new image of type from the settings pool written by fn, empty when fn refuses its source
+    template <typename Fn>
+    ImageData CreateResult(ImageDataType type, uint32_t width, uint32_t height, const ImageProcessingSettings &settings, Fn &&fn)
+    {
+        ImageData result(type, width, height, settings.pool);
+        if (!fn(result.GetView()))
+            return CreateEmpty(type);
+        return result;
+    }
+
+    bool GetRgbaType(ImageDataType type, ImageDataType &result)
+    {
+        if (type == ImageDataType::R8 || type == ImageDataType::RG8 || type == ImageDataType::RGB8 || type == ImageDataType::RGBA8)
+            result = ImageDataType::RGBA8;
+        else if (type == ImageDataType::RGB32F || type == ImageDataType::RGBA32F)
+            result = ImageDataType::RGBA32F;
+        else
+            return false;
+        return true;
+    }
+
+    bool GetHalfType(ImageDataType type, ImageDataType &result)
+    {
+        if (type == ImageDataType::R32F)
+            result = ImageDataType::R16F;
+        else if (type == ImageDataType::RGB32F)
+            result = ImageDataType::RGB16F;
+        else if (type == ImageDataType::RGBA32F)
+            result = ImageDataType::RGBA16F;
+        else
+            return false;
+        return true;
+    }
+
+    bool GetLinearType(ImageDataType type, ImageDataType &result)
+    {
+        if (type == ImageDataType::RGB8)
+            result = ImageDataType::RGB32F;
+        else if (type == ImageDataType::RGBA8)
+            result = ImageDataType::RGBA32F;
+        else
+            return false;
+        return true;
+    }
+
+    // ---- RGB to RGBA ----
+
+    void ExpandUnorm8Scalar(const uint8_t *source, uint32_t channels, uint8_t *destination, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint8_t *texel = source + i * channels;
+            uint8_t *result = destination + i * 4;
+            switch (channels)
+            {
+            case 1:
+                result[0] = result[1] = result[2] = texel[0];
+                result[3] = 255;
+                break;
+            case 2:
+                result[0] = result[1] = result[2] = texel[0];
+                result[3] = texel[1];
+                break;
+            default:
+                result[0] = texel[0];
+                result[1] = texel[1];
+                result[2] = texel[2];
+                result[3] = 255;
+                break;
+            }
+        }
+    }
+
+    void ExpandFloatScalar(const float *source, float *destination, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            destination[i * 4 + 0] = source[i * 3 + 0];
+            destination[i * 4 + 1] = source[i * 3 + 1];
+            destination[i * 4 + 2] = source[i * 3 + 2];
+            destination[i * 4 + 3] = 1.0f;
+        }
+    }
+
+#if LAB_SIMD_X86
+    LAB_TARGET_AVX2 void ExpandRgb8Avx2(const uint8_t *source, uint8_t *destination, size_t count)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+
+        // 8 texels from two 16 byte loads of 12 bytes each, the loop stops before the second one reads past the end
+        size_t i = 0;
+        for (; i + 10 <= count; i += 8)
+        {
+            const uint8_t *texels = source + i * 3;
+            const __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(texels))),
+                                                          _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels + 12)), 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(bytes, shuffle), alpha));
+        }
+        ExpandUnorm8Scalar(source + i * 3, 3, destination + i * 4, count - i);
+    }
+
+    LAB_TARGET_AVX2 void ExpandFloatAvx2(const float *source, float *destination, size_t count)
+    {
+        const __m256i permute = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        // 4 texels from two overlapping 8 float loads, the second reads 2 floats past the group
+        size_t i = 0;
+        for (; i + 5 <= count; i += 4)
+        {
+            const float *texels = source + i * 3;
+            const __m256 low = _mm256_permutevar8x32_ps(_mm256_loadu_ps(texels), permute);
+            const __m256 high = _mm256_permutevar8x32_ps(_mm256_loadu_ps(texels + 6), permute);
+            _mm256_storeu_ps(destination + i * 4, _mm256_blend_ps(low, one, 0x88));
+            _mm256_storeu_ps(destination + i * 4 + 8, _mm256_blend_ps(high, one, 0x88));
+        }
+        ExpandFloatScalar(source + i * 3, destination + i * 4, count - i);
+    }
+
+    LAB_TARGET_AVX512 void ExpandFloatAvx512(const float *source, float *destination, size_t count)
+    {
+        const __m512 one = _mm512_set1_ps(1.0f);
+
+        // the expanding load reads exactly the 12 floats of 4 texels into the rgb lanes
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            _mm512_storeu_ps(destination + i * 4, _mm512_mask_expandloadu_ps(one, 0x7777, source + i * 3));
+        ExpandFloatScalar(source + i * 3, destination + i * 4, count - i);
+    }
+#endif
+
+    // ---- float to half ----
+
+    void FloatToHalfScalar(const float *source, uint16_t *destination, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+            destination[i] = FloatToHalf(source[i]);
+    }
+
+#if LAB_SIMD_X86
+    LAB_TARGET_AVX2 void FloatToHalfAvx2(const float *source, uint16_t *destination, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i), _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+        FloatToHalfScalar(source + i, destination + i, count - i);
+    }
+
+    LAB_TARGET_AVX512 void FloatToHalfAvx512(const float *source, uint16_t *destination, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i), _mm512_cvtps_ph(_mm512_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+        FloatToHalfScalar(source + i, destination + i, count - i);
+    }
+#endif
+
+    // ---- sRGB to linear ----
+
+    struct Unorm8Tables
+    {
+        // the sRGB decode of every code, alpha is a plain code / 255
+        alignas(64) std::array<float, 256> srgb;
+        alignas(64) std::array<float, 256> linear;
+    };
+
+    const Unorm8Tables &GetUnorm8Tables()
+    {
+        static const Unorm8Tables tables = []()
+        {
+            Unorm8Tables result;
+            for (int i = 0; i < 256; ++i)
+            {
+                const double c = i / 255.0;
+                result.srgb[i] = (float)(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+                result.linear[i] = (float)c;
+            }
+            return result;
+        }();
+        return tables;
+    }
+
+    // elements rather than texels, index % channels is the channel
+    void SrgbToLinearScalar(const uint8_t *source, uint32_t channels, float *destination, size_t count)
+    {
+        const Unorm8Tables &tables = GetUnorm8Tables();
+        for (size_t i = 0; i < count; ++i)
+            destination[i] = (channels == 4 && i % 4 == 3) ? tables.linear[source[i]] : tables.srgb[source[i]];
+    }
+
+#if LAB_SIMD_X86
+    LAB_TARGET_AVX2 void SrgbToLinearAvx2(const uint8_t *source, uint32_t channels, float *destination, size_t count)
+    {
+        const Unorm8Tables &tables = GetUnorm8Tables();
+        // 8 elements are 2 whole rgba texels, rgb has no alpha lane to replace
+        const bool hasAlpha = channels == 4;
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256i codes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(source + i)));
+            const __m256 color = _mm256_i32gather_ps(tables.srgb.data(), codes, 4);
+            _mm256_storeu_ps(destination + i, hasAlpha ? _mm256_blend_ps(color, _mm256_i32gather_ps(tables.linear.data(), codes, 4), 0x88) : color);
+        }
+        SrgbToLinearScalar(source + i, channels, destination + i, count - i);
+    }
+
+    LAB_TARGET_AVX512 void SrgbToLinearAvx512(const uint8_t *source, uint32_t channels, float *destination, size_t count)
+    {
+        const Unorm8Tables &tables = GetUnorm8Tables();
+        const __mmask16 alphaLanes = channels == 4 ? 0x8888 : 0x0000;
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            const __m512i codes = _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i)));
+            const __m512 color = _mm512_i32gather_ps(codes, tables.srgb.data(), 4);
+            _mm512_storeu_ps(destination + i, _mm512_mask_i32gather_ps(color, alphaLanes, codes, tables.linear.data(), 4));
+        }
+        SrgbToLinearScalar(source + i, channels, destination + i, count - i);
+    }
+#endif
+
+    // ---- resampling ----
+
+    struct ResampleWeights
+    {
+        uint32_t tapCount = 0;
+        // first source texel of each destination texel, the tapCount texels from there lie inside the source
+        std::vector<uint32_t> first;
+        // tapCount weights a destination texel, summing to 1
+        std::vector<float> weights;
+    };
+
+    double GetFilterSupport(ResampleFilter filter)
+    {
+        switch (filter)
+        {
+        case ResampleFilter::BOX:
+            return 0.5;
+        case ResampleFilter::TRIANGLE:
+            return 1.0;
+        default:
+            return 3.0;
+        }
+    }
+
+    double EvaluateFilter(ResampleFilter filter, double x)
+    {
+        x = std::abs(x);
+        switch (filter)
+        {
+        case ResampleFilter::BOX:
+            // a texel exactly on the edge is shared by both neighbours
+            return x < 0.5 ? 1.0 : (x == 0.5 ? 0.5 : 0.0);
+        case ResampleFilter::TRIANGLE:
+            return std::max(1.0 - x, 0.0);
+        default:
+            if (x < 1e-8)
+                return 1.0;
+            if (x >= 3.0)
+                return 0.0;
+            return 3.0 * std::sin(PI * x) * std::sin(PI * x / 3.0) / (PI * PI * x * x);
+        }
+    }
+
+    ResampleWeights BuildResampleWeights(uint32_t sourceSize, uint32_t destinationSize, ResampleFilter filter)
+    {
+        const double scale = (double)destinationSize / sourceSize;
+        // shrinking stretches the filter over every source texel a destination texel covers
+        const double filterScale = std::min(scale, 1.0);
+        const double support = GetFilterSupport(filter) / filterScale;
+
+        // clamped edges fold the taps outside the source onto the border texel, so every window is contiguous
+        std::vector<std::vector<double>> windows(destinationSize);
+        std::vector<int64_t> windowStarts(destinationSize);
+        uint32_t tapCount = 1;
+        for (uint32_t d = 0; d < destinationSize; ++d)
+        {
+            const double center = (d + 0.5) / scale - 0.5;
+            const int64_t low = (int64_t)std::floor(center - support);
+            const int64_t high = (int64_t)std::ceil(center + support);
+
+            const int64_t start = std::clamp<int64_t>(low, 0, sourceSize - 1);
+            std::vector<double> &window = windows[d];
+            window.assign((size_t)(std::clamp<int64_t>(high, 0, sourceSize - 1) - start + 1), 0.0);
+
+            double sum = 0.0;
+            for (int64_t i = low; i <= high; ++i)
+            {
+                const double weight = EvaluateFilter(filter, (i - center) * filterScale);
+                window[(size_t)(std::clamp<int64_t>(i, 0, sourceSize - 1) - start)] += weight;
+                sum += weight;
+            }
+            if (sum != 0.0)
+                for (double &weight : window)
+                    weight /= sum;
+            else
+                window[(size_t)(std::clamp<int64_t>((int64_t)std::lround(center), 0, sourceSize - 1) - start)] = 1.0;
+
+            // zero weights at the ends cost a tap each for nothing
+            size_t first = 0, last = window.size();
+            while (first + 1 < last && window[first] == 0.0)
+                ++first;
+            while (last - 1 > first && window[last - 1] == 0.0)
+                --last;
+            window = std::vector<double>(window.begin() + first, window.begin() + last);
+            windowStarts[d] = start + (int64_t)first;
+            tapCount = std::max(tapCount, (uint32_t)window.size());
+        }
+
+        // every destination texel gets the same tap count, shifted left near the right edge to stay inside
+        ResampleWeights result;
+        result.tapCount = tapCount;
+        result.first.resize(destinationSize);
+        result.weights.assign((size_t)destinationSize * tapCount, 0.0f);
+        for (uint32_t d = 0; d < destinationSize; ++d)
+        {
+            const uint32_t first = (uint32_t)std::min<int64_t>(windowStarts[d], (int64_t)sourceSize - tapCount);
+            result.first[d] = first;
+            for (size_t t = 0; t < windows[d].size(); ++t)
+                result.weights[(size_t)d * tapCount + (windowStarts[d] - first) + t] = (float)windows[d][t];
+        }
+        return result;
+    }
+
+    // destination texels [begin, end) of one row
+    void ResampleRowScalar(const float *source, uint32_t channels, const ResampleWeights &weights, float *destination, uint32_t begin, uint32_t end)
+    {
+        const uint32_t tapCount = weights.tapCount;
+        for (uint32_t x = begin; x < end; ++x)
+        {
+            const float *taps = source + (size_t)weights.first[x] * channels;
+            const float *tapWeights = weights.weights.data() + (size_t)x * tapCount;
+            for (uint32_t c = 0; c < channels; ++c)
+            {
+                float sum = 0.0f;
+                for (uint32_t t = 0; t < tapCount; ++t)
+                    sum += tapWeights[t] * taps[t * channels + c];
+                destination[x * channels + c] = sum;
+            }
+        }
+    }
+
+    // sum of weights[t] * rows[t][i] over the taps, for the floats [begin, end) of a row
+    void ResampleColumnsScalar(const float *const *rows, const float *weights, uint32_t tapCount, float *destination, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            float sum = 0.0f;
+            for (uint32_t t = 0; t < tapCount; ++t)
+                sum += weights[t] * rows[t][i];
+            destination[i] = sum;
+        }
+    }
+
+#if LAB_SIMD_X86
+    // rgba only: two destination texels a vector, each half reading its own taps
+    LAB_TARGET_AVX2 void ResampleRowAvx2(const float *source, const ResampleWeights &weights, float *destination, uint32_t width)
+    {
+        const uint32_t tapCount = weights.tapCount;
+        uint32_t x = 0;
+        for (; x + 2 <= width; x += 2)
+        {
+            const float *tapsA = source + (size_t)weights.first[x] * 4;
+            const float *tapsB = source + (size_t)weights.first[x + 1] * 4;
+            const float *weightsA = weights.weights.data() + (size_t)x * tapCount;
+            const float *weightsB = weightsA + tapCount;
+
+            __m256 sum = _mm256_setzero_ps();
+            for (uint32_t t = 0; t < tapCount; ++t)
+            {
+                const __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(tapsA + t * 4)), _mm_loadu_ps(tapsB + t * 4), 1);
+                const __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(weightsA[t])), _mm_set1_ps(weightsB[t]), 1);
+                sum = _mm256_fmadd_ps(weight, texels, sum);
+            }
+            _mm256_storeu_ps(destination + (size_t)x * 4, sum);
+        }
+        ResampleRowScalar(source, 4, weights, destination, x, width);
+    }
+
+    LAB_TARGET_AVX2 void ResampleColumnsAvx2(const float *const *rows, const float *weights, uint32_t tapCount, float *destination, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 sum = _mm256_setzero_ps();
+            for (uint32_t t = 0; t < tapCount; ++t)
+                sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i), sum);
+            _mm256_storeu_ps(destination + i, sum);
+        }
+        ResampleColumnsScalar(rows, weights, tapCount, destination, i, count);
+    }
+
+    LAB_TARGET_AVX512 void ResampleColumnsAvx512(const float *const *rows, const float *weights, uint32_t tapCount, float *destination, size_t count)
+    {
+        for (size_t i = 0; i < count; i += 16)
+        {
+            // the row tail is a partial vector, masked rather than left to a scalar loop
+            const __mmask16 mask = count - i >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (count - i)) - 1u);
+            __m512 sum = _mm512_setzero_ps();
+            for (uint32_t t = 0; t < tapCount; ++t)
+                sum = _mm512_fmadd_ps(_mm512_set1_ps(weights[t]), _mm512_maskz_loadu_ps(mask, rows[t] + i), sum);
+            _mm512_mask_storeu_ps(destination + i, mask, sum);
+        }
+    }
+#endif
+
+    // ---- tone mapping ----
+
+    struct TonemapConstants
+    {
+        TonemapOperator op;
+        float exposure;
+        float pureWhiteSquared;
+        float inverseGamma;
+        // thresholds[k] is the linear value from which the gamma encoded code rounds to k, with -inf and +inf
+        // around the 255 real ones for the SIMD correction step
+        alignas(64) std::array<float, 257> thresholds;
+    };
+
+    TonemapConstants CreateTonemapConstants(const TonemapSettings &settings)
+    {
+        TonemapConstants constants;
+        constants.op = settings.op;
+        constants.exposure = settings.exposure;
+        constants.pureWhiteSquared = settings.pureWhite * settings.pureWhite;
+        constants.inverseGamma = 1.0f / settings.gamma;
+        constants.thresholds[0] = -std::numeric_limits<float>::infinity();
+        for (int k = 1; k < 256; ++k)
+            constants.thresholds[k] = (float)std::pow((k - 0.5) / 255.0, (double)settings.gamma);
+        constants.thresholds[256] = std::numeric_limits<float>::infinity();
+        return constants;
+    }
+
+    // round(pow(clamp(value, 0, 1), 1 / gamma) * 255) as a branchless search, NaN lands on 0
+    uint8_t EncodeGamma(float value, const float *thresholds)
+    {
+        uint32_t code = 0;
+        for (uint32_t step = 128; step > 0; step >>= 1)
+            if (value >= thresholds[code + step])
+                code += step;
+        return (uint8_t)code;
+    }
+
+#if LAB_SIMD_X86
+    // log2(1 + t) and exp2(t) on [0, 1], Chebyshev fits, lowest order first
+    constexpr float LOG2_POLYNOMIAL[6] = {1.6514671e-05f, 1.4414924f, -0.70648645f, 0.40947030f, -0.18748860f, 0.043004958f};
+    constexpr float EXP2_POLYNOMIAL[6] = {0.99999990f, 0.69315449f, 0.24014182f, 0.055860337f, 0.0089495904f, 0.0018937541f};
+#endif
+
+    float Aces(float x)
+    {
+        const float mapped = (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+        return std::clamp(mapped, 0.0f, 1.0f);
+    }
+
+    void TonemapScalar(const float *source, uint32_t channels, const TonemapConstants &constants, uint8_t *destination, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float *texel = source + i * channels;
+            float r = texel[0] * constants.exposure;
+            float g = texel[1] * constants.exposure;
+            float b = texel[2] * constants.exposure;
+
+            if (constants.op == TonemapOperator::REINHARD)
+            {
+                const float luminance = r * LUMINANCE_R + g * LUMINANCE_G + b * LUMINANCE_B;
+                const float mappedLuminance = (luminance * (1.0f + luminance / constants.pureWhiteSquared)) / (1.0f + luminance);
+                // the shader divides 0 by 0 on black and writes the NaN, which stores as 0 as well
+                const float scale = luminance > 0.0f ? mappedLuminance / luminance : 0.0f;
+                r *= scale;
+                g *= scale;
+                b *= scale;
+            }
+            else
+            {
+                r = Aces(r);
+                g = Aces(g);
+                b = Aces(b);
+            }
+
+            uint8_t *result = destination + i * 4;
+            result[0] = EncodeGamma(r, constants.thresholds.data());
+            result[1] = EncodeGamma(g, constants.thresholds.data());
+            result[2] = EncodeGamma(b, constants.thresholds.data());
+            result[3] = 255;
+        }
+    }
+
+#if LAB_SIMD_X86
+    // Texels stay interleaved, one per 4 lanes. The luminance weights are broadcast across the lanes of a texel
+    // with in lane permutes, and the alpha lane (or the next texel's red on rgb) is mapped along and replaced by 255.
+    // The gamma encode estimates the code as exp2(log2(x) / gamma) from two 5th degree polynomials, good to a
+    // small fraction of a code, and one threshold either side of the estimate then settles it exactly as the scalar
+    // search does: two gathers instead of eight.
+    LAB_TARGET_AVX2 __m256i EncodeGammaAvx2(__m256 value, float inverseGamma, const float *thresholds)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        // NaN takes the lower bound
+        const __m256 x = _mm256_min_ps(_mm256_max_ps(value, _mm256_set1_ps(1.0e-30f)), one);
+
+        const __m256i bits = _mm256_castps_si256(x);
+        const __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        const __m256 mantissa = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7FFFFF)), _mm256_castps_si256(one))), one);
+        __m256 log2 = _mm256_set1_ps(LOG2_POLYNOMIAL[5]);
+        for (int i = 4; i >= 0; --i)
+            log2 = _mm256_fmadd_ps(log2, mantissa, _mm256_set1_ps(LOG2_POLYNOMIAL[i]));
+
+        const __m256 y = _mm256_mul_ps(_mm256_add_ps(exponent, log2), _mm256_set1_ps(inverseGamma));
+        const __m256 whole = _mm256_floor_ps(y);
+        const __m256 fraction = _mm256_sub_ps(y, whole);
+        __m256 exp2 = _mm256_set1_ps(EXP2_POLYNOMIAL[5]);
+        for (int i = 4; i >= 0; --i)
+            exp2 = _mm256_fmadd_ps(exp2, fraction, _mm256_set1_ps(EXP2_POLYNOMIAL[i]));
+        exp2 = _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(exp2), _mm256_slli_epi32(_mm256_cvtps_epi32(whole), 23)));
+
+        __m256i code = _mm256_cvtps_epi32(_mm256_mul_ps(exp2, _mm256_set1_ps(255.0f)));
+        code = _mm256_min_epi32(_mm256_max_epi32(code, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+
+        // the compares give -1 where true
+        const __m256i codeUp = _mm256_add_epi32(code, _mm256_set1_epi32(1));
+        code = _mm256_sub_epi32(code, _mm256_castps_si256(_mm256_cmp_ps(value, _mm256_i32gather_ps(thresholds, codeUp, 4), _CMP_GE_OQ)));
+        code = _mm256_add_epi32(code, _mm256_castps_si256(_mm256_cmp_ps(value, _mm256_i32gather_ps(thresholds, code, 4), _CMP_LT_OQ)));
+        return code;
+    }
+
+    LAB_TARGET_AVX2 __m256 AcesAvx2(__m256 x)
+    {
+        const __m256 numerator = _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.51f), x), _mm256_set1_ps(0.03f)));
+        const __m256 denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.43f), x), _mm256_set1_ps(0.59f))), _mm256_set1_ps(0.14f));
+        return _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(numerator, denominator), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    }
+
+    LAB_TARGET_AVX2 void TonemapAvx2(const float *source, uint32_t channels, const TonemapConstants &constants, uint8_t *destination, size_t count)
+    {
+        const __m256 exposure = _mm256_set1_ps(constants.exposure);
+        const __m256 pureWhiteSquared = _mm256_set1_ps(constants.pureWhiteSquared);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256i alpha = _mm256_set1_epi32(255);
+
+        // an rgb texel is read as 4 floats, the last one is left to the scalar loop
+        const size_t vectorCount = channels == 4 ? count : (count > 0 ? count - 1 : 0);
+        size_t i = 0;
+        for (; i + 2 <= vectorCount; i += 2)
+        {
+            __m256 color = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(source + i * channels)), _mm_loadu_ps(source + (i + 1) * channels), 1);
+            color = _mm256_mul_ps(color, exposure);
+
+            if (constants.op == TonemapOperator::REINHARD)
+            {
+                const __m256 luminance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_permute_ps(color, 0x00), _mm256_set1_ps(LUMINANCE_R)),
+                                                                     _mm256_mul_ps(_mm256_permute_ps(color, 0x55), _mm256_set1_ps(LUMINANCE_G))),
+                                                       _mm256_mul_ps(_mm256_permute_ps(color, 0xAA), _mm256_set1_ps(LUMINANCE_B)));
+                const __m256 mappedLuminance = _mm256_div_ps(_mm256_mul_ps(luminance, _mm256_add_ps(one, _mm256_div_ps(luminance, pureWhiteSquared))),
+                                                             _mm256_add_ps(one, luminance));
+                const __m256 scale = _mm256_and_ps(_mm256_cmp_ps(luminance, _mm256_setzero_ps(), _CMP_GT_OQ), _mm256_div_ps(mappedLuminance, luminance));
+                color = _mm256_mul_ps(color, scale);
+            }
+            else
+                color = AcesAvx2(color);
+
+            const __m256i codes = _mm256_blend_epi32(EncodeGammaAvx2(color, constants.inverseGamma, constants.thresholds.data()), alpha, 0x88);
+            // 32 to 8 bits within each 128 bit lane, then the two lanes' low 4 bytes side by side
+            const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(codes, codes), _mm256_setzero_si256());
+            const __m128i bytes = _mm_unpacklo_epi32(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(destination + i * 4), bytes);
+        }
+        TonemapScalar(source + i * channels, channels, constants, destination + i * 4, count - i);
+    }
+
+    LAB_TARGET_AVX512 __m512i EncodeGammaAvx512(__m512 value, float inverseGamma, const float *thresholds)
+    {
+        const __m512 one = _mm512_set1_ps(1.0f);
+        const __m512 x = _mm512_min_ps(_mm512_max_ps(value, _mm512_set1_ps(1.0e-30f)), one);
+
+        // log2 and exp2 through the exponent field, as in the AVX2 version
+        const __m512 exponent = _mm512_getexp_ps(x);
+        const __m512 mantissa = _mm512_sub_ps(_mm512_getmant_ps(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_zero), one);
+        __m512 log2 = _mm512_set1_ps(LOG2_POLYNOMIAL[5]);
+        for (int i = 4; i >= 0; --i)
+            log2 = _mm512_fmadd_ps(log2, mantissa, _mm512_set1_ps(LOG2_POLYNOMIAL[i]));
+
+        const __m512 y = _mm512_mul_ps(_mm512_add_ps(exponent, log2), _mm512_set1_ps(inverseGamma));
+        const __m512 whole = _mm512_floor_ps(y);
+        const __m512 fraction = _mm512_sub_ps(y, whole);
+        __m512 exp2 = _mm512_set1_ps(EXP2_POLYNOMIAL[5]);
+        for (int i = 4; i >= 0; --i)
+            exp2 = _mm512_fmadd_ps(exp2, fraction, _mm512_set1_ps(EXP2_POLYNOMIAL[i]));
+        exp2 = _mm512_scalef_ps(exp2, whole);
+
+        __m512i code = _mm512_cvtps_epi32(_mm512_mul_ps(exp2, _mm512_set1_ps(255.0f)));
+        code = _mm512_min_epi32(_mm512_max_epi32(code, _mm512_setzero_si512()), _mm512_set1_epi32(255));
+
+        const __m512i codeUp = _mm512_add_epi32(code, _mm512_set1_epi32(1));
+        code = _mm512_mask_mov_epi32(code, _mm512_cmp_ps_mask(value, _mm512_i32gather_ps(codeUp, thresholds, 4), _CMP_GE_OQ), codeUp);
+        code = _mm512_mask_sub_epi32(code, _mm512_cmp_ps_mask(value, _mm512_i32gather_ps(code, thresholds, 4), _CMP_LT_OQ), code, _mm512_set1_epi32(1));
+        return code;
+    }
+
+    LAB_TARGET_AVX512 __m512 AcesAvx512(__m512 x)
+    {
+        const __m512 numerator = _mm512_mul_ps(x, _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(2.51f), x), _mm512_set1_ps(0.03f)));
+        const __m512 denominator = _mm512_add_ps(_mm512_mul_ps(x, _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(2.43f), x), _mm512_set1_ps(0.59f))), _mm512_set1_ps(0.14f));
+        return _mm512_min_ps(_mm512_max_ps(_mm512_div_ps(numerator, denominator), _mm512_setzero_ps()), _mm512_set1_ps(1.0f));
+    }
+
+    LAB_TARGET_AVX512 void TonemapAvx512(const float *source, uint32_t channels, const TonemapConstants &constants, uint8_t *destination, size_t count)
+    {
+        const __m512 exposure = _mm512_set1_ps(constants.exposure);
+        const __m512 pureWhiteSquared = _mm512_set1_ps(constants.pureWhiteSquared);
+        const __m512 one = _mm512_set1_ps(1.0f);
+        const __m512i alpha = _mm512_set1_epi32(255);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            // rgb fills 3 of every 4 lanes, the alpha lanes are replaced by 255 below either way
+            __m512 color = channels == 4 ? _mm512_loadu_ps(source + i * 4) : _mm512_maskz_expandloadu_ps(0x7777, source + i * 3);
+            color = _mm512_mul_ps(color, exposure);
+
+            if (constants.op == TonemapOperator::REINHARD)
+            {
+                const __m512 luminance = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_permute_ps(color, 0x00), _mm512_set1_ps(LUMINANCE_R)),
+                                                                     _mm512_mul_ps(_mm512_permute_ps(color, 0x55), _mm512_set1_ps(LUMINANCE_G))),
+                                                       _mm512_mul_ps(_mm512_permute_ps(color, 0xAA), _mm512_set1_ps(LUMINANCE_B)));
+                const __m512 mappedLuminance = _mm512_div_ps(_mm512_mul_ps(luminance, _mm512_add_ps(one, _mm512_div_ps(luminance, pureWhiteSquared))),
+                                                             _mm512_add_ps(one, luminance));
+                const __mmask16 lit = _mm512_cmp_ps_mask(luminance, _mm512_setzero_ps(), _CMP_GT_OQ);
+                color = _mm512_maskz_mul_ps(lit, color, _mm512_div_ps(mappedLuminance, luminance));
+            }
+            else
+                color = AcesAvx512(color);
+
+            const __m512i codes = _mm512_mask_mov_epi32(EncodeGammaAvx512(color, constants.inverseGamma, constants.thresholds.data()), 0x8888, alpha);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 4), _mm512_cvtepi32_epi8(codes));
+        }
+        TonemapScalar(source + i * channels, channels, constants, destination + i * 4, count - i);
+    }
+#endif
+}
+
+uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu)
+        return (uint16_t)(sign | (mantissa ? 0x7E00u | (mantissa >> 13) : 0x7C00u));
+
+    const int32_t halfExponent = (int32_t)exponent - 127 + 15;
+    if (halfExponent >= 31)
+        return (uint16_t)(sign | 0x7C00u);
+
+    if (halfExponent <= 0)
+    {
+        if (halfExponent < -10)
+            return (uint16_t)sign;
+        // subnormal, the implicit one shifted in and rounded to nearest even
+        mantissa |= 0x800000u;
+        const uint32_t shift = (uint32_t)(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        const uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFFu;
+    // a carry out of the mantissa bumps the exponent, up to infinity, which is the correct rounding
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        ++half;
+    return (uint16_t)(sign | half);
+}
+
+float HalfToFloat(uint16_t value)
+{
+    const uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1Fu;
+    uint32_t mantissa = value & 0x3FFu;
+
+    uint32_t bits;
+    // NaN comes back quiet, like vcvtph2ps
+    if (exponent == 0x1Fu)
+        bits = sign | 0x7F800000u | (mantissa ? 0x400000u | (mantissa << 13) : 0u);
+    else if (exponent != 0)
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // subnormal, normalised into the float exponent range
+        uint32_t shift = 0;
+        while (!(mantissa & 0x400u))
+        {
+            mantissa <<= 1;
+            ++shift;
+        }
+        bits = sign | ((127 - 15 + 1 - shift) << 23) | ((mantissa & 0x3FFu) << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+bool ConvertToRgba(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("ConvertToRgba");
+
+    const ImageDataType type = source.GetType();
+    ImageDataType resultType;
+    if (!GetRgbaType(type, resultType))
+    {
+        LOG_WARN("ConvertToRgba does not take image type {}", (int)type);
+        return false;
+    }
+    if (!CheckViews("ConvertToRgba", source, destination, resultType))
+        return false;
+
+    const uint32_t channels = GetImageDataTypeChannels(type);
+    const SimdLevel level = GetLevel(settings);
+    if (resultType == ImageDataType::RGBA8)
+    {
+        ForEachRowRun(source, destination, settings, [&](const uint8_t *pixels, uint8_t *resultPixels, size_t count)
+                      {
+                          if (channels == 4)
+                              std::memcpy(resultPixels, pixels, count * 4);
+#if LAB_SIMD_X86
+                          else if (channels == 3 && level >= SimdLevel::AVX2)
+                              ExpandRgb8Avx2(pixels, resultPixels, count);
+#endif
+                          else
+                              ExpandUnorm8Scalar(pixels, channels, resultPixels, count); });
+        return true;
+    }
+
+    ForEachRowRun(source, destination, settings, [&](const uint8_t *bytes, uint8_t *resultBytes, size_t count)
+                  {
+                      const float *pixels = reinterpret_cast<const float *>(bytes);
+                      float *resultPixels = reinterpret_cast<float *>(resultBytes);
+                      if (channels == 4)
+                          std::memcpy(resultPixels, pixels, count * 4 * sizeof(float));
+#if LAB_SIMD_X86
+                      else if (level >= SimdLevel::AVX512)
+                          ExpandFloatAvx512(pixels, resultPixels, count);
+                      else if (level >= SimdLevel::AVX2)
+                          ExpandFloatAvx2(pixels, resultPixels, count);
+#endif
+                      else
+                          ExpandFloatScalar(pixels, resultPixels, count); });
+    return true;
+}
+
+ImageData ConvertToRgba(const ImageData &source, const ImageProcessingSettings &settings)
+{
+    ImageDataType resultType;
+    if (!GetRgbaType(source.GetType(), resultType))
+    {
+        LOG_WARN("ConvertToRgba does not take image type {}", (int)source.GetType());
+        return CreateEmpty(ImageDataType::RGBA8);
+    }
+    return CreateResult(resultType, source.GetWidth(), source.GetHeight(), settings, [&](const ImageView &destination)
+                        { return ConvertToRgba(source.GetView(), destination, settings); });
+}
+
+bool ConvertFloatToHalf(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("ConvertFloatToHalf");
+
+    const ImageDataType type = source.GetType();
+    ImageDataType resultType;
+    if (!GetHalfType(type, resultType))
+    {
+        LOG_WARN("ConvertFloatToHalf does not take image type {}", (int)type);
+        return false;
+    }
+    if (!CheckViews("ConvertFloatToHalf", source, destination, resultType))
+        return false;
+
+    const uint32_t channels = GetImageDataTypeChannels(type);
+    const SimdLevel level = GetLevel(settings);
+    ForEachRowRun(source, destination, settings, [&](const uint8_t *bytes, uint8_t *resultBytes, size_t count)
+                  {
+                      const float *pixels = reinterpret_cast<const float *>(bytes);
+                      uint16_t *resultPixels = reinterpret_cast<uint16_t *>(resultBytes);
+                      count *= channels;
+#if LAB_SIMD_X86
+                      if (level >= SimdLevel::AVX512)
+                          FloatToHalfAvx512(pixels, resultPixels, count);
+                      else if (level >= SimdLevel::AVX2)
+                          FloatToHalfAvx2(pixels, resultPixels, count);
+                      else
+#endif
+                          FloatToHalfScalar(pixels, resultPixels, count); });
+    return true;
+}
+
+ImageData ConvertFloatToHalf(const ImageData &source, const ImageProcessingSettings &settings)
+{
+    ImageDataType resultType;
+    if (!GetHalfType(source.GetType(), resultType))
+    {
+        LOG_WARN("ConvertFloatToHalf does not take image type {}", (int)source.GetType());
+        return CreateEmpty(ImageDataType::RGBA16F);
+    }
+    return CreateResult(resultType, source.GetWidth(), source.GetHeight(), settings, [&](const ImageView &destination)
+                        { return ConvertFloatToHalf(source.GetView(), destination, settings); });
+}
+
+bool ConvertSrgbToLinear(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("ConvertSrgbToLinear");
+
+    const ImageDataType type = source.GetType();
+    ImageDataType resultType;
+    if (!GetLinearType(type, resultType))
+    {
+        LOG_WARN("ConvertSrgbToLinear does not take image type {}", (int)type);
+        return false;
+    }
+    if (!CheckViews("ConvertSrgbToLinear", source, destination, resultType))
+        return false;
+
+    const uint32_t channels = GetImageDataTypeChannels(type);
+    const SimdLevel level = GetLevel(settings);
+    ForEachRowRun(source, destination, settings, [&](const uint8_t *pixels, uint8_t *resultBytes, size_t count)
+                  {
+                      float *resultPixels = reinterpret_cast<float *>(resultBytes);
+                      count *= channels;
+#if LAB_SIMD_X86
+                      if (level >= SimdLevel::AVX512)
+                          SrgbToLinearAvx512(pixels, channels, resultPixels, count);
+                      else if (level >= SimdLevel::AVX2)
+                          SrgbToLinearAvx2(pixels, channels, resultPixels, count);
+                      else
+#endif
+                          SrgbToLinearScalar(pixels, channels, resultPixels, count); });
+    return true;
+}
+
+ImageData ConvertSrgbToLinear(const ImageData &source, const ImageProcessingSettings &settings)
+{
+    ImageDataType resultType;
+    if (!GetLinearType(source.GetType(), resultType))
+    {
+        LOG_WARN("ConvertSrgbToLinear does not take image type {}", (int)source.GetType());
+        return CreateEmpty(ImageDataType::RGBA32F);
+    }
+    return CreateResult(resultType, source.GetWidth(), source.GetHeight(), settings, [&](const ImageView &destination)
+                        { return ConvertSrgbToLinear(source.GetView(), destination, settings); });
+}
+
+bool ResizeImage(const ImageView &source, const ImageView &destination, ResampleFilter filter, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("ResizeImage");
+
+    const ImageDataType type = source.GetType();
+    const uint32_t sourceWidth = source.GetWidth(), sourceHeight = source.GetHeight();
+    const uint32_t width = destination.GetWidth(), height = destination.GetHeight();
+    if (!IsFloat32ImageDataType(type) || destination.GetType() != type || width == 0 || height == 0 || sourceWidth == 0 || sourceHeight == 0 ||
+        !source.IsPacked() || !destination.IsPacked())
+    {
+        LOG_WARN("ResizeImage does not take a {}x{} image of type {} to a {}x{} image of type {}", sourceWidth, sourceHeight, (int)type, width, height,
+                 (int)destination.GetType());
+        return false;
+    }
+
+    const uint32_t channels = GetImageDataTypeChannels(type);
+    const SimdLevel level = GetLevel(settings);
+    const ResampleWeights horizontal = BuildResampleWeights(sourceWidth, width, filter);
+    const ResampleWeights vertical = BuildResampleWeights(sourceHeight, height, filter);
+    const size_t rowSize = (size_t)width * channels;
+
+    // horizontal pass, a row of the source height at a time
+    ImageData intermediate(type, width, sourceHeight, settings.pool);
+    const float *intermediatePixels = intermediate.GetPixels<float>();
+    ParallelFor(
+        0, sourceHeight, [&](size_t begin, size_t end)
+        {
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float *row = source.GetRow<float>((uint32_t)y);
+                float *resultRow = intermediate.GetPixels<float>() + y * rowSize;
+#if LAB_SIMD_X86
+                if (channels == 4 && level >= SimdLevel::AVX2)
+                    ResampleRowAvx2(row, horizontal, resultRow, width);
+                else
+#endif
+                    ResampleRowScalar(row, channels, horizontal, resultRow, 0, width);
+            } },
+        MIN_BLOCK_ROWS, settings.threadCount);
+
+    // vertical pass, whole rows of floats at once whatever the channel count
+    ParallelFor(
+        0, height, [&](size_t begin, size_t end)
+        {
+            std::vector<const float *> rows(vertical.tapCount);
+            for (size_t y = begin; y < end; ++y)
+            {
+                for (uint32_t t = 0; t < vertical.tapCount; ++t)
+                    rows[t] = intermediatePixels + (vertical.first[y] + t) * rowSize;
+                const float *weights = vertical.weights.data() + y * vertical.tapCount;
+                float *resultRow = destination.GetRow<float>((uint32_t)y);
+#if LAB_SIMD_X86
+                if (level >= SimdLevel::AVX512)
+                    ResampleColumnsAvx512(rows.data(), weights, vertical.tapCount, resultRow, rowSize);
+                else if (level >= SimdLevel::AVX2)
+                    ResampleColumnsAvx2(rows.data(), weights, vertical.tapCount, resultRow, rowSize);
+                else
+#endif
+                    ResampleColumnsScalar(rows.data(), weights, vertical.tapCount, resultRow, 0, rowSize);
+            } },
+        MIN_BLOCK_ROWS, settings.threadCount);
+
+    return true;
+}
+
+ImageData ResizeImage(const ImageData &source, uint32_t width, uint32_t height, ResampleFilter filter, const ImageProcessingSettings &settings)
+{
+    return CreateResult(source.GetType(), width, height, settings, [&](const ImageView &destination)
+                        { return ResizeImage(source.GetView(), destination, filter, settings); });
+}
+
+bool GenerateImageMips(const ImageView &source, const std::vector<ImageView> &levels, ResampleFilter filter, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("GenerateImageMips");
+
+    const ImageView *previous = &source;
+    for (const ImageView &level : levels)
+    {
+        if (!ResizeImage(*previous, level, filter, settings))
+            return false;
+        previous = &level;
+    }
+    return true;
+}
+
+std::vector<ImageData> GenerateImageMips(const ImageData &source, ResampleFilter filter, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("GenerateImageMips");
+
+    std::vector<ImageData> levels;
+    const ImageData *previous = &source;
+    while (previous->GetWidth() > 1 || previous->GetHeight() > 1)
+    {
+        const uint32_t width = std::max(previous->GetWidth() / 2, 1u);
+        const uint32_t height = std::max(previous->GetHeight() / 2, 1u);
+        ImageData level = ResizeImage(*previous, width, height, filter, settings);
+        if (level.GetWidth() == 0)
+            break;
+        levels.emplace_back(std::move(level));
+        previous = &levels.back();
+    }
+    return levels;
+}
+
+bool TonemapImage(const ImageView &source, const ImageView &destination, const TonemapSettings &tonemap, const ImageProcessingSettings &settings)
+{
+    PROFILE_SCOPE("TonemapImage");
+
+    const ImageDataType type = source.GetType();
+    if (type != ImageDataType::RGB32F && type != ImageDataType::RGBA32F)
+    {
+        LOG_WARN("TonemapImage does not take image type {}", (int)type);
+        return false;
+    }
+    if (!CheckViews("TonemapImage", source, destination, ImageDataType::RGBA8))
+        return false;
+
+    const uint32_t channels = GetImageDataTypeChannels(type);
+    const SimdLevel level = GetLevel(settings);
+    const TonemapConstants constants = CreateTonemapConstants(tonemap);
+    ForEachRowRun(source, destination, settings, [&](const uint8_t *bytes, uint8_t *resultPixels, size_t count)
+                  {
+                      const float *pixels = reinterpret_cast<const float *>(bytes);
+#if LAB_SIMD_X86
+                      if (level >= SimdLevel::AVX512)
+                          TonemapAvx512(pixels, channels, constants, resultPixels, count);
+                      else if (level >= SimdLevel::AVX2)
+                          TonemapAvx2(pixels, channels, constants, resultPixels, count);
+                      else
+#endif
+                          TonemapScalar(pixels, channels, constants, resultPixels, count); });
+    return true;
+}
+
+ImageData TonemapImage(const ImageData &source, const TonemapSettings &tonemap, const ImageProcessingSettings &settings)
+{
+    return CreateResult(ImageDataType::RGBA8, source.GetWidth(), source.GetHeight(), settings, [&](const ImageView &destination)
+                        { return TonemapImage(source.GetView(), destination, tonemap, settings); });
+}
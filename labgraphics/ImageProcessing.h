@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ImageData.h"
+#include "Simd.h"
+
+// CPU conversions, resampling and tone mapping over ImageData. Each function comes twice: writing into a view the
+// caller owns (a mip level of a chain, mapped staging memory), false and untouched on a type or extent it does not
+// take; or returning a new image, empty on such a source. Rows are split into blocks over the thread pool and each
+// block runs the kernel of the requested SIMD level; the result does not depend on the thread count. Float kernels
+// may differ from scalar in the last bits (fma), integer outputs do not differ by more than one step. Views must be
+// packed, their rows may be pitched.
+
+struct ImageProcessingSettings
+{
+    SimdLevel level = GetSimdLevel();
+    // 0: every pool worker and the caller
+    uint32_t threadCount = 0;
+    // results and temporaries come from it when set
+    ImagePool *pool = nullptr;
+};
+
+enum class ResampleFilter
+{
+    // 1 texel wide, a 2x reduction averages 2x2 texels
+    BOX,
+    // tent, 2 texels wide
+    TRIANGLE,
+    // 3 lobe windowed sinc, sharpest, rings on hard edges
+    LANCZOS3,
+};
+
+enum class TonemapOperator
+{
+    // luminance Reinhard, the formula of tonemap.frag
+    REINHARD,
+    // Narkowicz's fit of the ACES filmic curve, per channel
+    ACES,
+};
+
+struct TonemapSettings
+{
+    TonemapOperator op = TonemapOperator::REINHARD;
+    // the constants of tonemap.frag
+    float exposure = 1.0f;
+    float pureWhite = 1.0f;
+    float gamma = 2.2f;
+};
+
+// round to nearest even, NaN quieted with its payload kept, bit exact with F16C
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// R8, RG8 and RGB8 to RGBA8 (gray replicated, alpha 255 unless stored), RGB32F to RGBA32F (alpha 1)
+bool ConvertToRgba(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings = {});
+ImageData ConvertToRgba(const ImageData &source, const ImageProcessingSettings &settings = {});
+// R32F to R16F, RGB32F to RGB16F, RGBA32F to RGBA16F
+bool ConvertFloatToHalf(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings = {});
+ImageData ConvertFloatToHalf(const ImageData &source, const ImageProcessingSettings &settings = {});
+// sRGB encoded RGB8/RGBA8 to RGB32F/RGBA32F with the exact piecewise curve, alpha is linear already
+bool ConvertSrgbToLinear(const ImageView &source, const ImageView &destination, const ImageProcessingSettings &settings = {});
+ImageData ConvertSrgbToLinear(const ImageData &source, const ImageProcessingSettings &settings = {});
+
+// Separable resampling of a float image (R32F, RGB32F, RGBA32F) with clamped edges: a horizontal pass into a
+// temporary of the source height, then a vertical one. Filter weights are built once per destination column and
+// row, stretched by the reduction factor when shrinking. The view version resizes to the extent of destination.
+bool ResizeImage(const ImageView &source, const ImageView &destination, ResampleFilter filter = ResampleFilter::TRIANGLE,
+                 const ImageProcessingSettings &settings = {});
+ImageData ResizeImage(const ImageData &source, uint32_t width, uint32_t height, ResampleFilter filter = ResampleFilter::TRIANGLE,
+                      const ImageProcessingSettings &settings = {});
+// Levels 1 and below down to 1x1, each halved (rounded down) from the one above it. The view version fills levels
+// below source in order, each from the one before, e.g. the views of GetMipChainViews after level 0.
+bool GenerateImageMips(const ImageView &source, const std::vector<ImageView> &levels, ResampleFilter filter = ResampleFilter::BOX,
+                       const ImageProcessingSettings &settings = {});
+std::vector<ImageData> GenerateImageMips(const ImageData &source, ResampleFilter filter = ResampleFilter::BOX, const ImageProcessingSettings &settings = {});
+
+// Linear RGB32F/RGBA32F to display RGBA8, alpha 1 like tonemap.frag. The gamma encode is an exact search over the
+// 255 code boundaries instead of pow, so every level rounds the same.
+bool TonemapImage(const ImageView &source, const ImageView &destination, const TonemapSettings &tonemap = {}, const ImageProcessingSettings &settings = {});
+ImageData TonemapImage(const ImageData &source, const TonemapSettings &tonemap = {}, const ImageProcessingSettings &settings = {});
@@ -1,5 +1,6 @@
 #include "InputSystem.h"
 #include <memory>
+#include <cstring>
 #include "App.h"
 
 KeyboardState::KeyboardState()
@@ -102,7 +103,7 @@ void InputSystem::Init()
 
 void InputSystem::PreUpdate()
 {
-	memcpy_s(mKeyboardState.mPreKeyState, SDL_NUM_SCANCODES, mKeyboardState.mCurKeyState, SDL_NUM_SCANCODES);
+	memcpy(mKeyboardState.mPreKeyState, mKeyboardState.mCurKeyState, SDL_NUM_SCANCODES);
 	mMouseState.mPreButtons = mMouseState.mCurButtons;
 	mMouseState.mPrePos = mMouseState.mCurPos;
 	mMouseState.mMouseScrollWheel = Vector2i32::ZERO;
@@ -0,0 +1,215 @@
+#include "Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include "ThreadPool.h"
+
+void ParallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &fn, size_t minChunk, uint32_t threadCount)
+{
+    if (end <= begin)
+        return;
+
+    ThreadPool &pool = ThreadPool::Instance();
+    const size_t count = end - begin;
+    minChunk = std::max<size_t>(minChunk, 1);
+    const size_t maxThreadCount = (size_t)pool.GetThreadCount() + 1;
+    const size_t participantCount = std::min({threadCount == 0 ? maxThreadCount : (size_t)threadCount, maxThreadCount, (count + minChunk - 1) / minChunk});
+    if (participantCount <= 1)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    // Helpers are queued on the pool while the caller works through the chunks itself. A helper that only
+    // starts once the caller is done finds the loop closed and returns, so the caller never waits on queued
+    // jobs and ParallelFor can be nested inside pool jobs without deadlocking.
+    struct Loop
+    {
+        std::atomic<size_t> next;
+        size_t end;
+        size_t chunk;
+        const std::function<void(size_t, size_t)> *fn;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        uint32_t running = 0;
+        bool closed = false;
+
+        void Run()
+        {
+            while (true)
+            {
+                const size_t chunkBegin = next.fetch_add(chunk);
+                if (chunkBegin >= end)
+                    break;
+                (*fn)(chunkBegin, std::min(chunkBegin + chunk, end));
+            }
+        }
+    };
+
+    auto loop = std::make_shared<Loop>();
+    loop->next = begin;
+    loop->end = end;
+    // a few chunks per thread balances the load without contending on the counter
+    loop->chunk = std::max(minChunk, count / (participantCount * 4));
+    loop->fn = &fn;
+
+    for (size_t i = 1; i < participantCount; ++i)
+        pool.Enqueue([loop]()
+                     {
+                         {
+                             std::lock_guard<std::mutex> lock(loop->mutex);
+                             if (loop->closed)
+                                 return;
+                             loop->running++;
+                         }
+                         loop->Run();
+                         {
+                             std::lock_guard<std::mutex> lock(loop->mutex);
+                             loop->running--;
+                         }
+                         loop->condition.notify_all(); });
+
+    loop->Run();
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->closed = true;
+    loop->condition.wait(lock, [&]()
+                         { return loop->running == 0; });
+}
+
+void ParallelForStealing(size_t begin, size_t end, const std::function<void(size_t)> &fn, uint32_t threadCount)
+{
+    if (end <= begin)
+        return;
+
+    ThreadPool &pool = ThreadPool::Instance();
+    const size_t count = end - begin;
+    const size_t maxThreadCount = (size_t)pool.GetThreadCount() + 1;
+    const size_t participantCount = std::min({threadCount == 0 ? maxThreadCount : (size_t)threadCount, maxThreadCount, count});
+    if (participantCount <= 1)
+    {
+        for (size_t i = begin; i < end; ++i)
+            fn(i);
+        return;
+    }
+
+    struct Share
+    {
+        std::mutex mutex;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    // Same lifetime rules as ParallelFor: a helper that starts after the caller finished finds the loop closed.
+    // Its share is not lost, the others steal it like any other.
+    struct Loop
+    {
+        std::unique_ptr<Share[]> shares;
+        size_t shareCount;
+        const std::function<void(size_t)> *fn;
+        std::atomic<size_t> nextSlot{1};
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        uint32_t running = 0;
+        bool closed = false;
+
+        bool Pop(Share &share, size_t &index)
+        {
+            std::lock_guard<std::mutex> lock(share.mutex);
+            if (share.next >= share.end)
+                return false;
+            index = share.next++;
+            return true;
+        }
+
+        // moves the upper half of the largest share into self, false once every share is empty
+        bool Steal(size_t self)
+        {
+            while (true)
+            {
+                size_t victim = shareCount;
+                size_t most = 0;
+                for (size_t i = 0; i < shareCount; ++i)
+                {
+                    if (i == self)
+                        continue;
+                    std::lock_guard<std::mutex> lock(shares[i].mutex);
+                    if (shares[i].end - shares[i].next > most)
+                    {
+                        most = shares[i].end - shares[i].next;
+                        victim = i;
+                    }
+                }
+                if (victim == shareCount)
+                    return false;
+
+                size_t stolenBegin, stolenEnd;
+                {
+                    std::lock_guard<std::mutex> lock(shares[victim].mutex);
+                    const size_t remaining = shares[victim].end - shares[victim].next;
+                    // drained since the scan, look again
+                    if (remaining == 0)
+                        continue;
+                    stolenEnd = shares[victim].end;
+                    stolenBegin = stolenEnd - (remaining + 1) / 2;
+                    shares[victim].end = stolenBegin;
+                }
+
+                std::lock_guard<std::mutex> lock(shares[self].mutex);
+                shares[self].next = stolenBegin;
+                shares[self].end = stolenEnd;
+                return true;
+            }
+        }
+
+        void Run(size_t self)
+        {
+            size_t index;
+            do
+            {
+                while (Pop(shares[self], index))
+                    (*fn)(index);
+            } while (Steal(self));
+        }
+    };
+
+    auto loop = std::make_shared<Loop>();
+    loop->shares.reset(new Share[participantCount]);
+    loop->shareCount = participantCount;
+    loop->fn = &fn;
+    for (size_t i = 0; i < participantCount; ++i)
+    {
+        loop->shares[i].next = begin + count * i / participantCount;
+        loop->shares[i].end = begin + count * (i + 1) / participantCount;
+    }
+
+    for (size_t i = 1; i < participantCount; ++i)
+        pool.Enqueue([loop]()
+                     {
+                         size_t slot;
+                         {
+                             std::lock_guard<std::mutex> lock(loop->mutex);
+                             if (loop->closed)
+                                 return;
+                             loop->running++;
+                             slot = loop->nextSlot++;
+                         }
+                         loop->Run(slot);
+                         {
+                             std::lock_guard<std::mutex> lock(loop->mutex);
+                             loop->running--;
+                         }
+                         loop->condition.notify_all(); });
+
+    loop->Run(0);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->closed = true;
+    loop->condition.wait(lock, [&]()
+                         { return loop->running == 0; });
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Runs fn(chunkBegin, chunkEnd) over [begin, end) on the ThreadPool workers and the calling thread and returns when
+// every chunk is done. Chunks are handed out dynamically so uneven rows do not leave threads idle; minChunk bounds the
+// scheduling overhead and threadCount caps the threads taking part (0: every pool worker and the caller). Safe to call
+// from inside a pool job.
+void ParallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t)> &fn, size_t minChunk = 1, uint32_t threadCount = 0);
+
+// Runs fn(index) for every index in [begin, end) on up to threadCount threads (0: every pool worker and the caller),
+// for items whose cost varies by orders of magnitude. Each thread starts on its own contiguous share and, once it runs
+// dry, steals the upper half of the largest share left, so one expensive region does not serialise the tail of the
+// loop the way a static split would. Safe to call from inside a pool job.
+void ParallelForStealing(size_t begin, size_t end, const std::function<void(size_t)> &fn, uint32_t threadCount = 0);
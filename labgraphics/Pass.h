@@ -5,6 +5,7 @@
 #include "Graphics/VK/CommandBuffer.h"
 #include "Graphics/VK/SyncObject.h"
 #include "Graphics/VK/Pipeline.h"
+#include "Graphics/VK/DescriptorAllocator.h"
 
 template <typename CmdBuffer>
 class Pass
@@ -19,11 +20,14 @@ public:
     void RecordCurrentCommand(std::function<void(CmdBuffer *, size_t)> fn);
 
     CmdBuffer* GetCurrentCommandBuffer() const;
+    // sets shared by the frames of the pass, stale ones are released once the frames using them completed
+    DescriptorSetCache *GetDescriptorSetCache() const;
 private:
     std::vector<std::unique_ptr<CmdBuffer>> mCommandBuffers;
     std::vector<std::unique_ptr<Semaphore>> mImageAvailableSemaphores;
     std::vector<std::unique_ptr<Semaphore>> mRenderFinishedSemaphores;
     std::vector<std::unique_ptr<Fence>> mInFlightFences;
+    std::unique_ptr<DescriptorSetCache> mDescriptorSetCache;
     size_t mInFlightFrameCount;
     size_t mCurFrame = 0;
 };
@@ -26,6 +26,7 @@ Pass<CmdBuffer>::Pass(size_t inFlightFrameCount)
     mImageAvailableSemaphores = App::Instance().GetGraphicsContext()->GetDevice()->CreateSemaphores(mInFlightFrameCount);
     mRenderFinishedSemaphores = App::Instance().GetGraphicsContext()->GetDevice()->CreateSemaphores(mInFlightFrameCount);
     mInFlightFences = App::Instance().GetGraphicsContext()->GetDevice()->CreateFences(mInFlightFrameCount, FenceStatus::SIGNALED);
+    mDescriptorSetCache = std::make_unique<DescriptorSetCache>(*App::Instance().GetGraphicsContext()->GetDevice(), (uint32_t)mInFlightFrameCount);
 }
 
 template <typename CmdBuffer>
@@ -62,6 +63,8 @@ template <typename CmdBuffer>
 void Pass<CmdBuffer>::RecordCurrentCommand(std::function<void(CmdBuffer *, size_t)> fn)
 {
     mInFlightFences[mCurFrame]->Wait();
+    // the frame recorded before with this command buffer has completed
+    mDescriptorSetCache->BeginFrame(mCurFrame);
     mCommandBuffers[mCurFrame]->Record([&]()
                                        { fn(mCommandBuffers[mCurFrame].get(), mCurFrame); });
 }
@@ -70,4 +73,9 @@ template <typename CmdBuffer>
 CmdBuffer *Pass<CmdBuffer>::GetCurrentCommandBuffer() const
 {
     return mCommandBuffers[mCurFrame].get();
+}
+template <typename CmdBuffer>
+DescriptorSetCache *Pass<CmdBuffer>::GetDescriptorSetCache() const
+{
+    return mDescriptorSetCache.get();
 }
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include "Logger.h"
+
+Profiler::Profiler()
+    : mEpoch(std::chrono::steady_clock::now())
+{
+}
+
+void Profiler::SetEnabled(bool enabled)
+{
+    mEnabled = enabled;
+}
+
+bool Profiler::IsEnabled() const
+{
+    return mEnabled;
+}
+
+void Profiler::SetHistorySize(uint32_t sampleCount)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mHistorySize = std::max(sampleCount, 1u);
+    for (auto &series : mSeries)
+        series.clear();
+}
+
+void Profiler::SetMaxTraceEventCount(uint32_t eventCount)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mMaxTraceEventCount = eventCount;
+    while (mTraceEvents.size() > mMaxTraceEventCount)
+        mTraceEvents.pop_front();
+}
+
+void Profiler::BeginFrame()
+{
+    mFrameStartUs = GetTimeUs();
+}
+
+void Profiler::EndFrame()
+{
+    AddSample("Frame", ProfileTrack::CPU, mFrameStartUs, GetTimeUs() - mFrameStartUs);
+    ++mFrameIndex;
+}
+
+uint64_t Profiler::GetFrameIndex() const
+{
+    return mFrameIndex;
+}
+
+double Profiler::GetTimeUs() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - mEpoch).count();
+}
+
+void Profiler::AddSample(const std::string &name, ProfileTrack track, double startUs, double durationUs)
+{
+    if (!mEnabled)
+        return;
+
+    const uint32_t threadId = GetThreadId();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto &series = mSeries[(size_t)track][name];
+    if (series.durationsMs.size() < mHistorySize)
+        series.durationsMs.emplace_back(durationUs / 1000.0);
+    else
+        series.durationsMs[series.next] = durationUs / 1000.0;
+    series.next = (series.next + 1) % mHistorySize;
+
+    if (mMaxTraceEventCount == 0)
+        return;
+    if (mTraceEvents.size() >= mMaxTraceEventCount)
+        mTraceEvents.pop_front();
+    mTraceEvents.push_back({name, track, startUs, durationUs, threadId});
+}
+
+ProfileStats Profiler::GetStats(const std::string &name, ProfileTrack track) const
+{
+    std::vector<double> durations;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto iter = mSeries[(size_t)track].find(name);
+        if (iter == mSeries[(size_t)track].end())
+            return {};
+        durations = iter->second.durationsMs;
+    }
+
+    if (durations.empty())
+        return {};
+
+    std::sort(durations.begin(), durations.end());
+
+    auto percentile = [&](double p)
+    {
+        return durations[std::min(durations.size() - 1, (size_t)(p * durations.size()))];
+    };
+
+    ProfileStats result;
+    result.count = (uint32_t)durations.size();
+    result.avgMs = std::accumulate(durations.begin(), durations.end(), 0.0) / durations.size();
+    result.minMs = durations.front();
+    result.maxMs = durations.back();
+    result.p50Ms = percentile(0.50);
+    result.p95Ms = percentile(0.95);
+    result.p99Ms = percentile(0.99);
+    return result;
+}
+
+std::vector<std::string> Profiler::GetNames(ProfileTrack track) const
+{
+    std::vector<std::string> result;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (const auto &[name, series] : mSeries[(size_t)track])
+            result.emplace_back(name);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void Profiler::PrintStats() const
+{
+    for (size_t track = 0; track < 2; ++track)
+    {
+        for (const auto &name : GetNames((ProfileTrack)track))
+        {
+            ProfileStats stats = GetStats(name, (ProfileTrack)track);
+            LOG_INFO("[{}] {}: avg {:.3f} ms, p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, min {:.3f} ms, max {:.3f} ms ({} samples)",
+                     track == (size_t)ProfileTrack::CPU ? "CPU" : "GPU", name, stats.avgMs, stats.p50Ms, stats.p95Ms, stats.p99Ms, stats.minMs, stats.maxMs, stats.count);
+        }
+    }
+}
+
+bool Profiler::ExportChromeTrace(const std::string &path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        LOG_WARN("Failed to write profiler trace {}", path);
+        return false;
+    }
+
+    auto escape = [](const std::string &str)
+    {
+        std::string result;
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result;
+    };
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // pid 0 holds the cpu threads, pid 1 the gpu queue
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"GPU\"}}";
+    for (const auto &event : mTraceEvents)
+    {
+        file << ",\n{\"name\":\"" << escape(event.name) << "\",\"cat\":\"" << (event.track == ProfileTrack::CPU ? "cpu" : "gpu")
+             << "\",\"ph\":\"X\",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs
+             << ",\"pid\":" << (uint32_t)event.track << ",\"tid\":" << event.threadId << "}";
+    }
+    file << "\n]}\n";
+
+    LOG_INFO("Profiler trace with {} events written to {}", mTraceEvents.size(), path);
+    return true;
+}
+
+void Profiler::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto &series : mSeries)
+        series.clear();
+    mTraceEvents.clear();
+}
+
+uint32_t Profiler::GetThreadId()
+{
+    // small sequential ids read better in the trace viewer than hashed std::thread::id
+    static std::atomic<uint32_t> sNextThreadId{0};
+    thread_local uint32_t threadId = sNextThreadId++;
+    return threadId;
+}
+
+ProfileScope::ProfileScope(const char *name)
+    : mName(name), mStartUs(Profiler::Instance().GetTimeUs())
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+    Profiler::Instance().AddSample(mName, ProfileTrack::CPU, mStartUs, Profiler::Instance().GetTimeUs() - mStartUs);
+}
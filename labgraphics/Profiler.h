@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class ProfileTrack
+{
+    CPU = 0,
+    GPU,
+};
+
+struct ProfileStats
+{
+    uint32_t count = 0;
+    double avgMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+};
+
+// Collects named cpu and gpu timings. Keeps a rolling window of durations per name for percentile stats
+// and a bounded list of trace events that can be exported for chrome://tracing or Perfetto.
+class Profiler
+{
+public:
+    static Profiler &Instance()
+    {
+        static Profiler instance;
+        return instance;
+    }
+
+    Profiler(const Profiler &) = delete;
+    Profiler(Profiler &&) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+    Profiler &operator=(Profiler &&) = delete;
+
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const;
+
+    // samples kept per name for the percentiles
+    void SetHistorySize(uint32_t sampleCount);
+    // trace events kept for export, the oldest are dropped first
+    void SetMaxTraceEventCount(uint32_t eventCount);
+
+    void BeginFrame();
+    void EndFrame();
+    uint64_t GetFrameIndex() const;
+
+    // microseconds since the profiler was created, the time base of all samples
+    double GetTimeUs() const;
+
+    void AddSample(const std::string &name, ProfileTrack track, double startUs, double durationUs);
+
+    ProfileStats GetStats(const std::string &name, ProfileTrack track = ProfileTrack::CPU) const;
+    // sorted names with samples on the track
+    std::vector<std::string> GetNames(ProfileTrack track) const;
+    void PrintStats() const;
+
+    bool ExportChromeTrace(const std::string &path) const;
+
+    void Clear();
+
+private:
+    Profiler();
+    ~Profiler() = default;
+
+    struct Series
+    {
+        std::vector<double> durationsMs;
+        size_t next = 0;
+    };
+
+    struct TraceEvent
+    {
+        std::string name;
+        ProfileTrack track;
+        double startUs;
+        double durationUs;
+        uint32_t threadId;
+    };
+
+    static uint32_t GetThreadId();
+
+    std::chrono::steady_clock::time_point mEpoch;
+
+    bool mEnabled = true;
+    uint32_t mHistorySize = 512;
+    uint32_t mMaxTraceEventCount = 200000;
+
+    uint64_t mFrameIndex = 0;
+    double mFrameStartUs = 0.0;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<std::string, Series> mSeries[2];
+    std::deque<TraceEvent> mTraceEvents;
+};
+
+// Records the lifetime of the scope on the cpu track
+class ProfileScope
+{
+public:
+    ProfileScope(const char *name);
+    ~ProfileScope();
+
+private:
+    const char *mName;
+    double mStartUs;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
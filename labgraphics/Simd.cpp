@@ -0,0 +1,92 @@
+#include "Simd.h"
+
+#if LAB_SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+#if LAB_SIMD_X86
+    void CpuId(uint32_t leaf, uint32_t subLeaf, uint32_t regs[4])
+    {
+#if defined(_MSC_VER)
+        int values[4];
+        __cpuidex(values, (int)leaf, (int)subLeaf);
+        for (int i = 0; i < 4; ++i)
+            regs[i] = (uint32_t)values[i];
+#else
+        __cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    uint64_t GetEnabledStateMask()
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((uint64_t)edx << 32) | eax;
+#endif
+    }
+
+    SimdLevel DetectSimdLevel()
+    {
+        uint32_t regs[4];
+        CpuId(0, 0, regs);
+        if (regs[0] < 7)
+            return SimdLevel::SCALAR;
+
+        CpuId(1, 0, regs);
+        const bool osxsave = (regs[2] & (1u << 27)) != 0;
+        const bool fma = (regs[2] & (1u << 12)) != 0;
+        const bool f16c = (regs[2] & (1u << 29)) != 0;
+        if (!osxsave)
+            return SimdLevel::SCALAR;
+
+        // the OS has to save the ymm (and zmm, opmask) registers across context switches
+        const uint64_t stateMask = GetEnabledStateMask();
+        const bool ymmEnabled = (stateMask & 0x6) == 0x6;
+        const bool zmmEnabled = (stateMask & 0xe6) == 0xe6;
+
+        CpuId(7, 0, regs);
+        const bool avx2 = (regs[1] & (1u << 5)) != 0;
+        const bool avx512f = (regs[1] & (1u << 16)) != 0;
+
+        if (avx512f && avx2 && fma && f16c && zmmEnabled)
+            return SimdLevel::AVX512;
+        if (avx2 && fma && f16c && ymmEnabled)
+            return SimdLevel::AVX2;
+        return SimdLevel::SCALAR;
+    }
+#else
+    SimdLevel DetectSimdLevel()
+    {
+        return SimdLevel::SCALAR;
+    }
+#endif
+}
+
+SimdLevel GetSimdLevel()
+{
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+const char *GetSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::AVX512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// Vector instruction sets the CPU code paths are specialised for. Kernels are compiled per level with the
+// LAB_TARGET_* attributes and picked at run time, the binary itself stays baseline x86-64.
+enum class SimdLevel
+{
+    SCALAR = 0,
+    // 8 floats per instruction, with FMA and F16C
+    AVX2,
+    // 16 floats per instruction and per lane masks
+    AVX512,
+};
+
+// highest level both the CPU and the OS (saved register state) support
+SimdLevel GetSimdLevel();
+const char *GetSimdLevelName(SimdLevel level);
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LAB_SIMD_X86 1
+#else
+#define LAB_SIMD_X86 0
+#endif
+
+// MSVC compiles any intrinsic without per function flags
+#if LAB_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define LAB_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+#define LAB_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#else
+#define LAB_TARGET_AVX2
+#define LAB_TARGET_AVX512
+#endif
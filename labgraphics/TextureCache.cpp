@@ -0,0 +1,436 @@
+#include "TextureCache.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <thread>
+#include <stb/stb_image.h>
+#include "ImageData.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include "Timer.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // shaped like the KTX2 identifier so a truncated or text mangled file fails the compare
+    constexpr uint8_t IDENTIFIER[12] = {0xAB, 'L', 'T', 'X', ' ', '1', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    // bump when the importer output changes, older caches are then rebuilt
+    constexpr uint32_t VERSION = 2;
+
+    uint64_t AlignPayload(uint64_t offset)
+    {
+        return (offset + 15) & ~15ull;
+    }
+
+    bool GetSourceStamp(const std::string &imagePath, uint64_t &size, int64_t &time)
+    {
+        std::error_code errorCode;
+        size = std::filesystem::file_size(imagePath, errorCode);
+        if (errorCode)
+            return false;
+        time = (int64_t)std::filesystem::last_write_time(imagePath, errorCode).time_since_epoch().count();
+        return !errorCode;
+    }
+}
+
+TextureCacheFile::~TextureCacheFile()
+{
+    Close();
+}
+
+bool TextureCacheFile::Open(const std::string &path)
+{
+    Close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    mFile = file;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        Close();
+        return false;
+    }
+    mFileSize = (uint64_t)fileSize.QuadPart;
+#else
+    mFile = open(path.c_str(), O_RDONLY);
+    if (mFile < 0)
+        return false;
+    const off_t fileSize = lseek(mFile, 0, SEEK_END);
+    if (fileSize < 0)
+    {
+        Close();
+        return false;
+    }
+    mFileSize = (uint64_t)fileSize;
+#endif
+
+    if (!ReadAt(0, &mHeader, sizeof(TextureCacheHeader)) ||
+        std::memcmp(mHeader.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 ||
+        mHeader.version != VERSION ||
+        mHeader.width == 0 || mHeader.height == 0 ||
+        mHeader.levelCount == 0 || mHeader.levelCount > GetMipCount(mHeader.width, mHeader.height))
+    {
+        Close();
+        return false;
+    }
+
+    mLevels.resize(mHeader.levelCount);
+    if (!ReadAt(sizeof(TextureCacheHeader), mLevels.data(), mLevels.size() * sizeof(TextureCacheLevel)))
+    {
+        Close();
+        return false;
+    }
+
+    // a level of another size than its format and extent need would overrun the image it is uploaded to
+    const Format format((VkFormat)mHeader.vkFormat);
+    for (uint32_t level = 0; level < mLevels.size(); ++level)
+        if (mLevels[level].byteOffset > mFileSize || mLevels[level].byteLength > mFileSize - mLevels[level].byteOffset ||
+            mLevels[level].byteLength == 0 || mLevels[level].byteLength != GetTextureLevelSize(format, GetLevelWidth(level), GetLevelHeight(level)))
+        {
+            Close();
+            return false;
+        }
+
+    return true;
+}
+
+void TextureCacheFile::Close()
+{
+#if defined(_WIN32)
+    if (mMappedData)
+        UnmapViewOfFile(mMappedData);
+    if (mMapping)
+        CloseHandle(mMapping);
+    if (mFile)
+        CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = nullptr;
+#else
+    if (mMappedData)
+        munmap(const_cast<uint8_t *>(mMappedData), mFileSize);
+    if (mFile >= 0)
+        close(mFile);
+    mFile = -1;
+#endif
+    mMappedData = nullptr;
+    mFileSize = 0;
+    mHeader = {};
+    mLevels.clear();
+}
+
+bool TextureCacheFile::IsOpen() const
+{
+#if defined(_WIN32)
+    return mFile != nullptr;
+#else
+    return mFile >= 0;
+#endif
+}
+
+uint32_t TextureCacheFile::GetLevelWidth(uint32_t level) const
+{
+    return std::max(mHeader.width >> level, 1u);
+}
+
+uint32_t TextureCacheFile::GetLevelHeight(uint32_t level) const
+{
+    return std::max(mHeader.height >> level, 1u);
+}
+
+bool TextureCacheFile::ReadAt(uint64_t offset, void *dst, uint64_t size) const
+{
+    if (!IsOpen() || offset > mFileSize || size > mFileSize - offset)
+        return false;
+
+    uint8_t *bytes = static_cast<uint8_t *>(dst);
+    while (size > 0)
+    {
+#if defined(_WIN32)
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)(offset & 0xFFFFFFFFull);
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD readSize = 0;
+        if (!ReadFile((HANDLE)mFile, bytes, (DWORD)std::min<uint64_t>(size, 1u << 30), &readSize, &overlapped) || readSize == 0)
+            return false;
+#else
+        const ssize_t readSize = pread(mFile, bytes, (size_t)std::min<uint64_t>(size, 1u << 30), (off_t)offset);
+        if (readSize <= 0)
+            return false;
+#endif
+        bytes += readSize;
+        offset += (uint64_t)readSize;
+        size -= (uint64_t)readSize;
+    }
+    return true;
+}
+
+bool TextureCacheFile::ReadLevel(uint32_t level, void *dst) const
+{
+    if (level >= mLevels.size())
+        return false;
+    return ReadAt(mLevels[level].byteOffset, dst, mLevels[level].byteLength);
+}
+
+const uint8_t *TextureCacheFile::MapLevel(uint32_t level)
+{
+    if (level >= mLevels.size())
+        return nullptr;
+
+    if (!mMappedData)
+    {
+#if defined(_WIN32)
+        mMapping = CreateFileMappingA((HANDLE)mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mMapping)
+            return nullptr;
+        mMappedData = static_cast<const uint8_t *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (!mMappedData)
+            return nullptr;
+#else
+        void *data = mmap(nullptr, mFileSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+        if (data == MAP_FAILED)
+            return nullptr;
+        mMappedData = static_cast<const uint8_t *>(data);
+#endif
+    }
+    return mMappedData + mLevels[level].byteOffset;
+}
+
+bool TextureCacheFile::Read(TextureData &texture) const
+{
+    texture.format = Format((VkFormat)mHeader.vkFormat);
+    texture.width = mHeader.width;
+    texture.height = mHeader.height;
+    texture.mips.resize(mLevels.size());
+
+    uint64_t offset = 0;
+    for (uint32_t level = 0; level < mLevels.size(); ++level)
+    {
+        TextureMip &mip = texture.mips[level];
+        mip.width = GetLevelWidth(level);
+        mip.height = GetLevelHeight(level);
+        mip.offset = offset;
+        mip.size = mLevels[level].byteLength;
+        offset = AlignPayload(offset + mip.size);
+    }
+    texture.data.resize(offset);
+
+    for (uint32_t level = 0; level < mLevels.size(); ++level)
+        if (!ReadLevel(level, texture.data.data() + texture.mips[level].offset))
+            return false;
+    return true;
+}
+
+bool TextureCacheFile::Write(const std::string &path, const TextureData &texture, TextureCacheHeader header)
+{
+    std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.version = VERSION;
+    header.vkFormat = (uint32_t)texture.format.ToVkHandle();
+    header.width = texture.width;
+    header.height = texture.height;
+    header.levelCount = (uint32_t)texture.mips.size();
+
+    // the mip tail leads the payload, a streamer reading front to back gets something to show first
+    std::vector<TextureCacheLevel> levels(texture.mips.size());
+    uint64_t offset = AlignPayload(sizeof(TextureCacheHeader) + levels.size() * sizeof(TextureCacheLevel));
+    for (size_t level = levels.size(); level-- > 0;)
+    {
+        levels[level].byteOffset = offset;
+        levels[level].byteLength = texture.mips[level].size;
+        offset = AlignPayload(offset + levels[level].byteLength);
+    }
+
+    // written aside and renamed over the old cache, a crash never leaves a half written file behind; the name is
+    // unique per writer, so jobs importing the same image with other settings never write into each other's file
+    static std::atomic<uint64_t> writeCounter{0};
+    const std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." + std::to_string(writeCounter++) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        static const char padding[16] = {};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(TextureCacheLevel));
+        for (size_t level = levels.size(); level-- > 0;)
+        {
+            file.write(padding, levels[level].byteOffset - (uint64_t)file.tellp());
+            file.write(reinterpret_cast<const char *>(texture.data.data() + texture.mips[level].offset), levels[level].byteLength);
+        }
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(tempPath);
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename(tempPath, path, errorCode);
+    if (errorCode)
+    {
+        std::filesystem::remove(tempPath, errorCode);
+        return false;
+    }
+    return true;
+}
+
+uint32_t GetTextureCacheSettingsKey(const TextureImportSettings &settings)
+{
+    return (uint32_t)settings.role |
+           ((uint32_t)settings.mipFilter << 4) |
+           ((uint32_t)settings.generateMips << 8) |
+           ((uint32_t)settings.compress << 9) |
+           ((uint32_t)settings.highQuality << 10);
+}
+
+std::string GetTextureCachePath(const std::string &imagePath)
+{
+    return imagePath + ".ltx";
+}
+
+bool OpenTextureCache(const std::string &imagePath, const TextureImportSettings &settings, TextureCacheFile &file)
+{
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (!GetSourceStamp(imagePath, sourceSize, sourceTime))
+        return false;
+
+    if (!file.Open(GetTextureCachePath(imagePath)))
+        return false;
+
+    const TextureCacheHeader &header = file.GetHeader();
+    if (header.settingsKey != GetTextureCacheSettingsKey(settings) ||
+        header.sourceSize != sourceSize ||
+        header.sourceTime != sourceTime)
+    {
+        file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool LoadTextureCache(const std::string &imagePath, const TextureImportSettings &settings, TextureData &texture)
+{
+    TextureCacheFile file;
+    return OpenTextureCache(imagePath, settings, file) && file.Read(texture);
+}
+
+bool SaveTextureCache(const std::string &imagePath, const TextureImportSettings &settings, const TextureData &texture)
+{
+    TextureCacheHeader header{};
+    header.settingsKey = GetTextureCacheSettingsKey(settings);
+    if (!GetSourceStamp(imagePath, header.sourceSize, header.sourceTime))
+        return false;
+    return TextureCacheFile::Write(GetTextureCachePath(imagePath), texture, header);
+}
+
+TextureData LoadTexture(const std::string &imagePath, const TextureImportSettings &settings, bool *fromCache)
+{
+    TextureData texture;
+    const bool cached = LoadTextureCache(imagePath, settings, texture);
+    if (fromCache)
+        *fromCache = cached;
+    if (cached)
+        return texture;
+
+    int width, height, channels;
+    // the file's own channel count, the importer picks what each role needs
+    uint8_t *pixels = stbi_load(imagePath.c_str(), &width, &height, &channels, 0);
+    if (!pixels)
+    {
+        LOG_WARN("Failed to load texture image {}", imagePath);
+        return TextureData();
+    }
+
+    static const ImageDataType types[] = {ImageDataType::R8, ImageDataType::RG8, ImageDataType::RGB8, ImageDataType::RGBA8};
+    const ImageData image(types[channels - 1], width, height, pixels, stbi_image_free);
+    texture = ImportTexture(image, settings);
+
+    if (!SaveTextureCache(imagePath, settings, texture))
+        LOG_WARN("Failed to write texture cache {}", GetTextureCachePath(imagePath));
+    return texture;
+}
+
+std::string GetCanonicalTexturePath(const std::string &imagePath)
+{
+    std::error_code errorCode;
+    const std::filesystem::path path = std::filesystem::weakly_canonical(imagePath, errorCode);
+    return errorCode ? imagePath : path.generic_string();
+}
+
+std::shared_future<TextureLoadResult> AsyncTextureLoader::Request(const std::string &imagePath, const TextureImportSettings &settings, TextureLoadMode mode)
+{
+    const std::string path = GetCanonicalTexturePath(imagePath);
+    const std::string key = path + "|" + std::to_string(GetTextureCacheSettingsKey(settings)) + "|" + std::to_string((uint32_t)mode);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto iter = mJobs.find(key);
+    if (iter != mJobs.end())
+        return iter->second.future;
+
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::shared_future<TextureLoadResult> job = ThreadPool::Instance().Submit([path, settings, mode, cancelled]()
+                                                                              {
+                                                                                  TextureLoadResult result;
+                                                                                  if (cancelled->load())
+                                                                                      return result;
+
+                                                                                  const uint64_t start = Timer::Now();
+                                                                                  auto file = std::make_shared<TextureCacheFile>();
+                                                                                  if (mode == TextureLoadMode::STREAMED && OpenTextureCache(path, settings, *file))
+                                                                                  {
+                                                                                      result.cacheFile = file;
+                                                                                      result.fromCache = true;
+                                                                                  }
+                                                                                  else
+                                                                                  {
+                                                                                      result.texture = LoadTexture(path, settings, &result.fromCache);
+                                                                                      // the import just wrote the cache, stream from it like a cached texture
+                                                                                      if (mode == TextureLoadMode::STREAMED && !result.texture.mips.empty() && OpenTextureCache(path, settings, *file))
+                                                                                      {
+                                                                                          result.cacheFile = file;
+                                                                                          result.texture = TextureData();
+                                                                                      }
+                                                                                  }
+                                                                                  result.milliseconds = static_cast<double>(Timer::Now() - start) / 1000000.0;
+                                                                                  return result; })
+                                                    .share();
+    mJobs.emplace(key, Job{job, cancelled});
+    return job;
+}
+
+void AsyncTextureLoader::Cancel()
+{
+    std::unordered_map<std::string, Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        jobs.swap(mJobs);
+    }
+
+    for (auto &job : jobs)
+        job.second.cancelled->store(true);
+    // the running ones cannot stop halfway, wait so they are done with the caches before anything rewrites them
+    for (auto &job : jobs)
+        job.second.future.wait();
+}
+
+void AsyncTextureLoader::Clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mJobs.clear();
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TextureImporter.h"
+
+// Imported mip chains cached next to their source image as "<image>.ltx", laid out after KTX2:
+//   TextureCacheHeader
+//   TextureCacheLevel[levelCount], level 0 first
+//   level payloads, smallest mip first, each 16 byte aligned
+// so a loader can fetch any single mip with one positioned read or straight from a mapping.
+
+struct TextureCacheHeader
+{
+    uint8_t identifier[12];
+    uint32_t version;
+    // VkFormat of the payload, BCn blocks or plain 8 bit texels
+    uint32_t vkFormat;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    // the TextureImportSettings the payload was built with, see GetTextureCacheSettingsKey
+    uint32_t settingsKey;
+    uint32_t reserved;
+    // the source image as it was when the cache was written, any change makes the cache stale
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+struct TextureCacheLevel
+{
+    uint64_t byteOffset;
+    uint64_t byteLength;
+};
+
+class TextureCacheFile
+{
+public:
+    TextureCacheFile() = default;
+    ~TextureCacheFile();
+
+    TextureCacheFile(const TextureCacheFile &) = delete;
+    TextureCacheFile &operator=(const TextureCacheFile &) = delete;
+
+    // reads and validates the header and the level index, the payloads stay on disk
+    bool Open(const std::string &path);
+    void Close();
+
+    bool IsOpen() const;
+    const TextureCacheHeader &GetHeader() const { return mHeader; }
+    const std::vector<TextureCacheLevel> &GetLevels() const { return mLevels; }
+    uint32_t GetLevelWidth(uint32_t level) const;
+    uint32_t GetLevelHeight(uint32_t level) const;
+
+    // one positioned read of a whole level, dst must hold GetLevels()[level].byteLength bytes
+    bool ReadLevel(uint32_t level, void *dst) const;
+    // maps the file read only on first use, the pointer stays valid until Close
+    const uint8_t *MapLevel(uint32_t level);
+
+    // every level in the TextureData layout ImportTexture produces
+    bool Read(TextureData &texture) const;
+
+    static bool Write(const std::string &path, const TextureData &texture, TextureCacheHeader header);
+
+private:
+    bool ReadAt(uint64_t offset, void *dst, uint64_t size) const;
+
+#if defined(_WIN32)
+    void *mFile = nullptr;
+    void *mMapping = nullptr;
+#else
+    int mFile = -1;
+#endif
+    uint64_t mFileSize = 0;
+    const uint8_t *mMappedData = nullptr;
+
+    TextureCacheHeader mHeader{};
+    std::vector<TextureCacheLevel> mLevels;
+};
+
+uint32_t GetTextureCacheSettingsKey(const TextureImportSettings &settings);
+std::string GetTextureCachePath(const std::string &imagePath);
+
+// a cache that matches the image on disk and the settings, false when there is none
+bool OpenTextureCache(const std::string &imagePath, const TextureImportSettings &settings, TextureCacheFile &file);
+bool LoadTextureCache(const std::string &imagePath, const TextureImportSettings &settings, TextureData &texture);
+bool SaveTextureCache(const std::string &imagePath, const TextureImportSettings &settings, const TextureData &texture);
+
+// The cached mip chain when it is fresh, otherwise decodes and imports the image and refreshes the cache.
+// Returns an empty TextureData (no mips) when the image cannot be decoded.
+TextureData LoadTexture(const std::string &imagePath, const TextureImportSettings &settings, bool *fromCache = nullptr);
+
+enum class TextureLoadMode
+{
+    // the whole mip chain in TextureLoadResult::texture
+    RESIDENT = 0,
+    // only the cache header, the levels stay on disk for a streamer; falls back to RESIDENT when no cache can be written
+    STREAMED,
+};
+
+struct TextureLoadResult
+{
+    TextureData texture;
+    // set by STREAMED loads, texture is empty then
+    std::shared_ptr<TextureCacheFile> cacheFile;
+    bool fromCache = false;
+    // time the job spent loading, decode plus import on a cache miss
+    double milliseconds = 0.0;
+};
+
+// Runs LoadTexture on the ThreadPool. Requests are keyed by the canonical image path and the import settings,
+// so the same file reached through different relative paths or from several threads is loaded once.
+class AsyncTextureLoader
+{
+public:
+    std::shared_future<TextureLoadResult> Request(const std::string &imagePath, const TextureImportSettings &settings, TextureLoadMode mode = TextureLoadMode::RESIDENT);
+
+    // forgets every job, their mip data is freed once the last requester drops its future
+    void Clear();
+    // forgets every job like Clear, jobs that have not started yet return an empty TextureLoadResult and
+    // the running ones are waited for, so requests made afterwards never race them for a cache file
+    void Cancel();
+
+private:
+    struct Job
+    {
+        std::shared_future<TextureLoadResult> future;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+    };
+
+    std::mutex mMutex;
+    std::unordered_map<std::string, Job> mJobs;
+};
+
+// weakly canonical and with generic separators, the path textures are deduplicated by
+std::string GetCanonicalTexturePath(const std::string &imagePath);
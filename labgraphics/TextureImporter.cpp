@@ -0,0 +1,536 @@
+#include "TextureImporter.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <xmmintrin.h>
+#include "BlockCompression.h"
+#include "ImageProcessing.h"
+#include "Parallel.h"
+
+namespace
+{
+    // the path tracer decodes color maps with pow(c, 2.2), filtering uses the same curve
+    constexpr float GAMMA = 2.2f;
+    constexpr int KAISER_TAPS = 8;
+
+    struct FloatImage
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // 4 for color and normals (xyz + unused), 1 for masks
+        uint32_t channels = 0;
+        std::vector<float> pixels;
+
+        FloatImage() = default;
+        FloatImage(uint32_t width, uint32_t height, uint32_t channels)
+            : width(width), height(height), channels(channels), pixels((size_t)width * height * channels)
+        {
+        }
+
+        float *GetRow(uint32_t y) { return pixels.data() + (size_t)y * width * channels; }
+        const float *GetRow(uint32_t y) const { return pixels.data() + (size_t)y * width * channels; }
+    };
+
+    uint32_t GetStoredChannels(TextureRole role)
+    {
+        switch (role)
+        {
+        case TextureRole::NORMAL:
+            return 2;
+        case TextureRole::MASK:
+            return 1;
+        default:
+            return 4;
+        }
+    }
+
+    uint32_t GetFilterChannels(TextureRole role)
+    {
+        return role == TextureRole::MASK ? 1 : 4;
+    }
+
+    const float *GetGammaToLinearTable()
+    {
+        static const std::array<float, 256> table = []()
+        {
+            std::array<float, 256> result;
+            for (int i = 0; i < 256; ++i)
+                result[i] = std::pow(i / 255.0f, GAMMA);
+            return result;
+        }();
+        return table.data();
+    }
+
+    float BesselI0(float x)
+    {
+        float sum = 1.0f, term = 1.0f;
+        for (int k = 1; k < 20; ++k)
+        {
+            const float half = x / (2.0f * k);
+            term *= half * half;
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Kaiser windowed sinc for a 2x reduction: taps sit 0.5, 1.5, 2.5 and 3.5 source texels either side of the
+    // destination texel center, the window spans 2 destination texels
+    const float *GetKaiserWeights()
+    {
+        static const std::array<float, KAISER_TAPS> weights = []()
+        {
+            constexpr float pi = 3.14159265358979f;
+            constexpr float width = 2.0f;
+            constexpr float alpha = 4.0f;
+
+            std::array<float, KAISER_TAPS> result;
+            float sum = 0.0f;
+            for (int t = 0; t < KAISER_TAPS; ++t)
+            {
+                const float x = (t - 3.5f) * 0.5f;
+                const float sinc = std::sin(pi * x) / (pi * x);
+                const float r = x / width;
+                result[t] = sinc * BesselI0(alpha * std::sqrt(std::max(0.0f, 1.0f - r * r))) / BesselI0(alpha);
+                sum += result[t];
+            }
+            for (auto &weight : result)
+                weight /= sum;
+            return result;
+        }();
+        return weights.data();
+    }
+
+    uint8_t ToUnorm8(float value)
+    {
+        return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // stb keeps the file's channel count, expand any of them to rgba
+    void ReadRgba(const uint8_t *pixel, int channels, uint8_t rgba[4])
+    {
+        switch (channels)
+        {
+        case 1:
+            rgba[0] = rgba[1] = rgba[2] = pixel[0];
+            rgba[3] = 255;
+            break;
+        case 2:
+            rgba[0] = rgba[1] = rgba[2] = pixel[0];
+            rgba[3] = pixel[1];
+            break;
+        case 3:
+            rgba[0] = pixel[0];
+            rgba[1] = pixel[1];
+            rgba[2] = pixel[2];
+            rgba[3] = 255;
+            break;
+        default:
+            std::memcpy(rgba, pixel, 4);
+            break;
+        }
+    }
+
+    // level 0 in the stored layout, the source texels are kept bit exact
+    std::vector<uint8_t> ConvertSource(const ImageData &source, TextureRole role)
+    {
+        const uint32_t width = source.GetWidth(), height = source.GetHeight();
+        const uint32_t channels = GetStoredChannels(role);
+        const int sourceChannels = source.GetChannels();
+        const uint8_t *pixels = source.GetPixels<uint8_t>();
+
+        std::vector<uint8_t> result((size_t)width * height * channels);
+        ParallelFor(0, height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin * width; i < end * width; ++i)
+                        {
+                            uint8_t rgba[4];
+                            ReadRgba(pixels + i * sourceChannels, sourceChannels, rgba);
+                            std::memcpy(result.data() + i * channels, rgba, channels);
+                        } },
+                    16);
+        return result;
+    }
+
+    FloatImage ToFloat(const ImageData &source, TextureRole role)
+    {
+        const uint32_t width = source.GetWidth(), height = source.GetHeight();
+        const int sourceChannels = source.GetChannels();
+        const uint8_t *pixels = source.GetPixels<uint8_t>();
+        const float *gammaToLinear = GetGammaToLinearTable();
+
+        FloatImage image(width, height, GetFilterChannels(role));
+        ParallelFor(0, height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin * width; i < end * width; ++i)
+                        {
+                            uint8_t rgba[4];
+                            ReadRgba(pixels + i * sourceChannels, sourceChannels, rgba);
+                            float *texel = image.pixels.data() + i * image.channels;
+                            switch (role)
+                            {
+                            case TextureRole::COLOR:
+                                texel[0] = gammaToLinear[rgba[0]];
+                                texel[1] = gammaToLinear[rgba[1]];
+                                texel[2] = gammaToLinear[rgba[2]];
+                                texel[3] = rgba[3] / 255.0f;
+                                break;
+                            case TextureRole::LINEAR_COLOR:
+                                for (int c = 0; c < 4; ++c)
+                                    texel[c] = rgba[c] / 255.0f;
+                                break;
+                            case TextureRole::NORMAL:
+                            {
+                                const float x = rgba[0] / 127.5f - 1.0f;
+                                const float y = rgba[1] / 127.5f - 1.0f;
+                                texel[0] = x;
+                                texel[1] = y;
+                                texel[2] = sourceChannels >= 3 ? rgba[2] / 127.5f - 1.0f : std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+                                texel[3] = 0.0f;
+                                break;
+                            }
+                            case TextureRole::MASK:
+                                texel[0] = rgba[0] / 255.0f;
+                                break;
+                            }
+                        } },
+                    16);
+        return image;
+    }
+
+    std::vector<uint8_t> FromFloat(const FloatImage &image, TextureRole role)
+    {
+        const uint32_t channels = GetStoredChannels(role);
+        std::vector<uint8_t> result((size_t)image.width * image.height * channels);
+        ParallelFor(0, image.height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin * image.width; i < end * image.width; ++i)
+                        {
+                            const float *texel = image.pixels.data() + i * image.channels;
+                            uint8_t *dst = result.data() + i * channels;
+                            switch (role)
+                            {
+                            case TextureRole::COLOR:
+                                for (int c = 0; c < 3; ++c)
+                                    dst[c] = ToUnorm8(std::pow(std::max(texel[c], 0.0f), 1.0f / GAMMA));
+                                dst[3] = ToUnorm8(texel[3]);
+                                break;
+                            case TextureRole::LINEAR_COLOR:
+                                for (int c = 0; c < 4; ++c)
+                                    dst[c] = ToUnorm8(texel[c]);
+                                break;
+                            case TextureRole::NORMAL:
+                                dst[0] = ToUnorm8(texel[0] * 0.5f + 0.5f);
+                                dst[1] = ToUnorm8(texel[1] * 0.5f + 0.5f);
+                                break;
+                            case TextureRole::MASK:
+                                dst[0] = ToUnorm8(texel[0]);
+                                break;
+                            }
+                        } },
+                    16);
+        return result;
+    }
+
+    // filtered normals shorten, the next level is filtered from unit vectors again
+    void NormalizeNormals(FloatImage &image)
+    {
+        ParallelFor(0, image.height, [&](size_t begin, size_t end)
+                    {
+                        for (size_t i = begin * image.width; i < end * image.width; ++i)
+                        {
+                            float *texel = image.pixels.data() + i * 4;
+                            const float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+                            if (length > 1e-6f)
+                            {
+                                texel[0] /= length;
+                                texel[1] /= length;
+                                texel[2] /= length;
+                            }
+                            else
+                            {
+                                texel[0] = texel[1] = 0.0f;
+                                texel[2] = 1.0f;
+                            }
+                        } },
+                    16);
+    }
+
+    // the box filter of ImageProcessing, a 2x reduction averages 2x2 texels, an odd edge spreads over the texels
+    // it straddles
+    FloatImage DownsampleBox(const FloatImage &src)
+    {
+        FloatImage dst(std::max(src.width / 2, 1u), std::max(src.height / 2, 1u), src.channels);
+        const ImageDataType type = src.channels == 4 ? ImageDataType::RGBA32F : ImageDataType::R32F;
+        ResizeImage(ImageView(type, src.width, src.height, const_cast<float *>(src.pixels.data())), ImageView(type, dst.width, dst.height, dst.pixels.data()),
+                    ResampleFilter::BOX);
+        return dst;
+    }
+
+    // separable: a horizontal then a vertical 2x reduction, clamped at the edges
+    FloatImage DownsampleKaiser(const FloatImage &src)
+    {
+        const float *weights = GetKaiserWeights();
+        const uint32_t channels = src.channels;
+
+        FloatImage horizontal(std::max(src.width / 2, 1u), src.height, channels);
+        ParallelFor(0, src.height, [&](size_t begin, size_t end)
+                    {
+                        auto column = [&](int x)
+                        { return (uint32_t)std::clamp(x, 0, (int)src.width - 1); };
+
+                        for (uint32_t y = (uint32_t)begin; y < end; ++y)
+                        {
+                            const float *row = src.GetRow(y);
+                            float *out = horizontal.GetRow(y);
+
+                            if (channels == 4)
+                            {
+                                for (uint32_t x = 0; x < horizontal.width; ++x)
+                                {
+                                    __m128 sum = _mm_setzero_ps();
+                                    for (int t = 0; t < KAISER_TAPS; ++t)
+                                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(row + column((int)(2 * x) - 3 + t) * 4)));
+                                    _mm_storeu_ps(out + x * 4, sum);
+                                }
+                                continue;
+                            }
+
+                            uint32_t x = 0;
+                            while (x < horizontal.width)
+                            {
+                                // 4 outputs at once away from the edges, output j of tap t reads base[t + 2j]
+                                if (x >= 2 && x + 4 <= horizontal.width && 2 * x + 11 < src.width)
+                                {
+                                    const float *base = row + 2 * x - 3;
+                                    __m128 sum = _mm_setzero_ps();
+                                    for (int t = 0; t < KAISER_TAPS; ++t)
+                                    {
+                                        const __m128 even = _mm_shuffle_ps(_mm_loadu_ps(base + t), _mm_loadu_ps(base + t + 4), _MM_SHUFFLE(2, 0, 2, 0));
+                                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), even));
+                                    }
+                                    _mm_storeu_ps(out + x, sum);
+                                    x += 4;
+                                    continue;
+                                }
+
+                                float sum = 0.0f;
+                                for (int t = 0; t < KAISER_TAPS; ++t)
+                                    sum += weights[t] * row[column((int)(2 * x) - 3 + t)];
+                                out[x] = sum;
+                                ++x;
+                            }
+                        } },
+                    8);
+
+        FloatImage dst(horizontal.width, std::max(src.height / 2, 1u), channels);
+        const size_t rowFloats = (size_t)dst.width * channels;
+        ParallelFor(0, dst.height, [&](size_t begin, size_t end)
+                    {
+                        for (uint32_t y = (uint32_t)begin; y < end; ++y)
+                        {
+                            const float *taps[KAISER_TAPS];
+                            for (int t = 0; t < KAISER_TAPS; ++t)
+                                taps[t] = horizontal.GetRow((uint32_t)std::clamp((int)(2 * y) - 3 + t, 0, (int)horizontal.height - 1));
+                            float *out = dst.GetRow(y);
+
+                            size_t i = 0;
+                            for (; i + 4 <= rowFloats; i += 4)
+                            {
+                                __m128 sum = _mm_setzero_ps();
+                                for (int t = 0; t < KAISER_TAPS; ++t)
+                                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(taps[t] + i)));
+                                _mm_storeu_ps(out + i, sum);
+                            }
+                            for (; i < rowFloats; ++i)
+                            {
+                                float sum = 0.0f;
+                                for (int t = 0; t < KAISER_TAPS; ++t)
+                                    sum += weights[t] * taps[t][i];
+                                out[i] = sum;
+                            }
+                        } },
+                    8);
+        return dst;
+    }
+
+    Format SelectFormat(const TextureImportSettings &settings, bool hasAlpha)
+    {
+        switch (settings.role)
+        {
+        case TextureRole::NORMAL:
+            return settings.compress ? Format::BC5_UNORM_BLOCK : Format::R8G8_UNORM;
+        case TextureRole::MASK:
+            return settings.compress ? Format::BC4_UNORM_BLOCK : Format::R8_UNORM;
+        default:
+            if (!settings.compress)
+                return Format::R8G8B8A8_UNORM;
+            if (settings.highQuality)
+                return Format::BC7_UNORM_BLOCK;
+            return hasAlpha ? Format::BC3_UNORM_BLOCK : Format::BC1_RGB_UNORM_BLOCK;
+        }
+    }
+
+    // bytes per 4x4 block, 0 for the uncompressed formats
+    uint32_t GetBlockSize(const Format &format)
+    {
+        switch (format.GetHandle())
+        {
+        case Format::BC1_RGB_UNORM_BLOCK:
+        case Format::BC4_UNORM_BLOCK:
+            return 8;
+        case Format::BC3_UNORM_BLOCK:
+        case Format::BC5_UNORM_BLOCK:
+        case Format::BC7_UNORM_BLOCK:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    void CompressBlockRow(const std::vector<uint8_t> &level, const TextureMip &mip, uint32_t channels, const Format &format, uint32_t blockY, uint8_t *dst)
+    {
+        const uint32_t blockSize = GetBlockSize(format);
+        const uint32_t blocksX = (mip.width + 3) / 4;
+        for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+        {
+            // partial edge blocks repeat the last row and column
+            uint8_t texels[16][4] = {};
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t x = std::min(blockX * 4 + i % 4, mip.width - 1);
+                const uint32_t y = std::min(blockY * 4 + i / 4, mip.height - 1);
+                std::memcpy(texels[i], level.data() + ((size_t)y * mip.width + x) * channels, channels);
+            }
+
+            uint8_t *block = dst + (size_t)blockX * blockSize;
+            switch (format.GetHandle())
+            {
+            case Format::BC1_RGB_UNORM_BLOCK:
+                EncodeBC1(texels, block);
+                break;
+            case Format::BC3_UNORM_BLOCK:
+                EncodeBC3(texels, block);
+                break;
+            case Format::BC7_UNORM_BLOCK:
+                EncodeBC7(texels, block);
+                break;
+            case Format::BC4_UNORM_BLOCK:
+            {
+                uint8_t values[16];
+                for (uint32_t i = 0; i < 16; ++i)
+                    values[i] = texels[i][0];
+                EncodeBC4(values, block);
+                break;
+            }
+            case Format::BC5_UNORM_BLOCK:
+            {
+                uint8_t rg[16][2];
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    rg[i][0] = texels[i][0];
+                    rg[i][1] = texels[i][1];
+                }
+                EncodeBC5(rg, block);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+}
+
+uint32_t GetMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        ++count;
+    return count;
+}
+
+uint64_t GetTextureLevelSize(const Format &format, uint32_t width, uint32_t height)
+{
+    const uint32_t blockSize = GetBlockSize(format);
+    if (blockSize > 0)
+        return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    return (uint64_t)width * height * format.GetTexelSize();
+}
+
+TextureData ImportTexture(const ImageData &source, const TextureImportSettings &settings)
+{
+    const TextureRole role = settings.role;
+    const uint32_t channels = GetStoredChannels(role);
+
+    TextureData texture;
+    texture.width = (uint32_t)source.GetWidth();
+    texture.height = (uint32_t)source.GetHeight();
+    const uint32_t mipCount = settings.generateMips ? GetMipCount(texture.width, texture.height) : 1;
+
+    // 8 bit levels in the stored layout, each filtered from the float level above
+    std::vector<std::vector<uint8_t>> levels(mipCount);
+    levels[0] = ConvertSource(source, role);
+    if (mipCount > 1)
+    {
+        FloatImage image = ToFloat(source, role);
+        for (uint32_t level = 1; level < mipCount; ++level)
+        {
+            image = settings.mipFilter == MipFilter::KAISER ? DownsampleKaiser(image) : DownsampleBox(image);
+            if (role == TextureRole::NORMAL)
+                NormalizeNormals(image);
+            levels[level] = FromFloat(image, role);
+        }
+    }
+
+    bool hasAlpha = false;
+    if (channels == 4)
+    {
+        for (size_t i = 3; i < levels[0].size() && !hasAlpha; i += 4)
+            hasAlpha = levels[0][i] < 255;
+    }
+
+    texture.format = SelectFormat(settings, hasAlpha);
+    const uint32_t blockSize = GetBlockSize(texture.format);
+
+    uint64_t offset = 0;
+    texture.mips.resize(mipCount);
+    for (uint32_t level = 0; level < mipCount; ++level)
+    {
+        TextureMip &mip = texture.mips[level];
+        mip.width = std::max(texture.width >> level, 1u);
+        mip.height = std::max(texture.height >> level, 1u);
+        mip.offset = offset;
+        mip.size = GetTextureLevelSize(texture.format, mip.width, mip.height);
+        offset = (offset + mip.size + 15) & ~15ull;
+    }
+    texture.data.resize(offset);
+
+    if (blockSize == 0)
+    {
+        // plain texels are laid out like any mip chain of ImageData, the offsets above match its views
+        const ImageDataType type = channels == 4 ? ImageDataType::RGBA8 : (channels == 2 ? ImageDataType::RG8 : ImageDataType::R8);
+        const std::vector<ImageView> views = GetMipChainViews(type, texture.width, texture.height, mipCount, texture.data.data());
+        for (uint32_t level = 0; level < mipCount; ++level)
+            ImageView(type, views[level].GetWidth(), views[level].GetHeight(), levels[level].data()).CopyTo(views[level]);
+        return texture;
+    }
+
+    // one job per block row of every level, so the small levels do not serialize at the end
+    std::vector<std::pair<uint32_t, uint32_t>> blockRows;
+    for (uint32_t level = 0; level < mipCount; ++level)
+        for (uint32_t blockY = 0; blockY < (texture.mips[level].height + 3) / 4; ++blockY)
+            blockRows.emplace_back(level, blockY);
+
+    ParallelFor(0, blockRows.size(), [&](size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        const auto [level, blockY] = blockRows[i];
+                        const TextureMip &mip = texture.mips[level];
+                        const size_t rowSize = (size_t)((mip.width + 3) / 4) * blockSize;
+                        CompressBlockRow(levels[level], mip, channels, texture.format, blockY, texture.data.data() + mip.offset + blockY * rowSize);
+                    } },
+                4);
+    return texture;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ImageData.h"
+#include "Format.h"
+
+// How a texture is sampled, decides the filtering space, the stored channels and the block format
+enum class TextureRole
+{
+    // gamma encoded rgb(a), albedo and specular maps
+    COLOR = 0,
+    // rgb(a) sampled as is, emission maps
+    LINEAR_COLOR,
+    // tangent space xy, the shader rebuilds z
+    NORMAL,
+    // the red channel alone, roughness, metallic and opacity maps
+    MASK,
+};
+
+enum class MipFilter
+{
+    BOX = 0,
+    // 8 tap windowed sinc, keeps the mips sharper than the box filter
+    KAISER,
+};
+
+struct TextureImportSettings
+{
+    TextureRole role = TextureRole::COLOR;
+    MipFilter mipFilter = MipFilter::KAISER;
+    bool generateMips = true;
+    // BCn blocks, otherwise plain 8 bit mips in R8, R8G8 or R8G8B8A8
+    bool compress = true;
+    // BC7 rather than BC1 (opaque) or BC3 (with alpha) for color roles
+    bool highQuality = false;
+};
+
+struct TextureMip
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // byte range inside TextureData::data, offsets are 16 byte aligned for the buffer to image copies
+    uint64_t offset = 0;
+    uint64_t size = 0;
+};
+
+// A GPU ready mip chain, the levels are packed back to back so the whole texture is one staging copy
+struct TextureData
+{
+    Format format = Format::R8G8B8A8_UNORM;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<TextureMip> mips;
+    std::vector<uint8_t> data;
+};
+
+// Builds the mip chain in linear space and compresses every level, both spread over the hardware threads
+TextureData ImportTexture(const ImageData &source, const TextureImportSettings &settings);
+
+uint32_t GetMipCount(uint32_t width, uint32_t height);
+
+// bytes of one level, BCn blocks or plain texels; 0 for formats without a known size
+uint64_t GetTextureLevelSize(const Format &format, uint32_t width, uint32_t height);
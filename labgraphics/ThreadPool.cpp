@@ -0,0 +1,48 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    mThreads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+        mThreads.emplace_back([this]()
+                              { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    for (auto &thread : mThreads)
+        thread.join();
+}
+
+void ThreadPool::Enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJobs.emplace_back(std::move(job));
+    }
+    mCondition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]()
+                            { return mStopping || !mJobs.empty(); });
+            // queued jobs are drained before the workers exit
+            if (mJobs.empty())
+                return;
+            job = std::move(mJobs.front());
+            mJobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads, one per hardware thread, serving a FIFO of jobs.
+// Long jobs (texture decodes) and the chunks of ParallelFor share the same workers, so nested parallel
+// work does not oversubscribe the cores.
+class ThreadPool
+{
+public:
+    static ThreadPool &Instance()
+    {
+        static ThreadPool instance(std::max(std::thread::hardware_concurrency(), 1u));
+        return instance;
+    }
+
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    template <typename Fn>
+    std::future<std::invoke_result_t<Fn>> Submit(Fn &&fn)
+    {
+        using Result = std::invoke_result_t<Fn>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> future = task->get_future();
+        Enqueue([task]()
+                { (*task)(); });
+        return future;
+    }
+
+    // fire and forget, the job must not throw
+    void Enqueue(std::function<void()> job);
+
+    uint32_t GetThreadCount() const { return (uint32_t)mThreads.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> mThreads;
+    std::deque<std::function<void()>> mJobs;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping = false;
+};
@@ -1,5 +1,27 @@
 #include "Timer.h"
-#include <SDL.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#if defined(__linux__) || defined(__APPLE__)
+#include <cerrno>
+#include <ctime>
+#endif
+#include "Logger.h"
+
+namespace
+{
+	constexpr uint64_t NS_PER_SECOND = 1000000000ull;
+	constexpr size_t PACING_HISTORY_SIZE = 512;
+
+#if defined(__linux__)
+	// generic timer slack is 50us, a few hundred microseconds of spinning absorbs the wakeup latency
+	constexpr uint64_t DEFAULT_SPIN_THRESHOLD_NS = 250000;
+#else
+	// sleeps are rounded to the scheduler tick elsewhere
+	constexpr uint64_t DEFAULT_SPIN_THRESHOLD_NS = 2000000;
+#endif
+}
 
 Timer::Timer()
 {
@@ -11,10 +33,18 @@ void Timer::Init()
 	mStartTick = 0;
 	mCurTick = 0;
 	mLastTick = 0;
+	mFrameTime = 0;
 	mDeltaTime = 0.0f;
 	mIsStop = false;
 	mLockFrameNum = -1;
-	mStartTick = SDL_GetTicks();
+	mSpinThreshold = DEFAULT_SPIN_THRESHOLD_NS;
+	mIntervals.clear();
+	mSleeps.clear();
+	mSpins.clear();
+	mNextSample = 0;
+	mLastSleep = 0;
+	mLastSpin = 0;
+	mStartTick = Now();
 }
 
 void Timer::SetLockFrameNum(uint32_t lockFrame)
@@ -22,6 +52,11 @@ void Timer::SetLockFrameNum(uint32_t lockFrame)
 	mLockFrameNum = lockFrame;
 }
 
+void Timer::SetSpinThreshold(uint32_t microseconds)
+{
+	mSpinThreshold = (uint64_t)microseconds * 1000;
+}
+
 void Timer::Stop()
 {
 	mIsStop = true;
@@ -31,16 +66,82 @@ void Timer::Resume()
 	mIsStop = false;
 }
 
-void Timer::Update()
+uint64_t Timer::Now()
+{
+#if defined(__linux__) || defined(__APPLE__)
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NS_PER_SECOND + (uint64_t)ts.tv_nsec;
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void Timer::WaitUntil(uint64_t deadline)
 {
-	mCurTick = SDL_GetTicks();
-	if (mLockFrameNum > 0)
-		while (!SDL_TICKS_PASSED(SDL_GetTicks(), mCurTick + (1.0f / mLockFrameNum) * 1000))
+	const uint64_t sleepStart = Now();
+	mLastSleep = 0;
+	mLastSpin = 0;
+	if (sleepStart >= deadline)
+		return;
+
+	if (deadline - sleepStart > mSpinThreshold)
+	{
+		const uint64_t wakeup = deadline - mSpinThreshold;
+#if defined(__linux__)
+		// absolute deadline, so a signal interruption resumes without drifting
+		timespec ts;
+		ts.tv_sec = (time_t)(wakeup / NS_PER_SECOND);
+		ts.tv_nsec = (long)(wakeup % NS_PER_SECOND);
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
 			;
+#else
+		std::this_thread::sleep_for(std::chrono::nanoseconds(wakeup - sleepStart));
+#endif
+	}
+
+	const uint64_t spinStart = Now();
+	while (Now() < deadline)
+		std::this_thread::yield();
+
+	mLastSleep = spinStart - sleepStart;
+	mLastSpin = Now() - spinStart;
+}
+
+void Timer::Update()
+{
+	if (mLockFrameNum > 0 && mLastTick != 0)
+		WaitUntil(mLastTick + NS_PER_SECOND / mLockFrameNum);
+	else
+	{
+		mLastSleep = 0;
+		mLastSpin = 0;
+	}
+
+	mCurTick = Now();
+
+	if (mLastTick != 0)
+	{
+		mFrameTime = mCurTick - mLastTick;
+
+		if (mIntervals.size() < PACING_HISTORY_SIZE)
+		{
+			mIntervals.emplace_back(mFrameTime);
+			mSleeps.emplace_back(mLastSleep);
+			mSpins.emplace_back(mLastSpin);
+		}
+		else
+		{
+			mIntervals[mNextSample] = mFrameTime;
+			mSleeps[mNextSample] = mLastSleep;
+			mSpins[mNextSample] = mLastSpin;
+		}
+		mNextSample = (mNextSample + 1) % PACING_HISTORY_SIZE;
+	}
 
 	if (!mIsStop)
 	{
-		mDeltaTime = (mCurTick - mLastTick) / 1000.0f;
+		mDeltaTime = mFrameTime / (float)NS_PER_SECOND;
 		if (mDeltaTime > 0.05f)
 			mDeltaTime = 0.05f;
 	}
@@ -52,3 +153,62 @@ float Timer::GetDeltaTime()
 {
 	return mDeltaTime;
 }
+
+uint64_t Timer::GetFrameTimeNs() const
+{
+	return mFrameTime;
+}
+
+uint64_t Timer::GetTimeNs() const
+{
+	return Now() - mStartTick;
+}
+
+FramePacingStats Timer::GetPacingStats() const
+{
+	FramePacingStats result;
+	if (mIntervals.empty())
+		return result;
+
+	const double count = (double)mIntervals.size();
+	result.count = (uint32_t)mIntervals.size();
+
+	double sum = 0.0, sleepSum = 0.0, spinSum = 0.0;
+	for (size_t i = 0; i < mIntervals.size(); ++i)
+	{
+		sum += mIntervals[i] / 1e6;
+		sleepSum += mSleeps[i] / 1e6;
+		spinSum += mSpins[i] / 1e6;
+	}
+	result.avgMs = sum / count;
+	result.avgSleepMs = sleepSum / count;
+	result.avgSpinMs = spinSum / count;
+	result.targetMs = mLockFrameNum > 0 ? 1000.0 / mLockFrameNum : result.avgMs;
+
+	double variance = 0.0;
+	std::vector<double> jitters(mIntervals.size());
+	for (size_t i = 0; i < mIntervals.size(); ++i)
+	{
+		const double intervalMs = mIntervals[i] / 1e6;
+		variance += (intervalMs - result.avgMs) * (intervalMs - result.avgMs);
+		jitters[i] = std::abs(intervalMs - result.targetMs);
+	}
+	result.stddevMs = std::sqrt(variance / count);
+
+	std::sort(jitters.begin(), jitters.end());
+	double jitterSum = 0.0;
+	for (double jitter : jitters)
+		jitterSum += jitter;
+	result.avgJitterMs = jitterSum / count;
+	result.p99JitterMs = jitters[std::min(jitters.size() - 1, (size_t)(0.99 * jitters.size()))];
+	result.maxJitterMs = jitters.back();
+
+	return result;
+}
+
+void Timer::PrintPacingStats() const
+{
+	FramePacingStats stats = GetPacingStats();
+	LOG_INFO("Frame pacing over {} frames: target {:.3f} ms, avg {:.3f} ms, stddev {:.3f} ms, jitter avg {:.3f} ms p99 {:.3f} ms max {:.3f} ms, limiter sleep {:.3f} ms spin {:.3f} ms",
+			 stats.count, stats.targetMs, stats.avgMs, stats.stddevMs, stats.avgJitterMs, stats.p99JitterMs, stats.maxJitterMs, stats.avgSleepMs, stats.avgSpinMs);
+}
@@ -1,5 +1,24 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
+#include <vector>
+
+struct FramePacingStats
+{
+	uint32_t count = 0;
+	// locked frame period, or the mean frame time when unlocked
+	double targetMs = 0.0;
+	double avgMs = 0.0;
+	double stddevMs = 0.0;
+	// jitter is the absolute deviation of a frame interval from the target
+	double avgJitterMs = 0.0;
+	double p99JitterMs = 0.0;
+	double maxJitterMs = 0.0;
+	// time spent waiting for the frame cap, split into the sleeping and the final spinning part
+	double avgSleepMs = 0.0;
+	double avgSpinMs = 0.0;
+};
+
 class Timer
 {
 public:
@@ -7,22 +26,47 @@ public:
 
 	void Init();
 
+	// Caps the frame rate, 0 or negative disables the limiter
 	void SetLockFrameNum(uint32_t lockFrame);
+	// The limiter sleeps until this long before the deadline and spins the rest, sleep wakeups are not precise
+	void SetSpinThreshold(uint32_t microseconds);
 
+	// seconds, clamped to 0.05 so simulation steps stay stable after stalls
 	float GetDeltaTime();
+	// unclamped duration of the last frame
+	uint64_t GetFrameTimeNs() const;
+	// monotonic nanoseconds since Init
+	uint64_t GetTimeNs() const;
+
+	FramePacingStats GetPacingStats() const;
+	void PrintPacingStats() const;
 
 	void Stop();
 	void Resume();
+
+	static uint64_t Now();
+
 private:
 	friend class App;
 	friend class RtxApp;
 
 	void Update();
+	void WaitUntil(uint64_t deadline);
 
 	bool mIsStop;
-	uint32_t mStartTick;
-	uint32_t mCurTick;
-	uint32_t mLastTick;
+	uint64_t mStartTick;
+	uint64_t mCurTick;
+	uint64_t mLastTick;
+	uint64_t mFrameTime;
 	float mDeltaTime;
 	int32_t mLockFrameNum;
-};
\ No newline at end of file
+	uint64_t mSpinThreshold;
+
+	// rolling window of frame intervals and limiter waits in nanoseconds
+	std::vector<uint64_t> mIntervals;
+	std::vector<uint64_t> mSleeps;
+	std::vector<uint64_t> mSpins;
+	size_t mNextSample;
+	uint64_t mLastSleep;
+	uint64_t mLastSpin;
+};
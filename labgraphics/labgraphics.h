@@ -17,11 +17,18 @@
 
 #include "App.h"
 #include "ImageData.h"
+#include "ImageProcessing.h"
 #include "Camera.h"
 #include "Scene.h"
 #include "Pass.h"
 #include "InputSystem.h"
 #include "Logger.h"
+#include "Parallel.h"
+#include "Profiler.h"
+#include "Simd.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+#include "TextureImporter.h"
 #include "Timer.h"
 #include "Window.h"
 
@@ -34,6 +41,12 @@
 #include "Graphics/VK/DescriptorPool.h"
 #include "Graphics/VK/DescriptorSetLayout.h"
 #include "Graphics/VK/DescriptorTable.h"
+#include "Graphics/VK/DescriptorAllocator.h"
+#include "Graphics/VK/BindlessTable.h"
+#include "Graphics/VK/ASBuilder.h"
+#include "Graphics/VK/ASCompactor.h"
+#include "Graphics/VK/ReadbackQueue.h"
+#include "Graphics/VK/GpuProfiler.h"
 #include "Graphics/VK/Device.h"
 #include "Graphics/VK/Enum.h"
 #include "Graphics/VK/Format.h"
@@ -12,18 +12,18 @@ static void check_vk_result(VkResult err)
 
 void SceneImgui::Init()
 {
-    mDescriptorTable = std::make_unique<DescriptorTable>(*App::Instance().GetGraphicsContext()->GetDevice());
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::SAMPLER, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::COMBINED_IMAGE_SAMPLER, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::SAMPLED_IMAGE, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::STORAGE_IMAGE, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::UNIFORM_TEXEL_BUFFER, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::STORAGE_TEXEL_BUFFER, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::UNIFORM_BUFFER, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::STORAGE_BUFFER, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::UNIFORM_BUFFER_DYNAMIC, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::STORAGE_BUFFER_DYNAMIC, 1000);
-    mDescriptorTable->GetPool()->AddPoolDesc(DescriptorType::INPUT_ATTACHMENT, 1000);
+    mDescriptorPool = std::make_unique<DescriptorPool>(*App::Instance().GetGraphicsContext()->GetDevice());
+    mDescriptorPool->AddPoolDesc(DescriptorType::SAMPLER, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::COMBINED_IMAGE_SAMPLER, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::SAMPLED_IMAGE, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::STORAGE_IMAGE, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::UNIFORM_TEXEL_BUFFER, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::STORAGE_TEXEL_BUFFER, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::UNIFORM_BUFFER, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::STORAGE_BUFFER, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::UNIFORM_BUFFER_DYNAMIC, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::STORAGE_BUFFER_DYNAMIC, 1000);
+    mDescriptorPool->AddPoolDesc(DescriptorType::INPUT_ATTACHMENT, 1000);
 
     auto inFlightFrameCount = (int32_t)App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size();
     mImguiPass = std::make_unique<RasterPass>(inFlightFrameCount);
@@ -48,7 +48,7 @@ void SceneImgui::Init()
     init_info.QueueFamily = App::Instance().GetGraphicsContext()->GetDevice()->GetQueueFamilyIndices().graphicsFamily.value();
     init_info.Queue = App::Instance().GetGraphicsContext()->GetDevice()->GetGraphicsQueue()->GetHandle();
     init_info.PipelineCache = VK_NULL_HANDLE;
-    init_info.DescriptorPool = mDescriptorTable->GetPool()->GetHandle();
+    init_info.DescriptorPool = mDescriptorPool->GetHandle();
     init_info.Allocator = nullptr;
     init_info.MinImageCount = App::Instance().GetGraphicsContext()->GetSwapChain()->GetImageViews().size();
     init_info.ImageCount = App::Instance().GetGraphicsContext()->GetSwapChain()->GetImageViews().size();
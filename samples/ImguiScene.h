@@ -19,7 +19,7 @@ private:
     bool mShowAnotherWindow = false;
     ImVec4 mClearColor = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
-    std::unique_ptr<DescriptorTable> mDescriptorTable;
+    std::unique_ptr<DescriptorPool> mDescriptorPool;
 
     std::unique_ptr<RasterPass> mImguiPass;
 };
\ No newline at end of file
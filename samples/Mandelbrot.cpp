@@ -0,0 +1,406 @@
+#include "Mandelbrot.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#if LAB_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// GCC fuses the intrinsic multiplies and adds of the FMA targets, the kernels would round differently
+// from IterateScalar and each other
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace
+{
+    using IterateFunction = void (*)(const MandelbrotUniform &uniform, const Vector2f *orbit, const Vector2f *offsets, size_t count, uint32_t *iterations);
+
+    // offsets are pixel - reference, iterations get the escape count (maxIterations inside the set)
+    void IterateScalar(const MandelbrotUniform &uniform, const Vector2f *orbit, const Vector2f *offsets, size_t count, uint32_t *iterations)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float dcx = offsets[i].x * uniform.pixelScale;
+            const float dcy = offsets[i].y * uniform.pixelScale;
+
+            float dzx = 0.0f, dzy = 0.0f;
+            if (uniform.skipIterations > 0)
+            {
+                const float ux = offsets[i].x / uniform.seriesRadius;
+                const float uy = offsets[i].y / uniform.seriesRadius;
+                const float u2x = ux * ux - uy * uy, u2y = 2.0f * ux * uy;
+                const float u3x = u2x * ux - u2y * uy, u3y = u2x * uy + u2y * ux;
+                dzx = uniform.seriesA.x * ux - uniform.seriesA.y * uy + uniform.seriesB.x * u2x - uniform.seriesB.y * u2y + uniform.seriesC.x * u3x - uniform.seriesC.y * u3y;
+                dzy = uniform.seriesA.x * uy + uniform.seriesA.y * ux + uniform.seriesB.x * u2y + uniform.seriesB.y * u2x + uniform.seriesC.x * u3y + uniform.seriesC.y * u3x;
+            }
+
+            uint32_t n = uniform.skipIterations;
+            uint32_t m = uniform.skipIterations;
+            while (n < uniform.maxIterations)
+            {
+                const float tx = 2.0f * orbit[m].x + dzx;
+                const float ty = 2.0f * orbit[m].y + dzy;
+                const float nextX = tx * dzx - ty * dzy + dcx;
+                dzy = tx * dzy + ty * dzx + dcy;
+                dzx = nextX;
+                ++m;
+                ++n;
+
+                const float zx = orbit[m].x + dzx;
+                const float zy = orbit[m].y + dzy;
+                const float r2 = zx * zx + zy * zy;
+                if (r2 > 4.0f)
+                    break;
+                if (r2 < dzx * dzx + dzy * dzy || m == uniform.orbitLength - 1)
+                {
+                    dzx = zx;
+                    dzy = zy;
+                    m = 0;
+                }
+            }
+            iterations[i] = n;
+        }
+    }
+
+#if LAB_SIMD_X86
+    LAB_TARGET_AVX2 void IterateAvx2(const MandelbrotUniform &uniform, const Vector2f *orbit, const Vector2f *offsets, size_t count, uint32_t *iterations)
+    {
+        // re and im interleaved, element m sits at float index 2m
+        const float *orbitData = &orbit[0].x;
+
+        const __m256 pixelScale = _mm256_set1_ps(uniform.pixelScale);
+        const __m256 radius = _mm256_set1_ps(uniform.seriesRadius);
+        const __m256 two = _mm256_set1_ps(2.0f);
+        const __m256 four = _mm256_set1_ps(4.0f);
+        const __m256i maxIterations = _mm256_set1_epi32((int32_t)uniform.maxIterations);
+        const __m256i last = _mm256_set1_epi32((int32_t)uniform.orbitLength - 1);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        for (size_t base = 0; base < count; base += 8)
+        {
+            const size_t laneCount = std::min<size_t>(8, count - base);
+            alignas(32) float offsetX[8] = {};
+            alignas(32) float offsetY[8] = {};
+            for (size_t lane = 0; lane < laneCount; ++lane)
+            {
+                offsetX[lane] = offsets[base + lane].x;
+                offsetY[lane] = offsets[base + lane].y;
+            }
+            const __m256 ox = _mm256_load_ps(offsetX);
+            const __m256 oy = _mm256_load_ps(offsetY);
+            const __m256 dcx = _mm256_mul_ps(ox, pixelScale);
+            const __m256 dcy = _mm256_mul_ps(oy, pixelScale);
+
+            __m256 dzx = _mm256_setzero_ps();
+            __m256 dzy = _mm256_setzero_ps();
+            if (uniform.skipIterations > 0)
+            {
+                const __m256 ux = _mm256_div_ps(ox, radius);
+                const __m256 uy = _mm256_div_ps(oy, radius);
+                const __m256 u2x = _mm256_sub_ps(_mm256_mul_ps(ux, ux), _mm256_mul_ps(uy, uy));
+                const __m256 u2y = _mm256_mul_ps(_mm256_mul_ps(two, ux), uy);
+                const __m256 u3x = _mm256_sub_ps(_mm256_mul_ps(u2x, ux), _mm256_mul_ps(u2y, uy));
+                const __m256 u3y = _mm256_add_ps(_mm256_mul_ps(u2x, uy), _mm256_mul_ps(u2y, ux));
+                const __m256 ax = _mm256_set1_ps(uniform.seriesA.x), ay = _mm256_set1_ps(uniform.seriesA.y);
+                const __m256 bx = _mm256_set1_ps(uniform.seriesB.x), by = _mm256_set1_ps(uniform.seriesB.y);
+                const __m256 cx = _mm256_set1_ps(uniform.seriesC.x), cy = _mm256_set1_ps(uniform.seriesC.y);
+                dzx = _mm256_sub_ps(_mm256_mul_ps(ax, ux), _mm256_mul_ps(ay, uy));
+                dzx = _mm256_add_ps(dzx, _mm256_mul_ps(bx, u2x));
+                dzx = _mm256_sub_ps(dzx, _mm256_mul_ps(by, u2y));
+                dzx = _mm256_add_ps(dzx, _mm256_mul_ps(cx, u3x));
+                dzx = _mm256_sub_ps(dzx, _mm256_mul_ps(cy, u3y));
+                dzy = _mm256_add_ps(_mm256_mul_ps(ax, uy), _mm256_mul_ps(ay, ux));
+                dzy = _mm256_add_ps(dzy, _mm256_mul_ps(bx, u2y));
+                dzy = _mm256_add_ps(dzy, _mm256_mul_ps(by, u2x));
+                dzy = _mm256_add_ps(dzy, _mm256_mul_ps(cx, u3y));
+                dzy = _mm256_add_ps(dzy, _mm256_mul_ps(cy, u3x));
+            }
+
+            __m256i n = _mm256_set1_epi32((int32_t)uniform.skipIterations);
+            __m256i m = n;
+            // all ones in the lanes still iterating
+            __m256i active = _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_set1_epi32((int32_t)laneCount), laneIndex), _mm256_cmpgt_epi32(maxIterations, n));
+            // Z_m, carried over from the previous iteration so only Z_m+1 is gathered
+            __m256 refX = _mm256_set1_ps(orbit[uniform.skipIterations].x);
+            __m256 refY = _mm256_set1_ps(orbit[uniform.skipIterations].y);
+
+            while (!_mm256_testz_si256(active, active))
+            {
+                // dz = (2Z + dz) dz + dc, in the operation order of IterateScalar so both round alike
+                const __m256 tx = _mm256_add_ps(_mm256_mul_ps(two, refX), dzx);
+                const __m256 ty = _mm256_add_ps(_mm256_mul_ps(two, refY), dzy);
+                const __m256 nextDzx = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(tx, dzx), _mm256_mul_ps(ty, dzy)), dcx);
+                const __m256 nextDzy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, dzy), _mm256_mul_ps(ty, dzx)), dcy);
+                // finished lanes may sit on the last orbit entry, keep their gather in bounds
+                const __m256i nextM = _mm256_min_epi32(_mm256_add_epi32(m, one), last);
+
+                const __m256i nextIndex = _mm256_slli_epi32(nextM, 1);
+                const __m256 nextRefX = _mm256_i32gather_ps(orbitData, nextIndex, 4);
+                const __m256 nextRefY = _mm256_i32gather_ps(orbitData + 1, nextIndex, 4);
+                const __m256 zx = _mm256_add_ps(nextRefX, nextDzx);
+                const __m256 zy = _mm256_add_ps(nextRefY, nextDzy);
+                const __m256 r2 = _mm256_add_ps(_mm256_mul_ps(zx, zx), _mm256_mul_ps(zy, zy));
+
+                const __m256 activeMask = _mm256_castsi256_ps(active);
+                dzx = _mm256_blendv_ps(dzx, nextDzx, activeMask);
+                dzy = _mm256_blendv_ps(dzy, nextDzy, activeMask);
+                refX = _mm256_blendv_ps(refX, nextRefX, activeMask);
+                refY = _mm256_blendv_ps(refY, nextRefY, activeMask);
+                m = _mm256_blendv_epi8(m, nextM, active);
+                // active lanes hold -1
+                n = _mm256_sub_epi32(n, active);
+
+                const __m256i escaped = _mm256_castps_si256(_mm256_cmp_ps(r2, four, _CMP_GT_OQ));
+                active = _mm256_andnot_si256(escaped, active);
+
+                // rebased lanes restart at Z_0 = 0
+                const __m256 dz2 = _mm256_add_ps(_mm256_mul_ps(nextDzx, nextDzx), _mm256_mul_ps(nextDzy, nextDzy));
+                const __m256i rebase = _mm256_and_si256(active, _mm256_or_si256(_mm256_castps_si256(_mm256_cmp_ps(r2, dz2, _CMP_LT_OQ)), _mm256_cmpeq_epi32(m, last)));
+                const __m256 rebaseMask = _mm256_castsi256_ps(rebase);
+                dzx = _mm256_blendv_ps(dzx, zx, rebaseMask);
+                dzy = _mm256_blendv_ps(dzy, zy, rebaseMask);
+                refX = _mm256_andnot_ps(rebaseMask, refX);
+                refY = _mm256_andnot_ps(rebaseMask, refY);
+                m = _mm256_andnot_si256(rebase, m);
+
+                active = _mm256_and_si256(active, _mm256_cmpgt_epi32(maxIterations, n));
+            }
+
+            alignas(32) uint32_t result[8];
+            _mm256_store_si256((__m256i *)result, n);
+            std::copy(result, result + laneCount, iterations + base);
+        }
+    }
+
+    LAB_TARGET_AVX512 void IterateAvx512(const MandelbrotUniform &uniform, const Vector2f *orbit, const Vector2f *offsets, size_t count, uint32_t *iterations)
+    {
+        const float *orbitData = &orbit[0].x;
+
+        const __m512 pixelScale = _mm512_set1_ps(uniform.pixelScale);
+        const __m512 radius = _mm512_set1_ps(uniform.seriesRadius);
+        const __m512 two = _mm512_set1_ps(2.0f);
+        const __m512 four = _mm512_set1_ps(4.0f);
+        const __m512i maxIterations = _mm512_set1_epi32((int32_t)uniform.maxIterations);
+        const __m512i last = _mm512_set1_epi32((int32_t)uniform.orbitLength - 1);
+        const __m512i one = _mm512_set1_epi32(1);
+
+        for (size_t base = 0; base < count; base += 16)
+        {
+            const size_t laneCount = std::min<size_t>(16, count - base);
+            alignas(64) float offsetX[16] = {};
+            alignas(64) float offsetY[16] = {};
+            for (size_t lane = 0; lane < laneCount; ++lane)
+            {
+                offsetX[lane] = offsets[base + lane].x;
+                offsetY[lane] = offsets[base + lane].y;
+            }
+            const __m512 ox = _mm512_load_ps(offsetX);
+            const __m512 oy = _mm512_load_ps(offsetY);
+            const __m512 dcx = _mm512_mul_ps(ox, pixelScale);
+            const __m512 dcy = _mm512_mul_ps(oy, pixelScale);
+
+            __m512 dzx = _mm512_setzero_ps();
+            __m512 dzy = _mm512_setzero_ps();
+            if (uniform.skipIterations > 0)
+            {
+                const __m512 ux = _mm512_div_ps(ox, radius);
+                const __m512 uy = _mm512_div_ps(oy, radius);
+                const __m512 u2x = _mm512_sub_ps(_mm512_mul_ps(ux, ux), _mm512_mul_ps(uy, uy));
+                const __m512 u2y = _mm512_mul_ps(_mm512_mul_ps(two, ux), uy);
+                const __m512 u3x = _mm512_sub_ps(_mm512_mul_ps(u2x, ux), _mm512_mul_ps(u2y, uy));
+                const __m512 u3y = _mm512_add_ps(_mm512_mul_ps(u2x, uy), _mm512_mul_ps(u2y, ux));
+                const __m512 ax = _mm512_set1_ps(uniform.seriesA.x), ay = _mm512_set1_ps(uniform.seriesA.y);
+                const __m512 bx = _mm512_set1_ps(uniform.seriesB.x), by = _mm512_set1_ps(uniform.seriesB.y);
+                const __m512 cx = _mm512_set1_ps(uniform.seriesC.x), cy = _mm512_set1_ps(uniform.seriesC.y);
+                dzx = _mm512_sub_ps(_mm512_mul_ps(ax, ux), _mm512_mul_ps(ay, uy));
+                dzx = _mm512_add_ps(dzx, _mm512_mul_ps(bx, u2x));
+                dzx = _mm512_sub_ps(dzx, _mm512_mul_ps(by, u2y));
+                dzx = _mm512_add_ps(dzx, _mm512_mul_ps(cx, u3x));
+                dzx = _mm512_sub_ps(dzx, _mm512_mul_ps(cy, u3y));
+                dzy = _mm512_add_ps(_mm512_mul_ps(ax, uy), _mm512_mul_ps(ay, ux));
+                dzy = _mm512_add_ps(dzy, _mm512_mul_ps(bx, u2y));
+                dzy = _mm512_add_ps(dzy, _mm512_mul_ps(by, u2x));
+                dzy = _mm512_add_ps(dzy, _mm512_mul_ps(cx, u3y));
+                dzy = _mm512_add_ps(dzy, _mm512_mul_ps(cy, u3x));
+            }
+
+            __m512i n = _mm512_set1_epi32((int32_t)uniform.skipIterations);
+            __m512i m = n;
+            __mmask16 active = (__mmask16)((1u << laneCount) - 1) & _mm512_cmplt_epi32_mask(n, maxIterations);
+            __m512 refX = _mm512_set1_ps(orbit[uniform.skipIterations].x);
+            __m512 refY = _mm512_set1_ps(orbit[uniform.skipIterations].y);
+
+            while (active != 0)
+            {
+                const __m512 tx = _mm512_add_ps(_mm512_mul_ps(two, refX), dzx);
+                const __m512 ty = _mm512_add_ps(_mm512_mul_ps(two, refY), dzy);
+                const __m512 nextDzx = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(tx, dzx), _mm512_mul_ps(ty, dzy)), dcx);
+                const __m512 nextDzy = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(tx, dzy), _mm512_mul_ps(ty, dzx)), dcy);
+                const __m512i nextM = _mm512_min_epi32(_mm512_add_epi32(m, one), last);
+
+                const __m512i nextIndex = _mm512_slli_epi32(nextM, 1);
+                const __m512 nextRefX = _mm512_i32gather_ps(nextIndex, orbitData, 4);
+                const __m512 nextRefY = _mm512_i32gather_ps(nextIndex, orbitData + 1, 4);
+                const __m512 zx = _mm512_add_ps(nextRefX, nextDzx);
+                const __m512 zy = _mm512_add_ps(nextRefY, nextDzy);
+                const __m512 r2 = _mm512_add_ps(_mm512_mul_ps(zx, zx), _mm512_mul_ps(zy, zy));
+
+                dzx = _mm512_mask_blend_ps(active, dzx, nextDzx);
+                dzy = _mm512_mask_blend_ps(active, dzy, nextDzy);
+                refX = _mm512_mask_blend_ps(active, refX, nextRefX);
+                refY = _mm512_mask_blend_ps(active, refY, nextRefY);
+                m = _mm512_mask_blend_epi32(active, m, nextM);
+                n = _mm512_mask_add_epi32(n, active, n, one);
+
+                active &= (__mmask16)~_mm512_cmp_ps_mask(r2, four, _CMP_GT_OQ);
+
+                const __m512 dz2 = _mm512_add_ps(_mm512_mul_ps(nextDzx, nextDzx), _mm512_mul_ps(nextDzy, nextDzy));
+                const __mmask16 rebase = active & (_mm512_cmp_ps_mask(r2, dz2, _CMP_LT_OQ) | _mm512_cmpeq_epi32_mask(m, last));
+                dzx = _mm512_mask_blend_ps(rebase, dzx, zx);
+                dzy = _mm512_mask_blend_ps(rebase, dzy, zy);
+                refX = _mm512_mask_mov_ps(refX, rebase, _mm512_setzero_ps());
+                refY = _mm512_mask_mov_ps(refY, rebase, _mm512_setzero_ps());
+                m = _mm512_mask_mov_epi32(m, rebase, _mm512_setzero_si512());
+
+                active &= _mm512_cmplt_epi32_mask(n, maxIterations);
+            }
+
+            alignas(64) uint32_t result[16];
+            _mm512_store_si512(result, n);
+            std::copy(result, result + laneCount, iterations + base);
+        }
+    }
+#endif
+
+    IterateFunction GetIterateFunction(SimdLevel level)
+    {
+#if LAB_SIMD_X86
+        if (level == SimdLevel::AVX512)
+            return IterateAvx512;
+        if (level == SimdLevel::AVX2)
+            return IterateAvx2;
+#endif
+        return IterateScalar;
+    }
+
+    int32_t FloorDiv(int32_t a, int32_t b)
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+}
+
+MandelbrotReference BuildMandelbrotReference(std::complex<long double> c, long double radius, uint32_t maxIterations)
+{
+    std::vector<std::complex<long double>> orbit;
+    orbit.reserve(maxIterations + 1);
+    orbit.emplace_back(0.0L);
+    std::complex<long double> z = 0.0L;
+    for (uint32_t i = 0; i < maxIterations; ++i)
+    {
+        z = z * z + c;
+        orbit.emplace_back(z);
+        if (std::norm(z) > 4.0L)
+            break;
+    }
+
+    MandelbrotReference reference;
+    for (const auto &value : orbit)
+        reference.orbit.emplace_back((float)value.real(), (float)value.imag());
+
+    // a_n = A_n r, b_n = B_n r^2, c_n = C_n r^3. Used while the dropped terms are negligible and no
+    // pixel within the radius can have escaped yet.
+    std::complex<long double> a = 0.0L, b = 0.0L, c3 = 0.0L;
+    for (size_t n = 0; n + 2 < orbit.size(); ++n)
+    {
+        const std::complex<long double> twoZ = 2.0L * orbit[n];
+        const std::complex<long double> nextA = twoZ * a + radius;
+        const std::complex<long double> nextB = twoZ * b + a * a;
+        const std::complex<long double> nextC = twoZ * c3 + 2.0L * a * b;
+        if (std::abs(nextC) > 1e-3L * std::abs(nextB) || std::abs(orbit[n + 1]) + std::abs(nextA) > 2.0L)
+            break;
+        a = nextA;
+        b = nextB;
+        c3 = nextC;
+        reference.skipIterations = (uint32_t)n + 1;
+    }
+
+    reference.seriesA = Vector2f((float)a.real(), (float)a.imag());
+    reference.seriesB = Vector2f((float)b.real(), (float)b.imag());
+    reference.seriesC = Vector2f((float)c3.real(), (float)c3.imag());
+    return reference;
+}
+
+uint32_t GetMandelbrotColor(uint32_t iterations, uint32_t maxIterations)
+{
+    const float t = iterations >= maxIterations ? 1.0f : (float)iterations / PALETTE_PERIOD;
+    const float d[3] = {0.3f, 0.3f, 0.5f};
+    const float e[3] = {-0.2f, -0.3f, -0.5f};
+    const float f[3] = {2.1f, 2.0f, 3.0f};
+    const float g[3] = {0.0f, 0.1f, 0.0f};
+    // alpha 255
+    uint32_t color = 0xff000000u;
+    for (int i = 0; i < 3; ++i)
+    {
+        const float value = d[i] + e[i] * std::cos(6.28318f * (f[i] * t + g[i]));
+        // float to unorm conversion of the storage image, round to nearest
+        color |= (uint32_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f) << (8 * i);
+    }
+    return color;
+}
+
+MandelbrotCpuRenderer::MandelbrotCpuRenderer(SimdLevel level)
+    : mLevel(std::min(level, GetSimdLevel()))
+{
+}
+
+uint64_t MandelbrotCpuRenderer::Render(const MandelbrotUniform &uniform, const Vector2f *orbit, const std::vector<MandelbrotTileJob> &jobs, uint32_t *image,
+                                       uint32_t threadCount) const
+{
+    const IterateFunction iterate = GetIterateFunction(mLevel);
+    const int32_t bufferWidth = (int32_t)uniform.bufferWidth;
+    const int32_t bufferHeight = (int32_t)uniform.bufferHeight;
+
+    std::atomic<uint64_t> totalIterations{0};
+    ParallelForStealing(0, jobs.size(), [&](size_t jobIndex)
+                        {
+                            const MandelbrotTileJob &job = jobs[jobIndex];
+                            const uint32_t sampleCount = uniform.tileSize / job.step;
+
+                            std::vector<Vector2i32> locals;
+                            std::vector<Vector2f> offsets;
+                            locals.reserve(sampleCount * sampleCount);
+                            offsets.reserve(sampleCount * sampleCount);
+                            for (uint32_t y = 0; y < sampleCount; ++y)
+                                for (uint32_t x = 0; x < sampleCount; ++x)
+                                {
+                                    const Vector2i32 local((int32_t)(x * job.step), (int32_t)(y * job.step));
+                                    if (job.previousStep != 0 && local.x % job.previousStep == 0 && local.y % job.previousStep == 0)
+                                        continue;
+                                    locals.emplace_back(local);
+                                    const Vector2i32 offset = job.origin + local - uniform.referencePixel;
+                                    offsets.emplace_back((float)offset.x, (float)offset.y);
+                                }
+
+                            std::vector<uint32_t> iterations(offsets.size());
+                            iterate(uniform, orbit, offsets.data(), offsets.size(), iterations.data());
+
+                            uint64_t jobIterations = 0;
+                            for (size_t i = 0; i < locals.size(); ++i)
+                            {
+                                jobIterations += iterations[i] - uniform.skipIterations;
+                                const uint32_t color = GetMandelbrotColor(iterations[i], uniform.maxIterations);
+
+                                // the tile never straddles the wrap, only its origin needs wrapping
+                                const Vector2i32 pixel = job.origin + locals[i];
+                                const int32_t slotX = pixel.x - FloorDiv(pixel.x, bufferWidth) * bufferWidth;
+                                const int32_t slotY = pixel.y - FloorDiv(pixel.y, bufferHeight) * bufferHeight;
+                                for (uint32_t y = 0; y < job.step; ++y)
+                                    for (uint32_t x = 0; x < job.step; ++x)
+                                        image[(size_t)(slotY + y) * bufferWidth + slotX + x] = color;
+                            }
+                            totalIterations += jobIterations; },
+                        threadCount);
+    return totalIterations;
+}
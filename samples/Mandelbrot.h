@@ -0,0 +1,83 @@
+#pragma once
+#include <complex>
+#include <cstdint>
+#include <vector>
+#include "labgraphics.h"
+
+constexpr uint32_t WORKGROUP_SIZE = 8;
+// the image is rendered and invalidated in square tiles of this many pixels
+constexpr uint32_t TILE_SIZE = 64;
+// first pass of a tile, one sample per COARSE_STEP x COARSE_STEP block, halved every pass down to 1
+constexpr uint32_t COARSE_STEP = 8;
+// escape counts per cycle of the color palette
+constexpr uint32_t PALETTE_PERIOD = 128;
+
+// std140, mandelbrot-set.comp and post.frag, buffer is the wrapped rgba8 image
+struct MandelbrotUniform
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t bufferWidth;
+    uint32_t bufferHeight;
+    // global pixel at the top left of the screen, the buffer holds global pixel p at p mod buffer size
+    Vector2i32 origin;
+    Vector2i32 referencePixel;
+    // series coefficients scaled by seriesRadius * pixelScale to the power of their order
+    Vector2f seriesA;
+    Vector2f seriesB;
+    Vector2f seriesC;
+    float pixelScale;
+    // in pixels, no rendered pixel is further from the reference
+    float seriesRadius;
+    uint32_t maxIterations;
+    uint32_t orbitLength;
+    uint32_t skipIterations;
+    uint32_t tileSize;
+};
+
+// one pass over a tile, std430
+struct MandelbrotTileJob
+{
+    Vector2i32 origin;
+    uint32_t step;
+    // samples on this grid are done already, 0 renders every sample
+    uint32_t previousStep;
+};
+
+// Reference orbit Z_0..Z_n of c, iterated in long double until it escapes or reaches maxIterations, and the
+// third order series dz_n = A_n dc + B_n dc^2 + C_n dc^3 up to the last iteration it stays accurate for
+// every |dc| <= radius. The coefficients are scaled by radius to the power of their order, so float holds
+// them at any zoom depth.
+struct MandelbrotReference
+{
+    std::vector<Vector2f> orbit;
+    Vector2f seriesA;
+    Vector2f seriesB;
+    Vector2f seriesC;
+    uint32_t skipIterations = 0;
+};
+
+MandelbrotReference BuildMandelbrotReference(std::complex<long double> c, long double radius, uint32_t maxIterations);
+
+// palette of mandelbrot-set.comp, packed like its rgba8 image with red in the low byte
+uint32_t GetMandelbrotColor(uint32_t iterations, uint32_t maxIterations);
+
+// The escape time iteration of mandelbrot-set.comp on the CPU: float deltas against the reference orbit,
+// rebased the same way, 8 (AVX2) or 16 (AVX-512) samples per instruction with finished lanes masked off
+// until the whole batch is done. Tiles are spread over the thread pool with work stealing, a tile on the
+// set boundary costs orders of magnitude more than one outside it.
+class MandelbrotCpuRenderer
+{
+public:
+    explicit MandelbrotCpuRenderer(SimdLevel level = GetSimdLevel());
+
+    SimdLevel GetLevel() const { return mLevel; }
+
+    // Writes the jobs into image, laid out like the compute image (tightly packed rgba8 rows of the wrapped
+    // bufferWidth x bufferHeight image), and returns the iterations it ran, the skipped ones excluded.
+    uint64_t Render(const MandelbrotUniform &uniform, const Vector2f *orbit, const std::vector<MandelbrotTileJob> &jobs, uint32_t *image,
+                    uint32_t threadCount = 0) const;
+
+private:
+    SimdLevel mLevel;
+};
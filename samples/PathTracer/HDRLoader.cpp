@@ -42,8 +42,9 @@ int LowerBound(const float *array, int lower, int upper, const float value)
 
 void buildDistributions(HDRData *res)
 {
-    int width = res->width;
-    int height = res->height;
+    int width = res->cols.GetWidth();
+    int height = res->cols.GetHeight();
+    const float *cols = res->cols.GetPixels<float>();
 
     auto pdf2D = new float[width * height];
     auto cdf2D = new float[width * height];
@@ -51,8 +52,10 @@ void buildDistributions(HDRData *res)
     auto pdf1D = new float[height];
     auto cdf1D = new float[height];
 
-    res->marginalDistData = new Vector3f[width * height];
-    res->conditionalDistData = new Vector3f[width * height];
+    res->marginalDistData = ImageData(ImageDataType::RGB32F, width, height);
+    res->conditionalDistData = ImageData(ImageDataType::RGB32F, width, height);
+    auto marginalDistData = res->marginalDistData.GetPixels<Vector3f>();
+    auto conditionalDistData = res->conditionalDistData.GetPixels<Vector3f>();
 
     float colWeightSum = 0.0f;
 
@@ -62,17 +65,17 @@ void buildDistributions(HDRData *res)
 
         for (int i = 0; i < width; ++i)
         {
-            float weight = Luminance(Vector3f(res->cols[j * width * 3 + i * 3 + 0],
-                                               res->cols[j * width * 3 + i * 3 + 1],
-                                               res->cols[j * width * 3 + i * 3 + 2]));
+            float weight = Luminance(Vector3f(cols[j * width * 3 + i * 3 + 0],
+                                               cols[j * width * 3 + i * 3 + 1],
+                                               cols[j * width * 3 + i * 3 + 2]));
 
             rowWeightSum += weight;
 
             pdf2D[j * width + i] = weight;
             cdf2D[j * width + i] = rowWeightSum;
 
-            res->conditionalDistData[j * width + i] = Vector3f::ZERO;
-            res->marginalDistData[j * width + i] = Vector3f::ZERO;
+            conditionalDistData[j * width + i] = Vector3f::ZERO;
+            marginalDistData[j * width + i] = Vector3f::ZERO;
         }
 
         /* Convert to range 0,1 */
@@ -100,8 +103,8 @@ void buildDistributions(HDRData *res)
     {
         float invHeight = static_cast<float>(i + 1) / height;
         float row = LowerBound(cdf1D, 0, height, invHeight);
-        res->marginalDistData[i * width].x = row / static_cast<float>(height);
-        res->marginalDistData[i * width].y = pdf1D[i];
+        marginalDistData[i * width].x = row / static_cast<float>(height);
+        marginalDistData[i * width].y = pdf1D[i];
     }
 
     for (int j = 0; j < height; j++)
@@ -110,8 +113,8 @@ void buildDistributions(HDRData *res)
         {
             float invWidth = static_cast<float>(i + 1) / width;
             float col = LowerBound(cdf2D, j * width, (j + 1) * width, invWidth) - j * width;
-            res->conditionalDistData[j * width + i].x = col / static_cast<float>(width);
-            res->conditionalDistData[j * width + i].y = pdf2D[j * width + i];
+            conditionalDistData[j * width + i].x = col / static_cast<float>(width);
+            conditionalDistData[j * width + i].y = pdf2D[j * width + i];
         }
     }
 
@@ -121,7 +124,7 @@ void buildDistributions(HDRData *res)
     delete[] cdf1D;
 }
 
-HDRData *LoadHDR(const char *fileName)
+std::unique_ptr<HDRData> LoadHDR(const char *fileName)
 {
     int i;
     char str[200];
@@ -131,8 +134,6 @@ HDRData *LoadHDR(const char *fileName)
     if (!file)
         return nullptr;
 
-    auto res = new HDRData;
-
     fread(str, 10, 1, file);
     if (memcmp(str, "#?RADIANCE", 10))
     {
@@ -171,32 +172,25 @@ HDRData *LoadHDR(const char *fileName)
         return nullptr;
     }
 
-    res->width = w;
-    res->height = h;
-
-    auto cols = new float[w * h * 3];
-    res->cols = cols;
+    // decoded straight into the image the scene takes over
+    auto res = std::make_unique<HDRData>();
+    res->cols = ImageData(ImageDataType::RGB32F, w, h);
+    auto cols = res->cols.GetPixels<float>();
 
-    auto scanline = new RGBE[w];
-    if (!scanline)
-    {
-        fclose(file);
-        return nullptr;
-    }
+    auto scanline = std::make_unique<RGBE[]>(w);
 
     // convert image
     for (int y = h - 1; y >= 0; y--)
     {
-        if (decrunch(scanline, w, file) == false)
+        if (decrunch(scanline.get(), w, file) == false)
             break;
-        workOnRGBE(scanline, w, cols);
+        workOnRGBE(scanline.get(), w, cols);
         cols += w * 3;
     }
 
-    delete[] scanline;
     fclose(file);
 
-    buildDistributions(res);
+    buildDistributions(res.get());
     return res;
 }
 
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 #include <array>
 
 #include "VK/Device.h"
@@ -15,19 +16,32 @@
 #include "VK/Shader.h"
 #include "VK/Buffer.h"
 #include "VK/DescriptorSetLayout.h"
-#include "VK/DescriptorPool.h"
+#include "VK/DescriptorSet.h"
 #include "Logger.h"
+#include "Profiler.h"
+
+namespace
+{
+	// workgroup size of the denoiser shaders
+	constexpr uint32_t DENOISER_TILE_SIZE = 16;
+}
 
 PostProcessPass::PostProcessPass(const SwapChain &swapChain,
 								 Device &device,
 								 const Image2D &inputImage,
+								 const Image2D &accumulationImage,
+								 const Image2D &momentsImage,
 								 const Image2D &normalsImage,
 								 const Image2D &positionsImage) : swapChain(swapChain), mDevice(device),
 																  mInputImage(inputImage),
 																  mNormalsImage(normalsImage),
-																  mPositionsImage(positionsImage)
+																  mPositionsImage(positionsImage),
+																  mAccumulationImage(accumulationImage),
+																  mMomentsImage(momentsImage)
 {
 	mComputeCommandBuffer = device.GetComputeCommandPool()->CreatePrimaryCommandBuffer();
+	// the command buffer is recorded once and resubmitted, a single query slot is enough
+	mGpuProfiler = std::make_unique<GpuProfiler>(device, "PostProcessPass", 1);
 
 	const auto extent = swapChain.GetExtent();
 	const auto outputFormat = swapChain.GetFormat();
@@ -54,10 +68,48 @@ PostProcessPass::PostProcessPass(const SwapChain &swapChain,
 	mPipelineLayout = std::make_unique<PipelineLayout>(device);
 	mPipelineLayout->AddDescriptorSetLayout(mDescriptorTable->GetLayout());
 
+	for (auto &image : mDenoiserImages)
+		image = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, Format::R32G32B32A32_SFLOAT, ImageTiling::OPTIMAL, ImageUsage::STORAGE);
+
+	mDenoiserTable = std::make_unique<DescriptorTable>(device);
+	mDenoiserTable->AddLayoutBinding(0, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+		.AddLayoutBinding(1, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+		.AddLayoutBinding(2, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+		.AddLayoutBinding(3, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+		.AddLayoutBinding(4, 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::COMPUTE)
+		.AddLayoutBinding(5, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+		.AddLayoutBinding(6, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+		.AddLayoutBinding(7, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE);
+
+	// pass 0 is the variance pass, pass i + 1 the a-trous iteration i
+	mDenoiserSets = mDenoiserTable->AllocateDescriptorSets(MAX_DENOISER_ITERATIONS + 1);
+	for (uint32_t pass = 0; pass <= MAX_DENOISER_ITERATIONS; ++pass)
+	{
+		mDenoiserUniformBuffers.emplace_back(mDevice.CreateUniformBuffer<Uniforms::Compute>());
+
+		// the variance pass writes image 0, iteration i reads image i % 2 and writes the other one
+		const uint32_t source = pass == 0 ? 1 : (pass - 1) % 2;
+		mDenoiserSets[pass]->WriteImage(0, mDenoiserImages[source]->GetView(), ImageLayout::GENERAL) // Input color and variance
+			.WriteImage(1, mDenoiserImages[1 - source]->GetView(), ImageLayout::GENERAL)			 // Output color and variance
+			.WriteImage(2, mNormalsImage.GetView(), ImageLayout::GENERAL)							 // Normals image
+			.WriteImage(3, mPositionsImage.GetView(), ImageLayout::GENERAL)							 // Positions image
+			.WriteBuffer(4, mDenoiserUniformBuffers[pass].get(), 0, sizeof(Uniforms::Compute))		 // Uniforms descriptor
+			.WriteImage(5, mAccumulationImage.GetView(), ImageLayout::GENERAL)						 // Accumulation image
+			.WriteImage(6, mMomentsImage.GetView(), ImageLayout::GENERAL)							 // Luminance moments image
+			.WriteImage(7, mOutputImage->GetView(), ImageLayout::GENERAL)							 // Display output image
+			.Update();
+	}
+
+	mDenoiserPipelineLayout = std::make_unique<PipelineLayout>(device);
+	mDenoiserPipelineLayout->AddDescriptorSetLayout(mDenoiserTable->GetLayout());
+
+	mVariancePipeline = std::make_unique<ComputePipeline>(device);
+	mVariancePipeline->SetShader(device.CreateShader(ShaderStage::COMPUTE, ReadBinary("DenoiserVariance.comp.spv"))).SetPipelineLayout(mDenoiserPipelineLayout.get());
+
 	mPipelines.resize(3);
 
 	mPipelines[0] = std::make_unique<ComputePipeline>(device);
-	mPipelines[0]->SetShader(device.CreateShader(ShaderStage::COMPUTE, ReadBinary("Denoiser.comp.spv"))).SetPipelineLayout(mPipelineLayout.get());
+	mPipelines[0]->SetShader(device.CreateShader(ShaderStage::COMPUTE, ReadBinary("Denoiser.comp.spv"))).SetPipelineLayout(mDenoiserPipelineLayout.get());
 
 	mPipelines[1] = std::make_unique<ComputePipeline>(device);
 	mPipelines[1]->SetShader(device.CreateShader(ShaderStage::COMPUTE, ReadBinary("Edgedetect.comp.spv"))).SetPipelineLayout(mPipelineLayout.get());
@@ -70,28 +122,98 @@ PostProcessPass::~PostProcessPass()
 {
 }
 
+void PostProcessPass::SetDenoiserSettings(const DenoiserSettings &settings)
+{
+	mDenoiserSettings = settings;
+	mDenoiserSettings.iterations = std::clamp(settings.iterations, 1u, MAX_DENOISER_ITERATIONS);
+	mDenoiserDirty = true;
+}
+
 void PostProcessPass::Process(int32_t shaderId)
 {
-	if (shaderId != mCurrentShader)
+	PROFILE_SCOPE("PostProcessPass::Process");
+
+	const bool denoiser = shaderId == (int32_t)PostProcessType::DENOISER;
+	if (shaderId != mCurrentShader || (denoiser && mDenoiserDirty))
 	{
 		mCurrentShader = shaderId;
 
 		mDevice.GetComputeQueue()->WaitIdle();
 
+		if (denoiser)
+			UpdateDenoiserUniforms();
+
 		const auto extent = swapChain.GetExtent();
 
 		mComputeCommandBuffer->Record([&]()
 									  {
+			mGpuProfiler->BeginFrame(mComputeCommandBuffer.get(), 0);
+			GpuProfileScope scope(mGpuProfiler.get(), mComputeCommandBuffer.get(), "Dispatch");
+
+			// the inputs were written by the ray tracer, their contents have to survive the barrier
 			mComputeCommandBuffer->ImageBarrier(mOutputImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mOutputImage->GetView()->GetSubresourceRange());
-			mComputeCommandBuffer->ImageBarrier(mNormalsImage.GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mNormalsImage.GetView()->GetSubresourceRange());
-			mComputeCommandBuffer->ImageBarrier(mPositionsImage.GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mPositionsImage.GetView()->GetSubresourceRange());
-			mComputeCommandBuffer->ImageBarrier(mInputImage.GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mInputImage.GetView()->GetSubresourceRange());
+			mComputeCommandBuffer->ImageBarrier(mNormalsImage.GetHandle(),Access::SHADER_WRITE,Access::SHADER_READ,ImageLayout::GENERAL,ImageLayout::GENERAL,mNormalsImage.GetView()->GetSubresourceRange());
+			mComputeCommandBuffer->ImageBarrier(mPositionsImage.GetHandle(),Access::SHADER_WRITE,Access::SHADER_READ,ImageLayout::GENERAL,ImageLayout::GENERAL,mPositionsImage.GetView()->GetSubresourceRange());
+			mComputeCommandBuffer->ImageBarrier(mInputImage.GetHandle(),Access::SHADER_WRITE,Access::SHADER_READ,ImageLayout::GENERAL,ImageLayout::GENERAL,mInputImage.GetView()->GetSubresourceRange());
+
+			if (mCurrentShader == (int32_t)PostProcessType::DENOISER)
+				RecordDenoiser();
+			else
+			{
+				mComputeCommandBuffer->BindPipeline(mPipelines[mCurrentShader].get());
+				mComputeCommandBuffer->BindDescriptorSets(mPipelineLayout.get(),0,{mDescriptorSet});
+
+				mComputeCommandBuffer->Dispatch(extent.x/32, extent.y/32, 1);
+			} });
+	}
 
-			mComputeCommandBuffer->BindPipeline(mPipelines[mCurrentShader].get());
-			mComputeCommandBuffer->BindDescriptorSets(mPipelineLayout.get(),0,{mDescriptorSet});
+	// results of the previous submission, skipped while it is still in flight
+	mGpuProfiler->Collect(0);
+	mComputeCommandBuffer->Submit({PipelineStage::COMPUTE_SHADER});
+	mGpuProfiler->EndFrame(0);
+}
 
-			mComputeCommandBuffer->Dispatch(extent.x/32, extent.y/32, 1); });
+void PostProcessPass::UpdateDenoiserUniforms()
+{
+	for (uint32_t pass = 0; pass <= mDenoiserSettings.iterations; ++pass)
+	{
+		Uniforms::Compute uniform{};
+		uniform.iteration = pass == 0 ? 0 : pass - 1;
+		uniform.colorPhi = mDenoiserSettings.colorPhi;
+		uniform.normalPhi = mDenoiserSettings.normalPhi;
+		uniform.positionPhi = mDenoiserSettings.positionPhi;
+		uniform.stepWidth = pass == 0 ? 0.0f : float(1u << (pass - 1));
+		uniform.iterationCount = mDenoiserSettings.iterations;
+		mDenoiserUniformBuffers[pass]->Set(uniform);
 	}
+	mDenoiserDirty = false;
+}
 
-	mComputeCommandBuffer->Submit({PipelineStage::COMPUTE_SHADER});
-}
\ No newline at end of file
+void PostProcessPass::RecordDenoiser()
+{
+	const auto extent = swapChain.GetExtent();
+	const uint32_t groupCountX = (extent.x + DENOISER_TILE_SIZE - 1) / DENOISER_TILE_SIZE;
+	const uint32_t groupCountY = (extent.y + DENOISER_TILE_SIZE - 1) / DENOISER_TILE_SIZE;
+
+	mComputeCommandBuffer->ImageBarrier(mAccumulationImage.GetHandle(), Access::SHADER_WRITE, Access::SHADER_READ, ImageLayout::GENERAL, ImageLayout::GENERAL, mAccumulationImage.GetView()->GetSubresourceRange());
+	mComputeCommandBuffer->ImageBarrier(mMomentsImage.GetHandle(), Access::SHADER_WRITE, Access::SHADER_READ, ImageLayout::GENERAL, ImageLayout::GENERAL, mMomentsImage.GetView()->GetSubresourceRange());
+	for (const auto &image : mDenoiserImages)
+		mComputeCommandBuffer->ImageBarrier(image->GetHandle(), Access::NONE, Access::SHADER_WRITE, ImageLayout::UNDEFINED, ImageLayout::GENERAL, image->GetView()->GetSubresourceRange());
+
+	{
+		GpuProfileScope scope(mGpuProfiler.get(), mComputeCommandBuffer.get(), "Variance");
+		mComputeCommandBuffer->BindPipeline(mVariancePipeline.get());
+		mComputeCommandBuffer->BindDescriptorSets(mDenoiserPipelineLayout.get(), 0, {mDenoiserSets[0]});
+		mComputeCommandBuffer->Dispatch(groupCountX, groupCountY, 1);
+	}
+
+	GpuProfileScope scope(mGpuProfiler.get(), mComputeCommandBuffer.get(), "A-trous");
+	mComputeCommandBuffer->BindPipeline(mPipelines[(int32_t)PostProcessType::DENOISER].get());
+	for (uint32_t iteration = 0; iteration < mDenoiserSettings.iterations; ++iteration)
+	{
+		// each pass reads what the one before wrote
+		mComputeCommandBuffer->GlobalMemoryBarrier(PipelineStage::COMPUTE_SHADER, PipelineStage::COMPUTE_SHADER, Access::SHADER_WRITE, Access::SHADER_READ);
+		mComputeCommandBuffer->BindDescriptorSets(mDenoiserPipelineLayout.get(), 0, {mDenoiserSets[iteration + 1]});
+		mComputeCommandBuffer->Dispatch(groupCountX, groupCountY, 1);
+	}
+}
@@ -7,6 +7,7 @@
 #include "VK/CommandBuffer.h"
 #include "VK/DescriptorTable.h"
 #include "VK/SwapChain.h"
+#include "VK/GpuProfiler.h"
 
 enum class PostProcessType
 {
@@ -25,9 +26,24 @@ namespace Uniforms
 		float normalPhi{};
 		float positionPhi{};
 		float stepWidth{};
+		uint32_t iterationCount{};
 	};
 }
 
+constexpr uint32_t MAX_DENOISER_ITERATIONS = 8;
+
+struct DenoiserSettings
+{
+	// a-trous passes, each doubles the step width: 5 reach 62 texels out
+	uint32_t iterations = 5;
+	// luminance edge stop, in standard deviations of the noise left in the accumulation
+	float colorPhi = 4.0f;
+	// power of the normal cosine
+	float normalPhi = 128.0f;
+	// squared world distance per texel of step width
+	float positionPhi = 0.6f;
+};
+
 class PostProcessPass
 {
 public:
@@ -35,17 +51,29 @@ public:
 		const SwapChain &swapChain,
 		Device &device,
 		const Image2D &inputImageView,
+		const Image2D &accumulationImage,
+		const Image2D &momentsImage,
 		const Image2D &normalsImageView,
 		const Image2D &positionsImageView);
 	~PostProcessPass();
 
 	void Process(int32_t shaderId);
 
+	// iterations are clamped to 1..MAX_DENOISER_ITERATIONS, takes effect on the next Process
+	void SetDenoiserSettings(const DenoiserSettings &settings);
+	const DenoiserSettings &GetDenoiserSettings() const
+	{
+		return mDenoiserSettings;
+	}
+
 	 Image2D *GetOutputImage() const
 	{
 		return mOutputImage.get();
 	}
 private:
+	void UpdateDenoiserUniforms();
+	void RecordDenoiser();
+
 	int32_t mCurrentShader = -1;
 
 	const SwapChain &swapChain;
@@ -60,10 +88,24 @@ private:
 	const Image2D &mInputImage;
 	const Image2D &mNormalsImage;
 	const Image2D &mPositionsImage;
+	const Image2D &mAccumulationImage;
+	const Image2D &mMomentsImage;
 
 	std::unique_ptr<GpuImage2D> mOutputImage;
 
 	std::unique_ptr<UniformBuffer<Uniforms::Compute>> mUniformBuffer;
 
+	// The denoiser chain: a variance pass resolving the accumulation into color and variance, then a-trous passes
+	// ping ponging between two HDR images, one descriptor set and uniform buffer per pass.
+	DenoiserSettings mDenoiserSettings;
+	bool mDenoiserDirty = true;
+	std::unique_ptr<GpuImage2D> mDenoiserImages[2];
+	std::unique_ptr<DescriptorTable> mDenoiserTable;
+	std::vector<DescriptorSet *> mDenoiserSets;
+	std::vector<std::unique_ptr<UniformBuffer<Uniforms::Compute>>> mDenoiserUniformBuffers;
+	std::unique_ptr<PipelineLayout> mDenoiserPipelineLayout;
+	std::unique_ptr<ComputePipeline> mVariancePipeline;
+
 	std::unique_ptr<ComputeCommandBuffer> mComputeCommandBuffer;
+	std::unique_ptr<GpuProfiler> mGpuProfiler;
 };
@@ -9,11 +9,11 @@
 #include <map>
 #include <rapidjson/document.h>
 #include <utility>
-#include <stb/stb_image.h>
 #include "Texture.h"
 #include "App.h"
 #include "Model.h"
 #include "InputSystem.h"
+#include "Logger.h"
 #include "Math/Quaternion.h"
 #include "Math/Vector4.h"
 #include "RtxRayTraceScene.h"
@@ -24,30 +24,6 @@ std::string ExtractFileDirectory(std::string_view path)
     return std::string(path).substr(0, path.find_last_of('/') + 1);
 }
 
-ImageData *Load2DImageData(const std::string &path)
-{
-    static std::unordered_map<std::string, ImageData *> textureDataPool;
-    auto iter = textureDataPool.find(path);
-    if (iter != textureDataPool.end())
-        return iter->second;
-    else
-    {
-        int texWidth;
-        int texHeight;
-        int channels;
-        uint8_t *pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &channels, STBI_rgb_alpha);
-
-        if (!pixels)
-        {
-            std::cout << "[ERROR] Failed to load texture image:" << path << std::endl;
-            exit(1);
-        }
-        auto newImageData = new ImageData(ImageDataType::RGBA8, texWidth, texHeight, 4, pixels);
-        textureDataPool[path] = newImageData;
-        return newImageData;
-    }
-}
-
 static Matrix4f GetEntityNodeSRTMat(const rapidjson::Value &entity)
 {
     Vector3f position;
@@ -75,34 +51,41 @@ RaymanScene::RaymanScene(std::string_view filePath)
     LoadFromFile(filePath);
 }
 
-void RaymanScene::AddHDR(HDRData *hdr)
+void RaymanScene::AddHDR(HDRData &hdr)
 {
-    hdrResolution = (float)hdr->width * hdr->height;
+    hdrResolution = (float)hdr.cols.GetWidth() * hdr.cols.GetHeight();
 
-    hdrColumns = std::make_unique<ImageData>(ImageDataType::HDR, hdr->width, hdr->height, 12, hdr->cols);
+    hdrColumns = std::make_unique<ImageData>(std::move(hdr.cols));
 
-    hdrConditional = std::make_unique<ImageData>(ImageDataType::HDR, hdr->width, hdr->height, 12, hdr->conditionalDistData);
+    hdrConditional = std::make_unique<ImageData>(std::move(hdr.conditionalDistData));
 
-    hdrMarginal = std::make_unique<ImageData>(ImageDataType::HDR, hdr->width, hdr->height, 12, hdr->marginalDistData);
+    hdrMarginal = std::make_unique<ImageData>(std::move(hdr.marginalDistData));
 }
 
-int RaymanScene::AddTexture(ImageData *texture)
+int RaymanScene::AddTexture(const std::string &filePath, TextureRole role)
 {
+    const std::string path = GetCanonicalTexturePath(filePath);
     int id = 0;
 
     bool exists = false;
-    for (int i = 0; i < textureDatas.size(); ++i)
-        if (textureDatas[i].get() == texture)
+    for (size_t i = 0; i < texturePaths.size(); ++i)
+        if (texturePaths[i] == path)
         {
-            id = i;
+            id = (int)i;
             exists = true;
             break;
         }
 
     if (!exists)
     {
-        id = (int)textureDatas.size();
-        textureDatas.emplace_back(texture);
+        id = (int)texturePaths.size();
+        texturePaths.emplace_back(path);
+        textureRoles.emplace_back(role);
+    }
+    else if (textureRoles[id] != role)
+    {
+        // shared between roles: keep all four channels, each role reads its own from rgba
+        textureRoles[id] = role == TextureRole::COLOR || textureRoles[id] == TextureRole::COLOR ? TextureRole::COLOR : TextureRole::LINEAR_COLOR;
     }
 
     return id;
@@ -275,42 +258,42 @@ void RaymanScene::LoadFromFile(std::string_view filePath)
         if (matData.HasMember("albedoMap") && matData["albedoMap"].IsString())
         {
             std::string filePath = matData["albedoMap"].GetString();
-            material.albedoTexID = AddTexture(Load2DImageData(sceneJsonDir + filePath));
+            material.albedoTexID = AddTexture(sceneJsonDir + filePath, TextureRole::COLOR);
         }
 
         // normal map
         if (matData.HasMember("normalMap") && matData["normalMap"].IsString())
         {
             std::string filePath = matData["normalMap"].GetString();
-            material.normalTexID = AddTexture(Load2DImageData(sceneJsonDir + filePath));
+            material.normalTexID = AddTexture(sceneJsonDir + filePath, TextureRole::NORMAL);
         }
 
         // metallic map
         if (matData.HasMember("metallicmap") && matData["metallicmap"].IsString())
         {
             std::string filePath = matData["metallicmap"].GetString();
-            material.metallicTexID = AddTexture(Load2DImageData(sceneJsonDir + filePath));
+            material.metallicTexID = AddTexture(sceneJsonDir + filePath, TextureRole::MASK);
         }
 
         // roughness map
         if (matData.HasMember("roughnessMap") && matData["roughnessMap"].IsString())
         {
             std::string filePath = matData["roughnessMap"].GetString();
-            material.roughnessTexID = AddTexture(Load2DImageData(sceneJsonDir + filePath));
+            material.roughnessTexID = AddTexture(sceneJsonDir + filePath, TextureRole::MASK);
         }
 
         // emission map
         if (matData.HasMember("emissionMap") && matData["emissionMap"].IsString())
         {
             std::string filePath = matData["emissionMap"].GetString();
-            material.emissionTexID = AddTexture(Load2DImageData(sceneJsonDir + filePath));
+            material.emissionTexID = AddTexture(sceneJsonDir + filePath, TextureRole::LINEAR_COLOR);
         }
 
         // opacity map
         if (matData.HasMember("opacityMap") && matData["opacityMap"].IsString())
         {
             std::string filePath = matData["opacityMap"].GetString();
-            material.opacityTexID = AddTexture(Load2DImageData(sceneJsonDir + filePath));
+            material.opacityTexID = AddTexture(sceneJsonDir + filePath, TextureRole::MASK);
         }
 
         if (materialMap.find(matName) == materialMap.end()) // New material
@@ -322,6 +305,9 @@ void RaymanScene::LoadFromFile(std::string_view filePath)
         std::cout << "loaded Material:" << matName << std::endl;
     }
 
+    // decode while the hdr and the models load, RtxRayTraceScene::CreateBuffers joins the jobs
+    StartTextureLoads();
+
     //====================================load camera==============================
     Vector3f target{};
     target.x = entities[0]["target"][0].GetFloat();
@@ -345,7 +331,7 @@ void RaymanScene::LoadFromFile(std::string_view filePath)
     {
         auto sceneHdrFilePath = sceneHdr["resource"].GetString();
         auto hdrName = sceneJsonDir + sceneHdrFilePath;
-        auto *hdr = LoadHDR(hdrName.c_str());
+        auto hdr = LoadHDR(hdrName.c_str());
 
         if (hdr == nullptr)
         {
@@ -355,7 +341,7 @@ void RaymanScene::LoadFromFile(std::string_view filePath)
         else
             std::cout << "loaded scene hdr:" << hdrName << std::endl;
 
-        AddHDR(hdr);
+        AddHDR(*hdr);
     }
 
     //==========================================load model entity======================================================
@@ -399,6 +385,25 @@ void RaymanScene::LoadFromFile(std::string_view filePath)
     }
 }
 
+TextureImportSettings RaymanScene::GetTextureImportSettings(size_t textureId, bool compress) const
+{
+    TextureImportSettings settings;
+    settings.role = textureRoles[textureId];
+    settings.compress = compress;
+    settings.highQuality = settings.role == TextureRole::COLOR;
+    return settings;
+}
+
+void RaymanScene::StartTextureLoads()
+{
+    // The device does not exist yet while the scene file loads. Every GPU that runs this ray tracing sample
+    // has BC support, so the jobs build compressed mips and the streamer reloads only when it is missing.
+    // The streamer reads its levels from the texture cache, the jobs keep just the opened cache file.
+    textureJobs.clear();
+    for (size_t i = 0; i < texturePaths.size(); ++i)
+        textureJobs.emplace_back(textureLoader.Request(texturePaths[i], GetTextureImportSettings(i, true), TextureLoadMode::STREAMED));
+}
+
 void RaymanScene::SetCamera(Vector3f position, Vector3f target, float fov, float aspect)
 {
     camera.reset(new RmCamera(position, target, fov, aspect));
@@ -480,6 +485,41 @@ void RaymanScene::ProcessInput()
             App::Instance().GetInputSystem().GetMouse().SetReleativeMode(true);
     }
 
+    if (App::Instance().GetInputSystem().GetKeyboard().GetKeyState(SDL_SCANCODE_T) == ButtonState::PRESS)
+        mRtxRayTraceScene->GetTextureStreamer()->PrintStats();
+
+    if (App::Instance().GetInputSystem().GetKeyboard().GetKeyState(SDL_SCANCODE_LEFTBRACKET) == ButtonState::PRESS)
+        mRtxRayTraceScene->SetTextureBudget(mRtxRayTraceScene->GetTextureStreamer()->GetBudget() / 2);
+
+    if (App::Instance().GetInputSystem().GetKeyboard().GetKeyState(SDL_SCANCODE_RIGHTBRACKET) == ButtonState::PRESS)
+        mRtxRayTraceScene->SetTextureBudget(mRtxRayTraceScene->GetTextureStreamer()->GetBudget() * 2);
+
+    if (App::Instance().GetInputSystem().GetKeyboard().GetKeyState(SDL_SCANCODE_M) == ButtonState::PRESS)
+        mRtxRayTraceScene->ToggleInstanceAnimation();
+
+    // denoiser strength: - and = take a-trous passes away or add them, 9 and 0 loosen or tighten the luminance edge stop
+    {
+        const auto &keyboard = App::Instance().GetInputSystem().GetKeyboard();
+        DenoiserSettings settings = mRtxRayTraceScene->GetDenoiserSettings();
+        bool changed = true;
+        if (keyboard.GetKeyState(SDL_SCANCODE_MINUS) == ButtonState::PRESS && settings.iterations > 1)
+            --settings.iterations;
+        else if (keyboard.GetKeyState(SDL_SCANCODE_EQUALS) == ButtonState::PRESS)
+            ++settings.iterations;
+        else if (keyboard.GetKeyState(SDL_SCANCODE_9) == ButtonState::PRESS)
+            settings.colorPhi *= 2.0f;
+        else if (keyboard.GetKeyState(SDL_SCANCODE_0) == ButtonState::PRESS)
+            settings.colorPhi *= 0.5f;
+        else
+            changed = false;
+
+        if (changed)
+        {
+            mRtxRayTraceScene->SetDenoiserSettings(settings);
+            LOG_INFO("Denoiser: {} iterations, color phi {}", mRtxRayTraceScene->GetDenoiserSettings().iterations, mRtxRayTraceScene->GetDenoiserSettings().colorPhi);
+        }
+    }
+
     static int32_t counter = 0;
     if (App::Instance().GetInputSystem().GetKeyboard().GetKeyState(SDL_SCANCODE_SPACE) == ButtonState::PRESS)
     {
@@ -25,9 +25,9 @@ public:
 
 	void LoadFromFile(std::string_view filePath);
 
-	void AddHDR(HDRData *hdr);
+	void AddHDR(HDRData &hdr);
 
-	int AddTexture(ImageData *texture);
+	int AddTexture(const std::string &filePath, TextureRole role);
 
 	void SetCamera(Vector3f position, Vector3f target, float fov, float aspect);
 	int AddMesh(MeshDef *mesh);
@@ -71,12 +71,15 @@ public:
 private:
 	friend class RtxRayTraceScene;
 
+	TextureImportSettings GetTextureImportSettings(size_t textureId, bool compress) const;
+	void StartTextureLoads();
+
 	void PrintInfo() const
 	{
 		std::cout << "[SCENE ANALYZER] Scene info:" << std::endl;
 		std::cout << "	         Meshes:    " << meshes.size() << std::endl;
 		std::cout << "	         Instances: " << meshInstances.size() << std::endl;
-		std::cout << "	         Textures:  " << textureDatas.size() << std::endl;
+		std::cout << "	         Textures:  " << texturePaths.size() << std::endl;
 		std::cout << "	         Lights:    " << lights.size() << std::endl;
 		std::cout << "	         Materials: " << materials.size() << std::endl;
 	}
@@ -86,7 +89,11 @@ private:
 	std::unique_ptr<RmCamera> camera;
 
 	std::vector<std::unique_ptr<MeshDef>> meshes;
-	std::vector<std::unique_ptr<ImageData>> textureDatas;
+	// canonical paths, decoded on the thread pool from the end of the material parsing
+	std::vector<std::string> texturePaths;
+	std::vector<TextureRole> textureRoles;
+	AsyncTextureLoader textureLoader;
+	std::vector<std::shared_future<TextureLoadResult>> textureJobs;
 
 	std::unique_ptr<ImageData> hdrColumns;
 	std::unique_ptr<ImageData> hdrConditional;
@@ -15,9 +15,14 @@
 #include "VK/SyncObject.h"
 #include "VK/Utils.h"
 #include "VK/Device.h"
-#include "VK/DescriptorPool.h"
 #include "VK/DescriptorSet.h"
 #include "VK/DescriptorSetLayout.h"
+#include "VK/BindlessTable.h"
+#include "VK/ASBuilder.h"
+#include "VK/ASCompactor.h"
+#include "VK/ReadbackQueue.h"
+#include "VK/GpuProfiler.h"
+#include "Profiler.h"
 #include "Memory.h"
 #include "RaymanScene.h"
 #include "ShaderCompiler.h"
@@ -32,6 +37,7 @@ RtxRayTracePass::RtxRayTracePass(const Instance &instance, Device &device)
 {
 	auto frameCount = App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size();
 	mRayTracePass = std::make_unique<RayTracePass>(frameCount);
+	mGpuProfiler = std::make_unique<GpuProfiler>(mDevice, "RtxRayTracePass", (uint32_t)frameCount);
 
 	for (const auto &_ : App::Instance().GetGraphicsContext()->GetSwapChain()->GetImageViews())
 		mUniformBuffers.emplace_back(mDevice.CreateUniformBuffer<Uniform>());
@@ -44,8 +50,23 @@ RtxRayTracePass::RtxRayTracePass(const Instance &instance, Device &device)
 
 	mAccumulationImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_SRC | ImageUsage::TRANSFER_DST);
 	mOutputImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, outputFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_SRC | ImageUsage::TRANSFER_DST);
-	mNormalsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE);
-	mPositionsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE);
+	mNormalsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_SRC);
+	mPositionsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_SRC);
+	mMomentsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_SRC);
+	mSampleImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE);
+
+	mHistoryAccumulationImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_DST);
+	mHistoryMomentsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_DST);
+	mHistoryNormalsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_DST);
+	mHistoryPositionsImage = std::make_unique<GpuImage2D>(mDevice, extent.x, extent.y, accumulationFormat, tiling, ImageUsage::STORAGE | ImageUsage::TRANSFER_DST);
+
+	// the temporal pass reads the accumulation and the moments back in place every frame, they leave UNDEFINED once
+	// here and stay GENERAL
+	auto cmd = mDevice.GetRayTraceCommandPool()->CreatePrimaryCommandBuffer();
+	cmd->ExecuteImmediately([&]()
+							{
+								for (GpuImage2D *image : {mAccumulationImage.get(), mMomentsImage.get()})
+									cmd->ImageBarrier(image->GetHandle(), Access::NONE, Access::SHADER_WRITE | Access::SHADER_READ, ImageLayout::UNDEFINED, ImageLayout::GENERAL, image->GetView()->GetSubresourceRange()); });
 
 	mCompiler.reset(new ShaderCompiler());
 }
@@ -62,48 +83,39 @@ Device &RtxRayTracePass::GetDevice() const
 
 void RtxRayTracePass::CreateRayTracerPipeline()
 {
+	// Scene textures live in the device bindless table (set 1), adding textures does not touch this layout
 	mDescriptorTable = std::make_unique<DescriptorTable>(mDevice);
-	mDescriptorTable->AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::ACCELERATION_STRUCTURE_KHR, ShaderStage::RAYGEN | ShaderStage::CLOSEST_HIT)	   // Top level acceleration structure.
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)														   // Image accumulation
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)														   // Output
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::RAYGEN | ShaderStage::MISS | ShaderStage::CLOSEST_HIT)		   // Uniforms
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_BUFFER, ShaderStage::MISS | ShaderStage::CLOSEST_HIT)								   // Vertex buffer
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)													   // Index buffer
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)													   // Material buffer
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)													   // Offset buffer
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), mScene->GetTextureSize(), DescriptorType::COMBINED_IMAGE_SAMPLER, ShaderStage::CLOSEST_HIT | ShaderStage::MISS) // Textures
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT | ShaderStage::MISS)								   // Lights buffer
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)														   // Normal
-		.AddLayoutBinding(mDescriptorTable->GetBindingCount(), 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)														   // World position
+	mDescriptorTable->AddLayoutBinding(0, 1, DescriptorType::ACCELERATION_STRUCTURE_KHR, ShaderStage::RAYGEN | ShaderStage::CLOSEST_HIT) // Top level acceleration structure.
+		.AddLayoutBinding(3, 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::RAYGEN | ShaderStage::MISS | ShaderStage::CLOSEST_HIT)   // Uniforms
+		.AddLayoutBinding(4, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::MISS | ShaderStage::CLOSEST_HIT)						   // Vertex buffer
+		.AddLayoutBinding(5, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)											   // Index buffer
+		.AddLayoutBinding(6, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)											   // Material buffer
+		.AddLayoutBinding(7, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)											   // Offset buffer
+		.AddLayoutBinding(9, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT | ShaderStage::MISS)						   // Lights buffer
+		.AddLayoutBinding(10, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)											   // Normal
+		.AddLayoutBinding(11, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)											   // World position
+		.AddLayoutBinding(13, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::CLOSEST_HIT)											   // Texture streaming handles and requests
+		.AddLayoutBinding(15, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::RAYGEN)											   // Frame sample
 		;
 	if (mScene->UseHDR())
-		mDescriptorTable->AddLayoutBinding(mDescriptorTable->GetBindingCount(), mScene->GetHDRTextures().size(), DescriptorType::COMBINED_IMAGE_SAMPLER, ShaderStage::CLOSEST_HIT | ShaderStage::MISS);
+		mDescriptorTable->AddLayoutBinding(12, mScene->GetHDRTextures().size(), DescriptorType::COMBINED_IMAGE_SAMPLER, ShaderStage::CLOSEST_HIT | ShaderStage::MISS);
 
 	mDescriptorSets = mDescriptorTable->AllocateDescriptorSets(App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size());
 
 	for (size_t imageIndex = 0; imageIndex < App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size(); imageIndex++)
 	{
 		mDescriptorSets[imageIndex]->WriteAccelerationStructure(0, mTLAS->GetHandle());					 // Top level acceleration structure.
-		mDescriptorSets[imageIndex]->WriteImage(1, mAccumulationImage->GetView(), ImageLayout::GENERAL); // Accumulation image
-		mDescriptorSets[imageIndex]->WriteImage(2, mOutputImage->GetView(), ImageLayout::GENERAL);		 // Output image
 		mDescriptorSets[imageIndex]->WriteBuffer(3, mUniformBuffers[imageIndex].get());					 // Uniform buffer
 		mDescriptorSets[imageIndex]->WriteBuffer(4, mScene->GetVertexBuffer());							 // Vertex buffer
 		mDescriptorSets[imageIndex]->WriteBuffer(5, mScene->GetIndexBuffer());							 // Index buffer
 		mDescriptorSets[imageIndex]->WriteBuffer(6, mScene->GetMaterialBuffer());						 // Material buffer
 		mDescriptorSets[imageIndex]->WriteBuffer(7, mScene->GetOffsetBuffer());							 // Offsets buffer
 
-		// Texture descriptor
-		std::vector<DescriptorImageInfo> imageInfos(mScene->GetTextures().size());
-		for (size_t t = 0; t < imageInfos.size(); ++t)
-		{
-			imageInfos[t].imageLayout = ImageLayout::SHADER_READ_ONLY_OPTIMAL;
-			imageInfos[t].imageView = mScene->GetTextures()[t]->GetImageView();
-			imageInfos[t].sampler = mScene->GetTextures()[t]->GetSampler()->GetHandle();
-		}
-		mDescriptorSets[imageIndex]->WriteImageArray(8, imageInfos);								   // Texture descriptor
 		mDescriptorSets[imageIndex]->WriteBuffer(9, mScene->GetLightsBuffer());						   // Lights buffer
 		mDescriptorSets[imageIndex]->WriteImage(10, mNormalsImage->GetView(), ImageLayout::GENERAL);   // Normal image
 		mDescriptorSets[imageIndex]->WriteImage(11, mPositionsImage->GetView(), ImageLayout::GENERAL); // Position image
+		mDescriptorSets[imageIndex]->WriteBuffer(13, mScene->GetTextureStreamer()->GetFrameBuffer(imageIndex)); // Texture streaming buffer
+		mDescriptorSets[imageIndex]->WriteImage(15, mSampleImage->GetView(), ImageLayout::GENERAL);	   // Frame sample image
 
 		// HDR descriptor
 		// Outside the block because of RAII
@@ -123,8 +135,20 @@ void RtxRayTracePass::CreateRayTracerPipeline()
 		mDescriptorSets[imageIndex]->Update();
 	}
 
+	// without a bindless table set 1 is a fixed array of the streamed textures, rewritten whenever one of them changes
+	DescriptorSetLayout *textureLayout = nullptr;
+	if (mDevice.GetBindlessTable())
+		textureLayout = mDevice.GetBindlessTable()->GetLayout();
+	else
+	{
+		mTextureDescriptorTable = std::make_unique<DescriptorTable>(mDevice);
+		mTextureDescriptorTable->AddLayoutBinding(0, (uint32_t)mScene->GetTextureStreamer()->GetImageInfos().size(), DescriptorType::COMBINED_IMAGE_SAMPLER, ShaderStage::CLOSEST_HIT | ShaderStage::MISS);
+		textureLayout = mTextureDescriptorTable->GetLayout();
+	}
+
 	mPipelineLayout = std::make_unique<PipelineLayout>(mDevice);
-	mPipelineLayout->AddDescriptorSetLayout(mDescriptorTable->GetLayout());
+	mPipelineLayout->AddDescriptorSetLayout(mDescriptorTable->GetLayout())
+		.AddDescriptorSetLayout(textureLayout);
 
 	mPipeline = std::make_unique<RayTracePipeline>(mDevice);
 	mPipeline->SetRayGenShader(mDevice.CreateShader(ShaderStage::RAYGEN, ReadBinary("Raytracing.compiled.rgen.spv")))
@@ -134,9 +158,62 @@ void RtxRayTracePass::CreateRayTracerPipeline()
 		.SetPipelineLayout(mPipelineLayout.get());
 }
 
+void RtxRayTracePass::CreateTemporalPipeline()
+{
+	// Adds the traced sample to the accumulation, reprojecting the history while the camera moves
+	mTemporalDescriptorTable = std::make_unique<DescriptorTable>(mDevice);
+	mTemporalDescriptorTable->AddLayoutBinding(1, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE) // Image accumulation
+		.AddLayoutBinding(2, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // Output
+		.AddLayoutBinding(3, 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::COMPUTE)					 // Uniforms
+		.AddLayoutBinding(10, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // Normal
+		.AddLayoutBinding(11, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // World position
+		.AddLayoutBinding(14, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // Luminance moments
+		.AddLayoutBinding(15, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // Frame sample
+		.AddLayoutBinding(16, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // History accumulation
+		.AddLayoutBinding(17, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // History moments
+		.AddLayoutBinding(18, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)					 // History normal
+		.AddLayoutBinding(19, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE);					 // History world position
+
+	// the sets are requested from the pass's cache when recording, it drops them once an image is recreated
+	mTemporalWrites.resize(App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size());
+	for (size_t imageIndex = 0; imageIndex < mTemporalWrites.size(); imageIndex++)
+	{
+		mTemporalWrites[imageIndex].WriteImage(1, mAccumulationImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(2, mOutputImage->GetView(), ImageLayout::GENERAL)
+			.WriteBuffer(3, mUniformBuffers[imageIndex].get())
+			.WriteImage(10, mNormalsImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(11, mPositionsImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(14, mMomentsImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(15, mSampleImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(16, mHistoryAccumulationImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(17, mHistoryMomentsImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(18, mHistoryNormalsImage->GetView(), ImageLayout::GENERAL)
+			.WriteImage(19, mHistoryPositionsImage->GetView(), ImageLayout::GENERAL);
+	}
+
+	mTemporalPipelineLayout = std::make_unique<PipelineLayout>(mDevice);
+	mTemporalPipelineLayout->AddDescriptorSetLayout(mTemporalDescriptorTable->GetLayout());
+
+	mTemporalPipeline = std::make_unique<ComputePipeline>(mDevice);
+	mTemporalPipeline->SetShader(mDevice.CreateShader(ShaderStage::COMPUTE, ReadBinary("TemporalAccumulation.comp.spv")))
+		.SetPipelineLayout(mTemporalPipelineLayout.get());
+}
+
 void RtxRayTracePass::CreateComputePipeline()
 {
-	mPostProcessPass = std::make_unique<PostProcessPass>(*App::Instance().GetGraphicsContext()->GetSwapChain(), mDevice, *mOutputImage, *mNormalsImage, *mPositionsImage);
+	mPostProcessPass = std::make_unique<PostProcessPass>(*App::Instance().GetGraphicsContext()->GetSwapChain(), mDevice, *mOutputImage, *mAccumulationImage, *mMomentsImage, *mNormalsImage, *mPositionsImage);
+	mPostProcessPass->SetDenoiserSettings(mDenoiserSettings);
+}
+
+DescriptorSet *RtxRayTracePass::GetTextureDescriptorSet()
+{
+	if (mDevice.GetBindlessTable())
+		return mDevice.GetBindlessTable()->GetDescriptorSet();
+
+	// the cache hands back the same set until a texture is streamed in or out
+	DescriptorWrites writes;
+	writes.WriteImageArray(0, mScene->GetTextureStreamer()->GetImageInfos());
+	return mRayTracePass->GetDescriptorSetCache()->Request(mTextureDescriptorTable->GetLayout(), writes);
 }
 
 void RtxRayTracePass::Copy(RayTraceCommandBuffer *commandBuffer, Image2D *src, VkImage dst) const
@@ -152,6 +229,28 @@ void RtxRayTracePass::Copy(RayTraceCommandBuffer *commandBuffer, Image2D *src, V
 	commandBuffer->ImageBarrier(dst, Access::TRANSFER_WRITE, Access::NONE, ImageLayout::TRANSFER_DST_OPTIMAL, ImageLayout::PRESENT_SRC_KHR, subresourceRange);
 }
 
+void RtxRayTracePass::CopyHistory(RayTraceCommandBuffer *commandBuffer) const
+{
+	auto extent = App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent();
+
+	// written by last frame's trace and temporal pass
+	commandBuffer->GlobalMemoryBarrier(PipelineStage::RAY_TRACING_SHADER | PipelineStage::COMPUTE_SHADER, PipelineStage::TRANSFER, Access::SHADER_WRITE, Access::TRANSFER_READ);
+
+	const std::pair<GpuImage2D *, GpuImage2D *> copies[] = {
+		{mAccumulationImage.get(), mHistoryAccumulationImage.get()},
+		{mMomentsImage.get(), mHistoryMomentsImage.get()},
+		{mNormalsImage.get(), mHistoryNormalsImage.get()},
+		{mPositionsImage.get(), mHistoryPositionsImage.get()},
+	};
+	for (const auto &[src, dst] : copies)
+	{
+		commandBuffer->ImageBarrier(dst->GetHandle(), Access::NONE, Access::TRANSFER_WRITE, ImageLayout::UNDEFINED, ImageLayout::GENERAL, dst->GetView()->GetSubresourceRange());
+		commandBuffer->CopyImage(src->GetHandle(), ImageLayout::GENERAL, dst->GetHandle(), ImageLayout::GENERAL, src->GetImageCopy(extent.x, extent.y));
+	}
+
+	commandBuffer->GlobalMemoryBarrier(PipelineStage::TRANSFER, PipelineStage::ALL_COMMANDS, Access::TRANSFER_READ | Access::TRANSFER_WRITE, Access::SHADER_READ | Access::SHADER_WRITE);
+}
+
 const Image2D *RtxRayTracePass::GetOutputImage() const
 {
 	return mOutputImage.get();
@@ -178,37 +277,95 @@ void RtxRayTracePass::SetRenderState(RenderState state)
 	mState = state;
 }
 
+void RtxRayTracePass::SetDenoiserSettings(const DenoiserSettings &settings)
+{
+	mDenoiserSettings = settings;
+	if (mPostProcessPass)
+	{
+		mPostProcessPass->SetDenoiserSettings(settings);
+		mDenoiserSettings = mPostProcessPass->GetDenoiserSettings();
+	}
+}
+
+const DenoiserSettings &RtxRayTracePass::GetDenoiserSettings() const
+{
+	return mDenoiserSettings;
+}
+
 void RtxRayTracePass::BuildPipeline()
 {
 	CompileShaders();
 	CreateRayTracerPipeline();
+	CreateTemporalPipeline();
 	CreateComputePipeline();
 	ResetAccumulation();
 }
 
 void RtxRayTracePass::Render()
 {
-	if (mScene->Get()->GetCamera().HaveUpdate())
-		ResetAccumulation();
+	PROFILE_SCOPE("RtxRayTracePass::Render");
+
+	// a moving camera keeps its accumulation, the temporal pass reprojects it into the new view
+	mReproject = mScene->Get()->GetCamera().HaveUpdate();
 	mRayTracePass->RecordCurrentCommand([&](RayTraceCommandBuffer *rayTraceCmd, size_t frameIdx)
 										{
 											const auto extent = App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent();
-									
-											rayTraceCmd->ImageBarrier( mAccumulationImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mAccumulationImage->GetView()->GetSubresourceRange());
-											rayTraceCmd->ImageBarrier( mOutputImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mOutputImage->GetView()->GetSubresourceRange());
-											rayTraceCmd->ImageBarrier( mNormalsImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mNormalsImage->GetView()->GetSubresourceRange());
-											rayTraceCmd->ImageBarrier( mPositionsImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mPositionsImage->GetView()->GetSubresourceRange());
-											rayTraceCmd->BindPipeline(mPipeline.get());
-											rayTraceCmd->BindDescriptorSets(mPipelineLayout.get(),0,{mDescriptorSets[frameIdx]});
-											rayTraceCmd->TraceRaysKHR(mPipeline->GetSBT(),extent.x,extent.y,1);
-											++mFrame;
-											if (mPostProcessType == PostProcessType::NONE)
-												Copy(rayTraceCmd, mOutputImage.get(), App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages()[frameIdx]);
-											else
+
+											// the frame's fence is signalled, its streaming requests can be read back
+											if (mDevice.GetBindlessTable())
+												mDevice.GetBindlessTable()->BeginFrame((uint32_t)App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size());
+											if (mScene->GetTextureStreamer()->BeginFrame((uint32_t)frameIdx, rayTraceCmd))
+												ResetAccumulation();
+
+											mGpuProfiler->BeginFrame(rayTraceCmd, frameIdx);
 											{
-												mPostProcessPass->Process((int32_t)mPostProcessType);
-												Copy(rayTraceCmd, mPostProcessPass->GetOutputImage(), App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages()[frameIdx]);
+												GpuProfileScope frameScope(mGpuProfiler.get(), rayTraceCmd, "Frame");
+
+												// nothing to reproject right after a reset
+												if (mReproject && mFrame > 0)
+												{
+													GpuProfileScope scope(mGpuProfiler.get(), rayTraceCmd, "Copy history");
+													CopyHistory(rayTraceCmd);
+												}
+
+												rayTraceCmd->ImageBarrier( mAccumulationImage->GetHandle(),Access::SHADER_WRITE | Access::SHADER_READ,Access::SHADER_WRITE | Access::SHADER_READ,ImageLayout::GENERAL,ImageLayout::GENERAL,mAccumulationImage->GetView()->GetSubresourceRange());
+												rayTraceCmd->ImageBarrier( mOutputImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mOutputImage->GetView()->GetSubresourceRange());
+												rayTraceCmd->ImageBarrier( mNormalsImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mNormalsImage->GetView()->GetSubresourceRange());
+												rayTraceCmd->ImageBarrier( mPositionsImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mPositionsImage->GetView()->GetSubresourceRange());
+												rayTraceCmd->ImageBarrier( mMomentsImage->GetHandle(),Access::SHADER_WRITE | Access::SHADER_READ,Access::SHADER_WRITE | Access::SHADER_READ,ImageLayout::GENERAL,ImageLayout::GENERAL,mMomentsImage->GetView()->GetSubresourceRange());
+												rayTraceCmd->ImageBarrier( mSampleImage->GetHandle(),Access::NONE,Access::SHADER_WRITE,ImageLayout::UNDEFINED,ImageLayout::GENERAL,mSampleImage->GetView()->GetSubresourceRange());
+												if (mInstancesDirty)
+												{
+													GpuProfileScope scope(mGpuProfiler.get(), rayTraceCmd, "TLAS update");
+													mTLAS->Update(rayTraceCmd);
+													mInstancesDirty = false;
+												}
+												{
+													GpuProfileScope scope(mGpuProfiler.get(), rayTraceCmd, "TraceRays");
+													rayTraceCmd->BindPipeline(mPipeline.get());
+													rayTraceCmd->BindDescriptorSets(mPipelineLayout.get(),0,{mDescriptorSets[frameIdx], GetTextureDescriptorSet()});
+													rayTraceCmd->TraceRaysKHR(mPipeline->GetSBT(),extent.x,extent.y,1);
+												}
+												{
+													GpuProfileScope scope(mGpuProfiler.get(), rayTraceCmd, "Temporal accumulation");
+													rayTraceCmd->GlobalMemoryBarrier(PipelineStage::RAY_TRACING_SHADER, PipelineStage::COMPUTE_SHADER, Access::SHADER_WRITE, Access::SHADER_READ);
+													rayTraceCmd->BindComputePipeline(mTemporalPipeline.get());
+													rayTraceCmd->BindComputeDescriptorSets(mTemporalPipelineLayout.get(),0,{mRayTracePass->GetDescriptorSetCache()->Request(mTemporalDescriptorTable->GetLayout(), mTemporalWrites[frameIdx])});
+													rayTraceCmd->Dispatch((extent.x + 15) / 16, (extent.y + 15) / 16, 1);
+													rayTraceCmd->GlobalMemoryBarrier(PipelineStage::COMPUTE_SHADER, PipelineStage::HOST, Access::SHADER_WRITE, Access::HOST_READ);
+												}
+												++mFrame;
+
+												GpuProfileScope copyScope(mGpuProfiler.get(), rayTraceCmd, "Copy to swapchain");
+												if (mPostProcessType == PostProcessType::NONE)
+													Copy(rayTraceCmd, mOutputImage.get(), App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages()[frameIdx]);
+												else
+												{
+													mPostProcessPass->Process((int32_t)mPostProcessType);
+													Copy(rayTraceCmd, mPostProcessPass->GetOutputImage(), App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages()[frameIdx]);
+												}
 											}
+											mGpuProfiler->EndFrame(frameIdx);
 
 											UpdateUniformBuffer(frameIdx); 
 										});
@@ -218,6 +375,8 @@ void RtxRayTracePass::Render()
 
 void RtxRayTracePass::Update()
 {
+	WriteFinishedScreenShots();
+
 	if (mPrevState != mState)
 	{
 		mPrevState = mState;
@@ -250,13 +409,30 @@ void RtxRayTracePass::ResetAccumulation()
 	mFrame = 0;
 }
 
+void RtxRayTracePass::SetInstanceTransform(uint32_t instanceId, const VkTransformMatrixKHR &transform)
+{
+	mTLAS->SetInstanceTransform(instanceId, transform);
+	mInstancesDirty = true;
+	ResetAccumulation();
+}
+
 void RtxRayTracePass::CreateBLAS()
 {
+	ASBuilder builder(mDevice);
+	builder.SetCompaction(true);
 	for (const auto &model : mScene->Get()->GetMeshInstances())
 	{
 		const auto &mesh = mScene->Get()->GetMeshes()[model.meshId];
-		mBLASs.emplace_back(std::make_unique<BLAS>(mDevice, mesh->vertices, mesh->indices));
+		mBLASs.emplace_back(std::make_unique<BLAS>(mDevice));
+		mBLASs.back()->SetGeometry(mesh->vertices, mesh->indices);
+		builder.AddBLAS(mBLASs.back().get());
 	}
+	builder.Build();
+
+	const auto &stats = builder.GetStats();
+	std::cout << "[SCENE ANALYZER] " << stats.blasCount << " BLAS built in " << stats.batchCount << " batches, " << stats.buildMs << " ms, scratch "
+			  << static_cast<double>(stats.scratchSize) / 1000000.0 << " MB (per mesh: " << static_cast<double>(stats.totalScratchSize) / 1000000.0 << " MB)" << std::endl;
+	builder.GetCompactionReport().Print();
 }
 
 void RtxRayTracePass::CreateTLAS()
@@ -268,7 +444,13 @@ void RtxRayTracePass::CreateTLAS()
 	for (auto instanceId = 0; instanceId < mScene->Get()->GetMeshInstances().size(); ++instanceId)
 		geometryInstances.emplace_back(mBLASs[instanceId]->CreateInstance());
 
-	mTLAS = std::make_unique<TLAS>(mDevice, geometryInstances);
+	// one copy of the instances per frame in flight so SetInstanceTransform never touches data a pending update reads
+	auto frameCount = (uint32_t)App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size();
+	mTLAS = std::make_unique<TLAS>(mDevice, geometryInstances, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR, frameCount);
+
+	ASCompactor compactor(mDevice);
+	compactor.Add(mTLAS.get(), "TLAS").Compact();
+	compactor.GetReport().Print();
 }
 
 void RtxRayTracePass::UpdateUniformBuffer(size_t frameIdx)
@@ -282,6 +464,12 @@ void RtxRayTracePass::UpdateUniformBuffer(size_t frameIdx)
 	uniform.hdrResolution = mScene->UseHDR() ? mScene->Get()->GetHDRResolution() : 0.f;
 	uniform.hdrMultiplier = mScene->UseHDR() ? mScene->Get()->hdrMultiplier : 1.0f;
 	uniform.frame = mFrame;
+	uniform.prevView = mPrevView;
+	uniform.prevProjection = mPrevProjection;
+	uniform.reproject = mReproject ? 1 : 0;
+
+	mPrevView = uniform.view;
+	mPrevProjection = uniform.projection;
 
 	mUniformBuffers[frameIdx]->Set(uniform);
 }
@@ -303,35 +491,49 @@ void RtxRayTracePass::SaveOutputImageToDisk()
 			(int)dis_millseconds);
 	std::string fileName = "rayman_ScreenShot" + std::string(strTime) + ".png";
 
-	auto dstImage = std::make_unique<CpuImage2D>(mDevice, mOutputImage->GetWidth(), mOutputImage->GetHeight(), Format::R8G8B8A8_UNORM, ImageTiling::LINEAR, ImageUsage::TRANSFER_DST);
-	auto cmd = mDevice.GetTransferCommandPool()->CreatePrimaryCommandBuffer();
-	cmd->ExecuteImmediately([&]()
-							{
-								cmd->ImageBarrier(dstImage->GetHandle(),Access::NONE,Access::TRANSFER_WRITE,ImageLayout::UNDEFINED,ImageLayout::TRANSFER_DST_OPTIMAL,dstImage->GetView()->GetSubresourceRange());
-							 	VkImageCopy imageCopy = mOutputImage->GetImageCopy(mOutputImage->GetWidth(), mOutputImage->GetHeight());
-								cmd->CopyImage(mOutputImage->GetHandle(),ImageLayout::TRANSFER_SRC_OPTIMAL,dstImage->GetHandle(),ImageLayout::TRANSFER_DST_OPTIMAL,imageCopy);
-								cmd->ImageBarrier(dstImage->GetHandle(),Access::TRANSFER_WRITE,Access::MEMORY_READ,ImageLayout::TRANSFER_DST_OPTIMAL,ImageLayout::GENERAL, dstImage->GetView()->GetSubresourceRange()); });
+	// the copy is queued behind the frames already submitted, WriteFinishedScreenShots saves it once it has landed
+	mPendingScreenShots.emplace_back(fileName, mDevice.GetReadbackQueue()->ReadImage(mOutputImage.get(), ImageLayout::GENERAL));
+}
 
-	VkSubresourceLayout subResourceLayout = dstImage->GetSubResourceLayout();
+void RtxRayTracePass::WriteFinishedScreenShots()
+{
+	auto readbackQueue = mDevice.GetReadbackQueue();
+	for (auto iter = mPendingScreenShots.begin(); iter != mPendingScreenShots.end();)
+	{
+		const auto &fileName = iter->first;
+		const auto ticket = iter->second;
+		if (ticket == INVALID_READBACK_TICKET)
+		{
+			iter = mPendingScreenShots.erase(iter);
+			continue;
+		}
+		if (!readbackQueue->IsReady(ticket))
+		{
+			++iter;
+			continue;
+		}
 
-	uint8_t *data;
-	vkMapMemory(mDevice.GetHandle(), dstImage->GetMemory(), 0, VK_WHOLE_SIZE, 0, (void **)&data);
-	data += subResourceLayout.offset;
+		auto view = readbackQueue->Wait(ticket);
+		const uint8_t *data = view.As<uint8_t>();
+		uint32_t width = view.width;
+		uint32_t height = view.height;
 
-	uint32_t width = mOutputImage->GetWidth();
-	uint32_t height = mOutputImage->GetHeight();
+		// B8G8R8A8->R8G8B8A8
+		std::vector<uint8_t> rgba8Pixels;
+		rgba8Pixels.reserve(width * height * 4);
+		for (size_t i = 0; i < width * height * 4; i += 4)
+		{
+			rgba8Pixels.emplace_back(data[i + 2]);
+			rgba8Pixels.emplace_back(data[i + 1]);
+			rgba8Pixels.emplace_back(data[i + 0]);
+			rgba8Pixels.emplace_back(data[i + 3]);
+		}
+		readbackQueue->Release(ticket);
 
-	// B8G8R8A8->R8G8B8A8
-	std::vector<uint8_t> rgba8Pixels;
-	for (size_t i = 0; i < width * height * 4; i += 4)
-	{
-		rgba8Pixels.emplace_back(data[i + 2]);
-		rgba8Pixels.emplace_back(data[i + 1]);
-		rgba8Pixels.emplace_back(data[i + 0]);
-		rgba8Pixels.emplace_back(data[i + 3]);
-	}
+		stbi_write_png(fileName.c_str(), width, height, 4, rgba8Pixels.data(), width * 4);
 
-	stbi_write_png(fileName.c_str(), width, height, 4, rgba8Pixels.data(), width * 4);
+		std::cout << fileName << " complete!" << std::endl;
 
-	std::cout << fileName << " complete!" << std::endl;
+		iter = mPendingScreenShots.erase(iter);
+	}
 }
\ No newline at end of file
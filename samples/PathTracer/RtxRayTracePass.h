@@ -9,6 +9,8 @@
 #include "VK/Image.h"
 #include "VK/ImageView.h"
 #include "VK/AS.h"
+#include "VK/ReadbackQueue.h"
+#include "VK/GpuProfiler.h"
 #include "ShaderCompiler.h"
 #include <vulkan/vulkan.h>
 
@@ -28,6 +30,11 @@ struct Uniform
 	alignas(4) uint32_t frame{};
 	alignas(4) float hdrResolution{};
 	alignas(4) float hdrMultiplier{};
+	// last frame's camera, the temporal pass reprojects the history with it
+	alignas(16) Matrix4f prevView = Matrix4f::IDENTITY;
+	alignas(16) Matrix4f prevProjection = Matrix4f::IDENTITY;
+	// 1 when the camera moved since the last frame, the history is then reprojected instead of read in place
+	alignas(4) uint32_t reproject{};
 };
 
 class RtxRayTracePass
@@ -43,10 +50,16 @@ public:
 	void SetScene(class RtxRayTraceScene *scene);
 	void SetPostProcessType(PostProcessType t);
 	void SetRenderState(RenderState state);
+	// kept across pipeline rebuilds, which recreate the post process pass
+	void SetDenoiserSettings(const DenoiserSettings &settings);
+	const DenoiserSettings &GetDenoiserSettings() const;
 
 	void ResetAccumulation();
 	void SaveOutputImageToDisk();
 
+	// Moves a mesh instance without reloading the scene, the TLAS is updated in the next frame's command buffer
+	void SetInstanceTransform(uint32_t instanceId, const VkTransformMatrixKHR &transform);
+
 	void CompileShaders() const;
 
 	void Update();
@@ -54,6 +67,7 @@ public:
 
 	void CreateRayTracerPipeline();
 	void CreateComputePipeline();
+	void CreateTemporalPipeline();
 	void CreateBLAS();
 	void CreateTLAS();
 
@@ -61,12 +75,18 @@ public:
 
 private:
 	void BuildPipeline();
+	// set 1, the bindless table or the fallback array of the streamed textures
+	DescriptorSet *GetTextureDescriptorSet();
 	void Copy(RayTraceCommandBuffer *commandBuffer, Image2D *src, VkImage dst) const;
+	// keeps last frame's accumulation, moments and primary hits for the reprojection, before the trace overwrites them
+	void CopyHistory(RayTraceCommandBuffer *commandBuffer) const;
+	void WriteFinishedScreenShots();
 
 	Device &mDevice;
 	class RtxRayTraceScene *mScene;
 	
 	std::unique_ptr<RayTracePass> mRayTracePass;
+	std::unique_ptr<GpuProfiler> mGpuProfiler;
 
 	RenderState mState;
 	RenderState mPrevState;
@@ -80,6 +100,14 @@ private:
 	std::unique_ptr<GpuImage2D> mOutputImage;
 	std::unique_ptr<GpuImage2D> mNormalsImage;
 	std::unique_ptr<GpuImage2D> mPositionsImage;
+	// luminance, squared luminance and sample count of the accumulation, for the denoiser's variance
+	std::unique_ptr<GpuImage2D> mMomentsImage;
+	// the frame's path traced sample, before it is added to the accumulation
+	std::unique_ptr<GpuImage2D> mSampleImage;
+	std::unique_ptr<GpuImage2D> mHistoryAccumulationImage;
+	std::unique_ptr<GpuImage2D> mHistoryMomentsImage;
+	std::unique_ptr<GpuImage2D> mHistoryNormalsImage;
+	std::unique_ptr<GpuImage2D> mHistoryPositionsImage;
 
 	std::unique_ptr<GpuBuffer> mBLASBuffer;
 	std::unique_ptr<GpuBuffer> mScratchBLASBuffer;
@@ -90,11 +118,29 @@ private:
 	std::unique_ptr<DescriptorTable> mDescriptorTable;
 	std::vector<DescriptorSet *> mDescriptorSets;
 
+	// the texture array of devices without a bindless table
+	std::unique_ptr<DescriptorTable> mTextureDescriptorTable;
+
+	std::unique_ptr<DescriptorTable> mTemporalDescriptorTable;
+	std::vector<DescriptorWrites> mTemporalWrites;
+	std::unique_ptr<PipelineLayout> mTemporalPipelineLayout;
+	std::unique_ptr<ComputePipeline> mTemporalPipeline;
+
 	std::unique_ptr<ShaderCompiler> mCompiler;
 
 	std::unique_ptr<PostProcessPass> mPostProcessPass;
 	PostProcessType mPostProcessType = PostProcessType::NONE;
+	DenoiserSettings mDenoiserSettings;
 
 	uint32_t mFrame = 0;
 
+	// the camera of the last recorded frame and whether it moved since
+	Matrix4f mPrevView = Matrix4f::IDENTITY;
+	Matrix4f mPrevProjection = Matrix4f::IDENTITY;
+	bool mReproject = false;
+
+	bool mInstancesDirty = false;
+
+	// file name and readback ticket of screenshots whose copy has not landed yet
+	std::vector<std::pair<std::string, ReadbackTicket>> mPendingScreenShots;
 };
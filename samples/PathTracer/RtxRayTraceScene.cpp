@@ -5,6 +5,18 @@
 #include "VK/CommandBuffer.h"
 #include "App.h"
 #include "App.h"
+#include <algorithm>
+#include <cmath>
+
+// what the scene may keep on the GPU for its textures, [ and ] halve and double it at run time
+static constexpr uint64_t DEFAULT_TEXTURE_BUDGET = 512ull << 20;
+// bounces per second of the animated instance
+static constexpr float INSTANCE_ANIMATION_FREQUENCY = 0.5f;
+
+static const VkTransformMatrixKHR IDENTITY_TRANSFORM = {1.0f, 0.0f, 0.0f, 0.0f,
+                                                        0.0f, 1.0f, 0.0f, 0.0f,
+                                                        0.0f, 0.0f, 1.0f, 0.0f};
+
 RtxRayTraceScene::RtxRayTraceScene(RaymanScene *scene)
     : mScene(scene)
 {
@@ -72,11 +84,25 @@ void RtxRayTraceScene::CreateBuffers()
     std::cout << "[SCENE ANALYZER] index buffer size = " << static_cast<double>(size) / 1000000.0 << " MB" << std::endl;
     Fill(mIndexBuffer, indices.data(), size, bufferUsage);
 
+    // =============== TEXTURES ===============
+
+    auto format = Format::R32G32B32_SFLOAT;
+    ImageTiling tiling = ImageTiling::LINEAR;
+
+    mHdrImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->hdrColumns.get(), format, tiling));
+    mHdrImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->hdrConditional.get(), format, tiling));
+    mHdrImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->hdrMarginal.get(), format, tiling));
+
+    CreateTextureStreamer();
+
     // =============== MATERIAL BUFFER ===============
 
-    size = sizeof(mScene->materials[0]) * mScene->materials.size();
+    // texture ids stay scene indices, the streaming buffer maps them to the resident image's bindless handle
+    std::vector<Material> materials = mScene->materials;
+
+    size = sizeof(materials[0]) * materials.size();
     std::cout << "[SCENE ANALYZER] material buffer size = " << static_cast<double>(size) / 1000000.0 << " MB" << std::endl;
-    Fill(mMaterialBuffer, mScene->materials.data(), size, BufferUsage::STORAGE);
+    Fill(mMaterialBuffer, materials.data(), size, BufferUsage::STORAGE);
 
     // =============== OFFSET BUFFER ===============
 
@@ -90,26 +116,10 @@ void RtxRayTraceScene::CreateBuffers()
     std::cout << "[SCENE ANALYZER] light buffer size = " << static_cast<double>(size) / 1000000.0 << " MB" << std::endl;
     Fill(mLightsBuffer, mScene->lights.data(), size, BufferUsage::STORAGE);
 
-    auto format = Format::R32G32B32_SFLOAT;
-    ImageTiling tiling = ImageTiling::LINEAR;
-
-    mHdrImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->hdrColumns.get(), format, tiling));
-    mHdrImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->hdrConditional.get(), format, tiling));
-    mHdrImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->hdrMarginal.get(), format, tiling));
-
-    for (const auto &textureData : mScene->textureDatas)
-        mTextureImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), textureData.get()));
 }
 
 void RtxRayTraceScene::Build()
 {
-    // Add a dummy texture for texture samplers in Vulkan
-    if (mScene->textureDatas.empty())
-    {
-        mScene->textureDatas.emplace_back(std::make_unique<ImageData>());
-        mTextureImages.emplace_back(new Texture(*App::Instance().GetGraphicsContext()->GetDevice(), mScene->textureDatas.back().get()));
-    }
-
     if (mScene->lights.empty())
     {
         Light light;
@@ -158,6 +168,16 @@ void RtxRayTraceScene::SetPostProcessType(PostProcessType type)
     mRtxRayTracePass->SetPostProcessType(type);
 }
 
+void RtxRayTraceScene::SetDenoiserSettings(const DenoiserSettings &settings)
+{
+    mRtxRayTracePass->SetDenoiserSettings(settings);
+}
+
+const DenoiserSettings &RtxRayTraceScene::GetDenoiserSettings() const
+{
+    return mRtxRayTracePass->GetDenoiserSettings();
+}
+
 void RtxRayTraceScene::SaveOutputImageToDisk()
 {
     mRtxRayTracePass->SaveOutputImageToDisk();
@@ -165,10 +185,80 @@ void RtxRayTraceScene::SaveOutputImageToDisk()
 
 void RtxRayTraceScene::Update()
 {
+    if (mAnimateInstance)
+    {
+        mAnimationTime += App::Instance().GetTimer().GetDeltaTime();
+
+        VkTransformMatrixKHR transform = IDENTITY_TRANSFORM;
+        transform.matrix[1][3] = mAnimationAmplitude * std::sin(mAnimationTime * 2.f * Math::PI * INSTANCE_ANIMATION_FREQUENCY);
+        mRtxRayTracePass->SetInstanceTransform(0, transform);
+    }
+
     mRtxRayTracePass->Update();
 }
 
 void RtxRayTraceScene::Render()
 {
     mRtxRayTracePass->Render();
-}
\ No newline at end of file
+}
+
+void RtxRayTraceScene::SetTextureBudget(uint64_t budgetBytes)
+{
+    mTextureStreamer->SetBudget(budgetBytes);
+    std::cout << "[TEXTURE STREAMER] Budget set to " << static_cast<double>(budgetBytes) / 1000000.0 << " MB" << std::endl;
+}
+
+void RtxRayTraceScene::ToggleInstanceAnimation()
+{
+    if (mScene->meshInstances.empty())
+        return;
+
+    mAnimateInstance = !mAnimateInstance;
+    if (!mAnimateInstance)
+    {
+        // back where the scene placed it
+        mRtxRayTracePass->SetInstanceTransform(0, IDENTITY_TRANSFORM);
+        return;
+    }
+
+    // the vertices are already in world space, a quarter of the instance's largest extent moves it visibly at any scene scale
+    const auto &vertices = mScene->meshes[mScene->meshInstances[0].meshId]->vertices;
+    Vector3f minimum = vertices.empty() ? Vector3f(0.f) : vertices[0].position;
+    Vector3f maximum = minimum;
+    for (const auto &vertex : vertices)
+    {
+        minimum = Vector3f(std::min(minimum.x, vertex.position.x), std::min(minimum.y, vertex.position.y), std::min(minimum.z, vertex.position.z));
+        maximum = Vector3f(std::max(maximum.x, vertex.position.x), std::max(maximum.y, vertex.position.y), std::max(maximum.z, vertex.position.z));
+    }
+    mAnimationAmplitude = 0.25f * std::max({maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z});
+    mAnimationTime = 0.f;
+
+    // emissive triangles of the instance stay in the light buffer where they were loaded
+    std::cout << "[SCENE ANALYZER] Animating mesh instance 0, the TLAS is refit every frame" << std::endl;
+}
+
+void RtxRayTraceScene::CreateTextureStreamer()
+{
+    Device &device = *App::Instance().GetGraphicsContext()->GetDevice();
+    if (!device.IsTextureCompressionBCSupported())
+    {
+        // the jobs assumed BC support, drop them before loading again as plain mips
+        std::cout << "[SCENE ANALYZER] No BC texture support, textures are imported as uncompressed mips" << std::endl;
+        mScene->textureLoader.Cancel();
+        for (size_t i = 0; i < mScene->texturePaths.size(); ++i)
+            mScene->textureJobs[i] = mScene->textureLoader.Request(mScene->texturePaths[i], mScene->GetTextureImportSettings(i, false), TextureLoadMode::STREAMED);
+    }
+
+    // the jobs keep running, textures show placeholders until theirs finish
+    mTextureStreamer = std::make_unique<TextureStreamer>(device, (uint32_t)App::Instance().GetGraphicsContext()->GetSwapChain()->GetImages().size(), DEFAULT_TEXTURE_BUDGET);
+    for (size_t i = 0; i < mScene->texturePaths.size(); ++i)
+        mTextureStreamer->AddTexture(mScene->textureJobs[i], mScene->textureRoles[i], mScene->texturePaths[i]);
+    mTextureStreamer->CreateFrameBuffers();
+
+    // the streamer holds the futures now
+    mScene->textureJobs.clear();
+    mScene->textureLoader.Clear();
+
+    std::cout << "[SCENE ANALYZER] Streaming " << mTextureStreamer->GetTextureCount() << " textures within "
+              << static_cast<double>(DEFAULT_TEXTURE_BUDGET) / 1000000.0 << " MB" << std::endl;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "RaymanScene.h"
 #include "RtxRayTracePass.h"
+#include "TextureStreamer.h"
 class RtxRayTraceScene
 {
 public:
@@ -36,9 +37,9 @@ public:
         return mLightsBuffer.get();
     }
 
-    const std::vector<std::unique_ptr<class Texture>> &GetTextures() const
+    TextureStreamer *GetTextureStreamer() const
     {
-        return mTextureImages;
+        return mTextureStreamer.get();
     }
 
     const std::vector<std::unique_ptr<class Texture>> &GetHDRTextures() const
@@ -51,11 +52,6 @@ public:
         return !mHdrImages.empty();
     }
 
-    uint32_t GetTextureSize() const
-    {
-        return (uint32_t)mTextureImages.size();
-    }
-
     RaymanScene *Get()
     {
         return mScene;
@@ -65,6 +61,11 @@ public:
 
     void SetRenderState(RenderState state);
     void SetPostProcessType(PostProcessType type);
+    void SetDenoiserSettings(const DenoiserSettings &settings);
+    const DenoiserSettings &GetDenoiserSettings() const;
+    void SetTextureBudget(uint64_t budgetBytes);
+    // moves the first mesh instance up and down, its TLAS instance is refit every frame while it does
+    void ToggleInstanceAnimation();
 
     void SaveOutputImageToDisk();
 
@@ -72,11 +73,14 @@ public:
     void Render();
 
 private:
+    // hands the scene's texture jobs to the streamer, materials keep indexing textures by scene id
+    void CreateTextureStreamer();
+
     RaymanScene *mScene;
 
     std::unique_ptr<class RtxRayTracePass> mRtxRayTracePass;
 
-    std::vector<std::unique_ptr<Texture>> mTextureImages;
+    std::unique_ptr<TextureStreamer> mTextureStreamer;
     std::vector<std::unique_ptr<Texture>> mHdrImages;
 
     std::unique_ptr<class GpuBuffer> mVertexBuffer;
@@ -84,4 +88,8 @@ private:
     std::unique_ptr<class GpuBuffer> mMaterialBuffer;
     std::unique_ptr<class GpuBuffer> mOffsetBuffer;
     std::unique_ptr<class GpuBuffer> mLightsBuffer;
+
+    bool mAnimateInstance = false;
+    float mAnimationTime = 0.f;
+    float mAnimationAmplitude = 0.f;
 };
@@ -2,13 +2,15 @@
 #include "VK/Buffer.h"
 #include "VK/CommandBuffer.h"
 #include "VK/CommandPool.h"
+#include "VK/BindlessTable.h"
 
 Texture::Texture(Device &device,
 				 ImageData *texture,
 				 Format format,
 				 ImageTiling tiling)
+	: mDevice(device)
 {
-	auto stagingBuffer = device.CreateCPUBuffer(texture->GetPixels<void>(), texture->GetImageSize(), BufferUsage::TRANSFER_SRC);
+	auto stagingBuffer = device.CreateCPUBuffer(texture->GetPixels<void>(), (uint32_t)texture->GetImageSize(), BufferUsage::TRANSFER_SRC);
 
 	const auto extent = VkExtent2D{static_cast<uint32_t>(texture->GetWidth()), static_cast<uint32_t>(texture->GetHeight())};
 
@@ -17,4 +19,34 @@ Texture::Texture(Device &device,
 	mImage->UploadDataFrom(texture->GetImageSize(), stagingBuffer.get(), ImageLayout::UNDEFINED, ImageLayout::SHADER_READ_ONLY_OPTIMAL);
 
 	mSampler.reset(new Sampler(device));
+
+	// without a bindless table the texture is only reachable through its view
+	if (device.GetBindlessTable())
+		mBindlessHandle = device.GetBindlessTable()->RegisterTexture(mImage->GetView(), mSampler.get());
+}
+
+Texture::Texture(Device &device, const TextureData &texture)
+	: mDevice(device)
+{
+	auto stagingBuffer = device.CreateCPUBuffer((void *)texture.data.data(), (uint32_t)texture.data.size(), BufferUsage::TRANSFER_SRC);
+
+	const uint32_t mipCount = (uint32_t)texture.mips.size();
+	mImage = std::make_unique<GpuImage2D>(device, texture.width, texture.height, texture.format, ImageTiling::OPTIMAL, ImageUsage::TRANSFER_DST | ImageUsage::SAMPLED, mipCount);
+
+	std::vector<uint64_t> mipOffsets;
+	for (const auto &mip : texture.mips)
+		mipOffsets.emplace_back(mip.offset);
+	mImage->UploadMipsFrom(stagingBuffer.get(), mipOffsets, ImageLayout::UNDEFINED, ImageLayout::SHADER_READ_ONLY_OPTIMAL);
+
+	mSampler.reset(new Sampler(device));
+	mSampler->SetMaxMipMapLevel((float)mipCount);
+
+	if (device.GetBindlessTable())
+		mBindlessHandle = device.GetBindlessTable()->RegisterTexture(mImage->GetView(), mSampler.get());
+}
+
+Texture::~Texture()
+{
+	if (mDevice.GetBindlessTable())
+		mDevice.GetBindlessTable()->ReleaseTexture(mBindlessHandle);
 }
\ No newline at end of file
@@ -9,13 +9,18 @@ public:
 			ImageData *texture,
 			Format format =Format::R8G8B8A8_UNORM,
 			ImageTiling tiling = ImageTiling::OPTIMAL);
-	~Texture() = default;
+	// every mip of an imported texture, trilinear sampled
+	Texture(Device &device, const TextureData &texture);
+	~Texture();
 
 	const GpuImage2D *GetImage() const { return mImage.get(); }
 	const ImageView2D *GetImageView() const { return mImage->GetView(); }
 	Sampler* GetSampler() const { return mSampler.get(); }
+	BindlessHandle GetBindlessHandle() const { return mBindlessHandle; }
 
 private:
+	Device &mDevice;
 	std::unique_ptr<GpuImage2D> mImage;
 	std::unique_ptr<Sampler> mSampler;
+	BindlessHandle mBindlessHandle = INVALID_BINDLESS_HANDLE;
 };
\ No newline at end of file
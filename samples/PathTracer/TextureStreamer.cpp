@@ -0,0 +1,523 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <tuple>
+#include "VK/Buffer.h"
+#include "VK/BindlessTable.h"
+
+namespace
+{
+    // levels no larger than this are uploaded as soon as a texture loads and never evicted
+    constexpr uint32_t MIP_TAIL_SIZE = 128;
+    // a texture no hit asked for in this many frames only keeps its mip tail wanted
+    constexpr uint64_t REQUEST_TIMEOUT_FRAMES = 240;
+    constexpr uint32_t MAX_PENDING_READS = 4;
+    constexpr uint64_t MAX_UPLOAD_BYTES_PER_FRAME = 64ull << 20;
+
+    uint64_t AlignLevel(uint64_t offset)
+    {
+        return (offset + 15) & ~15ull;
+    }
+
+    const char *GetTextureFormatName(const Format &format)
+    {
+        switch (format.GetHandle())
+        {
+        case Format::BC1_RGB_UNORM_BLOCK:
+            return "BC1";
+        case Format::BC3_UNORM_BLOCK:
+            return "BC3";
+        case Format::BC4_UNORM_BLOCK:
+            return "BC4";
+        case Format::BC5_UNORM_BLOCK:
+            return "BC5";
+        case Format::BC7_UNORM_BLOCK:
+            return "BC7";
+        case Format::R8_UNORM:
+            return "R8";
+        case Format::R8G8_UNORM:
+            return "RG8";
+        default:
+            return "RGBA8";
+        }
+    }
+
+    template <typename T>
+    bool IsReady(const std::future<T> &future)
+    {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    template <typename T>
+    bool IsReady(const std::shared_future<T> &future)
+    {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+}
+
+TextureStreamer::TextureStreamer(Device &device, uint32_t frameCount, uint64_t budgetBytes)
+    : mDevice(device), mFrameCount(frameCount), mBudget(budgetBytes)
+{
+    mSampler.reset(new Sampler(device));
+    // resident images differ in level count, one sampler covers them all
+    mSampler->SetMaxMipMapLevel(16.0f);
+
+    // neutral values per TextureRole: mid grey albedo, white emission multiplier, flat normal, opaque mask
+    const uint8_t placeholders[4][4] = {{188, 188, 188, 255}, {255, 255, 255, 255}, {128, 128, 255, 255}, {255, 255, 255, 255}};
+    for (const auto &texel : placeholders)
+    {
+        auto stagingBuffer = device.CreateCPUBuffer((void *)texel, sizeof(texel), BufferUsage::TRANSFER_SRC);
+        auto image = std::make_unique<GpuImage2D>(device, 1, 1, Format::R8G8B8A8_UNORM, ImageTiling::OPTIMAL, ImageUsage::TRANSFER_DST | ImageUsage::SAMPLED);
+        image->UploadDataFrom(sizeof(texel), stagingBuffer.get(), ImageLayout::UNDEFINED, ImageLayout::SHADER_READ_ONLY_OPTIMAL);
+        // without a bindless table the placeholders take the first slots of the texture array
+        if (device.GetBindlessTable())
+            mPlaceholderHandles.emplace_back(device.GetBindlessTable()->RegisterTexture(image->GetView(), mSampler.get()));
+        else
+            mPlaceholderHandles.emplace_back((BindlessHandle)mPlaceholderHandles.size());
+        mPlaceholderImages.emplace_back(std::move(image));
+    }
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    for (auto &texture : mTextures)
+    {
+        if (texture.pendingRead.valid())
+            texture.pendingRead.wait();
+        if (texture.image && mDevice.GetBindlessTable())
+            mDevice.GetBindlessTable()->ReleaseTexture(texture.handle);
+    }
+    ReleaseRetired(true);
+    if (mDevice.GetBindlessTable())
+        for (auto handle : mPlaceholderHandles)
+            mDevice.GetBindlessTable()->ReleaseTexture(handle);
+}
+
+uint32_t TextureStreamer::AddTexture(std::shared_future<TextureLoadResult> job, TextureRole role, const std::string &path)
+{
+    StreamedTexture texture;
+    texture.job = std::move(job);
+    texture.role = role;
+    texture.path = path;
+    // without a bindless table every texture keeps its slot and GetImageInfos puts the placeholder there
+    texture.handle = mDevice.GetBindlessTable() ? mPlaceholderHandles[(uint32_t)role] : (BindlessHandle)(mPlaceholderHandles.size() + mTextures.size());
+    mTextures.emplace_back(std::move(texture));
+    return (uint32_t)mTextures.size() - 1;
+}
+
+void TextureStreamer::CreateFrameBuffers()
+{
+    const std::vector<GpuEntry> entries(std::max<size_t>(mTextures.size(), 1), GpuEntry{0, 0, UINT32_MAX, 0});
+    mFrameBuffers.clear();
+    for (uint32_t i = 0; i < mFrameCount; ++i)
+        mFrameBuffers.emplace_back(mDevice.CreateCPUStorageBuffer((void *)entries.data(), entries.size() * sizeof(GpuEntry)));
+}
+
+bool TextureStreamer::BeginFrame(uint32_t frameIndex, CommandBuffer *commandBuffer)
+{
+    ++mFrame;
+    bool changed = false;
+
+    ReleaseRetired(false);
+
+    // the requests of this frame's previous use, its fence has been waited on
+    GpuEntry *entries = mFrameBuffers[frameIndex]->MapWhole<GpuEntry>();
+    for (size_t i = 0; i < mTextures.size(); ++i)
+    {
+        StreamedTexture &texture = mTextures[i];
+        if (texture.mipCount > 0 && entries[i].requestedLevel != UINT32_MAX)
+        {
+            texture.requestedLevel = std::min(entries[i].requestedLevel, texture.mipCount - 1);
+            texture.lastRequestFrame = mFrame;
+        }
+    }
+
+    for (auto &texture : mTextures)
+        if (!texture.loaded && IsReady(texture.job))
+            changed |= FinishLoad(texture, commandBuffer);
+
+    uint64_t uploadedBytes = 0;
+    for (auto &texture : mTextures)
+    {
+        if (uploadedBytes >= MAX_UPLOAD_BYTES_PER_FRAME)
+            break;
+        if (!texture.pendingRead.valid() || !IsReady(texture.pendingRead))
+            continue;
+
+        const std::vector<uint8_t> levels = texture.pendingRead.get();
+        if (texture.pendingImageBase < texture.imageBase)
+            mReservedBytes -= GetLevelsSize(texture, texture.pendingImageBase);
+        MakeResident(texture, texture.pendingBase, texture.pendingImageBase, levels, commandBuffer);
+        uploadedBytes += levels.size();
+        changed = true;
+    }
+
+    // a lowered budget shrinks even the textures still in view, the retired images go once the frames in flight are done
+    while (mResidentBytes + mReservedBytes > mBudget && EvictOne(nullptr, true, commandBuffer))
+        changed = true;
+
+    changed |= ScheduleReads(commandBuffer);
+
+    for (size_t i = 0; i < mTextures.size(); ++i)
+    {
+        const StreamedTexture &texture = mTextures[i];
+        entries[i] = texture.image ? GpuEntry{(int32_t)texture.handle, texture.imageBase, UINT32_MAX, texture.residentBase}
+                                   : GpuEntry{(int32_t)texture.handle, 0, UINT32_MAX, 0};
+    }
+    mFrameBuffers[frameIndex]->Unmap();
+
+    return changed;
+}
+
+bool TextureStreamer::FinishLoad(StreamedTexture &texture, CommandBuffer *commandBuffer)
+{
+    texture.loaded = true;
+
+    const TextureLoadResult &result = texture.job.get();
+    if (result.cacheFile)
+    {
+        const TextureCacheHeader &header = result.cacheFile->GetHeader();
+        texture.file = result.cacheFile;
+        texture.format = Format((VkFormat)header.vkFormat);
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.mipCount = header.levelCount;
+        for (const auto &level : result.cacheFile->GetLevels())
+            texture.levelSizes.emplace_back(level.byteLength);
+    }
+    else if (!result.texture.mips.empty())
+    {
+        texture.memory = &result.texture;
+        texture.format = result.texture.format;
+        texture.width = result.texture.width;
+        texture.height = result.texture.height;
+        texture.mipCount = (uint32_t)result.texture.mips.size();
+        for (const auto &mip : result.texture.mips)
+            texture.levelSizes.emplace_back(mip.size);
+    }
+    else
+    {
+        // keeps the placeholder, the rest of the scene still renders
+        std::cout << "[ERROR] Failed to load texture image:" << texture.path << std::endl;
+        return false;
+    }
+
+    texture.tailBase = texture.mipCount - 1;
+    while (texture.tailBase > 0 && std::max(texture.width >> (texture.tailBase - 1), texture.height >> (texture.tailBase - 1)) <= MIP_TAIL_SIZE)
+        texture.tailBase--;
+
+    // nothing is on the GPU yet, the first upload allocates the image for the mip tail
+    texture.imageBase = texture.mipCount;
+    texture.residentBase = texture.mipCount;
+    MakeResident(texture, texture.tailBase, texture.tailBase, ReadLevels(texture.file, texture.memory, texture.levelSizes, texture.tailBase, texture.mipCount), commandBuffer);
+
+    std::cout << "[TEXTURE STREAMER] " << std::filesystem::path(texture.path).filename().string() << " " << texture.width << "x" << texture.height << " "
+              << GetTextureFormatName(texture.format) << " with " << texture.mipCount << " mips ready after " << result.milliseconds << " ms"
+              << (result.fromCache ? " (cached)" : "") << ", mip tail " << std::max(texture.width >> texture.tailBase, 1u) << "x"
+              << std::max(texture.height >> texture.tailBase, 1u) << " resident" << std::endl;
+    return true;
+}
+
+uint32_t TextureStreamer::GetDesiredBase(const StreamedTexture &texture) const
+{
+    if (!texture.image)
+        return texture.residentBase;
+    if (texture.requestedLevel == UINT32_MAX || mFrame - texture.lastRequestFrame > REQUEST_TIMEOUT_FRAMES)
+        return texture.tailBase;
+    return std::min(texture.requestedLevel, texture.tailBase);
+}
+
+uint64_t TextureStreamer::GetLevelsSize(const StreamedTexture &texture, uint32_t base) const
+{
+    uint64_t size = 0;
+    for (uint32_t level = base; level < texture.mipCount; ++level)
+        size += texture.levelSizes[level];
+    return size;
+}
+
+std::vector<uint8_t> TextureStreamer::ReadLevels(const std::shared_ptr<TextureCacheFile> &file, const TextureData *memory,
+                                                 const std::vector<uint64_t> &levelSizes, uint32_t base, uint32_t end)
+{
+    uint64_t size = 0;
+    for (uint32_t level = base; level < end; ++level)
+        size = AlignLevel(size + levelSizes[level]);
+
+    std::vector<uint8_t> levels(size);
+    uint64_t offset = 0;
+    for (uint32_t level = base; level < end; ++level)
+    {
+        if (file)
+        {
+            // a cache changed under us only costs a wrong looking level, not the frame
+            if (!file->ReadLevel(level, levels.data() + offset))
+                std::memset(levels.data() + offset, 0, levelSizes[level]);
+        }
+        else
+            std::memcpy(levels.data() + offset, memory->data.data() + memory->mips[level].offset, levelSizes[level]);
+        offset = AlignLevel(offset + levelSizes[level]);
+    }
+    return levels;
+}
+
+void TextureStreamer::MakeResident(StreamedTexture &texture, uint32_t base, uint32_t imageBase, const std::vector<uint8_t> &levels, CommandBuffer *commandBuffer)
+{
+    if (!texture.image || imageBase < texture.imageBase)
+        Reallocate(texture, imageBase, commandBuffer);
+
+    auto stagingBuffer = mDevice.CreateCPUBuffer((void *)levels.data(), (uint32_t)levels.size(), BufferUsage::TRANSFER_SRC);
+
+    std::vector<uint64_t> mipOffsets;
+    uint64_t offset = 0;
+    for (uint32_t level = base; level < texture.residentBase; ++level)
+    {
+        mipOffsets.emplace_back(offset);
+        offset = AlignLevel(offset + texture.levelSizes[level]);
+    }
+    // the levels above have no data yet and nothing samples them, their contents can be discarded
+    texture.image->RecordUploadMips(commandBuffer, stagingBuffer.get(), mipOffsets, base - texture.imageBase, ImageLayout::UNDEFINED, ImageLayout::SHADER_READ_ONLY_OPTIMAL);
+    mRetiredStaging.push_back(RetiredStaging{mFrame + mFrameCount, std::move(stagingBuffer)});
+
+    texture.residentBase = base;
+    mUploadedBytes += levels.size();
+}
+
+void TextureStreamer::Reallocate(StreamedTexture &texture, uint32_t imageBase, CommandBuffer *commandBuffer)
+{
+    const uint32_t width = std::max(texture.width >> imageBase, 1u);
+    const uint32_t height = std::max(texture.height >> imageBase, 1u);
+    const uint32_t mipCount = texture.mipCount - imageBase;
+    auto image = std::make_unique<GpuImage2D>(mDevice, width, height, texture.format, ImageTiling::OPTIMAL, ImageUsage::TRANSFER_SRC | ImageUsage::TRANSFER_DST | ImageUsage::SAMPLED, mipCount);
+
+    const VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipCount, 0, 1};
+    commandBuffer->ImageBarrier(image->GetHandle(), Access::NONE, Access::TRANSFER_WRITE, ImageLayout::UNDEFINED, ImageLayout::TRANSFER_DST_OPTIMAL, range);
+
+    // the uploaded levels both images hold, the rest of the new image is filled by later uploads
+    const uint32_t firstCopied = std::max(texture.residentBase, imageBase);
+    if (texture.image && firstCopied < texture.mipCount)
+    {
+        const VkImageSubresourceRange sourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, firstCopied - texture.imageBase, texture.mipCount - firstCopied, 0, 1};
+        commandBuffer->ImageBarrier(texture.image->GetHandle(), Access::SHADER_READ, Access::TRANSFER_READ, ImageLayout::SHADER_READ_ONLY_OPTIMAL, ImageLayout::TRANSFER_SRC_OPTIMAL, sourceRange);
+
+        std::vector<VkImageCopy> regions;
+        for (uint32_t level = firstCopied; level < texture.mipCount; ++level)
+        {
+            VkImageCopy region{};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - texture.imageBase, 0, 1};
+            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - imageBase, 0, 1};
+            region.extent = {std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1};
+            regions.emplace_back(region);
+        }
+        commandBuffer->CopyImage(texture.image->GetHandle(), ImageLayout::TRANSFER_SRC_OPTIMAL, image->GetHandle(), ImageLayout::TRANSFER_DST_OPTIMAL, regions);
+    }
+
+    // levels without data are transitioned too, the view covers them even though the lod clamp keeps them unsampled
+    commandBuffer->ImageBarrier(image->GetHandle(), Access::TRANSFER_WRITE, Access::SHADER_READ, ImageLayout::TRANSFER_DST_OPTIMAL, ImageLayout::SHADER_READ_ONLY_OPTIMAL, range);
+
+    const BindlessHandle handle = mDevice.GetBindlessTable() ? mDevice.GetBindlessTable()->RegisterTexture(image->GetView(), mSampler.get()) : texture.handle;
+
+    // the frames in flight still sample the old image through the old handle, its memory stays taken until then
+    if (texture.image)
+    {
+        const uint64_t bytes = GetLevelsSize(texture, texture.imageBase);
+        mResidentBytes -= bytes;
+        mRetiredBytes += bytes;
+        mRetired.push_back(RetiredImage{mFrame + mFrameCount, std::move(texture.image), mDevice.GetBindlessTable() ? texture.handle : INVALID_BINDLESS_HANDLE, bytes});
+    }
+
+    texture.image = std::move(image);
+    texture.handle = handle;
+    texture.imageBase = imageBase;
+    texture.residentBase = std::max(texture.residentBase, imageBase);
+    mResidentBytes += GetLevelsSize(texture, imageBase);
+}
+
+bool TextureStreamer::EvictOne(const StreamedTexture *keep, bool force, CommandBuffer *commandBuffer)
+{
+    StreamedTexture *victim = nullptr;
+    bool victimUnwanted = false;
+    for (auto &texture : mTextures)
+    {
+        if (&texture == keep || !texture.image || texture.pendingRead.valid() || texture.imageBase >= texture.tailBase)
+            continue;
+
+        const bool unwanted = texture.imageBase < GetDesiredBase(texture);
+        if (!unwanted && !force)
+            continue;
+
+        // finer than requested first, then the longest unseen, then the finest resident
+        if (!victim ||
+            std::make_tuple(!unwanted, texture.lastRequestFrame, texture.imageBase) <
+                std::make_tuple(!victimUnwanted, victim->lastRequestFrame, victim->imageBase))
+        {
+            victim = &texture;
+            victimUnwanted = unwanted;
+        }
+    }
+
+    if (!victim)
+        return false;
+
+    // levels allocated but not uploaded yet go first, then the finest uploaded one; the rest is copied on the GPU
+    const uint32_t imageBase = victim->residentBase > victim->imageBase ? victim->residentBase : victim->imageBase + 1;
+    const uint64_t bytes = GetLevelsSize(*victim, victim->imageBase);
+    Reallocate(*victim, imageBase, commandBuffer);
+    mEvictedBytes += bytes - GetLevelsSize(*victim, imageBase);
+    return true;
+}
+
+bool TextureStreamer::ScheduleReads(CommandBuffer *commandBuffer)
+{
+    bool evicted = false;
+
+    uint32_t pendingCount = 0;
+    std::vector<StreamedTexture *> candidates;
+    for (auto &texture : mTextures)
+    {
+        if (texture.pendingRead.valid())
+            pendingCount++;
+        else if (texture.image && GetDesiredBase(texture) < texture.residentBase)
+            candidates.emplace_back(&texture);
+    }
+
+    // furthest from the requested level first, the most recently seen break ties
+    std::sort(candidates.begin(), candidates.end(), [this](const StreamedTexture *a, const StreamedTexture *b)
+              {
+                  const uint32_t missingA = a->residentBase - GetDesiredBase(*a);
+                  const uint32_t missingB = b->residentBase - GetDesiredBase(*b);
+                  if (missingA != missingB)
+                      return missingA > missingB;
+                  return a->lastRequestFrame > b->lastRequestFrame; });
+
+    for (StreamedTexture *texture : candidates)
+    {
+        if (pendingCount >= MAX_PENDING_READS)
+            break;
+
+        // one level at a time, the picture sharpens progressively; a request beyond the image allocates the whole
+        // requested chain at once, so the image is not rebuilt for every level
+        const uint32_t base = texture->residentBase - 1;
+        const uint32_t imageBase = std::min(texture->imageBase, GetDesiredBase(*texture));
+        const uint64_t extraBytes = imageBase < texture->imageBase ? GetLevelsSize(*texture, imageBase) : 0;
+        while (mResidentBytes + mReservedBytes + extraBytes > mBudget && EvictOne(texture, false, commandBuffer))
+            evicted = true;
+        // what eviction replaced is only freed once the frames in flight are done with it
+        if (extraBytes > 0 && mResidentBytes + mRetiredBytes + mReservedBytes + extraBytes > mBudget)
+            continue;
+
+        mReservedBytes += extraBytes;
+        texture->pendingBase = base;
+        texture->pendingImageBase = imageBase;
+        texture->pendingRead = ThreadPool::Instance().Submit([file = texture->file, memory = texture->memory, levelSizes = texture->levelSizes, base]()
+                                                             { return ReadLevels(file, memory, levelSizes, base, base + 1); });
+        pendingCount++;
+    }
+
+    return evicted;
+}
+
+void TextureStreamer::ReleaseRetired(bool all)
+{
+    while (!mRetired.empty() && (all || mRetired.front().frame <= mFrame))
+    {
+        if (mRetired.front().handle != INVALID_BINDLESS_HANDLE)
+            mDevice.GetBindlessTable()->ReleaseTexture(mRetired.front().handle);
+        mRetiredBytes -= mRetired.front().bytes;
+        mRetired.pop_front();
+    }
+    while (!mRetiredStaging.empty() && (all || mRetiredStaging.front().frame <= mFrame))
+        mRetiredStaging.pop_front();
+}
+
+const Buffer *TextureStreamer::GetFrameBuffer(uint32_t frameIndex) const
+{
+    return mFrameBuffers[frameIndex].get();
+}
+
+uint32_t TextureStreamer::GetTextureCount() const
+{
+    return (uint32_t)mTextures.size();
+}
+
+std::vector<DescriptorImageInfo> TextureStreamer::GetImageInfos() const
+{
+    std::vector<DescriptorImageInfo> infos;
+    for (const auto &image : mPlaceholderImages)
+        infos.emplace_back(DescriptorImageInfo{mSampler->GetHandle(), image->GetView(), ImageLayout::SHADER_READ_ONLY_OPTIMAL});
+    for (const auto &texture : mTextures)
+    {
+        const GpuImage2D *image = texture.image ? texture.image.get() : mPlaceholderImages[(uint32_t)texture.role].get();
+        infos.emplace_back(DescriptorImageInfo{mSampler->GetHandle(), image->GetView(), ImageLayout::SHADER_READ_ONLY_OPTIMAL});
+    }
+    return infos;
+}
+
+void TextureStreamer::SetBudget(uint64_t budgetBytes)
+{
+    mBudget = budgetBytes;
+}
+
+uint64_t TextureStreamer::GetBudget() const
+{
+    return mBudget;
+}
+
+TextureStreamingStats TextureStreamer::GetStats() const
+{
+    TextureStreamingStats stats;
+    stats.textureCount = (uint32_t)mTextures.size();
+    stats.budgetBytes = mBudget;
+    stats.residentBytes = mResidentBytes;
+    stats.retiredBytes = mRetiredBytes;
+    stats.uploadedBytes = mUploadedBytes;
+    stats.evictedBytes = mEvictedBytes;
+    for (const auto &texture : mTextures)
+    {
+        if (texture.image)
+        {
+            stats.loadedCount++;
+            stats.fullBytes += GetLevelsSize(texture, 0);
+            if (texture.residentBase == 0)
+                stats.fullyResidentCount++;
+        }
+        if (texture.pendingRead.valid())
+            stats.pendingReadCount++;
+    }
+    return stats;
+}
+
+void TextureStreamer::PrintStats() const
+{
+    const TextureStreamingStats stats = GetStats();
+    std::cout << "[TEXTURE STREAMER] " << stats.loadedCount << "/" << stats.textureCount << " textures loaded, "
+              << stats.fullyResidentCount << " fully resident, " << stats.pendingReadCount << " reads pending" << std::endl;
+    std::cout << "[TEXTURE STREAMER] Resident " << static_cast<double>(stats.residentBytes) / 1000000.0 << " MB of "
+              << static_cast<double>(stats.fullBytes) / 1000000.0 << " MB, retired " << static_cast<double>(stats.retiredBytes) / 1000000.0
+              << " MB, budget " << static_cast<double>(stats.budgetBytes) / 1000000.0
+              << " MB, uploaded " << static_cast<double>(stats.uploadedBytes) / 1000000.0 << " MB, evicted "
+              << static_cast<double>(stats.evictedBytes) / 1000000.0 << " MB" << std::endl;
+
+    struct DirectoryReport
+    {
+        uint32_t count = 0;
+        uint64_t residentBytes = 0;
+        uint64_t fullBytes = 0;
+    };
+    std::map<std::string, DirectoryReport> reports;
+    for (const auto &texture : mTextures)
+    {
+        if (!texture.image)
+            continue;
+        DirectoryReport &report = reports[std::filesystem::path(texture.path).parent_path().filename().string()];
+        report.count++;
+        report.residentBytes += GetLevelsSize(texture, texture.imageBase);
+        report.fullBytes += GetLevelsSize(texture, 0);
+    }
+    for (const auto &[name, report] : reports)
+        std::cout << "[TEXTURE STREAMER] Textures " << name << ": " << report.count << " textures, "
+                  << static_cast<double>(report.residentBytes) / 1000000.0 << " MB of " << static_cast<double>(report.fullBytes) / 1000000.0
+                  << " MB resident" << std::endl;
+}
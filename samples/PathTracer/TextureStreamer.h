@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "labgraphics.h"
+
+struct TextureStreamingStats
+{
+    uint32_t textureCount = 0;
+    // load job done and mip tail on the GPU
+    uint32_t loadedCount = 0;
+    // every level on the GPU
+    uint32_t fullyResidentCount = 0;
+    uint32_t pendingReadCount = 0;
+    uint64_t budgetBytes = 0;
+    uint64_t residentBytes = 0;
+    // images replaced while frames in flight still sample them, counted against the budget until they are freed
+    uint64_t retiredBytes = 0;
+    // every level of the loaded textures, what the scene takes without streaming
+    uint64_t fullBytes = 0;
+    uint64_t uploadedBytes = 0;
+    uint64_t evictedBytes = 0;
+};
+
+// Keeps the path tracer textures inside a VRAM budget.
+// A texture shows a 1x1 placeholder until its load job finishes, then its mip tail is uploaded at once. When a
+// finer level is asked for the image is reallocated once for the whole requested chain and the finer levels are
+// streamed into it from the texture cache one level at a time, the textures furthest from what they were asked for
+// first. Uploads are recorded into the frame's command buffer. The requests come from the closest hit shader: each
+// hit writes the finest full resolution level its ray cone needs into this frame's streaming buffer, read back when
+// the frame comes round again. Over budget, levels no longer requested are dropped first, then those of the
+// textures unseen for longest.
+class TextureStreamer
+{
+public:
+    // one per texture in the per frame buffer, StreamedTexture in Raytracing.rchit
+    struct GpuEntry
+    {
+        int32_t handle;
+        // full resolution level of the image's mip 0
+        uint32_t imageBase;
+        // finest level any hit asked for, atomicMin on the GPU
+        uint32_t requestedLevel;
+        // finest full resolution level holding data, the image's finer levels are still streaming in
+        uint32_t residentBase;
+    };
+
+    TextureStreamer(Device &device, uint32_t frameCount, uint64_t budgetBytes);
+    ~TextureStreamer();
+
+    // the returned id is what materials refer to
+    uint32_t AddTexture(std::shared_future<TextureLoadResult> job, TextureRole role, const std::string &path);
+    // once every texture is added
+    void CreateFrameBuffers();
+
+    // Called while recording frame frameIndex, after its fence: takes the requests that frame made last time,
+    // finishes loads, records the uploads into commandBuffer ahead of the frame's trace, evicts and refills the
+    // frame's buffer. True when a texture changed on the GPU.
+    bool BeginFrame(uint32_t frameIndex, CommandBuffer *commandBuffer);
+
+    const Buffer *GetFrameBuffer(uint32_t frameIndex) const;
+    uint32_t GetTextureCount() const;
+    // for devices without a bindless table: the texture array indexed by the handles, placeholders first
+    std::vector<DescriptorImageInfo> GetImageInfos() const;
+
+    void SetBudget(uint64_t budgetBytes);
+    uint64_t GetBudget() const;
+
+    TextureStreamingStats GetStats() const;
+    // totals and the per asset directory residency
+    void PrintStats() const;
+
+private:
+    struct StreamedTexture
+    {
+        std::shared_future<TextureLoadResult> job;
+        TextureRole role = TextureRole::COLOR;
+        std::string path;
+        bool loaded = false;
+
+        // level sources: the cache file, or the mips kept by the job when no cache could be written
+        std::shared_ptr<TextureCacheFile> file;
+        const TextureData *memory = nullptr;
+        Format format = Format::R8G8B8A8_UNORM;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipCount = 0;
+        std::vector<uint64_t> levelSizes;
+
+        // levels [tailBase, mipCount) stay resident once loaded, the image holds [imageBase, mipCount) of which
+        // [residentBase, mipCount) have been uploaded
+        uint32_t tailBase = 0;
+        uint32_t imageBase = 0;
+        uint32_t residentBase = 0;
+        uint32_t requestedLevel = UINT32_MAX;
+        uint64_t lastRequestFrame = 0;
+
+        std::unique_ptr<GpuImage2D> image;
+        BindlessHandle handle = INVALID_BINDLESS_HANDLE;
+
+        // levels [pendingBase, residentBase) read on the thread pool, to go into an image of [pendingImageBase, mipCount)
+        std::future<std::vector<uint8_t>> pendingRead;
+        uint32_t pendingBase = 0;
+        uint32_t pendingImageBase = 0;
+    };
+
+    // freed once the frames recorded up to frame have executed
+    struct RetiredImage
+    {
+        uint64_t frame;
+        std::unique_ptr<GpuImage2D> image;
+        BindlessHandle handle;
+        uint64_t bytes;
+    };
+
+    struct RetiredStaging
+    {
+        uint64_t frame;
+        std::unique_ptr<CpuBuffer> buffer;
+    };
+
+    bool FinishLoad(StreamedTexture &texture, CommandBuffer *commandBuffer);
+    uint32_t GetDesiredBase(const StreamedTexture &texture) const;
+    uint64_t GetLevelsSize(const StreamedTexture &texture, uint32_t base) const;
+    // levels [base, end) packed with the 16 byte aligned offsets of TextureData
+    static std::vector<uint8_t> ReadLevels(const std::shared_ptr<TextureCacheFile> &file, const TextureData *memory,
+                                           const std::vector<uint64_t> &levelSizes, uint32_t base, uint32_t end);
+    // uploads levels [base, residentBase) into the image, reallocating it for [imageBase, mipCount) when it does not hold them
+    void MakeResident(StreamedTexture &texture, uint32_t base, uint32_t imageBase, const std::vector<uint8_t> &levels, CommandBuffer *commandBuffer);
+    // moves the texture into a new image of levels [imageBase, mipCount), the uploaded levels both hold are copied on the GPU
+    void Reallocate(StreamedTexture &texture, uint32_t imageBase, CommandBuffer *commandBuffer);
+    // shrinks the image of the cheapest victim by one level, false when nothing can go
+    bool EvictOne(const StreamedTexture *keep, bool force, CommandBuffer *commandBuffer);
+    // starts the reads of the textures furthest from their request, true when it had to evict
+    bool ScheduleReads(CommandBuffer *commandBuffer);
+    void ReleaseRetired(bool all);
+
+    Device &mDevice;
+    uint32_t mFrameCount;
+    uint64_t mBudget;
+    uint64_t mFrame = 0;
+
+    std::unique_ptr<Sampler> mSampler;
+    // 1x1 stand-ins per TextureRole while the load jobs run
+    std::vector<std::unique_ptr<GpuImage2D>> mPlaceholderImages;
+    std::vector<BindlessHandle> mPlaceholderHandles;
+
+    std::vector<StreamedTexture> mTextures;
+    std::vector<std::unique_ptr<CpuBuffer>> mFrameBuffers;
+    std::deque<RetiredImage> mRetired;
+    std::deque<RetiredStaging> mRetiredStaging;
+
+    // the images the textures hold, whether their levels are uploaded yet or not
+    uint64_t mResidentBytes = 0;
+    uint64_t mRetiredBytes = 0;
+    // the images the reads in flight will be uploaded into, counted against the budget before they arrive
+    uint64_t mReservedBytes = 0;
+    uint64_t mUploadedBytes = 0;
+    uint64_t mEvictedBytes = 0;
+};
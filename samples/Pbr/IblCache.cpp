@@ -0,0 +1,263 @@
+#include "IblCache.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include "labgraphics.h"
+#include "VK/Format.h"
+
+namespace
+{
+    constexpr uint8_t IDENTIFIER[12] = {0xAB, 'L', 'I', 'B', 'L', ' ', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    // bump when the layout changes, older caches are then rebuilt
+    constexpr uint32_t VERSION = 1;
+    // bump when IntegrateBrdfLut changes its output, the shipped LUT is then rebuilt on first run
+    constexpr uint32_t BRDF_LUT_VERSION = 1;
+
+    constexpr float PI = 3.1415926535f;
+    constexpr float EPSILON = 0.000001f;
+
+    uint64_t AlignPayload(uint64_t offset)
+    {
+        return (offset + 15) & ~15ull;
+    }
+
+    float RadicalInverseVdC(uint32_t bits)
+    {
+        bits = (bits << 16u) | (bits >> 16u);
+        bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+        bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+        bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+        bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+        return float(bits) * 2.3283064365386963e-10f;
+    }
+
+    // Schlick-GGX with the IBL k = roughness^2 / 2
+    float GeometrySchlickGGX(float cosTheta, float roughness)
+    {
+        const float k = (roughness * roughness) / 2.0f;
+        return cosTheta / (cosTheta * (1.0f - k) + k);
+    }
+}
+
+uint32_t IblImage::GetLevelWidth(uint32_t level) const
+{
+    return std::max(width >> level, 1u);
+}
+
+uint32_t IblImage::GetLevelHeight(uint32_t level) const
+{
+    return std::max(height >> level, 1u);
+}
+
+uint64_t IblImage::GetLevelSize(uint32_t level) const
+{
+    return (uint64_t)GetLevelWidth(level) * GetLevelHeight(level) * layers * Format(format).GetTexelSize();
+}
+
+void IblImage::Allocate(uint32_t levelCount)
+{
+    levelOffsets.resize(levelCount);
+    uint64_t offset = 0;
+    for (uint32_t level = 0; level < levelCount; ++level)
+    {
+        levelOffsets[level] = offset;
+        offset = AlignPayload(offset + GetLevelSize(level));
+    }
+    data.resize(offset);
+}
+
+uint64_t HashIblBytes(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+bool HashIblFile(const std::string &path, uint64_t &hash, uint64_t seed)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+
+    std::vector<char> bytes((size_t)file.tellg());
+    file.seekg(0);
+    if (!file.read(bytes.data(), (std::streamsize)bytes.size()))
+        return false;
+
+    hash = HashIblBytes(bytes.data(), bytes.size(), seed);
+    return true;
+}
+
+std::string GetIblCachePath(const std::string &sourcePath)
+{
+    return sourcePath + ".ibl";
+}
+
+bool LoadIblCache(const std::string &path, uint64_t key, IblImage &image, IrradianceSH9 *irradiance)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    const uint64_t fileSize = (uint64_t)file.tellg();
+    file.seekg(0);
+
+    IblCacheHeader header{};
+    if (fileSize < sizeof(header) ||
+        !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0 ||
+        header.version != VERSION ||
+        header.key != key ||
+        header.levelCount == 0 || header.levelCount > 32 ||
+        header.layers == 0 || header.width == 0 || header.height == 0)
+        return false;
+
+    image.format = (VkFormat)header.vkFormat;
+    image.width = header.width;
+    image.height = header.height;
+    image.layers = header.layers;
+    image.Allocate(header.levelCount);
+
+    const uint64_t payloadOffset = AlignPayload(sizeof(header));
+    if (fileSize - payloadOffset < image.data.size())
+        return false;
+
+    file.seekg((std::streamoff)payloadOffset);
+    if (!file.read(reinterpret_cast<char *>(image.data.data()), (std::streamsize)image.data.size()))
+        return false;
+
+    if (irradiance)
+        *irradiance = header.irradiance;
+    return true;
+}
+
+bool SaveIblCache(const std::string &path, uint64_t key, const IblImage &image, const IrradianceSH9 *irradiance)
+{
+    IblCacheHeader header{};
+    std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+    header.version = VERSION;
+    header.vkFormat = (uint32_t)image.format;
+    header.width = image.width;
+    header.height = image.height;
+    header.layers = image.layers;
+    header.levelCount = (uint32_t)image.levelOffsets.size();
+    header.key = key;
+    if (irradiance)
+        header.irradiance = *irradiance;
+
+    // written aside and renamed over the old cache, a crash never leaves a half written file behind
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        static const char padding[16] = {};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(padding, AlignPayload(sizeof(header)) - sizeof(header));
+        file.write(reinterpret_cast<const char *>(image.data.data()), (std::streamsize)image.data.size());
+        if (!file)
+        {
+            file.close();
+            std::filesystem::remove(tempPath);
+            return false;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename(tempPath, path, errorCode);
+    if (errorCode)
+    {
+        std::filesystem::remove(tempPath, errorCode);
+        return false;
+    }
+    return true;
+}
+
+IblImage IntegrateBrdfLut(uint32_t size, uint32_t numSamples)
+{
+    PROFILE_SCOPE("IntegrateBrdfLut");
+
+    IblImage lut;
+    lut.format = VK_FORMAT_R16G16_SFLOAT;
+    lut.width = size;
+    lut.height = size;
+    lut.Allocate(1);
+    uint16_t *texels = reinterpret_cast<uint16_t *>(lut.data.data());
+
+    const float invNumSamples = 1.0f / float(numSamples);
+
+    ParallelFor(
+        0, size, [&](size_t begin, size_t end)
+        {
+            std::vector<float> halfX(numSamples), halfY(numSamples), halfZ(numSamples);
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float roughness = float(y) / float(size);
+                const float a = roughness * roughness;
+
+                // Hammersley GGX half vectors around N = +z, in the tangent frame the shader builds for that N
+                for (uint32_t i = 0; i < numSamples; ++i)
+                {
+                    const float phi = 2.0f * PI * (float(i) * invNumSamples);
+                    const float xi = RadicalInverseVdC(i);
+                    const float cosTheta = std::sqrt((1.0f - xi) / (1.0f + (a * a - 1.0f) * xi));
+                    const float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+                    halfX[i] = std::sin(phi) * sinTheta;
+                    halfY[i] = -std::cos(phi) * sinTheta;
+                    halfZ[i] = cosTheta;
+                }
+
+                for (uint32_t x = 0; x < size; ++x)
+                {
+                    const float NdotV = std::max(float(x) / float(size), EPSILON);
+                    const float Vx = std::sqrt(1.0f - NdotV * NdotV), Vz = NdotV;
+                    const float geometryV = GeometrySchlickGGX(NdotV, roughness);
+
+                    float DFG1 = 0.0f, DFG2 = 0.0f;
+                    for (uint32_t i = 0; i < numSamples; ++i)
+                    {
+                        const float VdotHRaw = Vx * halfX[i] + Vz * halfZ[i];
+                        // L = normalize(2 (V.H) H - V), only its z is needed
+                        const float Lx = 2.0f * VdotHRaw * halfX[i] - Vx;
+                        const float Ly = 2.0f * VdotHRaw * halfY[i];
+                        const float Lz = 2.0f * VdotHRaw * halfZ[i] - Vz;
+
+                        const float NdotL = std::max(Lz / std::sqrt(Lx * Lx + Ly * Ly + Lz * Lz), EPSILON);
+                        const float NdotH = std::max(halfZ[i], EPSILON);
+                        const float VdotH = std::max(VdotHRaw, EPSILON);
+
+                        if (NdotL > EPSILON)
+                        {
+                            const float G = GeometrySchlickGGX(NdotL, roughness) * geometryV;
+                            const float GVis = (G * VdotH) / (NdotH * NdotV);
+                            const float oneMinusVdotH = 1.0f - VdotH;
+                            const float Fc = oneMinusVdotH * oneMinusVdotH * oneMinusVdotH * oneMinusVdotH * oneMinusVdotH;
+
+                            DFG1 += (1.0f - Fc) * GVis;
+                            DFG2 += Fc * GVis;
+                        }
+                    }
+
+                    uint16_t *texel = texels + (y * size + x) * 2;
+                    texel[0] = FloatToHalf(DFG1 * invNumSamples);
+                    texel[1] = FloatToHalf(DFG2 * invNumSamples);
+                }
+            } },
+        1);
+
+    return lut;
+}
+
+uint64_t GetBrdfLutKey(uint32_t size, uint32_t numSamples)
+{
+    const uint32_t parameters[] = {BRDF_LUT_VERSION, size, numSamples};
+    return HashIblBytes(parameters, sizeof(parameters));
+}
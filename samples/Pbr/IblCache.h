@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "IrradianceSH.h"
+
+// Precomputed IBL images kept on disk between runs, one file each:
+//   IblCacheHeader
+//   level payloads, level 0 first, the layers of a level back to back, each level 16 byte aligned
+// The key is a hash of everything the image was built from (source bytes, shader sources, sizes), a cache
+// whose key differs from the one the caller computes is stale and ignored.
+
+struct IblCacheHeader
+{
+    uint8_t identifier[12];
+    uint32_t version;
+    uint32_t vkFormat;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layers;
+    uint32_t levelCount;
+    uint32_t reserved;
+    uint64_t key;
+    // the diffuse term of an environment cache, zero otherwise
+    IrradianceSH9 irradiance;
+};
+
+// A layered mip chain laid out like a vkCmdCopyBufferToImage source, one region a level covering every layer
+struct IblImage
+{
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t layers = 1;
+    std::vector<uint64_t> levelOffsets;
+    std::vector<uint8_t> data;
+
+    uint32_t GetLevelWidth(uint32_t level) const;
+    uint32_t GetLevelHeight(uint32_t level) const;
+    uint64_t GetLevelSize(uint32_t level) const;
+    // sets levelOffsets for the given level count and sizes data to match
+    void Allocate(uint32_t levelCount);
+};
+
+// FNV-1a, chained through seed
+uint64_t HashIblBytes(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+// the content of the file, false when it cannot be read
+bool HashIblFile(const std::string &path, uint64_t &hash, uint64_t seed = 0xcbf29ce484222325ull);
+
+std::string GetIblCachePath(const std::string &sourcePath);
+
+// irradiance may be null when the caller does not need it
+bool LoadIblCache(const std::string &path, uint64_t key, IblImage &image, IrradianceSH9 *irradiance = nullptr);
+bool SaveIblCache(const std::string &path, uint64_t key, const IblImage &image, const IrradianceSH9 *irradiance = nullptr);
+
+// The split sum DFG terms pbr.frag reads, rg16f, NdotV along x and roughness along y, sampled at x / size like
+// the compute shader that used to build it. The rows run on the thread pool; a row's GGX half vectors depend
+// only on its roughness and are generated once for all of its columns.
+IblImage IntegrateBrdfLut(uint32_t size, uint32_t numSamples);
+uint64_t GetBrdfLutKey(uint32_t size, uint32_t numSamples);
@@ -2,6 +2,7 @@
 #include <stb/stb_image.h>
 #include "Logger.h"
 Image::Image(const std::string &filePath, int32_t channels)
+    : mPixels(nullptr, stbi_image_free)
 {
     LOG_INFO("Loading image: {}\n", filePath);
 
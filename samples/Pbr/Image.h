@@ -23,7 +23,8 @@ public:
     bool mHdr;
 
 private:
-    std::unique_ptr<uint8_t> mPixels;
+    // stb allocates with malloc, freed with stbi_image_free
+    std::unique_ptr<uint8_t, void (*)(void *)> mPixels;
 };
 
 template <typename T>
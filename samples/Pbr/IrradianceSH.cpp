@@ -0,0 +1,182 @@
+#include "IrradianceSH.h"
+#include <array>
+#include <cmath>
+#include <vector>
+#if LAB_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    constexpr double PI = 3.14159265358979323846;
+
+    // azimuth terms of the basis, 1 is implicit
+    enum AzimuthTerm
+    {
+        COS_PHI = 0,
+        SIN_PHI,
+        COS_2PHI,
+        SIN_2PHI,
+        AZIMUTH_TERM_COUNT
+    };
+
+    // per row: sum of L, then the sum of L times each azimuth term, rgb each
+    using RowSums = std::array<std::array<float, 4>, AZIMUTH_TERM_COUNT + 1>;
+
+    // terms[t][x * 4 + c] is term t of column x repeated for the 4 channels, two texels load as one 8 wide vector
+    using AzimuthTable = std::array<std::vector<float>, AZIMUTH_TERM_COUNT>;
+
+    void SumRowScalar(const float *row, uint32_t width, uint32_t channels, const AzimuthTable &terms, RowSums &sums)
+    {
+        for (auto &sum : sums)
+            sum.fill(0.0f);
+
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const float *texel = row + (size_t)x * channels;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                sums[0][c] += texel[c];
+                for (uint32_t t = 0; t < AZIMUTH_TERM_COUNT; ++t)
+                    sums[t + 1][c] += texel[c] * terms[t][x * 4];
+            }
+        }
+    }
+
+#if LAB_SIMD_X86
+    // rgba texels only
+    LAB_TARGET_AVX2 void SumRowAvx2(const float *row, uint32_t width, const AzimuthTable &terms, RowSums &sums)
+    {
+        __m256 sum = _mm256_setzero_ps();
+        __m256 sumCos = _mm256_setzero_ps();
+        __m256 sumSin = _mm256_setzero_ps();
+        __m256 sumCos2 = _mm256_setzero_ps();
+        __m256 sumSin2 = _mm256_setzero_ps();
+
+        uint32_t x = 0;
+        for (; x + 2 <= width; x += 2)
+        {
+            const __m256 texels = _mm256_loadu_ps(row + (size_t)x * 4);
+            sum = _mm256_add_ps(sum, texels);
+            sumCos = _mm256_fmadd_ps(texels, _mm256_loadu_ps(&terms[COS_PHI][x * 4]), sumCos);
+            sumSin = _mm256_fmadd_ps(texels, _mm256_loadu_ps(&terms[SIN_PHI][x * 4]), sumSin);
+            sumCos2 = _mm256_fmadd_ps(texels, _mm256_loadu_ps(&terms[COS_2PHI][x * 4]), sumCos2);
+            sumSin2 = _mm256_fmadd_ps(texels, _mm256_loadu_ps(&terms[SIN_2PHI][x * 4]), sumSin2);
+        }
+
+        // the two texels of each lane pair fold into one rgba sum
+        const __m256 all[AZIMUTH_TERM_COUNT + 1] = {sum, sumCos, sumSin, sumCos2, sumSin2};
+        for (uint32_t s = 0; s <= AZIMUTH_TERM_COUNT; ++s)
+            _mm_storeu_ps(sums[s].data(), _mm_add_ps(_mm256_castps256_ps128(all[s]), _mm256_extractf128_ps(all[s], 1)));
+
+        for (; x < width; ++x)
+        {
+            const float *texel = row + (size_t)x * 4;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                sums[0][c] += texel[c];
+                for (uint32_t t = 0; t < AZIMUTH_TERM_COUNT; ++t)
+                    sums[t + 1][c] += texel[c] * terms[t][x * 4];
+            }
+        }
+    }
+#endif
+}
+
+Vector3f IrradianceSH9::Evaluate(const Vector3f &normal) const
+{
+    const float x = normal.x, y = normal.y, z = normal.z;
+    const float basis[9] = {
+        0.282095f,
+        0.488603f * y,
+        0.488603f * z,
+        0.488603f * x,
+        1.092548f * x * z,
+        1.092548f * y * z,
+        0.315392f * (3.0f * y * y - 1.0f),
+        1.092548f * x * y,
+        0.546274f * (x * x - z * z),
+    };
+
+    Vector3f result(0.0f);
+    for (uint32_t i = 0; i < 9; ++i)
+        result += Vector3f(coefficients[i].x, coefficients[i].y, coefficients[i].z) * basis[i];
+    return result;
+}
+
+IrradianceSH9 ProjectIrradianceSH9(const float *pixels, uint32_t width, uint32_t height, uint32_t channels)
+{
+    AzimuthTable terms;
+    for (auto &term : terms)
+        term.resize((size_t)width * 4);
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        const double phi = 2.0 * PI * (x + 0.5) / width;
+        const float values[AZIMUTH_TERM_COUNT] = {(float)std::cos(phi), (float)std::sin(phi), (float)std::cos(2.0 * phi), (float)std::sin(2.0 * phi)};
+        for (uint32_t t = 0; t < AZIMUTH_TERM_COUNT; ++t)
+            for (uint32_t c = 0; c < 4; ++c)
+                terms[t][x * 4 + c] = values[t];
+    }
+
+#if LAB_SIMD_X86
+    const bool useAvx2 = channels == 4 && GetSimdLevel() >= SimdLevel::AVX2;
+#else
+    const bool useAvx2 = false;
+#endif
+
+    // 9 coefficients x rgb per row, summed in row order below
+    std::vector<std::array<double, 27>> rowCoefficients(height);
+    ParallelFor(
+        0, height, [&](size_t begin, size_t end)
+        {
+            RowSums sums;
+            for (size_t y = begin; y < end; ++y)
+            {
+                const float *row = pixels + y * width * channels;
+#if LAB_SIMD_X86
+                if (useAvx2)
+                    SumRowAvx2(row, width, terms, sums);
+                else
+#endif
+                    SumRowScalar(row, width, channels, terms, sums);
+
+                const double theta = PI * (y + 0.5) / height;
+                const double cosTheta = std::cos(theta), sinTheta = std::sin(theta);
+                // solid angle of a texel of this row
+                const double weight = (2.0 * PI / width) * (PI / height) * sinTheta;
+
+                auto &coefficients = rowCoefficients[y];
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    const double s = sums[0][c];
+                    const double sCos = sums[COS_PHI + 1][c], sSin = sums[SIN_PHI + 1][c];
+                    const double sCos2 = sums[COS_2PHI + 1][c], sSin2 = sums[SIN_2PHI + 1][c];
+                    // x = sin(theta) cos(phi), y = cos(theta), z = sin(theta) sin(phi)
+                    coefficients[0 * 3 + c] = weight * 0.282095 * s;
+                    coefficients[1 * 3 + c] = weight * 0.488603 * cosTheta * s;
+                    coefficients[2 * 3 + c] = weight * 0.488603 * sinTheta * sSin;
+                    coefficients[3 * 3 + c] = weight * 0.488603 * sinTheta * sCos;
+                    coefficients[4 * 3 + c] = weight * 1.092548 * 0.5 * sinTheta * sinTheta * sSin2;
+                    coefficients[5 * 3 + c] = weight * 1.092548 * cosTheta * sinTheta * sSin;
+                    coefficients[6 * 3 + c] = weight * 0.315392 * (3.0 * cosTheta * cosTheta - 1.0) * s;
+                    coefficients[7 * 3 + c] = weight * 1.092548 * cosTheta * sinTheta * sCos;
+                    coefficients[8 * 3 + c] = weight * 0.546274 * sinTheta * sinTheta * sCos2;
+                }
+            } },
+        16);
+
+    std::array<double, 27> total{};
+    for (const auto &coefficients : rowCoefficients)
+        for (uint32_t i = 0; i < 27; ++i)
+            total[i] += coefficients[i];
+
+    // clamped cosine convolution over pi per band: pi, 2pi/3, pi/4
+    const double bandScale[3] = {1.0, 2.0 / 3.0, 0.25};
+    IrradianceSH9 result;
+    for (uint32_t i = 0; i < 9; ++i)
+    {
+        const double scale = bandScale[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+        result.coefficients[i] = Vector4f((float)(total[i * 3 + 0] * scale), (float)(total[i * 3 + 1] * scale), (float)(total[i * 3 + 2] * scale), 0.0f);
+    }
+    return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+#include "labgraphics.h"
+
+// Diffuse environment lighting as third order (9 coefficient) real spherical harmonics, y up like the
+// cubemap faces of equirect2cube.comp. The coefficients are already convolved with the clamped cosine and
+// divided by pi, so Evaluate(n) is the radiance leaving a white Lambertian surface facing n, the value the
+// irradiance cubemap used to hold. std140 compatible, one vec4 a coefficient, w unused.
+struct IrradianceSH9
+{
+    Vector4f coefficients[9];
+
+    Vector3f Evaluate(const Vector3f &normal) const;
+};
+
+// Projects an equirectangular float image (u = atan(z, x) / 2pi, v = acos(y) / pi, as equirect2cube.comp
+// samples it) in one pass, rows spread over the thread pool. A row has a single polar angle, so it reduces
+// to five sums over the azimuth (1, cos, sin, cos 2, sin 2) accumulated 2 rgba texels per AVX2 instruction,
+// and the polar terms are applied per row in double. Rows are summed in order, the result does not depend
+// on the thread count.
+IrradianceSH9 ProjectIrradianceSH9(const float *pixels, uint32_t width, uint32_t height, uint32_t channels);
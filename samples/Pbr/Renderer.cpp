@@ -1,4 +1,7 @@
 #include "Renderer.h"
+#include "IblCache.h"
+#include "IrradianceSH.h"
+#include "SpecularFilter.h"
 #include "labgraphics.h"
 #include "PbrScene.h"
 #include <cassert>
@@ -18,16 +21,17 @@ void Renderer::Init(uint32_t maxSamples)
 	assert(mRenderSamples >= 1);
 
 	mNumFrames = App::Instance().GetGraphicsContext()->GetSwapChain()->GetImageViews().size();
+	mGpuProfiler = std::make_unique<GpuProfiler>(*App::Instance().GetGraphicsContext()->GetDevice(), "PbrRenderer", mNumFrames);
 
 	mRenderTargets.resize(mNumFrames);
 	mResolveRenderTargets.resize(mNumFrames);
 
 	for (uint32_t i = 0; i < mNumFrames; ++i)
 	{
-		mRenderTargets[i] = CreateRenderTarget(App::Instance().GetWindow()->GetExtent().x, App::Instance().GetWindow()->GetExtent().y, mRenderSamples, colorFormat, depthFormat);
+		mRenderTargets[i] = CreateRenderTarget(App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent().x, App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent().y, mRenderSamples, colorFormat, depthFormat);
 
 		if (mRenderSamples > 1)
-			mResolveRenderTargets[i] = CreateRenderTarget(App::Instance().GetWindow()->GetExtent().x, App::Instance().GetWindow()->GetExtent().y, 1, colorFormat, VK_FORMAT_UNDEFINED);
+			mResolveRenderTargets[i] = CreateRenderTarget(App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent().x, App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent().y, 1, colorFormat, VK_FORMAT_UNDEFINED);
 	}
 
 	mRasterCommandBuffers=App::Instance().GetGraphicsContext()->GetDevice()->GetRasterCommandPool()->CreatePrimaryCommandBuffers(mNumFrames);
@@ -39,14 +43,16 @@ void Renderer::Init(uint32_t maxSamples)
 	fenceCreateInfo.pNext = nullptr;
 	fenceCreateInfo.flags = 0;
 
-	VK_CHECK(vkCreateFence(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), &fenceCreateInfo, nullptr, &mPresentationFence));
+	mPresentationFence = App::Instance().GetGraphicsContext()->GetDevice()->CreateFence();
 	for (auto &fence : mSubmitFences)
 		VK_CHECK(vkCreateFence(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), &fenceCreateInfo, nullptr, &fence));
 
-	VK_CHECK(vkAcquireNextImageKHR(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), App::Instance().GetGraphicsContext()->GetSwapChain()->GetHandle(), UINT64_MAX, VK_NULL_HANDLE, mPresentationFence, &mFrameIndex));
+	// through the swap chain wrapper so headless runs get the offscreen images
+	App::Instance().GetGraphicsContext()->GetSwapChain()->AcquireNextImage(nullptr, mPresentationFence.get());
+	mFrameIndex = App::Instance().GetGraphicsContext()->GetSwapChain()->GetNextImageIdx();
 
-	vkWaitForFences(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), 1, &mPresentationFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), 1, &mPresentationFence);
+	mPresentationFence->Wait();
+	mPresentationFence->Reset();
 
 	const std::array<VkDescriptorPoolSize, 3> poolSizes = {{
 		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16},
@@ -64,12 +70,12 @@ void Renderer::Init(uint32_t maxSamples)
 
 	VK_CHECK(vkCreateDescriptorPool(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), &descriptorPoolCreateInfo, nullptr, &mDescriptorPool));
 
-	mFrameRect = {0, 0, (uint32_t)App::Instance().GetWindow()->GetExtent().x, (uint32_t)App::Instance().GetWindow()->GetExtent().y};
+	mFrameRect = {0, 0, (uint32_t)App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent().x, (uint32_t)App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent().y};
 	mFrameCount = 0;
 
 	constexpr uint32_t kEnvMapSize = 1024;
-	constexpr uint32_t kIrradianceMapSize = 32;
 	constexpr uint32_t kBRDF_LUT_Size = 256;
+	constexpr uint32_t kBRDF_LUT_Samples = 4096;
 	constexpr uint32_t kEnvMapLevels = Math::NumMipmapLevels(kEnvMapSize, kEnvMapSize);
 	constexpr VkDeviceSize kUniformBufferSize = 64 * 1024;
 
@@ -93,6 +99,7 @@ void Renderer::Init(uint32_t maxSamples)
 		BINDING_INPUT_TEXTURE = 0,
 		BINDING_OUTPUT_TEXTURE = 1,
 		BINDING_OUTPUT_MIP_TAIL = 2,
+		BINDING_SAMPLE_TABLE = 3,
 	};
 
 	mUniformBuffer = CreateUniformBuffer(kUniformBufferSize);
@@ -109,10 +116,13 @@ void Renderer::Init(uint32_t maxSamples)
 		createInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		createInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		createInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		// the specular filter picks a source mip per sample
+		createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		createInfo.minLod = 0.0f;
+		createInfo.maxLod = FLT_MAX;
 
 		VK_CHECK(vkCreateSampler(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), &createInfo, nullptr, &computeSampler));
 
-		createInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 		createInfo.anisotropyEnable = VK_TRUE;
 		createInfo.maxAnisotropy = App::Instance().GetGraphicsContext()->GetDevice()->GetPhysicalProps().limits.maxSamplerAnisotropy;
 		createInfo.minLod = 0.0f;
@@ -129,9 +139,10 @@ void Renderer::Init(uint32_t maxSamples)
 
 	VkDescriptorPool computeDescriptorPool;
 	{
-		const std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+		const std::array<VkDescriptorPoolSize, 3> poolSizes = {{
 			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1},
 			{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kEnvMapLevels},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
 		}};
 
 		VkDescriptorPoolCreateInfo createInfo{};
@@ -152,6 +163,7 @@ void Renderer::Init(uint32_t maxSamples)
 			{BINDING_INPUT_TEXTURE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, &computeSampler},
 			{BINDING_OUTPUT_TEXTURE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
 			{BINDING_OUTPUT_MIP_TAIL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kEnvMapLevels - 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+			{BINDING_SAMPLE_TABLE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
 		};
 
 		setLayout.compute = CreateDescriptorSetLayout(&descriptorSetLayoutBindings);
@@ -350,8 +362,7 @@ void Renderer::Init(uint32_t maxSamples)
 
 	{
 		mEnvTexture = CreateTexture(kEnvMapSize, kEnvMapSize, 6, VK_FORMAT_R16G16B16A16_SFLOAT, 0, VK_IMAGE_USAGE_STORAGE_BIT);
-		mIrradianceTexture = CreateTexture(kIrradianceMapSize, kIrradianceMapSize, 6, VK_FORMAT_R16G16B16A16_SFLOAT, 1, VK_IMAGE_USAGE_STORAGE_BIT);
-		mBrdfLut = CreateTexture(kBRDF_LUT_Size, kBRDF_LUT_Size, 1, VK_FORMAT_R16G16_SFLOAT, 1, VK_IMAGE_USAGE_STORAGE_BIT);
+		mBrdfLut = CreateTexture(kBRDF_LUT_Size, kBRDF_LUT_Size, 1, VK_FORMAT_R16G16_SFLOAT, 1);
 	}
 
 	{
@@ -396,10 +407,26 @@ void Renderer::Init(uint32_t maxSamples)
 
 	mPbrModelBuffer = CreateModelBuffer(PbrModel(std::string(ASSETS_DIR) + "meshes/cerberus.glb"));
 
-	mAlbedoTexture = CreateTexture(Image(std::string(ASSETS_DIR) + "textures/cerberus_A.png"), VK_FORMAT_R8G8B8A8_SRGB);
-	mNormalTexture = CreateTexture(Image(std::string(ASSETS_DIR) + "textures/cerberus_N.png"), VK_FORMAT_R8G8B8A8_UNORM);
-	mMetalnessTexture = CreateTexture(Image(std::string(ASSETS_DIR) + "textures/cerberus_M.png"), VK_FORMAT_R8G8B8A8_UNORM);
-	mRoughnessTexture = CreateTexture(Image(std::string(ASSETS_DIR) + "textures/cerberus_R.png"), VK_FORMAT_R8G8B8A8_UNORM);
+	{
+		// mips and BC blocks come prebuilt from the texture cache next to each png after the first run
+		const bool compress = App::Instance().GetGraphicsContext()->GetDevice()->IsTextureCompressionBCSupported();
+		auto loadTexture = [compress](const std::string &path, TextureRole role)
+		{
+			TextureImportSettings settings;
+			settings.role = role;
+			settings.compress = compress;
+			settings.highQuality = role == TextureRole::COLOR;
+			TextureData texture = LoadTexture(path, settings);
+			if (texture.mips.empty())
+				throw std::runtime_error("Failed to load texture image: " + path);
+			return texture;
+		};
+
+		mAlbedoTexture = CreateTexture(loadTexture(std::string(ASSETS_DIR) + "textures/cerberus_A.png", TextureRole::COLOR), true);
+		mNormalTexture = CreateTexture(loadTexture(std::string(ASSETS_DIR) + "textures/cerberus_N.png", TextureRole::NORMAL), false);
+		mMetalnessTexture = CreateTexture(loadTexture(std::string(ASSETS_DIR) + "textures/cerberus_M.png", TextureRole::MASK), false);
+		mRoughnessTexture = CreateTexture(loadTexture(std::string(ASSETS_DIR) + "textures/cerberus_R.png", TextureRole::MASK), false);
+	}
 
 	{
 		const std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
@@ -419,8 +446,7 @@ void Renderer::Init(uint32_t maxSamples)
 				{2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &mDefaultSampler},		// metalness
 				{3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &mDefaultSampler},		// roughness
 				{4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &mDefaultSampler},		// specular env
-				{5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &mDefaultSampler},		// irradiance
-				{6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &mSpecularBRDFSampler}, // brdf
+				{5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &mSpecularBRDFSampler}, // brdf
 			};
 
 		setLayout.pbr = CreateDescriptorSetLayout(&descriptorSetLayoutBindings);
@@ -462,7 +488,6 @@ void Renderer::Init(uint32_t maxSamples)
 			{VK_NULL_HANDLE, mMetalnessTexture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
 			{VK_NULL_HANDLE, mRoughnessTexture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
 			{VK_NULL_HANDLE, mEnvTexture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
-			{VK_NULL_HANDLE, mIrradianceTexture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
 			{VK_NULL_HANDLE, mBrdfLut.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
 		};
 
@@ -521,18 +546,51 @@ void Renderer::Init(uint32_t maxSamples)
 		UpdateDescriptorSet(mSkyboxDescriptorSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, {skyboxTexture});
 	}
 
+	// The prefiltered environment and its SH9 come from the cache next to the hdr when one matches the hdr's bytes,
+	// both kernels and the sizes they ran with; otherwise they are computed and the cache is refreshed.
+	const std::string envPath = std::string(ASSETS_DIR) + "hdr/newport_loft.hdr";
+	const std::string equirect2cubeSource = ReadFile(std::string(ASSETS_DIR) + "shaders/equirect2cube.comp");
+	const std::string specularmapSource = ReadFile(std::string(ASSETS_DIR) + "shaders/specularmap.comp");
+	const SpecularFilterTable specularFilterTable = BuildSpecularFilterTable(kEnvMapSize, kEnvMapLevels - 1);
+
+	uint64_t envCacheKey = 0;
+	const bool envCacheable = HashIblFile(envPath, envCacheKey);
+	{
+		const uint32_t kernelParameters[] = {kEnvMapSize, kEnvMapLevels, (uint32_t)VK_FORMAT_R16G16B16A16_SFLOAT};
+		envCacheKey = HashIblBytes(equirect2cubeSource.data(), equirect2cubeSource.size(), envCacheKey);
+		envCacheKey = HashIblBytes(specularmapSource.data(), specularmapSource.size(), envCacheKey);
+		envCacheKey = HashIblBytes(specularFilterTable.samples.data(), specularFilterTable.samples.size() * sizeof(Vector4f), envCacheKey);
+		envCacheKey = HashIblBytes(kernelParameters, sizeof(kernelParameters), envCacheKey);
+	}
+
+	IblImage envCache;
+	IrradianceSH9 irradiance{};
+	bool envFromCache = false;
+	{
+		PROFILE_SCOPE("Renderer::LoadIblCache");
+		envFromCache = envCacheable && LoadIblCache(GetIblCachePath(envPath), envCacheKey, envCache, &irradiance);
+	}
+
 	// Load & pre-process environment map.
+	if (!envFromCache)
 	{
 		PbrTexture envTexture = CreateTexture(kEnvMapSize, kEnvMapSize, 6, VK_FORMAT_R16G16B16A16_SFLOAT, 0, VK_IMAGE_USAGE_STORAGE_BIT);
 
 		// equirect2cube
 		{
 			std::vector<uint32_t> equirect2cube_comp;
-			VK_CHECK(GlslToSpv(VK_SHADER_STAGE_COMPUTE_BIT, ReadFile(std::string(ASSETS_DIR) + "shaders/equirect2cube.comp"), equirect2cube_comp));
+			VK_CHECK(GlslToSpv(VK_SHADER_STAGE_COMPUTE_BIT, equirect2cubeSource, equirect2cube_comp));
 
 			VkPipeline compPipeline = CreateComputePipeline(equirect2cube_comp, computePipelineLayout);
 
-			PbrTexture envTextureEquirect = CreateTexture(Image(std::string(ASSETS_DIR) + "hdr/newport_loft.hdr"), VK_FORMAT_R32G32B32A32_SFLOAT, 1);
+			const Image envImage(envPath);
+			PbrTexture envTextureEquirect = CreateTexture(envImage, VK_FORMAT_R32G32B32A32_SFLOAT, 1);
+
+			// diffuse lighting straight from the equirect on the CPU, 9 coefficients in the shading uniforms instead of an irradiance cubemap
+			{
+				PROFILE_SCOPE("Renderer::ProjectIrradianceSH9");
+				irradiance = ProjectIrradianceSH9(envImage.pixels<float>(), envImage.mWidth, envImage.mHeight, envImage.mChannels);
+			}
 
 			const VkDescriptorImageInfo inputTexture = {VK_NULL_HANDLE, envTextureEquirect.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
 			const VkDescriptorImageInfo outputTexture = {VK_NULL_HANDLE, envTexture.view, VK_IMAGE_LAYOUT_GENERAL};
@@ -571,7 +629,7 @@ void Renderer::Init(uint32_t maxSamples)
 				const VkSpecializationInfo specializationInfo = {1, &specializationMap, sizeof(specializationData), specializationData};
 
 				std::vector<uint32_t> specularmap_comp;
-				VK_CHECK(GlslToSpv(VK_SHADER_STAGE_COMPUTE_BIT, ReadFile(std::string(ASSETS_DIR) + "shaders/specularmap.comp"), specularmap_comp));
+				VK_CHECK(GlslToSpv(VK_SHADER_STAGE_COMPUTE_BIT, specularmapSource, specularmap_comp));
 
 				compPipeline = CreateComputePipeline(specularmap_comp, computePipelineLayout, &specializationInfo);
 			}
@@ -612,6 +670,11 @@ void Renderer::Init(uint32_t maxSamples)
 								postCopyBarriers);
 
 				// other mip level prefilter
+				const VkDeviceSize sampleTableSize = specularFilterTable.samples.size() * sizeof(Vector4f);
+				Resource<VkBuffer> sampleTableBuffer = CreateBuffer(sampleTableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+				CopyToDevice(sampleTableBuffer.memory, specularFilterTable.samples.data(), sampleTableSize);
+				UpdateDescriptorSet(computeDescriptorSet, BINDING_SAMPLE_TABLE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, std::vector<VkDescriptorBufferInfo>{{sampleTableBuffer.handle, 0, sampleTableSize}});
+
 				std::vector<VkImageView> envTextureMipTailViews;
 				std::vector<VkDescriptorImageInfo> envTextureMipTailDescriptors;
 				const VkDescriptorImageInfo inputTexture = {VK_NULL_HANDLE, envTexture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
@@ -628,14 +691,30 @@ void Renderer::Init(uint32_t maxSamples)
 				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compPipeline);
 				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSet, 0, nullptr);
 
-				const float deltaRoughness = 1.0f / Math::Max(float(numMipTailLevels), 1.0f);
+				// dispatch times of the levels, logged to compare with labgraphics_specular_bench's cost and error per roughness
+				VkQueryPool timestampPool = VK_NULL_HANDLE;
+				if (mGpuProfiler->IsSupported())
+				{
+					VkQueryPoolCreateInfo queryPoolInfo{};
+					queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+					queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+					queryPoolInfo.queryCount = numMipTailLevels * 2;
+					VK_CHECK(vkCreateQueryPool(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), &queryPoolInfo, nullptr, &timestampPool));
+					vkCmdResetQueryPool(commandBuffer, timestampPool, 0, queryPoolInfo.queryCount);
+				}
+
 				for (uint32_t level = 1, size = kEnvMapSize / 2; level < kEnvMapLevels; ++level, size /= 2)
 				{
 					const uint32_t numGroups = Math::Max((uint32_t)1, size / 32);
 
-					const SpecularFilterPushConstants pushConstants = {level - 1, level * deltaRoughness};
+					const SpecularFilterLevel &filterLevel = specularFilterTable.levels[level - 1];
+					const SpecularFilterPushConstants pushConstants = {level - 1, filterLevel.sampleOffset, filterLevel.sampleCount, filterLevel.invWeightSum};
 					vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SpecularFilterPushConstants), &pushConstants);
+					if (timestampPool != VK_NULL_HANDLE)
+						vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, (level - 1) * 2);
 					vkCmdDispatch(commandBuffer, numGroups, numGroups, 6);
+					if (timestampPool != VK_NULL_HANDLE)
+						vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, (level - 1) * 2 + 1);
 				}
 
 				const auto barrier = ImageMemoryBarrier(mEnvTexture, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
@@ -643,65 +722,61 @@ void Renderer::Init(uint32_t maxSamples)
 
 				ExecuteImmediateCommandBuffer(commandBuffer);
 
+				if (timestampPool != VK_NULL_HANDLE)
+				{
+					std::vector<uint64_t> timestamps(numMipTailLevels * 2);
+					VK_CHECK(vkGetQueryPoolResults(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), timestampPool, 0, (uint32_t)timestamps.size(), sizeof(uint64_t) * timestamps.size(),
+												   timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+					const double timestampPeriod = App::Instance().GetGraphicsContext()->GetDevice()->GetPhysicalProps().limits.timestampPeriod;
+					for (uint32_t level = 1; level < kEnvMapLevels; ++level)
+					{
+						const SpecularFilterLevel &filterLevel = specularFilterTable.levels[level - 1];
+						const uint64_t begin = timestamps[(level - 1) * 2], end = timestamps[(level - 1) * 2 + 1];
+						LOG_INFO("Specular prefilter level {}: roughness {:.3f}, {} samples, {:.3f} ms", level, (float)level / numMipTailLevels, filterLevel.sampleCount,
+								 end > begin ? (end - begin) * timestampPeriod / 1.0e6 : 0.0);
+					}
+					vkDestroyQueryPool(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), timestampPool, nullptr);
+				}
+
 				for (const auto &mipTailView : envTextureMipTailViews)
 					vkDestroyImageView(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), mipTailView, nullptr);
 				vkDestroyPipeline(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), compPipeline, nullptr);
+				DestroyBuffer(sampleTableBuffer);
 				DestroyTexture(envTexture);
 			}
 		}
 
-		// diffuse irradiance map
+		// read back once so the next run starts from the cache
+		if (envCacheable)
 		{
-			std::vector<uint32_t> irradiance_comp;
-			VK_CHECK(GlslToSpv(VK_SHADER_STAGE_COMPUTE_BIT, ReadFile(std::string(ASSETS_DIR) + "shaders/irradiancemap.comp"), irradiance_comp));
-
-			VkPipeline compPipeline = CreateComputePipeline(irradiance_comp, computePipelineLayout);
-
-			const VkDescriptorImageInfo inputTexture = {VK_NULL_HANDLE, mEnvTexture.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-			const VkDescriptorImageInfo outputTexture = {VK_NULL_HANDLE, mIrradianceTexture.view, VK_IMAGE_LAYOUT_GENERAL};
-			UpdateDescriptorSet(computeDescriptorSet, BINDING_INPUT_TEXTURE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, {inputTexture});
-			UpdateDescriptorSet(computeDescriptorSet, BINDING_OUTPUT_TEXTURE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, {outputTexture});
-
-			VkCommandBuffer commandBuffer = BeginImmediateCommandBuffer();
-
-			const auto preDispatchBarrier = ImageMemoryBarrier(mIrradianceTexture, VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-			PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, {preDispatchBarrier});
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compPipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSet, 0, nullptr);
-			vkCmdDispatch(commandBuffer, kIrradianceMapSize / 32, kIrradianceMapSize / 32, 6);
-
-			const auto postDispatcher = ImageMemoryBarrier(mIrradianceTexture, VK_ACCESS_SHADER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-			PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, {postDispatcher});
-
-			ExecuteImmediateCommandBuffer(commandBuffer);
-			vkDestroyPipeline(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), compPipeline, nullptr);
+			PROFILE_SCOPE("Renderer::SaveIblCache");
+			envCache = CopyFromTexture(mEnvTexture, VK_FORMAT_R16G16B16A16_SFLOAT);
+			if (!SaveIblCache(GetIblCachePath(envPath), envCacheKey, envCache, &irradiance))
+				LOG_WARN("Failed to write IBL cache {}", GetIblCachePath(envPath));
 		}
+	}
+	else
+		CopyToTexture(mEnvTexture, envCache);
 
-		// brdf map
-		{
-			std::vector<uint32_t> brdf_comp;
-			VK_CHECK(GlslToSpv(VK_SHADER_STAGE_COMPUTE_BIT, ReadFile(std::string(ASSETS_DIR) + "shaders/pbr_brdf.comp"), brdf_comp));
-
-			VkPipeline compPipeline = CreateComputePipeline(brdf_comp, computePipelineLayout);
-			const VkDescriptorImageInfo outputTexture = {VK_NULL_HANDLE, mBrdfLut.view, VK_IMAGE_LAYOUT_GENERAL};
-			UpdateDescriptorSet(computeDescriptorSet, BINDING_OUTPUT_TEXTURE, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, {outputTexture});
-
-			VkCommandBuffer commandBuffer = BeginImmediateCommandBuffer();
+	for (auto &shadingUniforms : mShadingUniforms)
+		shadingUniforms.as<ShadingUniforms>()->irradiance = irradiance;
 
-			const auto preDispatchBarrier = ImageMemoryBarrier(mBrdfLut, VK_ACCESS_NONE, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-			PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, {preDispatchBarrier});
-
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compPipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeDescriptorSet, 0, nullptr);
-			vkCmdDispatch(commandBuffer, kBRDF_LUT_Size / 32, kBRDF_LUT_Size / 32, 6);
-
-			const auto postDispatchBarrier = ImageMemoryBarrier(mBrdfLut, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_NONE, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-			PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, {postDispatchBarrier});
+	// brdf map, shipped prebuilt with the assets; integrated on the CPU and written back only when the file is missing
+	// or was built with other parameters
+	{
+		const std::string brdfLutPath = std::string(ASSETS_DIR) + "textures/brdf_lut.ibl";
+		const uint64_t brdfLutKey = GetBrdfLutKey(kBRDF_LUT_Size, kBRDF_LUT_Samples);
 
-			ExecuteImmediateCommandBuffer(commandBuffer);
-			vkDestroyPipeline(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), compPipeline, nullptr);
+		IblImage brdfLut;
+		if (!LoadIblCache(brdfLutPath, brdfLutKey, brdfLut))
+		{
+			LOG_WARN("BRDF LUT {} is missing or stale, integrating it", brdfLutPath);
+			brdfLut = IntegrateBrdfLut(kBRDF_LUT_Size, kBRDF_LUT_Samples);
+			if (!SaveIblCache(brdfLutPath, brdfLutKey, brdfLut))
+				LOG_WARN("Failed to write BRDF LUT {}", brdfLutPath);
 		}
+		CopyToTexture(mBrdfLut, brdfLut);
 	}
 
 	vkDestroyDescriptorSetLayout(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), setLayout.uniforms, nullptr);
@@ -724,7 +799,6 @@ Renderer::~Renderer()
 	App::Instance().GetGraphicsContext()->GetDevice()->WaitIdle();
 
 	DestroyTexture(mEnvTexture);
-	DestroyTexture(mIrradianceTexture);
 	DestroyTexture(mBrdfLut);
 
 	DestroyModelBuffer(mSkyboxModelBuffer);
@@ -760,10 +834,13 @@ Renderer::~Renderer()
 	}
 
 	vkDestroyDescriptorPool(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), mDescriptorPool, nullptr);
-	vkDestroyFence(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), mPresentationFence, nullptr);
+	mPresentationFence.reset(nullptr);
+	mGpuProfiler.reset(nullptr);
 }
 void Renderer::Render(const PbrScene &scene)
 {
+	PROFILE_SCOPE("Renderer::Render");
+
 	const VkDeviceSize zeroOffset = 0;
 
 	Matrix4f projectionMatrix = scene.mCamera.mProjectionMatrix;
@@ -799,6 +876,11 @@ void Renderer::Render(const PbrScene &scene)
 		vkResetCommandBuffer(commandBuffer, 0);
 		vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 	}
+
+	// submit fence of this frame index has been waited in PresentFrame, the previous timestamps are ready
+	RasterCommandBuffer *profiledCommandBuffer = mRasterCommandBuffers[mFrameIndex].get();
+	mGpuProfiler->BeginFrame(profiledCommandBuffer, mFrameIndex);
+	const uint32_t frameScope = mGpuProfiler->BeginScope(profiledCommandBuffer, "Frame");
 	// begin render pass
 
 	std::array<VkClearValue, 2> clearValues{};
@@ -816,6 +898,8 @@ void Renderer::Render(const PbrScene &scene)
 
 	// draw skybox
 	{
+		GpuProfileScope scope(mGpuProfiler.get(), profiledCommandBuffer, "Skybox");
+
 		const std::array<VkDescriptorSet, 2> descriptorSets = {
 			uniformDescriptorSet,
 			mSkyboxDescriptorSet};
@@ -833,6 +917,8 @@ void Renderer::Render(const PbrScene &scene)
 
 	// draw PBR model
 	{
+		GpuProfileScope scope(mGpuProfiler.get(), profiledCommandBuffer, "PBR model");
+
 		const std::array<VkDescriptorSet, 1> descriptorSets = {
 			mPbrDescriptorSet,
 		};
@@ -852,6 +938,8 @@ void Renderer::Render(const PbrScene &scene)
 
 	// post processing
 	{
+		GpuProfileScope scope(mGpuProfiler.get(), profiledCommandBuffer, "Tonemap");
+
 		const std::array<VkDescriptorSet, 1> descriptorSets = {
 			toneMapDexcriptorSet};
 
@@ -861,6 +949,10 @@ void Renderer::Render(const PbrScene &scene)
 	}
 
 	vkCmdEndRenderPass(commandBuffer);
+
+	mGpuProfiler->EndScope(profiledCommandBuffer, frameScope);
+	mGpuProfiler->EndFrame(mFrameIndex);
+
 	vkEndCommandBuffer(commandBuffer);
 
 	// submit
@@ -1090,6 +1182,62 @@ PbrTexture Renderer::CreateTexture(const Image &image, VkFormat format, uint32_t
 		GenerateMipmaps(texture);
 	return texture;
 }
+PbrTexture Renderer::CreateTexture(const TextureData &data, bool srgb) const
+{
+	VkFormat format = data.format.ToVkHandle();
+	if (srgb)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			format = VK_FORMAT_R8G8B8A8_SRGB;
+			break;
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+			break;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			format = VK_FORMAT_BC3_SRGB_BLOCK;
+			break;
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			format = VK_FORMAT_BC7_SRGB_BLOCK;
+			break;
+		default:
+			break;
+		}
+	}
+
+	PbrTexture texture = CreateTexture(data.width, data.height, 1, format, (uint32_t)data.mips.size());
+
+	Resource<VkBuffer> stagingBuffer = CreateBuffer(data.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	CopyToDevice(stagingBuffer.memory, data.data.data(), data.data.size());
+
+	VkCommandBuffer commandBuffer = BeginImmediateCommandBuffer();
+
+	{
+		const auto barrier = ImageMemoryBarrier(texture, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, {barrier});
+	}
+
+	// the whole prebuilt chain in one copy, no blits
+	std::vector<VkBufferImageCopy> copyRegions(data.mips.size());
+	for (uint32_t level = 0; level < data.mips.size(); ++level)
+	{
+		copyRegions[level].bufferOffset = data.mips[level].offset;
+		copyRegions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1};
+		copyRegions[level].imageExtent = {data.mips[level].width, data.mips[level].height, 1};
+	}
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.handle, texture.image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)copyRegions.size(), copyRegions.data());
+
+	{
+		const auto barrier = ImageMemoryBarrier(texture, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, {barrier});
+	}
+
+	ExecuteImmediateCommandBuffer(commandBuffer);
+
+	DestroyBuffer(stagingBuffer);
+	return texture;
+}
 VkImageView Renderer::CreateTextureView(const PbrTexture &texture, VkFormat format, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t numMipLevels) const
 {
 	VkImageViewCreateInfo viewCreateInfo = {VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
@@ -1144,6 +1292,78 @@ void Renderer::GenerateMipmaps(const PbrTexture &texture) const
 
 	ExecuteImmediateCommandBuffer(commandBuffer);
 }
+void Renderer::CopyToTexture(const PbrTexture &texture, const IblImage &image) const
+{
+	assert(image.width == texture.width && image.height == texture.height);
+	assert(image.layers == texture.layers && image.levelOffsets.size() == texture.levels);
+
+	Resource<VkBuffer> stagingBuffer = CreateBuffer(image.data.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+	CopyToDevice(stagingBuffer.memory, image.data.data(), image.data.size());
+
+	VkCommandBuffer commandBuffer = BeginImmediateCommandBuffer();
+
+	{
+		const auto barrier = ImageMemoryBarrier(texture, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, {barrier});
+	}
+
+	// one region a level, its layers are packed back to back
+	std::vector<VkBufferImageCopy> copyRegions(image.levelOffsets.size());
+	for (uint32_t level = 0; level < copyRegions.size(); ++level)
+	{
+		copyRegions[level].bufferOffset = image.levelOffsets[level];
+		copyRegions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, image.layers};
+		copyRegions[level].imageExtent = {image.GetLevelWidth(level), image.GetLevelHeight(level), 1};
+	}
+	vkCmdCopyBufferToImage(commandBuffer, stagingBuffer.handle, texture.image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)copyRegions.size(), copyRegions.data());
+
+	{
+		const auto barrier = ImageMemoryBarrier(texture, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, {barrier});
+	}
+
+	ExecuteImmediateCommandBuffer(commandBuffer);
+
+	DestroyBuffer(stagingBuffer);
+}
+IblImage Renderer::CopyFromTexture(const PbrTexture &texture, VkFormat format) const
+{
+	IblImage image;
+	image.format = format;
+	image.width = texture.width;
+	image.height = texture.height;
+	image.layers = texture.layers;
+	image.Allocate(texture.levels);
+
+	Resource<VkBuffer> stagingBuffer = CreateBuffer(image.data.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	VkCommandBuffer commandBuffer = BeginImmediateCommandBuffer();
+
+	{
+		const auto barrier = ImageMemoryBarrier(texture, VK_ACCESS_NONE, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+		PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, {barrier});
+	}
+
+	std::vector<VkBufferImageCopy> copyRegions(image.levelOffsets.size());
+	for (uint32_t level = 0; level < copyRegions.size(); ++level)
+	{
+		copyRegions[level].bufferOffset = image.levelOffsets[level];
+		copyRegions[level].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, image.layers};
+		copyRegions[level].imageExtent = {image.GetLevelWidth(level), image.GetLevelHeight(level), 1};
+	}
+	vkCmdCopyImageToBuffer(commandBuffer, texture.image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer.handle, (uint32_t)copyRegions.size(), copyRegions.data());
+
+	{
+		const auto barrier = ImageMemoryBarrier(texture, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_NONE, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		PipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, {barrier});
+	}
+
+	ExecuteImmediateCommandBuffer(commandBuffer);
+
+	CopyFromDevice(stagingBuffer.memory, image.data.data(), image.data.size());
+	DestroyBuffer(stagingBuffer);
+	return image;
+}
 void Renderer::DestroyTexture(PbrTexture &texture) const
 {
 	if (texture.view)
@@ -1476,27 +1696,37 @@ void Renderer::CopyToDevice(VkDeviceMemory deviceMemory, const void *data, size_
 	vkFlushMappedMemoryRanges(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), 1, &flushRange);
 	vkUnmapMemory(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), deviceMemory);
 }
+void Renderer::CopyFromDevice(VkDeviceMemory deviceMemory, void *data, size_t size) const
+{
+	const VkMappedMemoryRange invalidateRange = {
+		VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+		nullptr,
+		deviceMemory,
+		0,
+		VK_WHOLE_SIZE};
+
+	void *mappedMemory;
+	VK_CHECK(vkMapMemory(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), deviceMemory, 0, VK_WHOLE_SIZE, 0, &mappedMemory));
+
+	vkInvalidateMappedMemoryRanges(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), 1, &invalidateRange);
+	std::memcpy(data, mappedMemory, size);
+	vkUnmapMemory(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), deviceMemory);
+}
 void Renderer::PipelineBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, const std::vector<ImageMemoryBarrier> &barriers) const
 {
 	vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, (uint32_t)barriers.size(), reinterpret_cast<const VkImageMemoryBarrier *>(barriers.data()));
 }
 void Renderer::PresentFrame()
 {
-	VkResult presentResult;
-
-	VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR};
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &App::Instance().GetGraphicsContext()->GetSwapChain()->GetHandle();
-	presentInfo.pImageIndices = &mFrameIndex;
-	presentInfo.pResults = &presentResult;
+	PROFILE_SCOPE("Renderer::PresentFrame");
 
-	VK_CHECK(vkQueuePresentKHR(App::Instance().GetGraphicsContext()->GetDevice()->GetGraphicsQueue()->GetHandle(), &presentInfo));
-	VK_CHECK(presentResult);
+	App::Instance().GetGraphicsContext()->GetSwapChain()->Present({});
 
-	VK_CHECK(vkAcquireNextImageKHR(App::Instance().GetGraphicsContext()->GetDevice()->GetHandle(), App::Instance().GetGraphicsContext()->GetSwapChain()->GetHandle(), UINT64_MAX, VK_NULL_HANDLE, mPresentationFence, &mFrameIndex));
+	App::Instance().GetGraphicsContext()->GetSwapChain()->AcquireNextImage(nullptr, mPresentationFence.get());
+	mFrameIndex = App::Instance().GetGraphicsContext()->GetSwapChain()->GetNextImageIdx();
 
 	const VkFence fences[] = {
-		mPresentationFence,
+		mPresentationFence->GetHandle(),
 		mSubmitFences[mFrameIndex],
 	};
 
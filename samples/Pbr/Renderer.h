@@ -5,8 +5,13 @@
 #include <vector>
 #include "Mesh.h"
 #include "Image.h"
+#include "IblCache.h"
+#include "IrradianceSH.h"
+#include "SpecularFilter.h"
+#include "TextureImporter.h"
 #include "VK/Instance.h"
 #include "VK/Device.h"
+#include "VK/GpuProfiler.h"
 
 constexpr int32_t LIGHT_NUM = 3;
 struct PbrLight
@@ -29,12 +34,17 @@ struct ShadingUniforms
 {
     PbrLight lights[LIGHT_NUM];
     Vector4f eyePosition;
+    // written once at Init, Render leaves it alone
+    IrradianceSH9 irradiance;
 };
 
 struct SpecularFilterPushConstants
 {
     uint32_t level;
-    float roughness;
+    // the level's range of SpecularFilterTable::samples
+    uint32_t sampleOffset;
+    uint32_t sampleCount;
+    float invWeightSum;
 };
 
 template <typename T>
@@ -166,8 +176,14 @@ private:
 
     PbrTexture CreateTexture(uint32_t width, uint32_t height, uint32_t layers, VkFormat format, uint32_t levels = 0, VkImageUsageFlags additionUsage = 0) const;
     PbrTexture CreateTexture(const Image &image, VkFormat format, uint32_t levels = 0) const;
+    // uploads a prebuilt mip chain as is, srgb views the color formats through their _SRGB variant
+    PbrTexture CreateTexture(const TextureData &data, bool srgb) const;
     VkImageView CreateTextureView(const PbrTexture &texture, VkFormat format, VkImageAspectFlags aspectMask, uint32_t baseMipLevel, uint32_t numMipLevels) const;
     void GenerateMipmaps(const PbrTexture &texture) const;
+    // every level and layer of image into texture, which it leaves in shader read only layout
+    void CopyToTexture(const PbrTexture &texture, const IblImage &image) const;
+    // every level and layer of a texture in shader read only layout back to the host
+    IblImage CopyFromTexture(const PbrTexture &texture, VkFormat format) const;
     void DestroyTexture(PbrTexture &texture) const;
 
     RenderTarget CreateRenderTarget(uint32_t width, uint32_t height, uint32_t samples, VkFormat colorFormat, VkFormat depthFormat) const;
@@ -205,6 +221,7 @@ private:
     void ExecuteImmediateCommandBuffer(VkCommandBuffer commandBuffer) const;
 
     void CopyToDevice(VkDeviceMemory deviceMemory, const void *data, size_t size) const;
+    void CopyFromDevice(VkDeviceMemory deviceMemory, void *data, size_t size) const;
 
     void PipelineBarrier(VkCommandBuffer commandBuffer,
                          VkPipelineStageFlags srcStageMask,
@@ -243,7 +260,8 @@ private:
     std::vector<RenderTarget> mRenderTargets;
     std::vector<RenderTarget> mResolveRenderTargets;
 
-    VkFence mPresentationFence;
+    std::unique_ptr<Fence> mPresentationFence;
+    std::unique_ptr<GpuProfiler> mGpuProfiler;
 
     uint32_t mRenderSamples;
     VkRect2D mFrameRect;
@@ -263,6 +281,5 @@ private:
     PbrTexture mMetalnessTexture;
     PbrTexture mRoughnessTexture;
     PbrTexture mEnvTexture;
-    PbrTexture mIrradianceTexture;
     PbrTexture mBrdfLut;
 };
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "labgraphics.h"
+
+// The GGX importance samples specularmap.comp filters with, built once on the CPU. With N = V every sample's
+// direction, cosine weight and pdf are the same for all texels of a level, so the table holds them in the
+// tangent frame of the output direction and the shader only rotates and fetches.
+struct SpecularFilterLevel
+{
+    uint32_t sampleOffset;
+    uint32_t sampleCount;
+    // one over the summed cosine weights of the level's samples
+    float invWeightSum;
+};
+
+struct SpecularFilterTable
+{
+    // xyz: incoming direction in the tangent frame, z is also its cosine weight; w: source lod its footprint
+    // covers (filtered importance sampling), std430 compatible
+    std::vector<Vector4f> samples;
+    // one a mip tail level, level 1 of the output first
+    std::vector<SpecularFilterLevel> levels;
+};
+
+// Hammersley points drawn for a lobe of this roughness. Samples below the horizon are dropped, so the table
+// holds fewer for the wide lobes.
+uint32_t GetSpecularFilterSampleCount(float roughness);
+
+// mip tail level l (1 based) filters roughness l / numMipTailLevels, sourceSize is the face size of mip 0 of
+// the source cubemap the lods refer to
+SpecularFilterTable BuildSpecularFilterTable(uint32_t sourceSize, uint32_t numMipTailLevels);
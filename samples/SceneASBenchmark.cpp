@@ -0,0 +1,235 @@
+#include "SceneASBenchmark.h"
+#include <chrono>
+#include <algorithm>
+#include "App.h"
+
+SceneASBenchmark::SceneASBenchmark(uint32_t meshCount, uint32_t gridResolution, uint32_t updateIterations)
+	: mMeshCount(meshCount), mGridResolution(gridResolution), mUpdateIterations(updateIterations)
+{
+}
+
+void SceneASBenchmark::Init()
+{
+	// wavy grids of varying resolution so the builds do not all need the same scratch size
+	for (uint32_t m = 0; m < mMeshCount; ++m)
+	{
+		uint32_t res = 2 + (m * 7919) % mGridResolution;
+
+		std::vector<Vector3f> vertices;
+		for (uint32_t y = 0; y <= res; ++y)
+			for (uint32_t x = 0; x <= res; ++x)
+			{
+				float u = x / (float)res;
+				float v = y / (float)res;
+				vertices.emplace_back(u, 0.1f * sin(10.0f * u + m) * cos(10.0f * v), v);
+			}
+
+		std::vector<uint32_t> indices;
+		for (uint32_t y = 0; y < res; ++y)
+			for (uint32_t x = 0; x < res; ++x)
+			{
+				uint32_t i0 = y * (res + 1) + x;
+				uint32_t i1 = i0 + 1;
+				uint32_t i2 = i0 + res + 1;
+				uint32_t i3 = i2 + 1;
+				indices.insert(indices.end(), {i0, i2, i1, i1, i2, i3});
+			}
+
+		mVertices.emplace_back(std::move(vertices));
+		mIndices.emplace_back(std::move(indices));
+	}
+}
+
+void SceneASBenchmark::Render()
+{
+	if (mDone)
+		return;
+
+	BenchmarkPerMeshBuild();
+	BenchmarkBatchedBuild();
+	BenchmarkCompactedBuild();
+	BenchmarkTLASUpdate();
+	BenchmarkBLASRefit();
+
+	mDone = true;
+}
+
+void SceneASBenchmark::BenchmarkPerMeshBuild()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::unique_ptr<BLAS>> blases;
+	for (uint32_t m = 0; m < mMeshCount; ++m)
+		blases.emplace_back(std::make_unique<BLAS>(*device, mVertices[m], mIndices[m]));
+
+	auto end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	LOG_INFO("Per mesh BLAS build: {} meshes, {} submissions, {:.2f} ms", mMeshCount, mMeshCount, ms);
+
+	device->WaitIdle();
+}
+
+void SceneASBenchmark::BenchmarkBatchedBuild()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	auto start = std::chrono::steady_clock::now();
+
+	ASBuilder builder(*device);
+	std::vector<std::unique_ptr<BLAS>> blases;
+	for (uint32_t m = 0; m < mMeshCount; ++m)
+	{
+		blases.emplace_back(std::make_unique<BLAS>(*device));
+		blases.back()->SetGeometry(mVertices[m], mIndices[m]);
+		builder.AddBLAS(blases.back().get());
+	}
+	builder.Build();
+
+	auto end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	const auto &stats = builder.GetStats();
+	LOG_INFO("Batched BLAS build: {} meshes, 1 submission, {} batches, {:.2f} ms ({:.2f} ms in ASBuilder::Build)", mMeshCount, stats.batchCount, ms, stats.buildMs);
+	LOG_INFO("  shared scratch {:.2f} MB instead of {:.2f} MB, storage {:.2f} MB", stats.scratchSize / 1e6, stats.totalScratchSize / 1e6, stats.storageSize / 1e6);
+
+	device->WaitIdle();
+}
+
+void SceneASBenchmark::BenchmarkCompactedBuild()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	auto start = std::chrono::steady_clock::now();
+
+	ASBuilder builder(*device);
+	builder.SetCompaction(true);
+	std::vector<std::unique_ptr<BLAS>> blases;
+	for (uint32_t m = 0; m < mMeshCount; ++m)
+	{
+		blases.emplace_back(std::make_unique<BLAS>(*device));
+		blases.back()->SetGeometry(mVertices[m], mIndices[m]);
+		builder.AddBLAS(blases.back().get());
+	}
+	builder.Build();
+
+	auto end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	const auto &report = builder.GetCompactionReport();
+	LOG_INFO("Batched BLAS build + compaction: {} meshes, {:.2f} ms ({:.2f} ms compacting)", mMeshCount, ms, report.compactMs);
+	LOG_INFO("  storage {:.2f} MB -> {:.2f} MB ({:.1f}%)", report.originalSize / 1e6, report.compactedSize / 1e6, report.originalSize > 0 ? 100.0 * report.compactedSize / report.originalSize : 0.0);
+
+	device->WaitIdle();
+}
+
+void SceneASBenchmark::BenchmarkTLASUpdate()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	ASBuilder builder(*device);
+	std::vector<std::unique_ptr<BLAS>> blases;
+	for (uint32_t m = 0; m < mMeshCount; ++m)
+	{
+		blases.emplace_back(std::make_unique<BLAS>(*device));
+		blases.back()->SetGeometry(mVertices[m], mIndices[m]);
+		builder.AddBLAS(blases.back().get());
+	}
+	builder.Build();
+
+	// a few instances per mesh laid out on a grid
+	const uint32_t instancesPerMesh = 8;
+	std::vector<VkAccelerationStructureInstanceKHR> instances;
+	for (uint32_t i = 0; i < mMeshCount * instancesPerMesh; ++i)
+	{
+		float x = (float)(i % 64) * 1.5f;
+		float z = (float)(i / 64) * 1.5f;
+		instances.emplace_back(blases[i % mMeshCount]->CreateInstance({1.0f, 0.0f, 0.0f, x,
+																		0.0f, 1.0f, 0.0f, 0.0f,
+																		0.0f, 0.0f, 1.0f, z}));
+	}
+
+	TLAS rebuiltTLAS(*device, instances);
+	TLAS updatedTLAS(*device, instances, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+
+	auto animate = [&](TLAS &tlas, uint32_t iteration)
+	{
+		for (uint32_t i = 0; i < tlas.GetInstanceCount(); ++i)
+		{
+			VkTransformMatrixKHR transform = tlas.GetInstance(i).transform;
+			transform.matrix[1][3] = 0.5f * sin(0.1f * iteration + i);
+			tlas.SetInstanceTransform(i, transform);
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t it = 0; it < mUpdateIterations; ++it)
+	{
+		animate(rebuiltTLAS, it);
+		rebuiltTLAS.Rebuild();
+	}
+	auto end = std::chrono::steady_clock::now();
+	double rebuildMs = std::chrono::duration<double, std::milli>(end - start).count() / mUpdateIterations;
+
+	start = std::chrono::steady_clock::now();
+	for (uint32_t it = 0; it < mUpdateIterations; ++it)
+	{
+		animate(updatedTLAS, it);
+		updatedTLAS.Update();
+	}
+	end = std::chrono::steady_clock::now();
+	double updateMs = std::chrono::duration<double, std::milli>(end - start).count() / mUpdateIterations;
+
+	LOG_INFO("TLAS with {} moving instances: rebuild {:.3f} ms, update {:.3f} ms per frame", instances.size(), rebuildMs, updateMs);
+
+	device->WaitIdle();
+}
+
+void SceneASBenchmark::BenchmarkBLASRefit()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	// refits keep the topology and only move vertices, deform a subset of the meshes every iteration
+	const uint32_t deformingCount = std::min(mMeshCount, 16u);
+
+	std::vector<std::unique_ptr<BLAS>> rebuiltBLASs;
+	std::vector<std::unique_ptr<BLAS>> refitBLASs;
+	for (uint32_t m = 0; m < deformingCount; ++m)
+	{
+		rebuiltBLASs.emplace_back(std::make_unique<BLAS>(*device, mVertices[m], mIndices[m]));
+
+		refitBLASs.emplace_back(std::make_unique<BLAS>(*device));
+		refitBLASs.back()->SetBuildFlags(VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+		refitBLASs.back()->SetData(mVertices[m], mIndices[m]);
+	}
+
+	double rebuildMs = 0.0;
+	double refitMs = 0.0;
+	for (uint32_t it = 0; it < mUpdateIterations; ++it)
+	{
+		for (uint32_t m = 0; m < deformingCount; ++m)
+		{
+			std::vector<Vector3f> vertices = mVertices[m];
+			for (auto &v : vertices)
+				v.y += 0.05f * sin(0.2f * it + 8.0f * v.x);
+
+			rebuiltBLASs[m]->UpdateVertices(vertices);
+			refitBLASs[m]->UpdateVertices(vertices);
+
+			auto start = std::chrono::steady_clock::now();
+			rebuiltBLASs[m]->Rebuild();
+			auto mid = std::chrono::steady_clock::now();
+			refitBLASs[m]->Update();
+			auto end = std::chrono::steady_clock::now();
+
+			rebuildMs += std::chrono::duration<double, std::milli>(mid - start).count();
+			refitMs += std::chrono::duration<double, std::milli>(end - mid).count();
+		}
+	}
+
+	LOG_INFO("{} deforming BLAS: rebuild {:.3f} ms, refit {:.3f} ms per frame", deformingCount, rebuildMs / mUpdateIterations, refitMs / mUpdateIterations);
+
+	device->WaitIdle();
+}
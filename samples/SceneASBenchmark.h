@@ -0,0 +1,28 @@
+#pragma once
+#include "labgraphics.h"
+
+// Compares acceleration structure build paths on procedural meshes and logs the timings, nothing is drawn.
+class SceneASBenchmark : public Scene
+{
+public:
+	SceneASBenchmark(uint32_t meshCount = 512, uint32_t gridResolution = 64, uint32_t updateIterations = 100);
+	~SceneASBenchmark() = default;
+
+	void Init() override;
+	void Render() override;
+
+private:
+	void BenchmarkPerMeshBuild();
+	void BenchmarkBatchedBuild();
+	void BenchmarkCompactedBuild();
+	void BenchmarkTLASUpdate();
+	void BenchmarkBLASRefit();
+
+	uint32_t mMeshCount;
+	uint32_t mGridResolution;
+	uint32_t mUpdateIterations;
+	bool mDone = false;
+
+	std::vector<std::vector<Vector3f>> mVertices;
+	std::vector<std::vector<uint32_t>> mIndices;
+};
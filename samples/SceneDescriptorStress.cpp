@@ -0,0 +1,159 @@
+#include "SceneDescriptorStress.h"
+#include <chrono>
+#include <cstdlib>
+#include "App.h"
+
+constexpr uint32_t STRESS_SETS_PER_FRAME = 1000;
+constexpr uint32_t STRESS_DISTINCT_BUFFERS = 16;
+// the default allocator starts with 64 sets per page and doubles, 1000 sets of a frame fit in at most 5 pages
+constexpr uint32_t STRESS_MAX_PAGES_PER_FRAME = 5;
+
+SceneDescriptorStress::SceneDescriptorStress(uint32_t setCount, uint32_t frameCount)
+	: mSetCount(setCount), mFrameCount(frameCount)
+{
+}
+
+void SceneDescriptorStress::Init()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	mDescriptorTable = std::make_unique<DescriptorTable>(*device);
+	mDescriptorTable->AddLayoutBinding(0, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::COMPUTE)
+		.AddLayoutBinding(1, 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::COMPUTE);
+
+	for (uint32_t i = 0; i < STRESS_DISTINCT_BUFFERS; ++i)
+		mStorageBuffers.emplace_back(device->CreateGPUStorageBuffer(256));
+
+	mUniformBuffer = device->CreateUniformBuffer<Vector4f>();
+	mUniformBuffer->Set(Vector4f::ZERO);
+}
+
+void SceneDescriptorStress::Render()
+{
+	if (mDone)
+		return;
+
+	RunFrameAllocatorStress();
+	RunCacheStress();
+	RunCacheInvalidation();
+
+	mDone = true;
+
+	if (mFailures > 0)
+	{
+		LOG_WARN("SceneDescriptorStress: {} checks failed", mFailures);
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+void SceneDescriptorStress::RunFrameAllocatorStress()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+
+	// nothing is submitted here, so every frame can be recycled as soon as it comes around again
+	FrameDescriptorAllocator frameAllocator(*device, mFrameCount);
+
+	auto start = std::chrono::steady_clock::now();
+
+	uint32_t frameIdx = 0;
+	uint64_t maxLiveSets = 0;
+	for (uint32_t allocated = 0; allocated < mSetCount; ++frameIdx)
+	{
+		frameAllocator.BeginFrame(frameIdx);
+
+		uint32_t setCount = std::min(STRESS_SETS_PER_FRAME, mSetCount - allocated);
+		for (uint32_t i = 0; i < setCount; ++i)
+		{
+			auto set = frameAllocator.Allocate(mDescriptorTable->GetLayout());
+			set->WriteBuffer(0, mStorageBuffers[i % STRESS_DISTINCT_BUFFERS].get())
+				.WriteBuffer(1, mUniformBuffer.get())
+				.Update();
+		}
+		allocated += setCount;
+		maxLiveSets = std::max(maxLiveSets, frameAllocator.GetCurrentAllocator()->GetStats().liveSets);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	auto stats = frameAllocator.GetStats();
+	LOG_INFO("FrameDescriptorAllocator: {} sets in {} frames, {:.2f} ms ({:.1f} ns/set)", mSetCount, frameIdx, ms, ms * 1e6 / mSetCount);
+	LOG_INFO("  pages created: {}, pages exhausted: {}, resets: {}, live sets: {}", stats.pageCount, stats.exhaustedPages, stats.resetCount, stats.liveSets);
+
+	// the pages depend on the sets of one frame, not on the sets allocated over all frames
+	Check(stats.pageCount <= (uint64_t)mFrameCount * STRESS_MAX_PAGES_PER_FRAME, "frame allocator pages are reused across frames");
+	Check(maxLiveSets <= STRESS_SETS_PER_FRAME, "frame allocator releases the sets of a recycled frame");
+}
+
+void SceneDescriptorStress::RunCacheStress()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+	DescriptorSetCache cache(*device, mFrameCount);
+
+	auto start = std::chrono::steady_clock::now();
+
+	DescriptorWrites writes;
+	for (uint32_t i = 0; i < mSetCount; ++i)
+	{
+		if (i % STRESS_SETS_PER_FRAME == 0)
+			cache.BeginFrame(i / STRESS_SETS_PER_FRAME);
+
+		writes.Clear();
+		writes.WriteBuffer(0, mStorageBuffers[i % STRESS_DISTINCT_BUFFERS].get())
+			.WriteBuffer(1, mUniformBuffer.get());
+		cache.Request(mDescriptorTable->GetLayout(), writes);
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+	const auto &stats = cache.GetStats();
+	const auto &allocatorStats = cache.GetAllocatorStats();
+	LOG_INFO("DescriptorSetCache: {} requests in {:.2f} ms ({:.1f} ns/request)", mSetCount, ms, ms * 1e6 / mSetCount);
+	LOG_INFO("  hits: {}, misses: {}, cached sets: {}, pages: {}", stats.hits, stats.misses, stats.cachedSets, allocatorStats.pageCount);
+
+	const uint32_t distinct = std::min(mSetCount, STRESS_DISTINCT_BUFFERS);
+	Check(stats.misses == distinct, "cache allocates one set per distinct binding");
+	Check(stats.hits == mSetCount - distinct, "cache shares the sets of identical bindings");
+	Check(stats.cachedSets == distinct && allocatorStats.liveSets == distinct, "cache does not grow with the requests");
+}
+
+void SceneDescriptorStress::RunCacheInvalidation()
+{
+	auto device = App::Instance().GetGraphicsContext()->GetDevice();
+	DescriptorSetCache cache(*device, mFrameCount);
+
+	DescriptorWrites writes;
+	writes.WriteBuffer(0, mStorageBuffers[0].get())
+		.WriteBuffer(1, mUniformBuffer.get());
+	cache.Request(mDescriptorTable->GetLayout(), writes);
+
+	const auto &stats = cache.GetStats();
+
+	// neither a buffer the set does not reference nor a staging buffer touches the entry
+	mStorageBuffers.back().reset();
+	device->CreateCPUBuffer(256, BufferUsage::TRANSFER_SRC).reset();
+	cache.Request(mDescriptorTable->GetLayout(), writes);
+	Check(stats.misses == 1 && stats.invalidations == 0, "cache keeps its sets when an unreferenced resource is destroyed");
+
+	// the handle of the destroyed buffer may be handed out again, its set must not be returned for the new buffer
+	mStorageBuffers.front().reset();
+	cache.Request(mDescriptorTable->GetLayout(), writes);
+
+	LOG_INFO("DescriptorSetCache invalidation: misses: {}, invalidations: {}", stats.misses, stats.invalidations);
+
+	Check(stats.misses == 2 && stats.invalidations == 1, "cache drops the sets referencing a destroyed resource");
+
+	// the retired sets are freed after every frame in flight has come around
+	for (uint32_t i = 0; i < mFrameCount; ++i)
+		cache.BeginFrame(i);
+	Check(cache.GetAllocatorStats().liveSets == 1, "cache frees retired sets after the frames in flight");
+}
+
+void SceneDescriptorStress::Check(bool condition, const char *what)
+{
+	if (condition)
+		return;
+	LOG_WARN("SceneDescriptorStress check failed: {}", what);
+	mFailures++;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "labgraphics.h"
+
+// Allocates descriptor sets through the paged per-frame allocator and the descriptor set cache, logs timings and
+// allocator statistics and checks that pages are reused, identical sets are shared and a destroyed resource drops
+// the cached sets. A failed check ends the process with EXIT_FAILURE, nothing is drawn.
+class SceneDescriptorStress : public Scene
+{
+public:
+	SceneDescriptorStress(uint32_t setCount = 100000, uint32_t frameCount = 3);
+	~SceneDescriptorStress() = default;
+
+	void Init() override;
+	void Render() override;
+
+private:
+	void RunFrameAllocatorStress();
+	void RunCacheStress();
+	void RunCacheInvalidation();
+
+	void Check(bool condition, const char *what);
+
+	uint32_t mSetCount;
+	uint32_t mFrameCount;
+	bool mDone = false;
+	uint32_t mFailures = 0;
+
+	std::unique_ptr<DescriptorTable> mDescriptorTable;
+	std::vector<std::unique_ptr<Buffer>> mStorageBuffers;
+	std::unique_ptr<UniformBuffer<Vector4f>> mUniformBuffer;
+};
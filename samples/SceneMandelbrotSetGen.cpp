@@ -1,27 +1,67 @@
 #include "SceneMandelbrotSetGen.h"
 #include "labgraphics.h"
 #include <stb/stb_image_write.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include "App.h"
+
+namespace
+{
+    constexpr uint32_t DEFAULT_ITERATIONS = 128;
+    // the orbit buffer is allocated once, = stops doubling here
+    constexpr uint32_t MAX_ITERATIONS = 1u << 20;
+    // compute time per frame the sample budget aims for
+    constexpr double TARGET_COMPUTE_MS = 8.0;
+
+    int32_t FloorDiv(int32_t a, int32_t b)
+    {
+        return a >= 0 ? a / b : -((-a + b - 1) / b);
+    }
+
+    int32_t Wrap(int32_t a, int32_t b)
+    {
+        return a - FloorDiv(a, b) * b;
+    }
+}
+
 void SceneMandelbrotSetGen::Init()
 {
-    mWindowExtent = App::Instance().GetWindow()->GetExtent();
+    mWindowExtent = App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent();
 
-    mUniform.width = mWindowExtent.x;
-    mUniform.height = mWindowExtent.y;
+    // one spare tile row and column, a view that is not tile aligned still fits
+    mBufferExtent.x = ((mWindowExtent.x + TILE_SIZE - 1) / TILE_SIZE + 1) * TILE_SIZE;
+    mBufferExtent.y = ((mWindowExtent.y + TILE_SIZE - 1) / TILE_SIZE + 1) * TILE_SIZE;
+    mTileSlots.resize((mBufferExtent.x / TILE_SIZE) * (mBufferExtent.y / TILE_SIZE));
+    mSampleBudget = (uint64_t)mWindowExtent.x * mWindowExtent.y / 4;
 
-    mComputeImgBuffer = App::Instance().GetGraphicsContext()->GetDevice()->CreateGPUStorageBuffer(sizeof(Vector4f) * mWindowExtent.x * mWindowExtent.y);
+    ResetView();
 
-    mUniformBuffer = App::Instance().GetGraphicsContext()->GetDevice()->CreateUniformBuffer<Uniform>();
-    mUniformBuffer->Set(mUniform);
+    // a quarter of the vec4 buffer it replaces. TRANSFER_SRC so the image can be pulled back through the
+    // readback queue, TRANSFER_DST for the CPU renderer's tiles
+    mComputeImage = std::make_unique<GpuImage2D>(*App::Instance().GetGraphicsContext()->GetDevice(), mBufferExtent.x, mBufferExtent.y, Format::R8G8B8A8_UNORM, ImageTiling::OPTIMAL,
+                                                 ImageUsage::STORAGE | ImageUsage::SAMPLED | ImageUsage::TRANSFER_SRC | ImageUsage::TRANSFER_DST);
+    mComputeImageSampler = std::make_unique<Sampler>(*App::Instance().GetGraphicsContext()->GetDevice());
+    mComputeImageSampler->SetMagFilter(FilterMode::NEAREST).SetMinFilter(FilterMode::NEAREST);
+    mOrbitBuffer = App::Instance().GetGraphicsContext()->GetDevice()->CreateCPUStorageBuffer(sizeof(Vector2f) * (MAX_ITERATIONS + 1));
+    mTileJobBuffer = App::Instance().GetGraphicsContext()->GetDevice()->CreateCPUStorageBuffer(sizeof(MandelbrotTileJob) * mTileSlots.size());
+
+    mUniformBuffer = App::Instance().GetGraphicsContext()->GetDevice()->CreateUniformBuffer<MandelbrotUniform>();
 
     mDescriptorTable = std::make_unique<DescriptorTable>(*App::Instance().GetGraphicsContext()->GetDevice());
-    mDescriptorTable->AddLayoutBinding(0, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::COMPUTE | ShaderStage::FRAGMENT)
-        .AddLayoutBinding(1, 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::COMPUTE | ShaderStage::FRAGMENT);
+    mDescriptorTable->AddLayoutBinding(0, 1, DescriptorType::STORAGE_IMAGE, ShaderStage::COMPUTE)
+        .AddLayoutBinding(1, 1, DescriptorType::UNIFORM_BUFFER, ShaderStage::COMPUTE | ShaderStage::FRAGMENT)
+        .AddLayoutBinding(2, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::COMPUTE)
+        .AddLayoutBinding(3, 1, DescriptorType::STORAGE_BUFFER, ShaderStage::COMPUTE)
+        .AddLayoutBinding(4, 1, DescriptorType::COMBINED_IMAGE_SAMPLER, ShaderStage::FRAGMENT);
 
     mDescriptorSet = mDescriptorTable->AllocateDescriptorSet();
-    mDescriptorSet->WriteBuffer(0, mComputeImgBuffer.get())
+    mDescriptorSet->WriteImage(0, mComputeImage->GetView(), ImageLayout::GENERAL)
         .WriteBuffer(1, mUniformBuffer.get())
+        .WriteBuffer(2, mOrbitBuffer.get())
+        .WriteBuffer(3, mTileJobBuffer.get())
+        .WriteImage(4, mComputeImage->GetView(), ImageLayout::GENERAL, mComputeImageSampler.get())
         .Update();
 
     mPipelineLayout = std::make_unique<PipelineLayout>(*App::Instance().GetGraphicsContext()->GetDevice());
@@ -32,12 +72,11 @@ void SceneMandelbrotSetGen::Init()
         .SetPipelineLayout(mPipelineLayout.get());
 
     mComputeCommandBuffer = App::Instance().GetGraphicsContext()->GetDevice()->GetComputeCommandPool()->CreatePrimaryCommandBuffer();
-
     mComputeCommandBuffer->ExecuteImmediately([&]()
-                                              {
-                                                  mComputeCommandBuffer->BindDescriptorSets(mPipelineLayout.get(), 0, {mDescriptorSet});
-                                                  mComputeCommandBuffer->BindPipeline(mComputePipeline.get());
-                                                  mComputeCommandBuffer->Dispatch((uint32_t)ceil(mWindowExtent.x / float(WORKGROUP_SIZE)), (uint32_t)ceil(mWindowExtent.y / float(WORKGROUP_SIZE)), 1); });
+                                              { mComputeCommandBuffer->ImageBarrier(mComputeImage->GetHandle(), Access::NONE, Access::SHADER_WRITE, ImageLayout::UNDEFINED, ImageLayout::GENERAL, mComputeImage->GetView()->GetSubresourceRange()); });
+
+    // the first frame shows at least the coarse pass of every tile
+    RenderTiles();
 
     ColorAttachment colorAttachment0;
     colorAttachment0.SetBlendDesc(false);
@@ -75,9 +114,278 @@ void SceneMandelbrotSetGen::Init()
 
 void SceneMandelbrotSetGen::Update()
 {
+    RenderTiles();
+
+    auto readbackQueue = App::Instance().GetGraphicsContext()->GetDevice()->GetReadbackQueue();
+
+    if (App::Instance().GetInputSystem().GetKeyboard().GetKeyState(SDL_SCANCODE_O) == ButtonState::PRESS && mCaptureTicket == INVALID_READBACK_TICKET)
+        mCaptureTicket = readbackQueue->ReadImage(mComputeImage.get(), ImageLayout::GENERAL);
+
+    // keep rendering while the copy is in flight, write the file once it has landed
+    if (mCaptureTicket != INVALID_READBACK_TICKET && readbackQueue->IsReady(mCaptureTicket))
+    {
+        auto view = readbackQueue->Wait(mCaptureTicket);
+        const uint32_t *pixels = view.As<uint32_t>();
+
+        std::vector<uint32_t> rgba8Pixels(mWindowExtent.x * mWindowExtent.y);
+        for (uint32_t y = 0; y < mWindowExtent.y; ++y)
+            for (uint32_t x = 0; x < mWindowExtent.x; ++x)
+                rgba8Pixels[(size_t)y * mWindowExtent.x + x] = pixels[(size_t)Wrap(mOrigin.y + (int32_t)y, mBufferExtent.y) * mBufferExtent.x + Wrap(mOrigin.x + (int32_t)x, mBufferExtent.x)];
+        readbackQueue->Release(mCaptureTicket);
+        mCaptureTicket = INVALID_READBACK_TICKET;
+
+        stbi_write_png("mandelbrot.png", mWindowExtent.x, mWindowExtent.y, 4, rgba8Pixels.data(), mWindowExtent.x * 4);
+        std::cout << "mandelbrot.png complete!" << std::endl;
+    }
 }
 
 void SceneMandelbrotSetGen::Render()
 {
     mRasterPass->Render();
-}
\ No newline at end of file
+}
+
+void SceneMandelbrotSetGen::ProcessInput()
+{
+    auto &mouse = App::Instance().GetInputSystem().GetMouse();
+    auto &keyboard = App::Instance().GetInputSystem().GetKeyboard();
+
+    if (mouse.GetButtonState(SDL_BUTTON_LEFT) == ButtonState::HOLD)
+    {
+        const Vector2i32 move = mouse.GetReleativeMove();
+        if (move.x != 0 || move.y != 0)
+        {
+            // whole pixels, the rendered tiles stay valid
+            mOrigin = mOrigin - move;
+
+            const Vector2i32 center = mOrigin + Vector2i32((int32_t)mWindowExtent.x / 2, (int32_t)mWindowExtent.y / 2);
+            const Vector2i32 drift = center - mReferencePixel;
+            const float halfDiagonal = 0.5f * std::sqrt((float)mWindowExtent.x * mWindowExtent.x + (float)mWindowExtent.y * mWindowExtent.y);
+            if (std::sqrt((float)drift.x * drift.x + (float)drift.y * drift.y) + halfDiagonal > mUniform.seriesRadius)
+                mReferenceDirty = true;
+        }
+    }
+
+    const int32_t wheel = mouse.GetMouseScrollWheel().y;
+    if (wheel != 0)
+        ZoomAt(mouse.GetMousePos(), std::pow(2.0L, (long double)wheel));
+
+    if (keyboard.GetKeyState(SDL_SCANCODE_EQUALS) == ButtonState::PRESS && mMaxIterations < MAX_ITERATIONS)
+    {
+        mMaxIterations *= 2;
+        mReferenceDirty = true;
+        InvalidateTiles();
+        std::cout << "Mandelbrot iterations: " << mMaxIterations << std::endl;
+    }
+    if (keyboard.GetKeyState(SDL_SCANCODE_MINUS) == ButtonState::PRESS && mMaxIterations > DEFAULT_ITERATIONS / 4)
+    {
+        mMaxIterations /= 2;
+        mReferenceDirty = true;
+        InvalidateTiles();
+        std::cout << "Mandelbrot iterations: " << mMaxIterations << std::endl;
+    }
+
+    if (keyboard.GetKeyState(SDL_SCANCODE_R) == ButtonState::PRESS)
+        ResetView();
+
+    if (keyboard.GetKeyState(SDL_SCANCODE_C) == ButtonState::PRESS)
+    {
+        mUseCpu = !mUseCpu;
+        InvalidateTiles();
+        if (mUseCpu)
+            std::cout << "Mandelbrot on the CPU: " << GetSimdLevelName(mCpuRenderer.GetLevel()) << ", " << ThreadPool::Instance().GetThreadCount() + 1 << " threads" << std::endl;
+        else
+            std::cout << "Mandelbrot on the GPU" << std::endl;
+    }
+}
+
+void SceneMandelbrotSetGen::ResetView()
+{
+    // the former fixed view: centered on -0.445, 2.34 high
+    mPixelScale = 2.34L / mWindowExtent.y;
+    mOrigin = Vector2i32(0, 0);
+    mAnchor = std::complex<long double>(-0.445L - mPixelScale * (mWindowExtent.x / 2), -mPixelScale * (mWindowExtent.y / 2));
+    mMaxIterations = DEFAULT_ITERATIONS;
+    mReferenceDirty = true;
+    InvalidateTiles();
+}
+
+void SceneMandelbrotSetGen::ZoomAt(Vector2i32 screenPos, long double factor)
+{
+    const Vector2i32 pixel = mOrigin + screenPos;
+    const std::complex<long double> c = mAnchor + std::complex<long double>(pixel.x, pixel.y) * mPixelScale;
+
+    // below a few ulps of long double per pixel the reference orbit cannot tell the pixels apart
+    const long double minScale = 16.0L * std::numeric_limits<long double>::epsilon() * std::max(std::abs(c), 1.0L);
+    const long double maxScale = 4.0L / mWindowExtent.y;
+    const long double scale = std::clamp(mPixelScale / factor, minScale, maxScale);
+    if (scale == mPixelScale)
+        return;
+
+    // the pixel under the cursor keeps its c
+    mPixelScale = scale;
+    mAnchor = c - std::complex<long double>(pixel.x, pixel.y) * mPixelScale;
+
+    // deeper views need more iterations to show any structure, 64 more per octave
+    const uint32_t zoomOctaves = (uint32_t)std::max(0.0L, std::log2(2.34L / (mWindowExtent.y * mPixelScale)));
+    mMaxIterations = std::min(std::max(mMaxIterations, DEFAULT_ITERATIONS + 64 * zoomOctaves), MAX_ITERATIONS);
+
+    mReferenceDirty = true;
+    InvalidateTiles();
+}
+
+void SceneMandelbrotSetGen::UpdateReference()
+{
+    mReferencePixel = mOrigin + Vector2i32((int32_t)mWindowExtent.x / 2, (int32_t)mWindowExtent.y / 2);
+    const std::complex<long double> c = mAnchor + std::complex<long double>(mReferencePixel.x, mReferencePixel.y) * mPixelScale;
+
+    // some slack around the screen, short pans keep the reference
+    const float halfDiagonal = 0.5f * std::sqrt((float)mWindowExtent.x * mWindowExtent.x + (float)mWindowExtent.y * mWindowExtent.y);
+    const float seriesRadius = 1.5f * halfDiagonal;
+
+    mReference = BuildMandelbrotReference(c, seriesRadius * mPixelScale, mMaxIterations);
+    mOrbitBuffer->Fill(0, sizeof(Vector2f) * mReference.orbit.size(), mReference.orbit.data());
+
+    mUniform.seriesA = mReference.seriesA;
+    mUniform.seriesB = mReference.seriesB;
+    mUniform.seriesC = mReference.seriesC;
+    mUniform.seriesRadius = seriesRadius;
+    mUniform.orbitLength = (uint32_t)mReference.orbit.size();
+    mUniform.skipIterations = mReference.skipIterations;
+
+    mReferenceDirty = false;
+}
+
+void SceneMandelbrotSetGen::InvalidateTiles()
+{
+    for (auto &slot : mTileSlots)
+        slot.step = 0;
+}
+
+void SceneMandelbrotSetGen::RenderTiles()
+{
+    if (mReferenceDirty)
+        UpdateReference();
+
+    mUniform.width = mWindowExtent.x;
+    mUniform.height = mWindowExtent.y;
+    mUniform.bufferWidth = mBufferExtent.x;
+    mUniform.bufferHeight = mBufferExtent.y;
+    mUniform.origin = mOrigin;
+    mUniform.referencePixel = mReferencePixel;
+    mUniform.pixelScale = (float)mPixelScale;
+    mUniform.maxIterations = mMaxIterations;
+    mUniform.tileSize = TILE_SIZE;
+    mUniformBuffer->Set(mUniform);
+
+    // the visible tiles missing a pass, coarse passes first, then from the screen center out
+    struct Candidate
+    {
+        TileSlot *slot;
+        Vector2i32 tile;
+        uint32_t step;
+        int64_t distance;
+    };
+    std::vector<Candidate> candidates;
+
+    const int32_t slotsX = (int32_t)(mBufferExtent.x / TILE_SIZE);
+    const int32_t slotsY = (int32_t)(mBufferExtent.y / TILE_SIZE);
+    const Vector2i32 center = mOrigin + Vector2i32((int32_t)mWindowExtent.x / 2, (int32_t)mWindowExtent.y / 2);
+    for (int32_t ty = FloorDiv(mOrigin.y, TILE_SIZE); ty <= FloorDiv(mOrigin.y + (int32_t)mWindowExtent.y - 1, TILE_SIZE); ++ty)
+        for (int32_t tx = FloorDiv(mOrigin.x, TILE_SIZE); tx <= FloorDiv(mOrigin.x + (int32_t)mWindowExtent.x - 1, TILE_SIZE); ++tx)
+        {
+            TileSlot &slot = mTileSlots[Wrap(ty, slotsY) * slotsX + Wrap(tx, slotsX)];
+            // the slot held a tile that scrolled out
+            if (slot.tile.x != tx || slot.tile.y != ty)
+            {
+                slot.tile = Vector2i32(tx, ty);
+                slot.step = 0;
+            }
+            if (slot.step == 1)
+                continue;
+
+            const int64_t dx = (int64_t)tx * TILE_SIZE + TILE_SIZE / 2 - center.x;
+            const int64_t dy = (int64_t)ty * TILE_SIZE + TILE_SIZE / 2 - center.y;
+            candidates.push_back(Candidate{&slot, slot.tile, slot.step == 0 ? COARSE_STEP : slot.step / 2, dx * dx + dy * dy});
+        }
+
+    if (candidates.empty())
+        return;
+
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+              {
+                  if (a.step != b.step)
+                      return a.step > b.step;
+                  return a.distance < b.distance; });
+
+    std::vector<MandelbrotTileJob> jobs;
+    uint64_t samples = 0;
+    for (const auto &candidate : candidates)
+    {
+        const uint64_t tileSamples = (TILE_SIZE / candidate.step) * (TILE_SIZE / candidate.step);
+        if (!jobs.empty() && samples + tileSamples > mSampleBudget)
+            break;
+        jobs.push_back(MandelbrotTileJob{candidate.tile * (int32_t)TILE_SIZE, candidate.step, candidate.step == COARSE_STEP ? 0 : candidate.step * 2});
+        samples += tileSamples;
+    }
+    const uint64_t start = Timer::Now();
+    if (mUseCpu)
+        RenderTilesOnCpu(jobs);
+    else
+    {
+        mTileJobBuffer->Fill(0, sizeof(MandelbrotTileJob) * jobs.size(), jobs.data());
+        mComputeCommandBuffer->ExecuteImmediately([&]()
+                                                  {
+                                                      mComputeCommandBuffer->BindDescriptorSets(mPipelineLayout.get(), 0, {mDescriptorSet});
+                                                      mComputeCommandBuffer->BindPipeline(mComputePipeline.get());
+                                                      mComputeCommandBuffer->Dispatch(TILE_SIZE / WORKGROUP_SIZE, TILE_SIZE / WORKGROUP_SIZE, (uint32_t)jobs.size()); });
+    }
+    const double computeMs = static_cast<double>(Timer::Now() - start) / 1000000.0;
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+        candidates[i].slot->step = candidates[i].step;
+
+    // deep views cost far more per sample, follow the measured time instead of guessing
+    const uint64_t minBudget = (TILE_SIZE / COARSE_STEP) * (TILE_SIZE / COARSE_STEP);
+    const uint64_t maxBudget = (uint64_t)mBufferExtent.x * mBufferExtent.y;
+    if (computeMs > TARGET_COMPUTE_MS)
+        mSampleBudget = std::max(mSampleBudget / 2, minBudget);
+    else if (computeMs < TARGET_COMPUTE_MS / 2 && jobs.size() < candidates.size())
+        mSampleBudget = std::min(mSampleBudget + mSampleBudget / 2, maxBudget);
+}
+
+void SceneMandelbrotSetGen::RenderTilesOnCpu(const std::vector<MandelbrotTileJob> &jobs)
+{
+    if (!mCpuImageBuffer)
+        mCpuImageBuffer = App::Instance().GetGraphicsContext()->GetDevice()->CreateCPUBuffer((uint32_t)(sizeof(uint32_t) * mBufferExtent.x * mBufferExtent.y), BufferUsage::TRANSFER_SRC);
+
+    uint32_t *image = mCpuImageBuffer->MapWhole<uint32_t>();
+    mCpuRenderer.Render(mUniform, mReference.orbit.data(), jobs, image);
+    mCpuImageBuffer->Unmap();
+
+    // same layout on both sides, a region per tile
+    std::vector<VkBufferImageCopy> regions;
+    for (const auto &job : jobs)
+    {
+        const uint32_t slotX = (uint32_t)Wrap(job.origin.x, (int32_t)mBufferExtent.x);
+        const uint32_t slotY = (uint32_t)Wrap(job.origin.y, (int32_t)mBufferExtent.y);
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = ((uint64_t)slotY * mBufferExtent.x + slotX) * sizeof(uint32_t);
+        region.bufferRowLength = mBufferExtent.x;
+        region.bufferImageHeight = mBufferExtent.y;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {(int32_t)slotX, (int32_t)slotY, 0};
+        region.imageExtent = {TILE_SIZE, TILE_SIZE, 1};
+        regions.emplace_back(region);
+    }
+
+    const auto subresourceRange = mComputeImage->GetView()->GetSubresourceRange();
+    mComputeCommandBuffer->ExecuteImmediately([&]()
+                                              {
+                                                  mComputeCommandBuffer->ImageBarrier(mComputeImage->GetHandle(), Access::SHADER_READ | Access::SHADER_WRITE, Access::TRANSFER_WRITE, ImageLayout::GENERAL, ImageLayout::TRANSFER_DST_OPTIMAL, subresourceRange);
+                                                  mComputeCommandBuffer->CopyImageFromBuffer(mComputeImage.get(), mCpuImageBuffer.get(), regions);
+                                                  mComputeCommandBuffer->ImageBarrier(mComputeImage->GetHandle(), Access::TRANSFER_WRITE, Access::SHADER_READ | Access::SHADER_WRITE, ImageLayout::TRANSFER_DST_OPTIMAL, ImageLayout::GENERAL, subresourceRange); });
+}
@@ -1,8 +1,15 @@
 #pragma once
+#include <complex>
+#include <vector>
 #include "labgraphics.h"
+#include "Mandelbrot.h"
 
-constexpr uint32_t WORKGROUP_SIZE = 32;
-
+// Pan by dragging with the left mouse button, zoom on the cursor with the wheel, = and - double and halve
+// the iteration count, R resets the view, C switches between the compute shader and the CPU renderer.
+// The GPU iterates float deltas against a reference orbit computed on the CPU in long double (perturbation),
+// starting past the iterations a third order series approximation can skip. The rgba8 image is addressed
+// modulo its size, panning only renders the tiles it uncovers; a zoom restarts every tile at the coarse
+// pass so the view stays interactive while it refines.
 class SceneMandelbrotSetGen : public Scene
 {
 public:
@@ -10,29 +17,66 @@ public:
 	~SceneMandelbrotSetGen() = default;
 
 	void Init() override;
+	void ProcessInput() override;
 	void Update() override;
 	void Render() override;
 
 private:
-	struct Uniform
+	struct TileSlot
 	{
-		uint32_t width;
-		uint32_t height;
+		Vector2i32 tile;
+		// step of the last finished pass, 0 when the slot holds nothing of this view
+		uint32_t step = 0;
 	};
 
-	Vector2i32 mWindowExtent;
+	void ResetView();
+	void ZoomAt(Vector2i32 screenPos, long double factor);
+	// reference orbit at the screen center and the series approximation covering the screen
+	void UpdateReference();
+	void InvalidateTiles();
+	void RenderTiles();
+	// the jobs through MandelbrotCpuRenderer into mCpuImageBuffer, then copied to their place in the compute image
+	void RenderTilesOnCpu(const std::vector<MandelbrotTileJob> &jobs);
+
+	Vector2u32 mWindowExtent;
+	Vector2u32 mBufferExtent;
+
+	// c of global pixel (0, 0) and the distance between two pixels, reset on every zoom
+	std::complex<long double> mAnchor;
+	long double mPixelScale;
+	Vector2i32 mOrigin;
+	uint32_t mMaxIterations;
+
+	Vector2i32 mReferencePixel;
+	MandelbrotReference mReference;
+	bool mReferenceDirty = true;
+
+	std::vector<TileSlot> mTileSlots;
+	// tile samples per frame, adapted to keep the compute work near the frame target
+	uint64_t mSampleBudget;
 
 	std::unique_ptr<DescriptorTable> mDescriptorTable;
 	DescriptorSet *mDescriptorSet;
 	std::unique_ptr<PipelineLayout> mPipelineLayout;
 
-	Uniform mUniform;
-	std::unique_ptr<UniformBuffer<Uniform>> mUniformBuffer;
+	MandelbrotUniform mUniform;
+	std::unique_ptr<UniformBuffer<MandelbrotUniform>> mUniformBuffer;
 
 	std::unique_ptr<ComputePipeline> mComputePipeline;
 	std::unique_ptr<ComputeCommandBuffer> mComputeCommandBuffer;
-	std::unique_ptr<Buffer> mComputeImgBuffer;
+	// written as a storage image, read by post.frag through a sampler, always in GENERAL layout
+	std::unique_ptr<GpuImage2D> mComputeImage;
+	std::unique_ptr<Sampler> mComputeImageSampler;
+	std::unique_ptr<CpuBuffer> mOrbitBuffer;
+	std::unique_ptr<CpuBuffer> mTileJobBuffer;
+
+	bool mUseCpu = false;
+	MandelbrotCpuRenderer mCpuRenderer;
+	// host copy of the whole wrapped image, created with the first CPU frame
+	std::unique_ptr<CpuBuffer> mCpuImageBuffer;
+
+	ReadbackTicket mCaptureTicket = INVALID_READBACK_TICKET;
 
 	std::unique_ptr<RasterPipeline> mRasterPipeline;
 	std::unique_ptr<RasterPass> mRasterPass;
-};
\ No newline at end of file
+};
@@ -15,7 +15,7 @@ void SceneRayTraceTriangle::Init()
 
 	std::cout << "Creating Offscreen Buffer.." << std::endl;
 
-	auto windowExtent = App::Instance().GetWindow()->GetExtent();
+	auto windowExtent = App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent();
 
 	mOffscreenImage2D = App::Instance().GetGraphicsContext()->GetDevice()->CreateCpuImage2D(windowExtent.x, windowExtent.y, App::Instance().GetGraphicsContext()->GetSwapChain()->GetFormat(), ImageTiling::LINEAR);
 
@@ -58,7 +58,7 @@ void SceneRayTraceTriangle::Init()
 										subResourceRange.baseArrayLayer = 0;
 										subResourceRange.layerCount = 1;
 
-										auto windowExtent = App::Instance().GetWindow()->GetExtent();
+										auto windowExtent = App::Instance().GetGraphicsContext()->GetSwapChain()->GetExtent();
 
 										VkImageCopy copyRegion{};
 										copyRegion.srcOffset = {0, 0, 0};
@@ -38,6 +38,8 @@ layout(set=0, binding=1) uniform ShadingUniforms
 {
     Light lights[NUM_LIGHTS];
     vec3 eyePosition;
+    // third order SH of the environment convolved with the clamped cosine over pi, see IrradianceSH.h
+    vec4 irradianceSH[9];
 };
 
 layout(set=1, binding=0) uniform sampler2D albedoTexture;
@@ -45,12 +47,14 @@ layout(set=1, binding=1) uniform sampler2D normalTexture;
 layout(set=1, binding=2) uniform sampler2D metalnessTexture;
 layout(set=1, binding=3) uniform sampler2D roughnessTexture;
 layout(set=1, binding=4) uniform samplerCube specularTexture;
-layout(set=1, binding=5) uniform samplerCube irradianceTexture;
-layout(set=1, binding=6) uniform sampler2D specularBRDF_LUT;
+layout(set=1, binding=5) uniform sampler2D specularBRDF_LUT;
 
 vec3 GetNormal(sampler2D map,vec2 uv)
 {
-    vec3 tangentNormal=texture(map,uv).xyz*2.0-1.0;
+    // two channel normal map (BC5 or RG8), z is rebuilt from the unit length
+    vec3 tangentNormal;
+    tangentNormal.xy=texture(map,uv).xy*2.0-1.0;
+    tangentNormal.z=sqrt(max(1.0-dot(tangentNormal.xy,tangentNormal.xy),0.0));
 
     vec3 q1=dFdx(inVertex.position);
     vec3 q2=dFdy(inVertex.position);
@@ -90,6 +94,20 @@ float GaSchlickGGX(float cosLi,float cosLo,float roughness)
     return GaSchlickG1(cosLi,k)*GaSchlickG1(cosLo,k);
 }
 
+// radiance off a white Lambertian surface facing n, y up like the environment cubemap
+vec3 EvaluateIrradianceSH(vec3 n)
+{
+    return irradianceSH[0].rgb*0.282095
+        +irradianceSH[1].rgb*(0.488603*n.y)
+        +irradianceSH[2].rgb*(0.488603*n.z)
+        +irradianceSH[3].rgb*(0.488603*n.x)
+        +irradianceSH[4].rgb*(1.092548*n.x*n.z)
+        +irradianceSH[5].rgb*(1.092548*n.y*n.z)
+        +irradianceSH[6].rgb*(0.315392*(3.0*n.y*n.y-1.0))
+        +irradianceSH[7].rgb*(1.092548*n.x*n.y)
+        +irradianceSH[8].rgb*(0.546274*(n.x*n.x-n.z*n.z));
+}
+
 vec3 FresnelSchlick(vec3 F0,float cosTheta)
 {
     return F0+(vec3(1.0)-F0)*pow(1.0-cosTheta,5.0);
@@ -141,7 +159,8 @@ void main()
     {
         vec3 diffuseDir=normalize(vec3(skyboxRotationMatrix*vec4(N,1.0)));
 
-        vec3 irradiance=texture(irradianceTexture,diffuseDir).rgb;
+        // third order SH rings below zero opposite small bright lights
+        vec3 irradiance=max(EvaluateIrradianceSH(diffuseDir),vec3(0.0));
         vec3 F=FresnelSchlick(F0,cosLo);
         vec3 kd=mix(vec3(1.0)-F,vec3(0.0),metalness);
         vec3 diffuseIBL=kd*albedo*irradiance;
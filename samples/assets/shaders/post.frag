@@ -1,22 +1,26 @@
 #version 450
 
-layout(std140,set=0, binding=0) buffer buf
-{
-    vec4 imageData[];
-};
+layout(set=0, binding=4) uniform sampler2D image;
 
 layout(std140,set=0, binding=1) uniform Uniform
 {
     uint width;
     uint height;
+    uint bufferWidth;
+    uint bufferHeight;
+    ivec2 origin;
 };
 
 layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragColor;
 
-void main() 
+void main()
 {
     ivec2 intUV=ivec2(inUV.x*width,inUV.y*height);
-    outFragColor = imageData[width*intUV.y+intUV.x];
-}
\ No newline at end of file
+    // the image wraps around, panning moves origin instead of the pixels
+    ivec2 g=origin+intUV;
+    ivec2 size=ivec2(bufferWidth,bufferHeight);
+    ivec2 slot=g-size*ivec2(floor(vec2(g)/vec2(size)));
+    outFragColor = texelFetch(image,slot,0);
+}
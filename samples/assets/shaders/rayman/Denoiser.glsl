@@ -0,0 +1,50 @@
+// Shared by the denoiser passes, see PostProcessPass::RecordDenoiser for the chain.
+
+struct DenoiserUniform
+{
+	uint iteration;
+	float colorPhi;
+	float normalPhi;
+	float positionPhi;
+	float stepWidth;
+	uint iterationCount;
+};
+
+const float DENOISER_EPSILON = 1e-6;
+// below this many samples per pixel the temporal moments are too noisy, the variance is taken over neighbors instead
+const float MIN_TEMPORAL_SAMPLES = 4.0;
+
+// B3 spline, the 1D taps of the 5x5 a-trous kernel
+const float KERNEL[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+float luminance(in vec3 rgb)
+{
+	return dot(rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// octahedral normal in two snorm16, 4 bytes a texel in the shared tile; 0 is kept for misses, which have no normal
+vec2 signNotZero(in vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+uint encodeNormal(in vec3 n)
+{
+	if (dot(n, n) < DENOISER_EPSILON)
+		return 0u;
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+	uint bits = packSnorm2x16(e);
+	return bits == 0u ? 1u : bits;
+}
+
+vec3 decodeNormal(in uint bits)
+{
+	if (bits == 0u)
+		return vec3(0.0);
+	vec2 e = unpackSnorm2x16(bits);
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0)
+		n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+	return normalize(n);
+}
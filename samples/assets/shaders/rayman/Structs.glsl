@@ -76,6 +76,10 @@ struct Uniform
 	uint frame;
 	float hdrResolution;
 	float hdrMultiplier;
+	// last frame's camera, see TemporalAccumulation.comp
+	mat4 prevView;
+	mat4 prevProj;
+	uint reproject;
 };
 struct LightSample
 {
@@ -105,4 +109,6 @@ struct RayPayload
 	bool stop;
 	float eta;
 	float distance;
+	// ray cone footprint at the last hit, picks the texture mips
+	float coneWidth;
 };
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "SceneSph.h"
 #include "SceneMandelbrotSetGen.h"
 #include "SceneRayTraceTriangle.h"
+#include "SceneDescriptorStress.h"
+#include "SceneASBenchmark.h"
 #include "ImguiScene.h"
 #include "PathTracer/RaymanScene.h"
 #include "Pbr/PbrScene.h"
@@ -17,6 +19,8 @@ public:
         // mScenes.emplace_back(std::make_unique<RaymanScene>(std::string(ASSETS_DIR) + "rayman/scene.json"));
 
         // mScenes.emplace_back(std::make_unique<SceneImgui>());
+        // mScenes.emplace_back(std::make_unique<SceneDescriptorStress>());
+        // mScenes.emplace_back(std::make_unique<SceneASBenchmark>());
         mScenes.emplace_back(std::make_unique<SceneRayTraceTriangle>());
     }
     ~SceneManager() override {}
@@ -55,6 +59,17 @@ private:
 
 int main(int argc, char **argv)
 {
+    // --headless [frameCount] [outputDir] renders offscreen without a window, for CI and render farm nodes
+    if (argc > 1 && std::string(argv[1]) == "--headless")
+    {
+        HeadlessSettings settings;
+        if (argc > 2)
+            settings.frameCount = (uint32_t)std::stoul(argv[2]);
+        if (argc > 3)
+            settings.outputDir = argv[3];
+        App::Instance().SetHeadless(settings);
+    }
+
     App::Instance().AddScene(new SceneManager());
     App::Instance().Run();
 